@@ -0,0 +1,198 @@
+/*
+ * Copyright 2012-2016 Moritz Hilscher
+ *
+ * This file is part of Mapcrafter.
+ *
+ * Mapcrafter is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mapcrafter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mapcrafter.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "bench.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace {
+
+std::atomic<uint64_t> allocation_count(0);
+std::atomic<uint64_t> allocation_bytes(0);
+
+void* countedAllocate(std::size_t size) {
+	allocation_count.fetch_add(1, std::memory_order_relaxed);
+	allocation_bytes.fetch_add(size, std::memory_order_relaxed);
+	void* ptr = std::malloc(size == 0 ? 1 : size);
+	if (ptr == nullptr)
+		throw std::bad_alloc();
+	return ptr;
+}
+
+}
+
+// the replaced allocation functions are used by libmapcraftercore as well
+void* operator new(std::size_t size) {
+	return countedAllocate(size);
+}
+
+void* operator new[](std::size_t size) {
+	return countedAllocate(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+	try {
+		return countedAllocate(size);
+	} catch (const std::bad_alloc&) {
+		return nullptr;
+	}
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+	try {
+		return countedAllocate(size);
+	} catch (const std::bad_alloc&) {
+		return nullptr;
+	}
+}
+
+void operator delete(void* ptr) noexcept {
+	std::free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+	std::free(ptr);
+}
+
+void operator delete(void* ptr, const std::nothrow_t&) noexcept {
+	std::free(ptr);
+}
+
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept {
+	std::free(ptr);
+}
+
+namespace mapcrafter {
+namespace bench {
+
+AllocationStats getAllocationStats() {
+	AllocationStats stats;
+	stats.count = allocation_count.load(std::memory_order_relaxed);
+	stats.bytes = allocation_bytes.load(std::memory_order_relaxed);
+	return stats;
+}
+
+BenchmarkState::BenchmarkState(const BenchmarkOptions& options)
+	: options(options), running(false), paused(false), iterations(0),
+	  elapsed(clock::duration::zero()), items(0) {
+	allocations_start = allocations = {0, 0};
+}
+
+BenchmarkState::~BenchmarkState() {
+}
+
+const BenchmarkOptions& BenchmarkState::getOptions() const {
+	return options;
+}
+
+bool BenchmarkState::run() {
+	if (!running) {
+		running = true;
+		resume();
+		return true;
+	}
+
+	iterations++;
+	// check the elapsed time without stopping the clock
+	clock::duration total = elapsed;
+	if (!paused)
+		total += clock::now() - start;
+	if (std::chrono::duration<double>(total).count() < options.min_time)
+		return true;
+
+	pause();
+	running = false;
+	return false;
+}
+
+void BenchmarkState::pause() {
+	if (paused)
+		return;
+	elapsed += clock::now() - start;
+	AllocationStats now = getAllocationStats();
+	allocations.count += now.count - allocations_start.count;
+	allocations.bytes += now.bytes - allocations_start.bytes;
+	paused = true;
+}
+
+void BenchmarkState::resume() {
+	paused = false;
+	allocations_start = getAllocationStats();
+	start = clock::now();
+}
+
+void BenchmarkState::setItemsPerIteration(double items, const std::string& unit) {
+	this->items = items;
+	this->items_unit = unit;
+}
+
+void BenchmarkState::setCounter(const std::string& name, double value) {
+	counters[name] = value;
+}
+
+int BenchmarkState::getIterations() const {
+	return iterations;
+}
+
+double BenchmarkState::getElapsedTime() const {
+	return std::chrono::duration<double>(elapsed).count();
+}
+
+double BenchmarkState::getItemsPerIteration() const {
+	return items;
+}
+
+const std::string& BenchmarkState::getItemsUnit() const {
+	return items_unit;
+}
+
+const AllocationStats& BenchmarkState::getAllocations() const {
+	return allocations;
+}
+
+const std::map<std::string, double>& BenchmarkState::getCounters() const {
+	return counters;
+}
+
+namespace {
+
+std::vector<Benchmark>& getBenchmarkRegistry() {
+	static std::vector<Benchmark> benchmarks;
+	return benchmarks;
+}
+
+}
+
+std::vector<Benchmark> getBenchmarks() {
+	std::vector<Benchmark> benchmarks = getBenchmarkRegistry();
+	std::sort(benchmarks.begin(), benchmarks.end(), [](const Benchmark& b1, const Benchmark& b2) {
+		return b1.name < b2.name;
+	});
+	return benchmarks;
+}
+
+BenchmarkRegistrar::BenchmarkRegistrar(const std::string& name, BenchmarkFunction function) {
+	getBenchmarkRegistry().push_back({name, function});
+}
+
+}
+}
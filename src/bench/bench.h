@@ -0,0 +1,150 @@
+/*
+ * Copyright 2012-2016 Moritz Hilscher
+ *
+ * This file is part of Mapcrafter.
+ *
+ * Mapcrafter is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mapcrafter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mapcrafter.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BENCH_H_
+#define BENCH_H_
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+#include <boost/filesystem.hpp>
+
+namespace fs = boost::filesystem;
+
+namespace mapcrafter {
+namespace bench {
+
+/**
+ * Number of heap allocations and allocated bytes since program start. Counted by the
+ * replaced global operator new of the benchmark executable.
+ */
+struct AllocationStats {
+	uint64_t count;
+	uint64_t bytes;
+};
+
+AllocationStats getAllocationStats();
+
+/**
+ * Settings that are shared by all benchmarks.
+ */
+struct BenchmarkOptions {
+	// minimum time in seconds a benchmark is repeated
+	double min_time;
+	// side length in chunks of the generated synthetic world
+	int world_size;
+	// number of threads used by the end-to-end benchmarks
+	int jobs;
+
+	fs::path block_dir, template_dir;
+	// temporary directory for generated worlds and rendered tiles
+	fs::path work_dir;
+};
+
+/**
+ * Passed to every benchmark. The timed part of a benchmark is written as loop:
+ *
+ *   while (state.run()) {
+ *     ...
+ *   }
+ *
+ * The loop is repeated until at least the minimum time has elapsed. Setup work inside
+ * the loop can be excluded from the measurement with pause() and resume().
+ */
+class BenchmarkState {
+public:
+	BenchmarkState(const BenchmarkOptions& options);
+	~BenchmarkState();
+
+	const BenchmarkOptions& getOptions() const;
+
+	bool run();
+
+	void pause();
+	void resume();
+
+	/**
+	 * Sets how many items (for example blocks, pixels or tiles) one iteration processes.
+	 */
+	void setItemsPerIteration(double items, const std::string& unit);
+
+	/**
+	 * Sets an additional value that is reported with the results.
+	 */
+	void setCounter(const std::string& name, double value);
+
+	int getIterations() const;
+	double getElapsedTime() const;
+	double getItemsPerIteration() const;
+	const std::string& getItemsUnit() const;
+	const AllocationStats& getAllocations() const;
+	const std::map<std::string, double>& getCounters() const;
+
+private:
+	typedef std::chrono::steady_clock clock;
+
+	const BenchmarkOptions& options;
+
+	bool running, paused;
+	int iterations;
+	clock::time_point start;
+	clock::duration elapsed;
+	AllocationStats allocations_start, allocations;
+
+	double items;
+	std::string items_unit;
+	std::map<std::string, double> counters;
+};
+
+typedef void (*BenchmarkFunction)(BenchmarkState& state);
+
+struct Benchmark {
+	std::string name;
+	BenchmarkFunction function;
+};
+
+/**
+ * Returns all registered benchmarks in order of their names.
+ */
+std::vector<Benchmark> getBenchmarks();
+
+class BenchmarkRegistrar {
+public:
+	BenchmarkRegistrar(const std::string& name, BenchmarkFunction function);
+};
+
+/**
+ * Keeps the compiler from optimizing away a computed value.
+ */
+template <typename T>
+inline void doNotOptimize(const T& value) {
+	asm volatile("" : : "r,m"(value) : "memory");
+}
+
+}
+}
+
+#define MAPCRAFTER_BENCHMARK(name) \
+	static void bench_##name(mapcrafter::bench::BenchmarkState& state); \
+	static mapcrafter::bench::BenchmarkRegistrar bench_registrar_##name(#name, bench_##name); \
+	static void bench_##name(mapcrafter::bench::BenchmarkState& state)
+
+#endif /* BENCH_H_ */
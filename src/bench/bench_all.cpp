@@ -0,0 +1,190 @@
+/*
+ * Copyright 2012-2016 Moritz Hilscher
+ *
+ * This file is part of Mapcrafter.
+ *
+ * Mapcrafter is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mapcrafter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mapcrafter.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "bench.h"
+
+#include "../mapcraftercore/renderer/biomes.h"
+#include "../mapcraftercore/util.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <boost/program_options.hpp>
+
+namespace po = boost::program_options;
+namespace util = mapcrafter::util;
+
+using namespace mapcrafter::bench;
+
+namespace {
+
+/**
+ * Returns a resource directory of the source tree if no installed one can be found.
+ */
+fs::path findDataDir(const fs::path& found, const std::string& name) {
+	if (!found.empty())
+		return found;
+	return fs::path(MAPCRAFTER_BENCH_DATA_DIR) / name;
+}
+
+std::string formatTime(double seconds) {
+	std::stringstream ss;
+	ss << std::fixed << std::setprecision(2);
+	if (seconds < 1e-6)
+		ss << seconds * 1e9 << " ns";
+	else if (seconds < 1e-3)
+		ss << seconds * 1e6 << " us";
+	else if (seconds < 1)
+		ss << seconds * 1e3 << " ms";
+	else
+		ss << seconds << " s";
+	return ss.str();
+}
+
+}
+
+int main(int argc, char** argv) {
+	BenchmarkOptions options;
+	std::string filter, json_file;
+	fs::path block_dir, template_dir;
+
+	po::options_description all("Allowed options");
+	all.add_options()
+		("help,h", "shows this help message")
+		("list", "lists the available benchmarks")
+		("filter,f", po::value<std::string>(&filter),
+			"runs only the benchmarks whose name contains this string")
+		("min-time", po::value<double>(&options.min_time)->default_value(1.0),
+			"the minimum time in seconds each benchmark is repeated")
+		("world-size", po::value<int>(&options.world_size)->default_value(8),
+			"the side length in chunks of the generated synthetic world")
+		("jobs,j", po::value<int>(&options.jobs)->default_value(1),
+			"the count of threads to use for the end-to-end benchmarks")
+		("block-dir", po::value<fs::path>(&block_dir),
+			"the block image directory to use (automatically determined if not specified)")
+		("template-dir", po::value<fs::path>(&template_dir),
+			"the template directory to use (automatically determined if not specified)")
+		("json", po::value<std::string>(&json_file),
+			"writes the results also as json to this file");
+
+	po::variables_map vm;
+	try {
+		po::store(po::parse_command_line(argc, argv, all), vm);
+	} catch (po::error& ex) {
+		std::cerr << "There is a problem parsing the command line arguments: "
+				<< ex.what() << std::endl << std::endl;
+		std::cerr << all << std::endl;
+		return 1;
+	}
+	po::notify(vm);
+
+	if (vm.count("help")) {
+		std::cout << all << std::endl;
+		return 0;
+	}
+
+	std::vector<Benchmark> benchmarks = getBenchmarks();
+	if (vm.count("list")) {
+		for (auto it = benchmarks.begin(); it != benchmarks.end(); ++it)
+			std::cout << it->name << std::endl;
+		return 0;
+	}
+
+	if (options.world_size < 1 || options.world_size > 32) {
+		std::cerr << "The world size must be between 1 and 32 chunks!" << std::endl;
+		return 1;
+	}
+
+	options.block_dir = block_dir.empty() ? findDataDir(util::findBlockDir(), "blocks") : block_dir;
+	options.template_dir = template_dir.empty() ? findDataDir(util::findTemplateDir(), "template") : template_dir;
+	options.work_dir = fs::temp_directory_path() / fs::unique_path("mapcrafter-bench-%%%%-%%%%");
+	fs::create_directories(options.work_dir);
+
+	// the renderer logs a lot of progress information
+	util::Logging::getInstance().setSinkVerbosity("__output__", util::LogLevel::WARNING);
+	// chunks need the biome names when they are read
+	mapcrafter::renderer::Biome::initializeBiomes();
+
+	std::cout << std::left << std::setw(28) << "benchmark" << std::right
+		<< std::setw(10) << "iters" << std::setw(14) << "time/iter"
+		<< std::setw(22) << "throughput"
+		<< std::setw(14) << "allocs/iter" << std::setw(14) << "bytes/iter" << std::endl;
+
+	picojson::array results;
+	int failed = 0;
+	for (auto it = benchmarks.begin(); it != benchmarks.end(); ++it) {
+		if (!filter.empty() && it->name.find(filter) == std::string::npos)
+			continue;
+
+		BenchmarkState state(options);
+		try {
+			it->function(state);
+		} catch (std::exception& ex) {
+			std::cout << std::left << std::setw(28) << it->name << "failed: " << ex.what() << std::endl;
+			failed++;
+			continue;
+		}
+
+		int iterations = std::max(state.getIterations(), 1);
+		double time = state.getElapsedTime() / iterations;
+		double allocs = (double) state.getAllocations().count / iterations;
+		double bytes = (double) state.getAllocations().bytes / iterations;
+		double throughput = state.getItemsPerIteration() / time;
+
+		std::stringstream throughput_str;
+		throughput_str << std::fixed << std::setprecision(throughput < 100 ? 2 : 0)
+			<< throughput << " " << state.getItemsUnit() << "/s";
+		std::cout << std::left << std::setw(28) << it->name << std::right
+			<< std::setw(10) << state.getIterations()
+			<< std::setw(14) << formatTime(time)
+			<< std::setw(22) << throughput_str.str()
+			<< std::fixed << std::setprecision(1)
+			<< std::setw(14) << allocs << std::setw(14) << std::setprecision(0) << bytes;
+		auto counters = state.getCounters();
+		for (auto counter = counters.begin(); counter != counters.end(); ++counter)
+			std::cout << "  " << counter->first << "=" << counter->second;
+		std::cout << std::endl;
+
+		picojson::object result;
+		result["name"] = picojson::value(it->name);
+		result["iterations"] = picojson::value((double) state.getIterations());
+		result["time_per_iteration"] = picojson::value(time);
+		result["items_per_second"] = picojson::value(throughput);
+		result["items_unit"] = picojson::value(state.getItemsUnit());
+		result["allocations_per_iteration"] = picojson::value(allocs);
+		result["allocated_bytes_per_iteration"] = picojson::value(bytes);
+		for (auto counter = counters.begin(); counter != counters.end(); ++counter)
+			result[counter->first] = picojson::value(counter->second);
+		results.push_back(picojson::value(result));
+	}
+
+	fs::remove_all(options.work_dir);
+
+	if (!json_file.empty()) {
+		std::ofstream out(json_file);
+		out << picojson::value(results).serialize(true);
+		if (!out) {
+			std::cerr << "Unable to write json file " << json_file << "!" << std::endl;
+			return 1;
+		}
+	}
+	return failed == 0 ? 0 : 1;
+}
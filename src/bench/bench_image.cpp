@@ -0,0 +1,219 @@
+/*
+ * Copyright 2012-2016 Moritz Hilscher
+ *
+ * This file is part of Mapcrafter.
+ *
+ * Mapcrafter is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mapcrafter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mapcrafter.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "bench.h"
+
+#include "../mapcraftercore/config.h"
+#include "../mapcraftercore/renderer/image.h"
+#include "../mapcraftercore/renderer/image/quantization.h"
+#include "../mapcraftercore/renderer/image/scaling.h"
+
+#include <vector>
+
+namespace renderer = mapcrafter::renderer;
+
+using namespace mapcrafter::bench;
+using renderer::RGBAImage;
+using renderer::RGBAPixel;
+
+namespace {
+
+const int TILE_SIZE = 512;
+const int BLOCK_SIZE = 16;
+
+/**
+ * Small deterministic pseudo random number generator, the images of the benchmarks
+ * must not depend on the standard library implementation.
+ */
+class Random {
+public:
+	Random(uint32_t seed) : state(seed) {}
+
+	uint32_t next() {
+		state = state * 1664525 + 1013904223;
+		return state >> 8;
+	}
+
+private:
+	uint32_t state;
+};
+
+/**
+ * Creates an image that looks roughly like a rendered tile: shaded areas of a few
+ * dozen base colors with some noise and a transparent corner.
+ */
+RGBAImage createTileImage(int size) {
+	Random random(42);
+	std::vector<RGBAPixel> colors;
+	for (int i = 0; i < 48; i++)
+		colors.push_back(renderer::rgba(random.next() % 256, random.next() % 256, random.next() % 256));
+
+	RGBAImage image(size, size);
+	for (int y = 0; y < size; y++) {
+		for (int x = 0; x < size; x++) {
+			if (x + y < size / 4)
+				continue;
+			RGBAPixel color = colors[((x / BLOCK_SIZE) * 7 + (y / (BLOCK_SIZE / 2)) * 13) % colors.size()];
+			int shade = 160 + (x % BLOCK_SIZE) * 4 + random.next() % 32;
+			image.setPixel(x, y, renderer::rgba_multiply_scalar(color, std::min(shade, 255)));
+		}
+	}
+	return image;
+}
+
+/**
+ * Creates a block image with a transparent border and semi-transparent pixels.
+ */
+RGBAImage createBlockImage() {
+	Random random(23);
+	RGBAImage image(BLOCK_SIZE, BLOCK_SIZE);
+	for (int y = 0; y < BLOCK_SIZE; y++) {
+		for (int x = 0; x < BLOCK_SIZE; x++) {
+			if (std::abs(2 * x - BLOCK_SIZE + 1) + std::abs(4 * y - 2 * BLOCK_SIZE + 2) > 2 * BLOCK_SIZE)
+				continue;
+			uint8_t alpha = (x + y) % 5 == 0 ? 128 : 255;
+			image.setPixel(x, y, renderer::rgba(random.next() % 256, random.next() % 256,
+					random.next() % 256, alpha));
+		}
+	}
+	return image;
+}
+
+std::string getOutputFile(const BenchmarkState& state, const std::string& filename) {
+	fs::create_directories(state.getOptions().work_dir / "images");
+	return (state.getOptions().work_dir / "images" / filename).string();
+}
+
+}
+
+MAPCRAFTER_BENCHMARK(image_alpha_blit) {
+	RGBAImage block = createBlockImage();
+	RGBAImage tile(TILE_SIZE, TILE_SIZE);
+	int blocks = (TILE_SIZE / BLOCK_SIZE) * (TILE_SIZE / BLOCK_SIZE) * 2;
+	state.setItemsPerIteration(blocks, "blocks");
+
+	while (state.run()) {
+		tile.clear();
+		// overlapping like the blocks of a tile
+		for (int y = 0; y < TILE_SIZE; y += BLOCK_SIZE / 2)
+			for (int x = 0; x < TILE_SIZE; x += BLOCK_SIZE)
+				tile.alphaBlit(block, x + (y / 8) % 2 * BLOCK_SIZE / 2, y);
+		doNotOptimize(tile.data[0]);
+	}
+}
+
+MAPCRAFTER_BENCHMARK(image_resize_half) {
+	RGBAImage tile = createTileImage(TILE_SIZE);
+	RGBAImage half;
+	state.setItemsPerIteration(TILE_SIZE * TILE_SIZE, "pixels");
+
+	while (state.run()) {
+		renderer::imageResizeHalf(tile, half);
+		doNotOptimize(half.data[0]);
+	}
+}
+
+MAPCRAFTER_BENCHMARK(image_write_png) {
+	RGBAImage tile = createTileImage(TILE_SIZE);
+	std::string filename = getOutputFile(state, "tile.png");
+	state.setItemsPerIteration(1, "tiles");
+
+	while (state.run())
+		tile.writePNG(filename);
+	state.setCounter("file_bytes", fs::file_size(filename));
+}
+
+MAPCRAFTER_BENCHMARK(image_write_png_fast_deflate) {
+	RGBAImage tile = createTileImage(TILE_SIZE);
+	std::string filename = getOutputFile(state, "tile_fast.png");
+	renderer::PNGEncodingOptions options(6, renderer::PNGFilter::ALL, true);
+	state.setItemsPerIteration(1, "tiles");
+
+	while (state.run())
+		tile.writePNG(filename, options);
+	state.setCounter("file_bytes", fs::file_size(filename));
+}
+
+MAPCRAFTER_BENCHMARK(image_write_png_filter_up) {
+	RGBAImage tile = createTileImage(TILE_SIZE);
+	std::string filename = getOutputFile(state, "tile_up.png");
+	renderer::PNGEncodingOptions options(6, renderer::PNGFilter::UP);
+	state.setItemsPerIteration(1, "tiles");
+
+	while (state.run())
+		tile.writePNG(filename, options);
+	state.setCounter("file_bytes", fs::file_size(filename));
+}
+
+MAPCRAFTER_BENCHMARK(image_write_jpeg) {
+	RGBAImage tile = createTileImage(TILE_SIZE);
+	std::string filename = getOutputFile(state, "tile.jpg");
+	state.setItemsPerIteration(1, "tiles");
+
+	while (state.run())
+		tile.writeJPEG(filename, 85);
+	state.setCounter("file_bytes", fs::file_size(filename));
+}
+
+#ifdef HAVE_WEBP
+
+MAPCRAFTER_BENCHMARK(image_write_webp_lossless) {
+	RGBAImage tile = createTileImage(TILE_SIZE);
+	std::string filename = getOutputFile(state, "tile_lossless.webp");
+	state.setItemsPerIteration(1, "tiles");
+
+	while (state.run())
+		tile.writeWebP(filename, 85, true);
+	state.setCounter("file_bytes", fs::file_size(filename));
+}
+
+MAPCRAFTER_BENCHMARK(image_write_webp_lossy) {
+	RGBAImage tile = createTileImage(TILE_SIZE);
+	std::string filename = getOutputFile(state, "tile_lossy.webp");
+	state.setItemsPerIteration(1, "tiles");
+
+	while (state.run())
+		tile.writeWebP(filename, 85, false);
+	state.setCounter("file_bytes", fs::file_size(filename));
+}
+
+#endif
+
+MAPCRAFTER_BENCHMARK(image_write_indexed_png) {
+	RGBAImage tile = createTileImage(TILE_SIZE);
+	std::string filename = getOutputFile(state, "tile_indexed.png");
+	state.setItemsPerIteration(1, "tiles");
+
+	while (state.run())
+		tile.writeIndexedPNG(filename, 8, true);
+	state.setCounter("file_bytes", fs::file_size(filename));
+}
+
+MAPCRAFTER_BENCHMARK(image_quantize_octree) {
+	RGBAImage tile = createTileImage(TILE_SIZE);
+	std::vector<RGBAPixel> colors;
+	state.setItemsPerIteration(TILE_SIZE * TILE_SIZE, "pixels");
+
+	while (state.run()) {
+		colors.clear();
+		renderer::octreeColorQuantize(tile, 256, colors);
+		doNotOptimize(colors[0]);
+	}
+	state.setCounter("colors", colors.size());
+}
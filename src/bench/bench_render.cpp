@@ -0,0 +1,246 @@
+/*
+ * Copyright 2012-2016 Moritz Hilscher
+ *
+ * This file is part of Mapcrafter.
+ *
+ * Mapcrafter is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mapcrafter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mapcrafter.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "bench.h"
+#include "syntheticworld.h"
+
+#include "../mapcraftercore/config/mapcrafterconfig.h"
+#include "../mapcraftercore/mc/blockstate.h"
+#include "../mapcraftercore/mc/world.h"
+#include "../mapcraftercore/mc/worldcache.h"
+#include "../mapcraftercore/renderer/biomes.h"
+#include "../mapcraftercore/renderer/blockimages.h"
+#include "../mapcraftercore/renderer/manager.h"
+#include "../mapcraftercore/renderer/rendermode.h"
+#include "../mapcraftercore/renderer/renderview.h"
+#include "../mapcraftercore/renderer/renderviews/isometricnew/tilerenderer.h"
+#include "../mapcraftercore/renderer/tileset.h"
+#include "../mapcraftercore/util.h"
+
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+namespace config = mapcrafter::config;
+namespace mc = mapcrafter::mc;
+namespace renderer = mapcrafter::renderer;
+namespace util = mapcrafter::util;
+
+using namespace mapcrafter::bench;
+
+namespace {
+
+/**
+ * Creates the configuration of a map of the synthetic world.
+ */
+config::MapcrafterConfig createConfig(const BenchmarkOptions& options,
+		const fs::path& output_dir, const std::string& render_view) {
+	std::stringstream ss;
+	ss << "output_dir = " << output_dir.string() << std::endl;
+	ss << "template_dir = " << options.template_dir.string() << std::endl;
+	ss << "[world:world]" << std::endl;
+	ss << "input_dir = " << getBenchmarkWorld(options).string() << std::endl;
+	ss << "[map:map]" << std::endl;
+	ss << "world = world" << std::endl;
+	ss << "render_view = " << render_view << std::endl;
+	ss << "block_dir = " << options.block_dir.string() << std::endl;
+	ss << "rotations = top-left" << std::endl;
+
+	config::MapcrafterConfig config;
+	config::ValidationMap validation = config.parseString(ss.str());
+	if (validation.isCritical()) {
+		validation.log();
+		throw std::runtime_error("Invalid benchmark configuration!");
+	}
+	return config;
+}
+
+/**
+ * Everything a tile renderer of a map of the synthetic world needs.
+ */
+class RenderSetup {
+public:
+	RenderSetup(const BenchmarkOptions& options, const std::string& view,
+			renderer::RenderRotation::Direction rotation)
+		: config(createConfig(options, options.work_dir / "output", view)),
+		  world_config(config.getWorld("world")), map_config(config.getMap("map")),
+		  world(world_config.getInputDir().string(), world_config.getDimension(),
+				  config.getCachePath("world").string()),
+		  world_cache(block_registry, world) {
+		if (!world.load())
+			throw std::runtime_error("Unable to load synthetic world!");
+
+		render_view.reset(renderer::createRenderView(
+				map_config.getRenderView(), rotation, map_config.getWaterOpacity()));
+		block_images.reset(render_view->createBlockImages(block_registry));
+		render_view->configureBlockImages(block_images.get(), world_config, map_config);
+		renderer::RenderedBlockImages* rendered_block_images =
+			dynamic_cast<renderer::RenderedBlockImages*>(block_images.get());
+		if (rendered_block_images == nullptr || !rendered_block_images->loadBlockImages(
+				map_config.getBlockDir().string(), util::str(map_config.getRenderView()),
+				rotation, map_config.getTextureSize()))
+			throw std::runtime_error("Unable to load block images!");
+		renderer::Biome::initializeBiomes();
+
+		render_mode.reset(renderer::createRenderMode(
+				world_config, map_config, render_view->getRotation()));
+	}
+
+	config::MapcrafterConfig config;
+	config::WorldSection world_config;
+	config::MapSection map_config;
+
+	mc::BlockStateRegistry block_registry;
+	mc::World world;
+	mc::WorldCache world_cache;
+	std::unique_ptr<renderer::RenderView> render_view;
+	std::unique_ptr<renderer::BlockImages> block_images;
+	std::unique_ptr<renderer::RenderMode> render_mode;
+};
+
+/**
+ * Isometric tile renderer that makes the rendering of single block columns accessible.
+ */
+class ColumnTileRenderer : public renderer::NewIsometricTileRenderer {
+public:
+	ColumnTileRenderer(const renderer::RenderView* render_view,
+			mc::BlockStateRegistry& block_registry, renderer::BlockImages* images,
+			int tile_width, mc::WorldCache* world, renderer::RenderMode* render_mode)
+		: NewIsometricTileRenderer(render_view, block_registry, images, tile_width,
+				world, render_mode) {
+	}
+
+	void renderColumn(int x, int y, const mc::BlockPos& top,
+			boost::container::vector<renderer::TileImage>& tile_images) {
+		mc::BlockDir dir = render_view->getRotation().rotate(mc::DIR_NORTH + mc::DIR_EAST + mc::DIR_BOTTOM);
+		renderBlocks(x, y, top, dir, tile_images);
+	}
+};
+
+}
+
+MAPCRAFTER_BENCHMARK(render_blocks) {
+	const BenchmarkOptions& options = state.getOptions();
+	RenderSetup setup(options, "isometric", renderer::RenderRotation::TOP_LEFT);
+	ColumnTileRenderer tile_renderer(setup.render_view.get(), setup.block_registry,
+			setup.block_images.get(), setup.map_config.getTileWidth(), &setup.world_cache,
+			setup.render_mode.get());
+	setup.render_view->configureTileRenderer(&tile_renderer, setup.world_config,
+			setup.map_config);
+
+	// the columns start above the terrain and go down diagonally, place them so they
+	// reach the terrain (about y=64) in the middle of the world
+	const int column_y = 96;
+	int center = options.world_size * 8, offset = column_y - 64;
+	mc::BlockPos column_start(center - offset - 8, center + offset - 8, column_y);
+	boost::container::vector<renderer::TileImage> tile_images;
+	state.setItemsPerIteration(16 * 16, "columns");
+
+	while (state.run()) {
+		tile_images.clear();
+		for (int z = 0; z < 16; z++)
+			for (int x = 0; x < 16; x++)
+				tile_renderer.renderColumn(0, 0, column_start + mc::BlockDir(x, z, 0), tile_images);
+		doNotOptimize(tile_images.size());
+	}
+	state.setCounter("tile_images", tile_images.size());
+}
+
+namespace {
+
+/**
+ * Renders the tiles that contain the center chunk of the synthetic world.
+ */
+void renderTiles(BenchmarkState& state, const std::string& view,
+		renderer::RenderRotation::Direction rotation) {
+	const BenchmarkOptions& options = state.getOptions();
+	RenderSetup setup(options, view, rotation);
+	std::unique_ptr<renderer::TileRenderer> tile_renderer(setup.render_view->createTileRenderer(
+			setup.block_registry, setup.block_images.get(), setup.map_config.getTileWidth(),
+			&setup.world_cache, setup.render_mode.get()));
+	setup.render_view->configureTileRenderer(tile_renderer.get(), setup.world_config,
+			setup.map_config);
+
+	std::unique_ptr<renderer::TileSet> tile_set(setup.render_view->createTileSet(
+			setup.map_config.getTileWidth()));
+	std::vector<renderer::TilePos> tiles;
+	mc::ChunkPos center(options.world_size / 2, options.world_size / 2);
+	tile_set->mapChunkToTiles(center, tiles);
+	state.setItemsPerIteration(tiles.size(), "tiles");
+
+	renderer::RGBAImage tile;
+	while (state.run()) {
+		for (auto it = tiles.begin(); it != tiles.end(); ++it)
+			tile_renderer->renderTile(*it, tile);
+		doNotOptimize(tile.data);
+	}
+}
+
+}
+
+MAPCRAFTER_BENCHMARK(render_tile_isometric) {
+	renderTiles(state, "isometric", renderer::RenderRotation::TOP_LEFT);
+}
+
+MAPCRAFTER_BENCHMARK(render_tile_isometric_rotated) {
+	renderTiles(state, "isometric", renderer::RenderRotation::BOTTOM_RIGHT);
+}
+
+MAPCRAFTER_BENCHMARK(render_tile_topdown) {
+	renderTiles(state, "topdown", renderer::RenderRotation::TOP_LEFT);
+}
+
+namespace {
+
+void renderWorld(BenchmarkState& state, const std::string& render_view) {
+	const BenchmarkOptions& options = state.getOptions();
+	fs::path output_dir = options.work_dir / ("output_" + render_view);
+	config::MapcrafterConfig config = createConfig(options, output_dir, render_view);
+
+	int tiles = 0;
+	while (state.run()) {
+		state.pause();
+		fs::remove_all(output_dir);
+		state.resume();
+
+		renderer::RenderManager manager(config);
+		manager.setRenderBehaviors(renderer::RenderBehaviors(renderer::RenderBehavior::FORCE));
+		if (!manager.run(options.jobs, true))
+			throw std::runtime_error("Unable to render synthetic world!");
+
+		state.pause();
+		tiles = 0;
+		for (fs::recursive_directory_iterator it(output_dir / "map"), end; it != end; ++it)
+			if (it->path().extension() == ".png")
+				tiles++;
+		state.resume();
+	}
+	state.setItemsPerIteration(tiles, "tiles");
+}
+
+}
+
+MAPCRAFTER_BENCHMARK(render_world_isometric) {
+	renderWorld(state, "isometric");
+}
+
+MAPCRAFTER_BENCHMARK(render_world_topdown) {
+	renderWorld(state, "topdown");
+}
@@ -0,0 +1,112 @@
+/*
+ * Copyright 2012-2016 Moritz Hilscher
+ *
+ * This file is part of Mapcrafter.
+ *
+ * Mapcrafter is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mapcrafter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mapcrafter.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "bench.h"
+#include "syntheticworld.h"
+
+#include "../mapcraftercore/mc/blockstate.h"
+#include "../mapcraftercore/mc/chunk.h"
+#include "../mapcraftercore/mc/nbt.h"
+#include "../mapcraftercore/mc/region.h"
+#include "../mapcraftercore/mc/world.h"
+#include "../mapcraftercore/renderer/renderviews/isometricnew/tileset.h"
+
+#include <vector>
+
+namespace mc = mapcrafter::mc;
+namespace nbt = mapcrafter::mc::nbt;
+namespace renderer = mapcrafter::renderer;
+
+using namespace mapcrafter::bench;
+
+namespace {
+
+// a chunk in the middle of the synthetic world (with trees, water and light)
+const mc::ChunkPos BENCH_CHUNK(3, 2);
+
+}
+
+MAPCRAFTER_BENCHMARK(nbt_decode) {
+	std::vector<uint8_t> data = SyntheticWorld().createChunkData(BENCH_CHUNK);
+	state.setItemsPerIteration(1, "chunks");
+	state.setCounter("compressed_bytes", data.size());
+
+	while (state.run()) {
+		nbt::NBTFile nbt;
+		nbt.readNBT(reinterpret_cast<const char*>(&data[0]), data.size(), nbt::Compression::ZLIB);
+		doNotOptimize(nbt);
+	}
+}
+
+MAPCRAFTER_BENCHMARK(chunk_read_nbt) {
+	std::vector<uint8_t> data = SyntheticWorld().createChunkData(BENCH_CHUNK);
+	mc::BlockStateRegistry block_registry;
+	mc::Chunk chunk;
+	state.setItemsPerIteration(1, "chunks");
+
+	while (state.run()) {
+		chunk.readNBT(block_registry, reinterpret_cast<const char*>(&data[0]), data.size(),
+				nbt::Compression::ZLIB);
+		doNotOptimize(chunk);
+	}
+}
+
+MAPCRAFTER_BENCHMARK(region_read) {
+	std::string filename = (getBenchmarkWorld(state.getOptions()) / "region" / "r.0.0.mca").string();
+	mc::RegionFile region(filename);
+	region.read();
+	state.setItemsPerIteration(region.getContainingChunksCount(), "chunks");
+
+	while (state.run()) {
+		region.read();
+		doNotOptimize(region);
+	}
+}
+
+MAPCRAFTER_BENCHMARK(region_load_chunks) {
+	std::string filename = (getBenchmarkWorld(state.getOptions()) / "region" / "r.0.0.mca").string();
+	mc::BlockStateRegistry block_registry;
+	mc::RegionFile region(filename);
+	region.read();
+	const mc::RegionFile::ChunkMap& chunks = region.getContainingChunks();
+	state.setItemsPerIteration(chunks.size(), "chunks");
+
+	mc::Chunk chunk;
+	while (state.run()) {
+		for (auto it = chunks.begin(); it != chunks.end(); ++it) {
+			region.loadChunk(*it, block_registry, chunk);
+			doNotOptimize(chunk);
+		}
+	}
+}
+
+MAPCRAFTER_BENCHMARK(tileset_scan) {
+	const BenchmarkOptions& options = state.getOptions();
+	mc::World world(getBenchmarkWorld(options).string(), mc::Dimension::OVERWORLD,
+			(options.work_dir / "cache").string());
+	world.load();
+	renderer::RenderRotation rotation(renderer::RenderRotation::TOP_LEFT);
+	state.setItemsPerIteration(world.getAvailableRegionCount(), "regions");
+
+	while (state.run()) {
+		renderer::NewIsometricTileSet tile_set(1, rotation);
+		tile_set.scan(world, options.jobs);
+		doNotOptimize(tile_set);
+	}
+}
@@ -0,0 +1,290 @@
+/*
+ * Copyright 2012-2016 Moritz Hilscher
+ *
+ * This file is part of Mapcrafter.
+ *
+ * Mapcrafter is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mapcrafter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mapcrafter.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "syntheticworld.h"
+
+#include "../mapcraftercore/mc/region.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <sstream>
+#include <stdexcept>
+
+namespace mapcrafter {
+namespace bench {
+
+namespace nbt = mc::nbt;
+
+namespace {
+
+enum SyntheticBlock {
+	AIR, BEDROCK, STONE, COAL_ORE, DIRT, GRASS_BLOCK, SAND, WATER,
+	POPPY, TORCH, OAK_LOG, OAK_LEAVES, GLASS, OAK_SLAB_BOTTOM, OAK_SLAB_TOP
+};
+
+struct SyntheticBlockState {
+	const char* name;
+	const char* properties;
+};
+
+// block states of the synthetic blocks, properties as "key=value,key=value"
+const SyntheticBlockState BLOCK_STATES[] = {
+	{"minecraft:air", ""},
+	{"minecraft:bedrock", ""},
+	{"minecraft:stone", ""},
+	{"minecraft:coal_ore", ""},
+	{"minecraft:dirt", ""},
+	{"minecraft:grass_block", "snowy=false"},
+	{"minecraft:sand", ""},
+	{"minecraft:water", "level=0"},
+	{"minecraft:poppy", ""},
+	{"minecraft:torch", ""},
+	{"minecraft:oak_log", "axis=y"},
+	{"minecraft:oak_leaves", "distance=1,persistent=true"},
+	{"minecraft:glass", ""},
+	{"minecraft:oak_slab", "type=bottom,waterlogged=false"},
+	{"minecraft:oak_slab", "type=top,waterlogged=false"},
+};
+
+const char* BIOMES[] = {
+	"minecraft:plains", "minecraft:forest", "minecraft:desert", "minecraft:swamp"
+};
+
+int getHeight(int x, int z) {
+	return 64 + 10 * std::sin(x / 13.0) + 8 * std::cos(z / 9.0) + 4 * std::sin((x + z) / 5.0);
+}
+
+SyntheticBlock getBlock(int x, int y, int z, int h) {
+	if (y < -60)
+		return BEDROCK;
+	if (y < h - 4)
+		return (x * 7 + y * 3 + z) % 17 ? STONE : COAL_ORE;
+	if (y < h)
+		return DIRT;
+	if (y == h)
+		return h >= 62 ? GRASS_BLOCK : SAND;
+	if (y <= 62)
+		return WATER;
+	// patches of a bottom slab layer above a top slab layer, together the slabs cover
+	// the grass or water behind them
+	if (x % 23 >= 7 && x % 23 <= 10 && z % 17 >= 3 && z % 17 <= 6) {
+		int ground = std::max(h, 62);
+		if (y == ground + 1)
+			return OAK_SLAB_TOP;
+		if (y == ground + 2)
+			return OAK_SLAB_BOTTOM;
+	}
+	if (y == h + 1 && (x * 31 + z * 17) % 23 == 0)
+		return POPPY;
+	if (y == h + 1 && (x * 13 + z * 29) % 41 == 0)
+		return TORCH;
+	if (x % 11 == 3 && z % 11 == 5 && y <= h + 4)
+		return OAK_LOG;
+	if (std::abs(x % 11 - 3) <= 2 && std::abs(z % 11 - 5) <= 2
+			&& y >= h + 3 && y <= h + 6 && h >= 62)
+		return OAK_LEAVES;
+	if (x % 19 == 0 && z % 19 < 4 && y <= h + 3)
+		return GLASS;
+	return AIR;
+}
+
+int bitLength(int value) {
+	int bits = 0;
+	for (; value > 0; value >>= 1)
+		bits++;
+	return bits;
+}
+
+/**
+ * Packs the values like Minecraft 1.16+ does, values don't span across longs.
+ */
+std::vector<int64_t> packValues(const std::vector<int>& values, int bits) {
+	int per_long = 64 / bits;
+	std::vector<int64_t> longs((values.size() + per_long - 1) / per_long, 0);
+	for (size_t i = 0; i < values.size(); i++) {
+		uint64_t value = values[i];
+		longs[i / per_long] |= value << ((i % per_long) * bits);
+	}
+	return longs;
+}
+
+nbt::TagCompound* createBlockState(SyntheticBlock block) {
+	const SyntheticBlockState& state = BLOCK_STATES[block];
+	nbt::TagCompound* tag = new nbt::TagCompound();
+	tag->addTag("Name", nbt::TagString(state.name));
+
+	std::string properties = state.properties;
+	if (properties.empty())
+		return tag;
+	nbt::TagCompound properties_tag;
+	std::stringstream ss(properties);
+	std::string property;
+	while (std::getline(ss, property, ',')) {
+		size_t equal = property.find('=');
+		properties_tag.addTag(property.substr(0, equal), nbt::TagString(property.substr(equal + 1)));
+	}
+	tag->addTag("Properties", properties_tag);
+	return tag;
+}
+
+nbt::TagCompound* createSection(int chunk_x, int chunk_z, int section_y) {
+	nbt::TagCompound* section = new nbt::TagCompound();
+	section->addTag("Y", nbt::TagByte(section_y));
+
+	int heights[16 * 16];
+	for (int z = 0; z < 16; z++)
+		for (int x = 0; x < 16; x++)
+			heights[z * 16 + x] = getHeight(chunk_x * 16 + x, chunk_z * 16 + z);
+
+	// block states, indices are ordered YZX
+	std::vector<SyntheticBlock> palette;
+	std::vector<int> indices(16 * 16 * 16);
+	std::vector<int8_t> sky_light(2048, 0), block_light(2048, 0);
+	for (int i = 0; i < 16 * 16 * 16; i++) {
+		int x = chunk_x * 16 + i % 16, z = chunk_z * 16 + (i / 16) % 16;
+		int y = section_y * 16 + i / 256;
+		int h = heights[i % 256];
+
+		SyntheticBlock block = getBlock(x, y, z, h);
+		size_t index = 0;
+		while (index < palette.size() && palette[index] != block)
+			index++;
+		if (index == palette.size())
+			palette.push_back(block);
+		indices[i] = index;
+
+		int sky = y > h ? 15 : std::max(0, 15 - 3 * (h - y));
+		int light = 0;
+		if (y > h - 2)
+			light = std::max(0, 14 - std::abs(x % 13 - 6) - std::abs(z % 13 - 6) - std::abs(y - h - 1));
+		sky_light[i / 2] |= (i % 2 == 0 ? sky : sky << 4);
+		block_light[i / 2] |= (i % 2 == 0 ? light : light << 4);
+	}
+
+	nbt::TagCompound block_states;
+	nbt::TagList palette_tag(nbt::TagCompound::TAG_TYPE);
+	for (size_t i = 0; i < palette.size(); i++)
+		palette_tag.payload.push_back(nbt::TagPtr(createBlockState(palette[i])));
+	block_states.addTag("palette", palette_tag);
+	if (palette.size() > 1) {
+		int bits = std::max(4, bitLength(palette.size() - 1));
+		block_states.addTag("data", nbt::TagLongArray(packValues(indices, bits)));
+	}
+	section->addTag("block_states", block_states);
+
+	// biomes, one per 4x4x4 cells
+	std::vector<int> biome_indices(64), biomes_used;
+	for (int i = 0; i < 64; i++) {
+		int biome = ((chunk_x * 4 + i % 4) / 6 + (chunk_z * 4 + (i / 4) % 4) / 5) % 4;
+		size_t index = 0;
+		while (index < biomes_used.size() && biomes_used[index] != biome)
+			index++;
+		if (index == biomes_used.size())
+			biomes_used.push_back(biome);
+		biome_indices[i] = index;
+	}
+	nbt::TagCompound biomes;
+	nbt::TagList biomes_palette(nbt::TagString::TAG_TYPE);
+	for (size_t i = 0; i < biomes_used.size(); i++)
+		biomes_palette.payload.push_back(nbt::TagPtr(new nbt::TagString(BIOMES[biomes_used[i]])));
+	biomes.addTag("palette", biomes_palette);
+	if (biomes_used.size() > 1)
+		biomes.addTag("data", nbt::TagLongArray(packValues(biome_indices,
+				bitLength(biomes_used.size() - 1))));
+	section->addTag("biomes", biomes);
+
+	section->addTag("SkyLight", nbt::TagByteArray(sky_light));
+	section->addTag("BlockLight", nbt::TagByteArray(block_light));
+	return section;
+}
+
+}
+
+SyntheticWorld::SyntheticWorld(int size)
+	: size(size) {
+}
+
+SyntheticWorld::~SyntheticWorld() {
+}
+
+int SyntheticWorld::getSize() const {
+	return size;
+}
+
+void SyntheticWorld::createChunk(const mc::ChunkPos& pos, nbt::NBTFile& nbt) const {
+	nbt.addTag("DataVersion", nbt::TagInt(2975));
+	nbt.addTag("xPos", nbt::TagInt(pos.x));
+	nbt.addTag("yPos", nbt::TagInt(-4));
+	nbt.addTag("zPos", nbt::TagInt(pos.z));
+	nbt.addTag("Status", nbt::TagString("full"));
+
+	nbt::TagList sections(nbt::TagCompound::TAG_TYPE);
+	for (int y = -4; y < 8; y++)
+		sections.payload.push_back(nbt::TagPtr(createSection(pos.x, pos.z, y)));
+	nbt.addTag("sections", sections);
+}
+
+std::vector<uint8_t> SyntheticWorld::createChunkData(const mc::ChunkPos& pos) const {
+	nbt::NBTFile nbt;
+	createChunk(pos, nbt);
+	std::stringstream stream;
+	nbt.writeNBT(stream, nbt::Compression::ZLIB);
+	std::string data = stream.str();
+	return std::vector<uint8_t>(data.begin(), data.end());
+}
+
+bool SyntheticWorld::write(const fs::path& world_dir) const {
+	fs::create_directories(world_dir / "region");
+
+	nbt::NBTFile level;
+	nbt::TagCompound data("Data");
+	nbt::TagCompound version("Version");
+	version.addTag("Id", nbt::TagInt(2975));
+	version.addTag("Name", nbt::TagString("1.18.2"));
+	data.addTag("Version", version);
+	data.addTag("DataVersion", nbt::TagInt(2975));
+	level.addTag("Data", data);
+	level.writeNBT((world_dir / "level.dat").string().c_str(), nbt::Compression::GZIP);
+
+	mc::RegionFile region((world_dir / "region" / "r.0.0.mca").string());
+	for (int x = 0; x < 32; x++) {
+		for (int z = 0; z < 32; z++) {
+			mc::ChunkPos pos(x, z);
+			bool exists = x < size && z < size;
+			region.setChunkData(pos, exists ? createChunkData(pos) : std::vector<uint8_t>(), 2);
+			region.setChunkTimestamp(pos, exists ? 1600000000 : 0);
+		}
+	}
+	return region.write();
+}
+
+fs::path getBenchmarkWorld(const BenchmarkOptions& options) {
+	static fs::path world_dir;
+	if (world_dir.empty()) {
+		fs::path dir = options.work_dir / "world";
+		if (!SyntheticWorld(options.world_size).write(dir))
+			throw std::runtime_error("Unable to write synthetic world to " + dir.string());
+		world_dir = dir;
+	}
+	return world_dir;
+}
+
+}
+}
@@ -0,0 +1,79 @@
+/*
+ * Copyright 2012-2016 Moritz Hilscher
+ *
+ * This file is part of Mapcrafter.
+ *
+ * Mapcrafter is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mapcrafter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mapcrafter.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SYNTHETICWORLD_H_
+#define SYNTHETICWORLD_H_
+
+#include "bench.h"
+
+#include "../mapcraftercore/mc/nbt.h"
+#include "../mapcraftercore/mc/pos.h"
+
+#include <string>
+#include <vector>
+#include <boost/filesystem.hpp>
+
+namespace fs = boost::filesystem;
+
+namespace mapcrafter {
+namespace bench {
+
+/**
+ * Generates a deterministic Minecraft 1.18 world for the benchmarks: rolling hills of
+ * stone, dirt and grass with water, sand, trees, flowers, torches, glass pillars and
+ * slab patches, four biomes and varying sky/block light.
+ *
+ * The world covers the chunks 0..size-1 (x and z) of region 0,0.
+ */
+class SyntheticWorld {
+public:
+	SyntheticWorld(int size = 8);
+	~SyntheticWorld();
+
+	int getSize() const;
+
+	/**
+	 * Creates the NBT data of a chunk like it is stored in a region file.
+	 */
+	void createChunk(const mc::ChunkPos& pos, mc::nbt::NBTFile& nbt) const;
+
+	/**
+	 * Creates the zlib compressed NBT data of a chunk.
+	 */
+	std::vector<uint8_t> createChunkData(const mc::ChunkPos& pos) const;
+
+	/**
+	 * Writes the world (level.dat and region file) to a directory.
+	 */
+	bool write(const fs::path& world_dir) const;
+
+private:
+	int size;
+};
+
+/**
+ * Returns the directory of the synthetic world the benchmarks use. The world is
+ * generated in the work directory on first use.
+ */
+fs::path getBenchmarkWorld(const BenchmarkOptions& options);
+
+}
+}
+
+#endif /* SYNTHETICWORLD_H_ */
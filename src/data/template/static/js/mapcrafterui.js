@@ -36,6 +36,7 @@ var topBlock = 320;
 function createMCTileLayer(mapName, mapConfig, mapRotation) {
 	return new MCTileLayer(mapName + "/" + ["tl", "tr", "br", "bl"][mapRotation], {
 		maxZoom: mapConfig.maxZoom,
+		maxNativeZoom: mapConfig.maxNativeZoom !== undefined ? mapConfig.maxNativeZoom : mapConfig.maxZoom,
 		tileSize: L.point(mapConfig.tileSize[0], mapConfig.tileSize[1]),
 		noWrap: true,
 		continuousWorld: true,
@@ -23,6 +23,7 @@
 #include "mapcraftercore/version.h"
 
 #include <iostream>
+#include <stdexcept>
 #include <string>
 #include <cstring>
 #include <boost/program_options.hpp>
@@ -47,7 +48,7 @@ int main(int argc, char** argv) {
 	}
 
 	renderer::RenderOpts opts;
-	std::string arg_color, arg_config;
+	std::string arg_color, arg_config, arg_profile;
 
 	po::options_description general("General options");
 	general.add_options()
@@ -77,7 +78,20 @@ int main(int argc, char** argv) {
 			"renders the specified map(s) completely")
 		("render-force-all,F", "force renders all maps")
 		("jobs,j", po::value<int>(&opts.jobs)->default_value(1),
-			"the count of jobs to use when rendering the map");
+			"the count of jobs to use when rendering the map")
+		("profile", po::value<std::string>(&arg_profile)->implicit_value("text"),
+			"measures the time spent in the phases of the rendering and logs it (text) or writes it to profile.json in the output directory (json)")
+		("interleave-rotations", "renders all rotations of a map together ordered by world region, so each region is read just once (needs -j > 1)")
+		("watch", "keeps running after rendering and re-renders the changed parts of the worlds whenever their region files change")
+		("watch-debounce", po::value<int>(&opts.watch_debounce)->default_value(10),
+			"the seconds without region file changes to wait before rendering the changes when watching")
+		("shard", po::value<std::string>(&opts.shard),
+			"renders just a shard of the maps, given as index/count (for example 2/8), the shards split the subtrees some zoom levels above the render tiles evenly")
+		("shard-tiles", po::value<std::vector<std::string>>(&opts.shard_tiles)->multitoken(),
+			"renders just the subtrees of the specified tiles (for example 1/4 2) as shard of the maps")
+		("shard-levels", po::value<int>(&opts.shard_levels)->default_value(2),
+			"how many zoom levels above the render tiles the subtrees of the shards are")
+		("compose-only", "composes the tiles above the subtrees of the shards once all shards are rendered");
 
 	po::options_description all("Allowed options");
 	all.add(general).add(logging).add(renderer);
@@ -171,9 +185,75 @@ int main(int argc, char** argv) {
 	opts.skip_all = vm.count("render-reset");
 	opts.force_all = vm.count("render-force-all");
 	opts.batch = vm.count("batch");
+	opts.interleave_rotations = vm.count("interleave-rotations");
+	opts.watch = vm.count("watch");
+	opts.compose_only = vm.count("compose-only");
 	if (!vm.count("logging-config"))
 		opts.logging_config = util::findLoggingConfigFile();
 
+	if (arg_profile.empty())
+		opts.profiling = renderer::RenderProfiling::DISABLED;
+	else if (arg_profile == "text")
+		opts.profiling = renderer::RenderProfiling::TEXT;
+	else if (arg_profile == "json")
+		opts.profiling = renderer::RenderProfiling::JSON;
+	else {
+		std::cerr << "Invalid argument '" << arg_profile << "' for '--profile'." << std::endl;
+		std::cerr << "Allowed arguments are 'text' or 'json'." << std::endl;
+		std::cerr << "Use '" << argv[0] << " --help' for more information." << std::endl;
+		return 1;
+	}
+
+	if (opts.watch_debounce < 0) {
+		std::cerr << "The debounce time of '--watch-debounce' must not be negative!" << std::endl;
+		std::cerr << "Use '" << argv[0] << " --help' for more information." << std::endl;
+		return 1;
+	}
+
+	renderer::RenderShard shard;
+	shard.levels = opts.shard_levels;
+	shard.compose_only = opts.compose_only;
+	if (!opts.shard.empty()) {
+		size_t slash = opts.shard.find('/');
+		try {
+			shard.index = util::as<int>(opts.shard.substr(0, slash)) - 1;
+			shard.count = slash == std::string::npos ? 0 : util::as<int>(opts.shard.substr(slash + 1));
+		} catch (std::invalid_argument&) {
+			shard.count = 0;
+		}
+		if (shard.count <= 0 || shard.index < 0 || shard.index >= shard.count) {
+			std::cerr << "Invalid argument '" << opts.shard << "' for '--shard'." << std::endl;
+			std::cerr << "The shard must be given as index/count, the index from 1 to count." << std::endl;
+			std::cerr << "Use '" << argv[0] << " --help' for more information." << std::endl;
+			return 1;
+		}
+	}
+	for (auto it = opts.shard_tiles.begin(); it != opts.shard_tiles.end(); ++it) {
+		try {
+			shard.tiles.push_back(renderer::TilePath::byString(*it));
+		} catch (std::invalid_argument&) {
+			std::cerr << "Invalid tile '" << *it << "' for '--shard-tiles'." << std::endl;
+			std::cerr << "Tiles are given as paths like 1/4/2." << std::endl;
+			std::cerr << "Use '" << argv[0] << " --help' for more information." << std::endl;
+			return 1;
+		}
+	}
+	if (shard.levels < 1) {
+		std::cerr << "The zoom levels of '--shard-levels' must be at least 1!" << std::endl;
+		std::cerr << "Use '" << argv[0] << " --help' for more information." << std::endl;
+		return 1;
+	}
+	if ((shard.count > 0) + !shard.tiles.empty() + shard.compose_only > 1) {
+		std::cerr << "You may only use one of --shard, --shard-tiles or --compose-only!" << std::endl;
+		std::cerr << "Use '" << argv[0] << " --help' for more information." << std::endl;
+		return 1;
+	}
+	if (shard.isEnabled() && opts.watch) {
+		std::cerr << "You can't watch the worlds when rendering shards!" << std::endl;
+		std::cerr << "Use '" << argv[0] << " --help' for more information." << std::endl;
+		return 1;
+	}
+
 	if (opts.skip_all && opts.force_all) {
 		std::cerr << "You may only use one of --render-reset or --render-force-all!" << std::endl;
 		std::cerr << "Use '" << argv[0] << " --help' for more information." << std::endl;
@@ -207,7 +287,13 @@ int main(int argc, char** argv) {
 
 	renderer::RenderManager manager(config);
 	manager.setRenderBehaviors(renderer::RenderBehaviors::fromRenderOpts(config, opts));
-	if (!manager.run(opts.jobs, opts.batch))
+	manager.setRenderProfiling(opts.profiling);
+	manager.setInterleaveRotations(opts.interleave_rotations);
+	manager.setRenderShard(shard);
+	if (opts.watch) {
+		if (!manager.watch(opts.jobs, opts.batch, opts.watch_debounce * 1000))
+			return 1;
+	} else if (!manager.run(opts.jobs, opts.batch))
 		return 1;
 	return 0;
 }
@@ -0,0 +1,159 @@
+/*
+ * Copyright 2012-2016 Moritz Hilscher
+ *
+ * This file is part of Mapcrafter.
+ *
+ * Mapcrafter is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mapcrafter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mapcrafter.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "accumulator.h"
+#include "mapcraftercore/util.h"
+#include "mapcraftercore/config/mapcrafterconfig.h"
+#include "mapcraftercore/renderer/tilearchive.h"
+
+#include <fstream>
+#include <string>
+#include <vector>
+#include <boost/program_options.hpp>
+#include <boost/filesystem.hpp>
+
+namespace po = boost::program_options;
+namespace fs = boost::filesystem;
+
+namespace util = mapcrafter::util;
+namespace config = mapcrafter::config;
+namespace renderer = mapcrafter::renderer;
+
+/**
+ * Writes the tiles of a tile archive as image files to a directory, in the same layout
+ * as the rendered tiles without a tile archive (base.png, 1.png, 1/2.png, ...).
+ */
+bool extractArchive(const fs::path& archive_file, const fs::path& output_dir) {
+	renderer::TileArchive archive(archive_file);
+	if (!archive.open())
+		return false;
+
+	std::vector<renderer::TilePath> tiles = archive.getTiles();
+	LOG(INFO) << "Extracting " << tiles.size() << " tiles from " << archive_file << " ...";
+	std::string data;
+	for (auto it = tiles.begin(); it != tiles.end(); ++it) {
+		if (!archive.readTile(*it, data)) {
+			LOG(ERROR) << "Unable to read tile '" << it->toString() << "' from " << archive_file << "!";
+			return false;
+		}
+		// the image format is determined by the signature of the image
+		std::string suffix = ".jpg";
+		if (data.compare(0, 4, "\x89PNG") == 0)
+			suffix = ".png";
+		else if (data.compare(0, 4, "RIFF") == 0 && data.compare(8, 4, "WEBP") == 0)
+			suffix = ".webp";
+		fs::path file = output_dir / ((it->getDepth() == 0 ? "base" : it->toString()) + suffix);
+		fs::create_directories(file.parent_path());
+		// don't write through hard links of tiles deduplicated before
+		boost::system::error_code error;
+		fs::remove(file, error);
+		std::ofstream out(file.string().c_str(), std::ios::binary);
+		out.write(data.data(), data.size());
+		out.close();
+		if (!out) {
+			LOG(ERROR) << "Unable to write tile " << file << "!";
+			return false;
+		}
+	}
+	return true;
+}
+
+int main(int argc, char** argv) {
+	std::string config_file;
+	std::string input_file, output_dir;
+	int verbosity = 0;
+
+	po::options_description all("Allowed options");
+	all.add_options()
+		("help,h", "shows this help message")
+		("verbose,v", accumulator<int>(&verbosity),
+				"shows more verbose output")
+
+		("config,c", po::value<std::string>(&config_file),
+			"the path to the configuration file, the tile archives of all rendered "
+			"maps are extracted into their output directories")
+		("input,i", po::value<std::string>(&input_file),
+			"a single tile archive to extract (instead of a configuration file)")
+		("output-dir,o", po::value<std::string>(&output_dir),
+			"the directory to extract the single tile archive to");
+
+	po::variables_map vm;
+	try {
+		po::store(po::parse_command_line(argc, argv, all), vm);
+	} catch (po::error& ex) {
+		std::cout << "There is a problem parsing the command line arguments: "
+				<< ex.what() << std::endl << std::endl;
+		std::cout << all << std::endl;
+		return 1;
+	}
+
+	po::notify(vm);
+
+	if (vm.count("help")) {
+		std::cout << all << std::endl;
+		return 1;
+	}
+
+	if (vm.count("config") == vm.count("input")) {
+		std::cerr << "You have to specify either a configuration file or a tile archive!"
+				<< std::endl;
+		return 1;
+	}
+	if (vm.count("input") && !vm.count("output-dir")) {
+		std::cerr << "You have to specify an output directory for the tile archive!"
+				<< std::endl;
+		return 1;
+	}
+
+	util::LogLevel log_level = util::LogLevel::WARNING;
+	if (verbosity == 1)
+		log_level = util::LogLevel::INFO;
+	else if (verbosity > 1)
+		log_level = util::LogLevel::DEBUG;
+	util::Logging::getInstance().setSinkVerbosity("__output__", log_level);
+	util::Logging::getInstance().setSinkLogProgress("__output__", true);
+
+	if (vm.count("input"))
+		return extractArchive(input_file, output_dir) ? 0 : 1;
+
+	config::MapcrafterConfig config;
+	config::ValidationMap validation = config.parseFile(config_file);
+
+	if (!validation.isEmpty()) {
+		if (validation.isCritical())
+			LOG(FATAL) << "Your configuration file is invalid!";
+		else
+			LOG(WARNING) << "Some notes on your configuration file:";
+		validation.log();
+		LOG(WARNING) << "Please read the documentation about the new configuration file format.";
+	}
+
+	bool ok = true;
+	auto maps = config.getMaps();
+	for (auto map_it = maps.begin(); map_it != maps.end(); ++map_it) {
+		auto rotations = map_it->getRotations();
+		for (auto rotation_it = rotations.begin(); rotation_it != rotations.end(); ++rotation_it) {
+			fs::path dir = config.getOutputPath(map_it->getShortName() + "/"
+					+ config::ROTATION_NAMES_SHORT[*rotation_it]);
+			if (fs::exists(dir / renderer::TileArchive::FILENAME))
+				ok = extractArchive(dir / renderer::TileArchive::FILENAME, dir) && ok;
+		}
+	}
+	return ok ? 0 : 1;
+}
@@ -19,6 +19,7 @@
 
 #include "../configsections/map.h"
 #include "../iniconfig.h"
+#include "../../config.h"
 #include "../../util.h"
 
 namespace mapcrafter {
@@ -30,7 +31,27 @@ config::ImageFormat as<config::ImageFormat>(const std::string& from) {
 		return config::ImageFormat::PNG;
 	else if (from == "jpeg")
 		return config::ImageFormat::JPEG;
-	throw std::invalid_argument("Must be 'png' or 'jpeg'!");
+	else if (from == "webp")
+		return config::ImageFormat::WEBP;
+	throw std::invalid_argument("Must be 'png', 'jpeg' or 'webp'!");
+}
+
+template <>
+renderer::PNGFilter as<renderer::PNGFilter>(const std::string& from) {
+	if (from == "none")
+		return renderer::PNGFilter::NONE;
+	else if (from == "sub")
+		return renderer::PNGFilter::SUB;
+	else if (from == "up")
+		return renderer::PNGFilter::UP;
+	else if (from == "average")
+		return renderer::PNGFilter::AVERAGE;
+	else if (from == "paeth")
+		return renderer::PNGFilter::PAETH;
+	else if (from == "all")
+		return renderer::PNGFilter::ALL;
+	throw std::invalid_argument("Must be one of 'none', 'sub', 'up', 'average', "
+			"'paeth' or 'all'!");
 }
 
 template <>
@@ -129,6 +150,8 @@ std::ostream& operator<<(std::ostream& out, ImageFormat image_format) {
 		out << "png";
 	else if (image_format == ImageFormat::JPEG)
 		out << "jpeg";
+	else if (image_format == ImageFormat::WEBP)
+		out << "webp";
 	return out;
 }
 
@@ -155,9 +178,17 @@ void MapSection::dump(std::ostream& out) const {
 	out << "  rotations = " << rotations << std::endl;
 	out << "  block_dir = " << block_dir << std::endl;
 	out << "  texture_size = " << texture_size << std::endl;
+	out << "  lod_levels = " << lod_levels << std::endl;
 	out << "  image_format = " << image_format << std::endl;
 	out << "  png_indexed = " << png_indexed << std::endl;
+	out << "  png_compression_level = " << png_compression_level << std::endl;
+	out << "  png_filter = " << png_filter << std::endl;
+	out << "  png_fast_deflate = " << png_fast_deflate << std::endl;
 	out << "  jpeg_quality = " << jpeg_quality << std::endl;
+	out << "  webp_lossless = " << webp_lossless << std::endl;
+	out << "  webp_quality = " << webp_quality << std::endl;
+	out << "  deduplicate_tiles = " << deduplicate_tiles << std::endl;
+	out << "  tile_archive = " << tile_archive << std::endl;
 	out << "  lighting_intensity = " << lighting_intensity << std::endl;
 	out << "  lighting_water_intensity = " << lighting_water_intensity << std::endl;
 	out << "  render_biomes = " << render_biomes << std::endl;
@@ -208,6 +239,10 @@ int MapSection::getTileWidth() const {
 	return tile_width.getValue();
 }
 
+int MapSection::getLODLevels() const {
+	return lod_levels.getValue();
+}
+
 double MapSection::getWaterOpacity() const {
 	return water_opacity.getValue();
 }
@@ -219,6 +254,8 @@ ImageFormat MapSection::getImageFormat() const {
 std::string MapSection::getImageFormatSuffix() const {
 	if (getImageFormat() == ImageFormat::PNG)
 		return "png";
+	else if (getImageFormat() == ImageFormat::WEBP)
+		return "webp";
 	return "jpg";
 }
 
@@ -226,10 +263,31 @@ bool MapSection::isPNGIndexed() const {
 	return png_indexed.getValue();
 }
 
+renderer::PNGEncodingOptions MapSection::getPNGEncodingOptions() const {
+	return renderer::PNGEncodingOptions(png_compression_level.getValue(),
+			png_filter.getValue(), png_fast_deflate.getValue());
+}
+
 int MapSection::getJPEGQuality() const {
 	return jpeg_quality.getValue();
 }
 
+bool MapSection::isWebPLossless() const {
+	return webp_lossless.getValue();
+}
+
+int MapSection::getWebPQuality() const {
+	return webp_quality.getValue();
+}
+
+bool MapSection::deduplicateTiles() const {
+	return deduplicate_tiles.getValue();
+}
+
+bool MapSection::useTileArchive() const {
+	return tile_archive.getValue();
+}
+
 double MapSection::getLightingIntensity() const {
 	return lighting_intensity.getValue();
 }
@@ -276,10 +334,18 @@ void MapSection::preParse(const INIConfigSection& section,
 
 	texture_size.setDefault(12);
 	tile_width.setDefault(1);
+	lod_levels.setDefault(0);
 
 	image_format.setDefault(ImageFormat::PNG);
 	png_indexed.setDefault(false);
+	png_compression_level.setDefault(6);
+	png_filter.setDefault(renderer::PNGFilter::ALL);
+	png_fast_deflate.setDefault(false);
 	jpeg_quality.setDefault(85);
+	webp_lossless.setDefault(true);
+	webp_quality.setDefault(85);
+	deduplicate_tiles.setDefault(false);
+	tile_archive.setDefault(false);
 
 	lighting_intensity.setDefault(1.0);
 	lighting_water_intensity.setDefault(0.85);
@@ -326,14 +392,36 @@ bool MapSection::parseField(const std::string key, const std::string value,
 		tile_width.load(key, value, validation);
 		if (tile_width.getValue() < 1)
 			validation.error("'tile_width' must be a positive number!");
+	} else if (key == "lod_levels") {
+		if (lod_levels.load(key, value, validation)
+				&& (lod_levels.getValue() < 0 || lod_levels.getValue() > 4))
+			validation.error("'lod_levels' must be a number between 0 and 4!");
 	} else if (key == "image_format") {
 		image_format.load(key, value, validation);
 	} else if (key == "png_indexed") {
 		png_indexed.load(key, value, validation);
+	} else if (key == "png_compression_level") {
+		if (png_compression_level.load(key, value, validation)
+				&& (png_compression_level.getValue() < 0 || png_compression_level.getValue() > 9))
+			validation.error("'png_compression_level' must be a number between 0 and 9!");
+	} else if (key == "png_filter") {
+		png_filter.load(key, value, validation);
+	} else if (key == "png_fast_deflate") {
+		png_fast_deflate.load(key, value, validation);
 	} else if (key == "jpeg_quality") {
 		if (jpeg_quality.load(key, value, validation)
 				&& (jpeg_quality.getValue() < 0 || jpeg_quality.getValue() > 100))
 			validation.error("'jpeg_quality' must be a number between 0 and 100!");
+	} else if (key == "webp_lossless") {
+		webp_lossless.load(key, value, validation);
+	} else if (key == "webp_quality") {
+		if (webp_quality.load(key, value, validation)
+				&& (webp_quality.getValue() < 0 || webp_quality.getValue() > 100))
+			validation.error("'webp_quality' must be a number between 0 and 100!");
+	} else if (key == "deduplicate_tiles") {
+		deduplicate_tiles.load(key, value, validation);
+	} else if (key == "tile_archive") {
+		tile_archive.load(key, value, validation);
 	} else if (key == "lighting_intensity") {
 		lighting_intensity.load(key, value, validation);
 	} else if (key == "lighting_water_intensity") {
@@ -370,6 +458,20 @@ void MapSection::postParse(const INIConfigSection& section,
 		}
 	}
 
+#ifndef HAVE_WEBP
+	if (image_format.getValue() == ImageFormat::WEBP)
+		validation.error("Mapcrafter was built without libwebp, "
+				"the 'webp' image format is not available!");
+#endif
+
+	if (lod_levels.getValue() > 0
+			&& texture_size.getValue() % (1 << lod_levels.getValue()) != 0)
+		validation.error("'texture_size' must be divisible by 2^'lod_levels' = "
+				+ util::str(1 << lod_levels.getValue()) + "!");
+
+	if (deduplicate_tiles.getValue() && tile_archive.getValue())
+		validation.warning("'deduplicate_tiles' has no effect with 'tile_archive'!");
+
 	// check if required options were specified
 	if (!isGlobal()) {
 		world.require(validation, "You have to specify a world ('world')!");
@@ -22,6 +22,7 @@
 
 #include "../configsection.h"
 #include "../validation.h"
+#include "../../renderer/image/pngencoder.h"
 #include "../../renderer/rendermode.h"
 #include "../../renderer/renderview.h"
 
@@ -76,7 +77,8 @@ public:
 
 enum class ImageFormat {
 	PNG,
-	JPEG
+	JPEG,
+	WEBP
 };
 
 std::ostream& operator<<(std::ostream& out, ImageFormat image_format);
@@ -106,11 +108,17 @@ public:
 	int getTextureBlur() const;
 	double getWaterOpacity() const;
 	int getTileWidth() const;
+	int getLODLevels() const;
 
 	ImageFormat getImageFormat() const;
 	std::string getImageFormatSuffix() const;
 	bool isPNGIndexed() const;
+	renderer::PNGEncodingOptions getPNGEncodingOptions() const;
 	int getJPEGQuality() const;
+	bool isWebPLossless() const;
+	int getWebPQuality() const;
+	bool deduplicateTiles() const;
+	bool useTileArchive() const;
 
 	double getLightingIntensity() const;
 	double getLightingWaterIntensity() const;
@@ -143,11 +151,18 @@ private:
 
 	Field<fs::path> block_dir;
 	Field<int> texture_size, tile_width;
+	Field<int> lod_levels;
 	Field<double> water_opacity;
 
 	Field<ImageFormat> image_format;
     Field<bool> png_indexed;
+	Field<int> png_compression_level;
+	Field<renderer::PNGFilter> png_filter;
+	Field<bool> png_fast_deflate;
 	Field<int> jpeg_quality;
+	Field<bool> webp_lossless;
+	Field<int> webp_quality;
+	Field<bool> deduplicate_tiles, tile_archive;
 
 	Field<double> lighting_intensity, lighting_water_intensity;
 	Field<bool> cave_high_contrast;
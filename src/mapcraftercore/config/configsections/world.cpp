@@ -49,12 +49,58 @@ mc::BlockPos as<mc::BlockPos>(const std::string& from) {
 	return pos;
 }
 
+template <>
+config::RenderPriority as<config::RenderPriority>(const std::string& from) {
+	std::stringstream ss(from);
+	config::RenderPriority render_priority;
+	std::string point;
+	while (ss >> point) {
+		if (point == "spawn")
+			render_priority.spawn = true;
+		else if (point == "players")
+			render_priority.players = true;
+		else if (point == "default_view")
+			render_priority.default_view = true;
+		else if (point.find(',') != std::string::npos)
+			render_priority.positions.push_back(as<mc::BlockPos>(point));
+		else
+			throw std::invalid_argument("Invalid point '" + point + "', must be 'spawn', "
+					"'players', 'default_view' or block coordinates '<x>,<z>,<y>'!");
+	}
+	return render_priority;
+}
+
 }
 }
 
 namespace mapcrafter {
 namespace config {
 
+bool RenderPriority::isEmpty() const {
+	return !spawn && !players && !default_view && positions.empty();
+}
+
+std::ostream& operator<<(std::ostream& out, const RenderPriority& render_priority) {
+	std::string separator;
+	if (render_priority.spawn) {
+		out << "spawn";
+		separator = " ";
+	}
+	if (render_priority.players) {
+		out << separator << "players";
+		separator = " ";
+	}
+	if (render_priority.default_view) {
+		out << separator << "default_view";
+		separator = " ";
+	}
+	for (auto it = render_priority.positions.begin(); it != render_priority.positions.end(); ++it) {
+		out << separator << it->x << "," << it->z << "," << it->y;
+		separator = " ";
+	}
+	return out;
+}
+
 WorldSection::WorldSection() {
 }
 
@@ -76,6 +122,7 @@ void WorldSection::dump(std::ostream& out) const {
 	out << "  default_zoom = " << default_zoom << std::endl;
 	out << "  default_rotation = " << default_rotation << std::endl;
 	out << "  sea_level = " << sea_level << std::endl;
+	out << "  render_priority = " << render_priority << std::endl;
 	out << "  min_y = " << min_y << std::endl;
 	out << "  max_y = " << max_y << std::endl;
 	out << "  min_x = " << min_x << std::endl;
@@ -125,6 +172,10 @@ int WorldSection::getSeaLevel() const {
 	return sea_level.getValue();
 }
 
+RenderPriority WorldSection::getRenderPriority() const {
+	return render_priority.getValue();
+}
+
 bool WorldSection::hasCropUnpopulatedChunks() const {
 	return crop_unpopulated_chunks.getValue();
 }
@@ -181,7 +232,8 @@ bool WorldSection::parseField(const std::string key, const std::string value,
 		default_rotation.setValue(rotation.getRotation());
 	} else if (key == "sea_level") {
 		sea_level.load(key,value, validation);
-	}
+	} else if (key == "render_priority")
+		render_priority.load(key, value, validation);
 
 	else if (key == "crop_min_y") {
 		if (min_y.load(key, value, validation))
@@ -28,6 +28,7 @@
 #include "../../mc/worldcrop.h"
 
 #include <string>
+#include <vector>
 #include <boost/filesystem.hpp>
 
 namespace fs = boost::filesystem;
@@ -35,6 +36,21 @@ namespace fs = boost::filesystem;
 namespace mapcrafter {
 namespace config {
 
+/**
+ * The points of interest of a world whose tiles are rendered first: The spawn point,
+ * the positions of the players, the default view and fixed block positions.
+ */
+struct RenderPriority {
+	RenderPriority() : spawn(false), players(false), default_view(false) {}
+
+	bool isEmpty() const;
+
+	bool spawn, players, default_view;
+	std::vector<mc::BlockPos> positions;
+};
+
+std::ostream& operator<<(std::ostream& out, const RenderPriority& render_priority);
+
 class INIConfigSection;
 
 class WorldSection : public ConfigSection {
@@ -57,6 +73,7 @@ public:
 	int getDefaultZoom() const;
 	int getDefaultRotation() const;
 	int getSeaLevel() const;
+	RenderPriority getRenderPriority() const;
 
 	bool hasCropUnpopulatedChunks() const;
 	std::string getBlockMask() const;
@@ -82,6 +99,7 @@ private:
 	Field<mc::BlockPos> default_view;
 	Field<int> default_zoom, default_rotation;
 	Field<int> sea_level;
+	Field<RenderPriority> render_priority;
 
 	Field<int> min_y, max_y;
 	Field<int> min_x, max_x, min_z, max_z;
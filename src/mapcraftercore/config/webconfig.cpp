@@ -22,6 +22,8 @@
 #include "iniconfig.h"
 #include "../util.h"
 
+#include <algorithm>
+
 namespace mapcrafter {
 namespace config {
 
@@ -286,6 +288,10 @@ picojson::value WebConfig::getConfigJSON() const {
 		map_json["tileSize"] = picojson::value(tile_size_json);
 
 		map_json["maxZoom"] = picojson::value((double) getMapMaxZoom(map_it->getShortName()));
+		// the deepest zoom levels aren't rendered, the web interface scales the tiles up
+		if (map_it->getLODLevels() > 0)
+			map_json["maxNativeZoom"] = picojson::value((double) std::max(
+					getMapMaxZoom(map_it->getShortName()) - map_it->getLODLevels(), 0));
 
 		picojson::array last_rendered_json;
 		for (int rotation = 0; rotation < 4; rotation++) {
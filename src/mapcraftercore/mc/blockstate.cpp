@@ -115,10 +115,12 @@ const BlockState& BlockStateRegistry::getBlockState(uint16_t id) const {
 }
 
 void BlockStateRegistry::addKnownProperty(std::string block, std::string property) {
+	std::lock_guard<std::mutex> guard(mutex);
 	known_properties[block].insert(property);
 }
 
 bool BlockStateRegistry::isKnownProperty(std::string block, std::string property) const {
+	std::lock_guard<std::mutex> guard(mutex);
 	auto it = known_properties.find(block);
 	if (it == known_properties.end()) {
 		return false;
@@ -22,6 +22,7 @@
 #include "../renderer/biomes.h"
 #include "../renderer/blockimages.h"
 
+#include <algorithm>
 #include <cmath>
 #include <iostream>
 #include <boost/range.hpp>
@@ -51,6 +52,76 @@ void readPackedShorts_v116(const std::vector<int64_t>& data, uint16_t* palette,
 
 } // namespace
 
+ChunkSection::ChunkSection()
+	: y(0), bits(0), palette(1, 0) {
+	std::fill(biomes, biomes + boost::size(biomes), 0);
+	light_value[0] = light_value[1] = 0;
+}
+
+void ChunkSection::setBlockIDs(const uint16_t* ids) {
+	palette.clear();
+	packed.clear();
+	block_ids.clear();
+
+	// build the local palette, the palette of the NBT data isn't used directly
+	// because different entries there may be mapped to the same block ID
+	std::vector<uint16_t> indices(16 * 16 * 16);
+	std::unordered_map<uint16_t, uint16_t> palette_lookup;
+	for (size_t i = 0; i < 16 * 16 * 16; i++) {
+		auto it = palette_lookup.find(ids[i]);
+		if (it == palette_lookup.end()) {
+			it = palette_lookup.insert(std::make_pair(ids[i], palette.size())).first;
+			palette.push_back(ids[i]);
+		}
+		indices[i] = it->second;
+	}
+
+	if (palette.size() == 1) {
+		bits = 0;
+	} else if (palette.size() > 256) {
+		bits = 16;
+		palette.clear();
+		block_ids.assign(ids, ids + 16 * 16 * 16);
+	} else {
+		bits = 1;
+		while ((1u << bits) < palette.size())
+			bits *= 2;
+		packed.resize(16 * 16 * 16 * bits / 8, 0);
+		for (size_t i = 0; i < 16 * 16 * 16; i++) {
+			size_t bit = i * bits;
+			packed[bit >> 3] |= indices[i] << (bit & 7);
+		}
+	}
+	palette.shrink_to_fit();
+}
+
+void ChunkSection::setLight(int array, const uint8_t* data, uint8_t value) {
+	std::vector<uint8_t>& light_data = light[array];
+	light_data.clear();
+	light_value[array] = value;
+	if (data == NULL)
+		return;
+
+	// completely dark or completely lit sections don't need the whole array
+	uint8_t first = data[0];
+	if ((first == 0x00 || first == 0xff)
+			&& std::all_of(data, data + 16 * 16 * 8, [first](uint8_t b) { return b == first; })) {
+		light_value[array] = first & 0xf;
+		return;
+	}
+	light_data.assign(data, data + 16 * 16 * 8);
+}
+
+bool ChunkSection::isUniform() const {
+	return bits == 0;
+}
+
+size_t ChunkSection::getMemoryUsage() const {
+	return sizeof(ChunkSection) + palette.capacity() * sizeof(uint16_t)
+		+ packed.capacity() + block_ids.capacity() * sizeof(uint16_t)
+		+ light[0].capacity() + light[1].capacity();
+}
+
 uint16_t Chunk::nop_id = 0;
 
 Chunk::Chunk()
@@ -81,6 +152,7 @@ bool Chunk::readNBT(mc::BlockStateRegistry& block_registry, const char* data, si
 
 	nbt::NBTFile nbt;
 	nbt.readNBT(data, len, compression);
+	util::ProfileTimer timer(util::ProfilePhase::PALETTE_RESOLVE);
 
 	// Make sure we know which data format this chunk is built of
 	if (!nbt.hasTag<nbt::TagInt>("DataVersion")) {
@@ -105,8 +177,18 @@ bool Chunk::readNBT(mc::BlockStateRegistry& block_registry, const char* data, si
 	int chunk_lowest = nbt.findTag<nbt::TagInt>("yPos").payload;
 
 	// now we have the original chunk position:
-	// check whether this chunk is completely contained within the cropped world
-	chunk_completely_contained = world_crop.isChunkCompletelyContained(chunkpos);
+	// check which columns of the chunk are contained within the cropped world
+	bool chunk_completely_contained = world_crop.isChunkCompletelyContained(chunkpos);
+	bool columns_contained[16 * 16];
+	for (int z = 0; z < 16; z++)
+		for (int x = 0; x < 16; x++)
+			columns_contained[z * 16 + x] = chunk_completely_contained
+				|| world_crop.isBlockContainedXZ(LocalBlockPos(x, z, 0).toGlobalPos(chunkpos));
+	// whether the blocks of the sections need to be checked at all
+	bool crop_blocks = !chunk_completely_contained || world_crop.hasBlockMask()
+		|| !world_crop.isBlockContainedY(BlockPos(0, 0, chunk_lowest * 16))
+		|| !world_crop.isBlockContainedY(BlockPos(0, 0,
+				(chunk_lowest + Y_CHUNKS_PER_REGION_FILE) * 16 - 1));
 
 	if (nbt.hasTag<nbt::TagString>("Status")) {
 		const nbt::TagString& tag = nbt.findTag<nbt::TagString>("Status");
@@ -185,35 +267,44 @@ bool Chunk::readNBT(mc::BlockStateRegistry& block_registry, const char* data, si
 		/**
 		 * Get the block states data
 		 */
+		// the blocks which are cropped or hidden by the block mask
+		bool hidden[16 * 16 * 16];
+		bool any_hidden = false;
 		if (palettebs.payload.size()>1) {
 			const nbt::TagLongArray& databs = blockstates.findTag<nbt::TagLongArray>("data");
-			readPackedShorts_v116(databs.payload, section.block_ids, &section.block_ids[boost::size(section.block_ids)]);
+			uint16_t block_ids[16 * 16 * 16];
+			readPackedShorts_v116(databs.payload, block_ids, &block_ids[boost::size(block_ids)]);
 
 			bool ok = true;
 			for (size_t i = 0; i < 16*16*16; i++) {
-				if (section.block_ids[i] >= palette_blockstates.size()) {
+				if (block_ids[i] >= palette_blockstates.size()) {
 					int bits_per_entry = databs.payload.size() * 64 / (16*16*16);
-					LOG(ERROR) << "Incorrectly parsed palette ID " << section.block_ids[i]
+					LOG(ERROR) << "Incorrectly parsed palette ID " << block_ids[i]
 						<< " at index " << i << " (max is " << palette_blockstates.size()-1
 						<< " with " << bits_per_entry << " bits per entry)";
 					ok = false;
 					break;
 				}
-				section.block_ids[i] = palette_blockstates_idx[section.block_ids[i]];
+				block_ids[i] = palette_blockstates_idx[block_ids[i]];
 			}
 			if (!ok) {
 				continue;
 			}
+			if (crop_blocks)
+				any_hidden = cropBlocks(section.y, columns_contained, block_ids, hidden);
+			section.setBlockIDs(block_ids);
 		} else if (palettebs.payload.size()==1) {
 			// Check if air is the only block in this section, if so, ignore it completly, it will speed up the rest
 			// of the rendering as we won't have to verify every single block in this section.
 			if (palette_blockstates_idx[0] == nop_id) continue;
 			// Only 1 in palette: There's only block in this chunk
-			std::fill(section.block_ids, section.block_ids+boost::size(section.block_ids), palette_blockstates_idx[0]);
-		} else {
-			// No palette, this shouldn't happen, anyway let's use the default one
-			std::fill(section.block_ids, section.block_ids+boost::size(section.block_ids), 0);
+			uint16_t block_ids[16 * 16 * 16];
+			std::fill(block_ids, block_ids+boost::size(block_ids), palette_blockstates_idx[0]);
+			if (crop_blocks)
+				any_hidden = cropBlocks(section.y, columns_contained, block_ids, hidden);
+			section.setBlockIDs(block_ids);
 		}
+		// No palette, this shouldn't happen, anyway the section keeps the default block ID 0
 
 
 		/**
@@ -249,23 +340,37 @@ bool Chunk::readNBT(mc::BlockStateRegistry& block_registry, const char* data, si
 			std::fill(section.biomes, section.biomes+boost::size(section.biomes), 0);
 		}
 
-		if (section_tag.hasArray<nbt::TagByteArray>("BlockLight")) {
-			const nbt::TagByteArray& block_light = section_tag.findTag<nbt::TagByteArray>("BlockLight");
-			std::copy(block_light.payload.begin(), block_light.payload.end(), section.block_light);
-		} else {
-			std::fill(&section.block_light[0], &section.block_light[2048], 0);
-		}
+		const char* light_tags[2] = {"BlockLight", "SkyLight"};
+		for (int array = 0; array < 2; array++) {
+			const uint8_t* light = NULL;
+			if (section_tag.hasArray<nbt::TagByteArray>(light_tags[array], 2048)) {
+				const nbt::TagByteArray& light_tag = section_tag.findTag<nbt::TagByteArray>(light_tags[array]);
+				light = reinterpret_cast<const uint8_t*>(&light_tag.payload[0]);
+			}
+			if (!any_hidden) {
+				section.setLight(array, light, 0);
+				continue;
+			}
 
-		if (section_tag.hasArray<nbt::TagByteArray>("SkyLight", 2048)) {
-			const nbt::TagByteArray& sky_light = section_tag.findTag<nbt::TagByteArray>("SkyLight");
-			std::copy(sky_light.payload.begin(), sky_light.payload.end(), section.sky_light);
-		} else {
-			std::fill(&section.sky_light[0], &section.sky_light[2048], 0);
+			// the hidden blocks get the light of empty space (no block light, full sky light)
+			uint8_t hidden_light = array == 1 ? 15 : 0;
+			uint8_t cropped_light[16 * 16 * 8];
+			if (light != NULL)
+				std::copy(light, light + 16 * 16 * 8, cropped_light);
+			else
+				std::fill(cropped_light, cropped_light + 16 * 16 * 8, 0);
+			for (int i = 0; i < 16 * 16 * 16; i++) {
+				if (!hidden[i])
+					continue;
+				int shift = (i & 1) << 2;
+				cropped_light[i >> 1] = (cropped_light[i >> 1] & ~(0xf << shift)) | (hidden_light << shift);
+			}
+			section.setLight(array, cropped_light);
 		}
 
 		// add this section to the section list
 		section_offsets[section.y-CHUNK_LOWEST] = sections.size();
-		sections.push_back(section);
+		sections.push_back(std::move(section));
 	}
 
 	return true;
@@ -282,99 +387,23 @@ bool Chunk::hasSection(int y) const {
 	return cs != NULL;
 }
 
-const ChunkSection* Chunk::getSection(int y) const {
-	int chunk_idx = y >> 4;
-	if( chunk_idx < CHUNK_LOWEST || chunk_idx >= CHUNK_HIGHEST) {
-		return NULL;
-	}
-	// Convert index to index into the data array
-	size_t section_idx = section_offsets[chunk_idx - CHUNK_LOWEST];
-	if( section_idx < 0 || section_idx >= sections.size()) {
-		return NULL;
-	}
-	return &sections[section_idx];
-}
-
-uint16_t Chunk::getBlockID(const LocalBlockPos& pos, bool force) const {
-	const ChunkSection* cs = getSection(pos.y);
-	if (!cs)
-		return nop_id;
-
-	int x = pos.x;
-	int z = pos.z;
-
-	// check whether this block is really rendered
-	if (!checkBlockWorldCrop(x, z, pos.y))
-		return nop_id;
-
-	// calculate the offset and get the block ID
-	// and don't forget the add data
-	int offset = ((pos.y & 15) * 256) + (z * 16) + x;
-	uint16_t id = cs->block_ids[offset];
-	if (!force && world_crop.hasBlockMask()) {
-		const BlockMask* mask = world_crop.getBlockMask();
-		BlockMask::BlockState block_state = mask->getBlockState(id);
-		if (block_state == BlockMask::BlockState::COMPLETELY_HIDDEN)
-			return nop_id;
-		else if (block_state == BlockMask::BlockState::COMPLETELY_SHOWN)
-			return id;
-		if (mask->isHidden(id, 0 /*getBlockData(pos, true)*/))
-			return nop_id;
-	}
-	return id;
-}
-
-bool Chunk::checkBlockWorldCrop(int x, int z, int y) const {
-	// now about the actual world cropping:
-	// get the global position of the block
-	BlockPos global_pos = LocalBlockPos(x, z, y).toGlobalPos(chunkpos);
-	// check whether the block is contained in the y-bounds.
-	if (!world_crop.isBlockContainedY(global_pos))
-		return false;
-	// only check x/z-bounds if the chunk is not completely contained
-	if (!chunk_completely_contained && !world_crop.isBlockContainedXZ(global_pos))
-		return false;
-	return true;
-}
-
-uint8_t Chunk::getData(const LocalBlockPos& pos, int array, bool force) const {
-	const ChunkSection* cs = getSection(pos.y);
-	if (!cs) {
-		 // not existing sections should always have skylight
-		 return array == 1 ? 15 : 0;
-	}
-
-	int x = pos.x;
-	int z = pos.z;
-
-	// check whether this block is really rendered
-	if (!checkBlockWorldCrop(x, z, pos.y)) {
-		 return array == 1 ? 15 : 0;
-	}
-
-	uint8_t data = 0;
-	// calculate the offset and get the block data
-	int offset = ((pos.y & 15) * 256) + (z * 16) + x;
-	// handle bottom/top nibble
-	if ((offset % 2) == 0)
-		 data = cs->getArray(array)[offset / 2] & 0xf;
-	else
-		 data = (cs->getArray(array)[offset / 2] >> 4) & 0x0f;
-	if (!force && world_crop.hasBlockMask()) {
-		 const BlockMask* mask = world_crop.getBlockMask();
-		 if (mask->isHidden(getBlockID(pos, true), data)) {
-			  return array == 1 ? 15 : 0;
+bool Chunk::cropBlocks(int y, const bool* columns_contained, uint16_t* block_ids,
+		bool* hidden) const {
+	const BlockMask* block_mask = world_crop.getBlockMask();
+	bool any_hidden = false;
+	for (int i = 0; i < 16; i++) {
+		bool layer_contained = world_crop.isBlockContainedY(BlockPos(0, 0, y * 16 + i));
+		for (int j = 0; j < 16 * 16; j++) {
+			int offset = i * 256 + j;
+			hidden[offset] = !layer_contained || !columns_contained[j]
+				|| (block_mask != nullptr && block_mask->isHidden(block_ids[offset], 0));
+			if (hidden[offset]) {
+				block_ids[offset] = nop_id;
+				any_hidden = true;
+			}
 		}
 	}
-	return data;
-}
-
-uint8_t Chunk::getBlockLight(const LocalBlockPos& pos) const {
-	return getData(pos, 0);
-}
-
-uint8_t Chunk::getSkyLight(const LocalBlockPos& pos) const {
-	return getData(pos, 1);
+	return any_hidden;
 }
 
 uint16_t Chunk::getBiomeAt(const LocalBlockPos& pos) const {
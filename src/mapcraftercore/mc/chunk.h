@@ -26,6 +26,7 @@
 
 #include <stdint.h>
 #include <unordered_map>
+#include <vector>
 
 namespace mapcrafter {
 namespace mc {
@@ -39,21 +40,75 @@ const int Y_CHUNKS_PER_REGION_FILE = 24;	// Number of chunksection in a chunk (t
 
 /**
  * A 16x16x16 section of a chunk.
+ *
+ * The block IDs are stored in a compact, paletted form: A section with only one block
+ * type stores just that single ID, sections with up to 256 different blocks store
+ * bit-packed (1, 2, 4 or 8 bits) indices into a local palette, and only sections with
+ * even more different blocks store every block ID directly. Light arrays which are
+ * completely dark (0) or completely lit (15) aren't stored at all.
  */
 struct ChunkSection {
+	ChunkSection();
+
+	/**
+	 * Sets the block IDs of the section from an array with 16*16*16 block IDs,
+	 * indexed by y*256 + z*16 + x.
+	 */
+	void setBlockIDs(const uint16_t* ids);
+
+	/**
+	 * Sets the light data (0: block light, 1: sky light) of the section from an array
+	 * with 16*16*8 bytes (nibbles), or sets a constant light value if data is NULL.
+	 */
+	void setLight(int array, const uint8_t* data, uint8_t value = 0);
+
+	/**
+	 * Returns the block ID at a specific offset (y*256 + z*16 + x).
+	 */
+	inline uint16_t getBlockID(int offset) const {
+		if (bits == 0)
+			return palette[0];
+		if (bits == 16)
+			return block_ids[offset];
+		int bit = offset * bits;
+		return palette[(packed[bit >> 3] >> (bit & 7)) & ((1 << bits) - 1)];
+	}
+
+	/**
+	 * Returns the light value (0: block light, 1: sky light) at a specific offset.
+	 */
+	inline uint8_t getLight(int array, int offset) const {
+		const std::vector<uint8_t>& data = light[array];
+		if (data.empty())
+			return light_value[array];
+		return (data[offset >> 1] >> ((offset & 1) << 2)) & 0xf;
+	}
+
+	/**
+	 * Returns whether the section consists of only one block type.
+	 */
+	bool isUniform() const;
+
+	/**
+	 * Returns an estimate of the memory used by this section (in bytes).
+	 */
+	size_t getMemoryUsage() const;
+
 	int8_t y;
-	uint8_t block_light[16 * 16 * 8];
-	uint8_t sky_light[16 * 16 * 8];
-	uint16_t block_ids[16 * 16 * 16];
 	uint16_t biomes[4 * 4 * 4];
 
-	inline const uint8_t* getArray(int index) const {
-		if (index == 0) {
-			return block_light;
-		} else {
-			return sky_light;
-		}
-	}
+private:
+	// bits per packed palette index: 0 means the whole section consists of palette[0],
+	// 16 means that the block IDs are stored in block_ids without a palette
+	uint8_t bits;
+	std::vector<uint16_t> palette;
+	std::vector<uint8_t> packed;
+	std::vector<uint16_t> block_ids;
+
+	// nibble arrays of block light / sky light, empty if the whole
+	// section has the same light value light_value[array]
+	std::vector<uint8_t> light[2];
+	uint8_t light_value[2];
 };
 
 /**
@@ -61,6 +116,9 @@ struct ChunkSection {
  * data such as block IDs, block data values and block lighting data.
  *
  * To save memory, the class stores only the sections which exist in the NBT data.
+ * The world crop and the block mask are applied when the chunk is read: Blocks which
+ * are cropped or hidden are stored as air (with the light of empty space), so the
+ * accessors don't need to check them for every block.
  */
 class Chunk {
 public:
@@ -68,7 +126,7 @@ public:
 	~Chunk();
 
 	/**
-	 * Sets the boundaries of the world.
+	 * Sets the boundaries of the world, they are applied when reading the chunk.
 	 */
 	void setWorldCrop(const WorldCrop& world_crop);
 
@@ -97,7 +155,7 @@ public:
 	/**
 	 * Returns the block ID at a specific position (local coordinates).
 	 */
-	uint16_t getBlockID(const LocalBlockPos& pos, bool force = false) const;
+	uint16_t getBlockID(const LocalBlockPos& pos) const;
 
 	/**
 	 * Returns the block light at a specific position (local coordinates).
@@ -128,8 +186,6 @@ private:
 
 	// cropping of the world
 	WorldCrop world_crop;
-	// whether the chunk is completely contained (according x- and z-coordinates, not y)
-	bool chunk_completely_contained;
 
 	// the index of the chunk sections in the sections array
 	// or -1 if section does not exist
@@ -141,10 +197,14 @@ private:
 	std::unordered_map<int, uint16_t> extra_data_map;
 
 	/**
-	 * Checks whether a block is in the cropped
-	 * part of the world and therefore not rendered.
+	 * Replaces the blocks of a section (with y the section index) which are in the
+	 * cropped part of the world or hidden by the block mask with air. The columns of
+	 * the chunk which are contained in the world crop are specified by
+	 * columns_contained (indexed by z*16 + x). Returns whether any block was replaced,
+	 * the replaced blocks are marked in hidden.
 	 */
-	bool checkBlockWorldCrop(int x, int z, int y) const;
+	bool cropBlocks(int y, const bool* columns_contained, uint16_t* block_ids,
+			bool* hidden) const;
 
 	/**
 	 * Returns a specific block data (block data value, block light, sky light) at a
@@ -152,13 +212,52 @@ private:
 	 *   0: block light,
 	 *   1: sky light
 	 */
-	uint8_t getData(const LocalBlockPos& pos, int array, bool force = false) const;
+	uint8_t getData(const LocalBlockPos& pos, int array) const;
 
 	int positionToKey(int x, int z, int y) const;
 	void insertExtraData(const LocalBlockPos& pos, uint16_t extra_data);
 	uint16_t getExtraData(const LocalBlockPos& pos, uint16_t default_value = 0) const;
 };
 
+// the block accessors are used for every block of the renderer, so they are inlined
+
+inline const ChunkSection* Chunk::getSection(int y) const {
+	int chunk_idx = y >> 4;
+	if( chunk_idx < CHUNK_LOWEST || chunk_idx >= CHUNK_HIGHEST) {
+		return NULL;
+	}
+	// Convert index to index into the data array
+	size_t section_idx = section_offsets[chunk_idx - CHUNK_LOWEST];
+	if( section_idx >= sections.size()) {
+		return NULL;
+	}
+	return &sections[section_idx];
+}
+
+inline uint16_t Chunk::getBlockID(const LocalBlockPos& pos) const {
+	const ChunkSection* cs = getSection(pos.y);
+	if (!cs)
+		return nop_id;
+	return cs->getBlockID(((pos.y & 15) * 256) + (pos.z * 16) + pos.x);
+}
+
+inline uint8_t Chunk::getData(const LocalBlockPos& pos, int array) const {
+	const ChunkSection* cs = getSection(pos.y);
+	if (!cs) {
+		 // not existing sections should always have skylight
+		 return array == 1 ? 15 : 0;
+	}
+	return cs->getLight(array, ((pos.y & 15) * 256) + (pos.z * 16) + pos.x);
+}
+
+inline uint8_t Chunk::getBlockLight(const LocalBlockPos& pos) const {
+	return getData(pos, 0);
+}
+
+inline uint8_t Chunk::getSkyLight(const LocalBlockPos& pos) const {
+	return getData(pos, 1);
+}
+
 }
 }
 
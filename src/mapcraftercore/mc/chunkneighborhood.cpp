@@ -0,0 +1,78 @@
+/*
+ * Copyright 2012-2016 Moritz Hilscher
+ *
+ * This file is part of Mapcrafter.
+ *
+ * Mapcrafter is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mapcrafter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mapcrafter.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "chunkneighborhood.h"
+
+#include <algorithm>
+
+namespace mapcrafter {
+namespace mc {
+
+ChunkNeighborhood::ChunkNeighborhood() {
+	clear();
+}
+
+const Chunk* ChunkNeighborhood::update(WorldCache& world, const ChunkPos& center) {
+	this->center = center;
+	for (int dz = -1; dz <= 1; dz++)
+		for (int dx = -1; dx <= 1; dx++)
+			chunks[(dz + 1) * 3 + dx + 1] = world.getChunk(ChunkPos(center.x + dx, center.z + dz));
+	this->world = &world;
+	chunk_loads = world.getChunkLoads();
+	valid = true;
+	return chunks[4];
+}
+
+void ChunkNeighborhood::clear() {
+	valid = false;
+	center = ChunkPos(0, 0);
+	world = nullptr;
+	chunk_loads = 0;
+	std::fill(chunks, chunks + 9, nullptr);
+}
+
+Block ChunkNeighborhood::getBlock(const BlockPos& pos, int get) const {
+	const Chunk* chunk = chunks[getIndex(pos)];
+	if (chunk == nullptr || pos.y < CHUNK_LOWEST*16)
+		return Block();
+
+	LocalBlockPos local(pos);
+	Block block;
+	block.pos = pos;
+	if (get & GET_ID) {
+		block.id = chunk->getBlockID(local);
+		block.fields_set |= GET_ID;
+	}
+	if (get & GET_BIOME) {
+		block.biome = chunk->getBiomeAt(local);
+		block.fields_set |= GET_BIOME;
+	}
+	if (get & GET_BLOCK_LIGHT) {
+		block.block_light = chunk->getBlockLight(local);
+		block.fields_set |= GET_BLOCK_LIGHT;
+	}
+	if (get & GET_SKY_LIGHT) {
+		block.sky_light = chunk->getSkyLight(local);
+		block.fields_set |= GET_SKY_LIGHT;
+	}
+	return block;
+}
+
+}
+}
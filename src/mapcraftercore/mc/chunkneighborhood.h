@@ -0,0 +1,137 @@
+/*
+ * Copyright 2012-2016 Moritz Hilscher
+ *
+ * This file is part of Mapcrafter.
+ *
+ * Mapcrafter is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mapcrafter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mapcrafter.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CHUNKNEIGHBORHOOD_H_
+#define CHUNKNEIGHBORHOOD_H_
+
+#include "chunk.h"
+#include "pos.h"
+#include "worldcache.h"
+
+#include <cassert>
+
+namespace mapcrafter {
+namespace mc {
+
+/**
+ * A view of a chunk and its eight neighbor chunks. The chunks are looked up in the world
+ * cache once when the center chunk changes, so the block data of every position within
+ * 16 blocks (x and z) around the center chunk can be accessed without hashing chunk
+ * positions or building mc::Block objects.
+ *
+ * The getters return the same values as WorldCache::getBlock: Blocks below the world or
+ * in not existing chunks are air (id 0) with sky light 15 and block light 0.
+ *
+ * The chunk pointers point into the chunk cache of the world cache. The nine chunks
+ * have different cache positions, they stay valid as long as no chunk 32 chunks away
+ * (which would replace one of them) is loaded from the world cache. As the world cache
+ * may be shared with other users, the neighborhood isn't valid anymore as soon as any
+ * chunk is loaded into the world cache after looking up the chunks.
+ */
+class ChunkNeighborhood {
+public:
+	ChunkNeighborhood();
+
+	/**
+	 * Looks up the chunks around a center chunk. Returns the center chunk, or nullptr
+	 * if it doesn't exist.
+	 */
+	const Chunk* update(WorldCache& world, const ChunkPos& center);
+
+	/**
+	 * Forgets the chunks, for example when the world cache is about to load other ones.
+	 */
+	void clear();
+
+	/**
+	 * Returns whether the chunks around a specific center chunk are looked up and
+	 * still in the world cache.
+	 */
+	bool hasCenter(const ChunkPos& center) const {
+		return valid && center == this->center && world->getChunkLoads() == chunk_loads;
+	}
+
+	/**
+	 * Returns the center chunk, nullptr if it doesn't exist.
+	 */
+	const Chunk* getCenterChunk() const {
+		return chunks[4];
+	}
+
+	/**
+	 * Returns the chunk of a block position, nullptr if it doesn't exist.
+	 */
+	const Chunk* getChunk(const BlockPos& pos) const {
+		return chunks[getIndex(pos)];
+	}
+
+	uint16_t getID(const BlockPos& pos) const {
+		const Chunk* chunk = chunks[getIndex(pos)];
+		if (chunk == nullptr || pos.y < CHUNK_LOWEST*16)
+			return 0;
+		return chunk->getBlockID(LocalBlockPos(pos));
+	}
+
+	uint8_t getSkyLight(const BlockPos& pos) const {
+		const Chunk* chunk = chunks[getIndex(pos)];
+		if (chunk == nullptr || pos.y < CHUNK_LOWEST*16)
+			return 15;
+		return chunk->getSkyLight(LocalBlockPos(pos));
+	}
+
+	uint8_t getBlockLight(const BlockPos& pos) const {
+		const Chunk* chunk = chunks[getIndex(pos)];
+		if (chunk == nullptr || pos.y < CHUNK_LOWEST*16)
+			return 0;
+		return chunk->getBlockLight(LocalBlockPos(pos));
+	}
+
+	uint16_t getBiome(const BlockPos& pos) const {
+		const Chunk* chunk = chunks[getIndex(pos)];
+		if (chunk == nullptr || pos.y < CHUNK_LOWEST*16)
+			return 0;
+		return chunk->getBiomeAt(LocalBlockPos(pos));
+	}
+
+	/**
+	 * Returns the requested data of a block like WorldCache::getBlock.
+	 */
+	Block getBlock(const BlockPos& pos, int get = GET_ID) const;
+
+private:
+	int getIndex(const BlockPos& pos) const {
+		int dx = (pos.x >> 4) - center.x + 1;
+		int dz = (pos.z >> 4) - center.z + 1;
+		assert(valid && dx >= 0 && dx < 3 && dz >= 0 && dz < 3);
+		return dz * 3 + dx;
+	}
+
+	bool valid;
+	ChunkPos center;
+	// the world cache of the chunks and its chunk load count after looking them up
+	const WorldCache* world;
+	uint64_t chunk_loads;
+	// the chunks, indexed by (z + 1) * 3 + (x + 1) relative to the center chunk
+	const Chunk* chunks[9];
+};
+
+}
+}
+
+#endif /* CHUNKNEIGHBORHOOD_H_ */
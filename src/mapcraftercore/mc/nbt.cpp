@@ -409,7 +409,11 @@ void NBTFile::decompressStream(std::istream& stream, std::stringstream& decompre
 
 void NBTFile::readCompressed(std::istream& stream, Compression compression) {
 	std::stringstream decompressed(std::ios::in | std::ios::out | std::ios::binary);
-	decompressStream(stream, decompressed, compression);
+	{
+		util::ProfileTimer timer(util::ProfilePhase::DECOMPRESSION);
+		decompressStream(stream, decompressed, compression);
+	}
+	util::ProfileTimer timer(util::ProfilePhase::NBT_PARSE);
 	int8_t type = ((TagByte&) TagByte().read(decompressed)).payload;
 	if (type != TagCompound::TAG_TYPE)
 		throw NBTError("First tag is not a tag compound!");
@@ -96,24 +96,11 @@ bool ChunkPos::operator<(const ChunkPos& other) const {
 	return x > other.x;
 }
 
-BlockPos::BlockPos() : x(0), z(0), y(0) {
-}
-
-BlockPos::BlockPos(int x, int z, int y) : x(x), z(z), y(y) {
-}
-
 BlockDir BlockPos::operator-(const BlockPos& p2) const {
 	BlockDir d(this->x - p2.x, this->z - p2.z, this->y - p2.y);
 	return d;
 }
 
-BlockPos& BlockPos::operator+=(const BlockDir& dir) {
-	x += dir.x;
-	z += dir.z;
-	y += dir.y;
-	return *this;
-}
-
 BlockPos& BlockPos::operator-=(const BlockDir& dir) {
 	x -= dir.x;
 	z -= dir.z;
@@ -121,11 +108,6 @@ BlockPos& BlockPos::operator-=(const BlockDir& dir) {
 	return *this;
 }
 
-BlockPos BlockPos::operator+(const BlockDir& dir) const {
-	BlockPos p(this->x + dir.x, this->z + dir.z, this->y + dir.y);
-	return p;
-}
-
 BlockPos BlockPos::operator-(const BlockDir& dir) const {
 	BlockPos p(this->x - dir.x, this->z - dir.z, this->y - dir.y);
 	return p;
@@ -139,12 +121,6 @@ bool BlockPos::operator!=(const BlockPos& other) const {
 	return !operator==(other);
 }
 
-BlockDir::BlockDir() : x(0), z(0), y(0) {
-}
-
-BlockDir::BlockDir(int x, int z, int y) : x(x), z(z), y(y) {
-}
-
 BlockDir& BlockDir::operator+=(const BlockDir& p) {
 	x += p.x;
 	z += p.z;
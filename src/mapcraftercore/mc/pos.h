@@ -89,8 +89,8 @@ class BlockPos {
   public:
 	int x, z, y;
 
-	BlockPos();
-	BlockPos(int x, int z, int y);
+	constexpr BlockPos() : x(0), z(0), y(0) {}
+	constexpr BlockPos(int x, int z, int y) : x(x), z(z), y(y) {}
 
 	bool operator==(const BlockPos& other) const;
 	bool operator!=(const BlockPos& other) const;
@@ -110,8 +110,8 @@ class BlockDir {
   public:
 	int x, z, y;
 
-	BlockDir();
-	BlockDir(int x, int z, int y);
+	constexpr BlockDir() : x(0), z(0), y(0) {}
+	constexpr BlockDir(int x, int z, int y) : x(x), z(z), y(y) {}
 
 	bool operator==(const BlockDir& other) const;
 	bool operator!=(const BlockDir& other) const;
@@ -125,6 +125,18 @@ class BlockDir {
 	BlockPos operator-(const BlockPos& pos) const;
 };
 
+// these are used for every block step of the renderer, so they are inlined
+inline BlockPos& BlockPos::operator+=(const BlockDir& dir) {
+	x += dir.x;
+	z += dir.z;
+	y += dir.y;
+	return *this;
+}
+
+inline BlockPos BlockPos::operator+(const BlockDir& dir) const {
+	return BlockPos(x + dir.x, z + dir.z, y + dir.y);
+}
+
 extern const mc::BlockDir DIR_NORTH, DIR_SOUTH, DIR_EAST, DIR_WEST, DIR_TOP, DIR_BOTTOM;
 
 /**
@@ -0,0 +1,221 @@
+/*
+ * Copyright 2012-2016 Moritz Hilscher
+ *
+ * This file is part of Mapcrafter.
+ *
+ * Mapcrafter is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mapcrafter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mapcrafter.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "regionprefetcher.h"
+
+#include "../util.h"
+
+#include <algorithm>
+#include <atomic>
+#include <fcntl.h>
+#ifdef HAVE_UNISTD_H
+#  include <unistd.h>
+#endif
+
+namespace mapcrafter {
+namespace mc {
+
+namespace {
+
+// the id of the next prefetcher
+std::atomic<uint64_t> next_id(1);
+
+/**
+ * Asks the operating system to read a file into the page cache in the background.
+ */
+void adviseWillNeed(const fs::path& path) {
+#if defined(POSIX_FADV_WILLNEED) && defined(HAVE_UNISTD_H)
+	int fd = open(path.string().c_str(), O_RDONLY);
+	if (fd < 0)
+		return;
+	posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+	close(fd);
+#endif
+}
+
+} // namespace
+
+RegionPrefetcher::RegionPrefetcher(const World& world, int io_threads, int max_regions)
+	: world(world), io_threads(io_threads), max_regions(std::max(max_regions, 1)),
+	  id(next_id++), finished(false),
+	  loaded_unrequested(0), regions_prefetched(0), regions_missed(0) {
+	for (int i = 0; i < io_threads; i++)
+		threads.push_back(thread_ns::thread(&RegionPrefetcher::run, this));
+}
+
+RegionPrefetcher::~RegionPrefetcher() {
+	stop();
+}
+
+void RegionPrefetcher::prefetch(const RegionPos& pos) {
+	thread_ns::unique_lock<thread_ns::mutex> lock(mutex);
+	if (finished || known.count(pos) || !world.hasRegion(pos))
+		return;
+	known.insert(pos);
+	queue.push_back(pos);
+	condition_queue.notify_one();
+}
+
+void RegionPrefetcher::prefetch(const std::vector<RegionPos>& regions) {
+	for (auto it = regions.begin(); it != regions.end(); ++it)
+		prefetch(*it);
+}
+
+bool RegionPrefetcher::getRegion(const RegionPos& pos, RegionFile& region) {
+	std::shared_ptr<RegionFile> result;
+	{
+		thread_ns::unique_lock<thread_ns::mutex> lock(mutex);
+		while (loading.count(pos))
+			condition_loaded.wait(lock);
+
+		auto it = loaded.find(pos);
+		if (it == loaded.end()) {
+			// the renderer needs the region now, so don't read it in the background anymore
+			auto queue_it = std::find(queue.begin(), queue.end(), pos);
+			if (queue_it != queue.end()) {
+				queue.erase(queue_it);
+				known.erase(pos);
+				cached.erase(pos);
+			}
+			regions_missed++;
+			return false;
+		}
+
+		if (it->second.requests++ == 0) {
+			loaded_unrequested--;
+			condition_queue.notify_all();
+		}
+		regions_prefetched++;
+		result = it->second.region;
+	}
+
+	// copy the region data without blocking the other threads
+	region = *result;
+	return true;
+}
+
+void RegionPrefetcher::regionCached(const RegionPos& pos) {
+	thread_ns::unique_lock<thread_ns::mutex> lock(mutex);
+	auto it = loaded.find(pos);
+	if (it == loaded.end()) {
+		// other render threads might still need the region, so it's read anyway
+		if (known.count(pos))
+			cached.insert(pos);
+		return;
+	}
+
+	if (it->second.requests++ == 0) {
+		loaded_unrequested--;
+		condition_queue.notify_all();
+		evictRegions();
+	}
+}
+
+void RegionPrefetcher::stop() {
+	{
+		thread_ns::unique_lock<thread_ns::mutex> lock(mutex);
+		finished = true;
+		condition_queue.notify_all();
+	}
+	for (auto it = threads.begin(); it != threads.end(); ++it)
+		if (it->joinable())
+			it->join();
+	threads.clear();
+}
+
+std::vector<RegionPos> RegionPrefetcher::getLoadedRegions() const {
+	thread_ns::unique_lock<thread_ns::mutex> lock(mutex);
+	return std::vector<RegionPos>(loaded_order.begin(), loaded_order.end());
+}
+
+int RegionPrefetcher::getRegionsPrefetched() const {
+	thread_ns::unique_lock<thread_ns::mutex> lock(mutex);
+	return regions_prefetched;
+}
+
+int RegionPrefetcher::getRegionsMissed() const {
+	thread_ns::unique_lock<thread_ns::mutex> lock(mutex);
+	return regions_missed;
+}
+
+uint64_t RegionPrefetcher::getId() const {
+	return id;
+}
+
+void RegionPrefetcher::evictRegions() {
+	auto it = loaded_order.begin();
+	while (it != loaded_order.end() && loaded.size() > (size_t) max_regions) {
+		auto loaded_it = loaded.find(*it);
+		// regions nobody asked for yet are kept
+		if (loaded_it->second.requests == 0) {
+			++it;
+			continue;
+		}
+		known.erase(*it);
+		loaded.erase(loaded_it);
+		it = loaded_order.erase(it);
+	}
+}
+
+void RegionPrefetcher::run() {
+	while (true) {
+		RegionPos pos;
+		std::vector<fs::path> advise;
+		{
+			thread_ns::unique_lock<thread_ns::mutex> lock(mutex);
+			while (!finished && (queue.empty() || loaded_unrequested >= max_regions))
+				condition_queue.wait(lock);
+			if (finished)
+				return;
+			pos = queue.front();
+			queue.pop_front();
+			loading.insert(pos);
+
+			// the next regions are probably read soon, let the OS already fetch them
+			for (size_t i = 0; i < queue.size() && i < (size_t) io_threads; i++)
+				advise.push_back(world.getRegionPath(queue[i]));
+		}
+
+		for (auto it = advise.begin(); it != advise.end(); ++it)
+			adviseWillNeed(*it);
+
+		std::shared_ptr<RegionFile> region = std::make_shared<RegionFile>();
+		bool ok = world.getRegion(pos, *region) && region->read();
+
+		thread_ns::unique_lock<thread_ns::mutex> lock(mutex);
+		loading.erase(pos);
+		bool was_cached = cached.erase(pos) != 0;
+		if (ok) {
+			LoadedRegion& entry = loaded[pos];
+			entry.region = region;
+			entry.requests = was_cached ? 1 : 0;
+			loaded_order.push_back(pos);
+			if (!was_cached)
+				loaded_unrequested++;
+			evictRegions();
+		} else {
+			// broken regions are read (and remembered) by the world cache itself
+			known.erase(pos);
+		}
+		condition_loaded.notify_all();
+	}
+}
+
+}
+}
@@ -0,0 +1,147 @@
+/*
+ * Copyright 2012-2016 Moritz Hilscher
+ *
+ * This file is part of Mapcrafter.
+ *
+ * Mapcrafter is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mapcrafter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mapcrafter.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef REGIONPREFETCHER_H_
+#define REGIONPREFETCHER_H_
+
+#include "pos.h"
+#include "region.h"
+#include "world.h"
+#include "../compat/thread.h"
+
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <set>
+#include <thread>
+#include <vector>
+
+namespace mapcrafter {
+namespace mc {
+
+/**
+ * Reads region files in the background before the renderer needs them.
+ *
+ * The render dispatcher tells the prefetcher which regions the upcoming render work
+ * will need (in the order the work is processed). A small pool of I/O threads then
+ * reads these region files into memory, while asking the operating system to already
+ * read the next region files of the queue into the page cache. The world caches of the
+ * render threads ask the prefetcher for a region before reading it themselves.
+ *
+ * To limit the memory usage, only a fixed number of regions is kept in memory. The I/O
+ * threads pause when this many regions were read ahead and weren't requested yet. The
+ * world caches tell the prefetcher about regions they have cached already, these are
+ * never requested.
+ */
+class RegionPrefetcher {
+public:
+	RegionPrefetcher(const World& world, int io_threads = 2, int max_regions = 16);
+	~RegionPrefetcher();
+
+	/**
+	 * Adds a region to the end of the prefetch queue. Regions which are already queued
+	 * or loaded are ignored.
+	 */
+	void prefetch(const RegionPos& pos);
+
+	/**
+	 * Adds multiple regions to the prefetch queue (in this order).
+	 */
+	void prefetch(const std::vector<RegionPos>& regions);
+
+	/**
+	 * Assigns a prefetched region to the supplied region object. If the region is
+	 * currently being read, this waits until it is ready. Returns false if the region
+	 * wasn't prefetched (or it is broken), the caller has to read it by itself then.
+	 */
+	bool getRegion(const RegionPos& pos, RegionFile& region);
+
+	/**
+	 * Tells the prefetcher that a world cache has a region already (for example from
+	 * previous render work). The region can be evicted like a requested region then,
+	 * the I/O threads don't wait for it to be requested.
+	 */
+	void regionCached(const RegionPos& pos);
+
+	/**
+	 * Stops the I/O threads. Regions which are still queued aren't read anymore.
+	 */
+	void stop();
+
+	/**
+	 * Returns the regions which are read and kept in memory, in the order they were read.
+	 */
+	std::vector<RegionPos> getLoadedRegions() const;
+
+	int getRegionsPrefetched() const;
+	int getRegionsMissed() const;
+
+	/**
+	 * Returns a number which identifies this prefetcher. Every prefetcher has another
+	 * number, also if it was created at the address of a destroyed one.
+	 */
+	uint64_t getId() const;
+
+private:
+	struct LoadedRegion {
+		std::shared_ptr<RegionFile> region;
+		int requests;
+	};
+
+	World world;
+	int io_threads, max_regions;
+	uint64_t id;
+
+	mutable thread_ns::mutex mutex;
+	thread_ns::condition_variable condition_queue, condition_loaded;
+	bool finished;
+
+	// regions waiting to be read, and all regions the prefetcher knows about
+	std::deque<RegionPos> queue;
+	std::set<RegionPos> known;
+	// regions which are currently read by an I/O thread
+	std::set<RegionPos> loading;
+	// queued regions a world cache has already, they don't wait for a request when read
+	std::set<RegionPos> cached;
+	// regions which are read, with their order to evict the oldest ones
+	std::map<RegionPos, LoadedRegion> loaded;
+	std::deque<RegionPos> loaded_order;
+	int loaded_unrequested;
+
+	int regions_prefetched, regions_missed;
+
+	std::vector<thread_ns::thread> threads;
+
+	/**
+	 * Evicts the oldest already requested regions if there are too many regions in
+	 * memory. Must be called with the mutex locked.
+	 */
+	void evictRegions();
+
+	/**
+	 * Main loop of an I/O thread.
+	 */
+	void run();
+};
+
+}
+}
+
+#endif /* REGIONPREFETCHER_H_ */
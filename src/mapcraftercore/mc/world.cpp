@@ -187,5 +187,70 @@ int World::getMinecraftVersion() const {
 	}
 }
 
+bool World::getSpawnPoint(BlockPos& spawn) const {
+	fs::path level_dat = world_dir / "level.dat";
+	if (!fs::is_regular_file(level_dat))
+		return false;
+
+	nbt::NBTFile nbt;
+	try {
+		nbt.readNBT(level_dat.string().c_str());
+		const nbt::TagCompound& data_tag = nbt.findTag<nbt::TagCompound>("Data");
+		if (!data_tag.hasTag<nbt::TagInt>("SpawnX") || !data_tag.hasTag<nbt::TagInt>("SpawnY")
+				|| !data_tag.hasTag<nbt::TagInt>("SpawnZ"))
+			return false;
+		spawn = BlockPos(data_tag.findTag<nbt::TagInt>("SpawnX").payload,
+				data_tag.findTag<nbt::TagInt>("SpawnZ").payload,
+				data_tag.findTag<nbt::TagInt>("SpawnY").payload);
+		return true;
+	} catch (nbt::NBTError& e) {
+		LOG(WARNING) << "Unable to read level.dat file: " << e.what();
+		return false;
+	}
+}
+
+std::vector<BlockPos> World::getPlayerPositions() const {
+	std::vector<BlockPos> positions;
+	fs::path playerdata_dir = world_dir / "playerdata";
+	if (!fs::is_directory(playerdata_dir))
+		return positions;
+
+	// the dimension of a player is a string since Minecraft 1.16, a number before
+	std::string dimension_name = "minecraft:overworld";
+	int dimension_id = 0;
+	if (dimension == Dimension::NETHER) {
+		dimension_name = "minecraft:the_nether";
+		dimension_id = -1;
+	} else if (dimension == Dimension::END) {
+		dimension_name = "minecraft:the_end";
+		dimension_id = 1;
+	}
+
+	for (fs::directory_iterator it(playerdata_dir); it != fs::directory_iterator(); ++it) {
+		if (it->path().extension() != ".dat")
+			continue;
+		nbt::NBTFile nbt;
+		try {
+			nbt.readNBT(it->path().string().c_str());
+			if (!nbt.hasList<nbt::TagDouble>("Pos", 3))
+				continue;
+			if (nbt.hasTag<nbt::TagString>("Dimension")
+					&& nbt.findTag<nbt::TagString>("Dimension").payload != dimension_name)
+				continue;
+			if (nbt.hasTag<nbt::TagInt>("Dimension")
+					&& nbt.findTag<nbt::TagInt>("Dimension").payload != dimension_id)
+				continue;
+			const nbt::TagList& pos = nbt.findTag<nbt::TagList>("Pos");
+			positions.push_back(BlockPos(
+					std::floor(pos.payload[0]->cast<nbt::TagDouble>().payload),
+					std::floor(pos.payload[2]->cast<nbt::TagDouble>().payload),
+					std::floor(pos.payload[1]->cast<nbt::TagDouble>().payload)));
+		} catch (nbt::NBTError& e) {
+			LOG(WARNING) << "Unable to read player data file " << it->path() << ": " << e.what();
+		}
+	}
+	return positions;
+}
+
 }
 }
@@ -29,6 +29,7 @@
 #include <string>
 #include <unordered_map>
 #include <unordered_set>
+#include <vector>
 #include <boost/filesystem.hpp>
 #include <boost/unordered_set.hpp>
 #include <boost/unordered_map.hpp>
@@ -175,6 +176,18 @@ public:
 	 */
 	int getMinecraftVersion() const;
 
+	/**
+	 * Reads the spawn point of the world (tags "SpawnX", "SpawnY" and "SpawnZ" in tag
+	 * "Data" of the level.dat). Returns false if the spawn point can't be read.
+	 */
+	bool getSpawnPoint(BlockPos& spawn) const;
+
+	/**
+	 * Returns the positions of the players in the dimension of the world, read from the
+	 * player data files in the playerdata directory of the world.
+	 */
+	std::vector<BlockPos> getPlayerPositions() const;
+
 private:
 	// world directory, region directory
 	fs::path world_dir, region_dir, cache_dir;
@@ -20,6 +20,9 @@
 #include "worldcache.h"
 
 #include "blockstate.h"
+#include "regionprefetcher.h"
+
+#include <algorithm>
 
 namespace mapcrafter {
 namespace mc {
@@ -36,9 +39,12 @@ Block::Block(const mc::BlockPos& pos, uint16_t id)
 }
 
 WorldCache::WorldCache(mc::BlockStateRegistry& block_registry, const World& world)
-	: block_registry(block_registry), world(world) {
-	for (int i = 0; i < RSIZE; i++)
+	: block_registry(block_registry), world(world), region_prefetcher(nullptr),
+	  region_prefetcher_id(0), chunk_loads(0) {
+	for (int i = 0; i < RSIZE; i++) {
 		regioncache[i].used = false;
+		regions_announced[i] = false;
+	}
 	for (int i = 0; i < CSIZE; i++)
 		chunkcache[i].used = false;
 }
@@ -47,6 +53,15 @@ const World& WorldCache::getWorld() const {
 	return world;
 }
 
+void WorldCache::setRegionPrefetcher(RegionPrefetcher* region_prefetcher) {
+	// a prefetcher might have the address of a previous one, so they are told apart by id
+	uint64_t id = region_prefetcher != nullptr ? region_prefetcher->getId() : 0;
+	if (region_prefetcher_id != id)
+		std::fill(regions_announced, regions_announced + RSIZE, false);
+	this->region_prefetcher = region_prefetcher;
+	region_prefetcher_id = id;
+}
+
 /**
  * Calculates the position of a region position in the cache.
  */
@@ -63,13 +78,22 @@ int WorldCache::getChunkCacheIndex(const ChunkPos& pos) const {
 }
 
 RegionFile* WorldCache::getRegion(const RegionPos& pos) {
-	CacheEntry<RegionPos, RegionFile>& entry = regioncache[getRegionCacheIndex(pos)];
+	int index = getRegionCacheIndex(pos);
+	CacheEntry<RegionPos, RegionFile>& entry = regioncache[index];
 
 	// check if region is already in cache
 	if (entry.used && entry.key == pos) {
-		//regionstats.hits++;
+		regionstats.hits++;
+		util::profileCount(util::ProfileCounter::REGION_CACHE_HITS);
+		// the region might have been cached before it was prefetched (by another job),
+		// the prefetcher doesn't need to keep it
+		if (region_prefetcher != nullptr && !regions_announced[index]) {
+			region_prefetcher->regionCached(pos);
+			regions_announced[index] = true;
+		}
 		return &entry.value;
 	}
+	regions_announced[index] = true;
 
 	// if not try to load the region
 	// but make sure we did not already try to load the region file and it was broken
@@ -77,10 +101,27 @@ RegionFile* WorldCache::getRegion(const RegionPos& pos) {
 		return nullptr;
 
 	// region does not exist, region in cache was not modified
+	if (!world.hasRegion(pos)) {
+		regionstats.not_found++;
+		return nullptr;
+	}
+
+	util::ProfileTimer timer(util::ProfilePhase::CHUNK_IO);
+	regionstats.misses++;
+	util::profileCount(util::ProfileCounter::REGION_CACHE_MISSES);
+
+	// maybe the prefetcher has already read the region in the background
+	if (region_prefetcher != nullptr && region_prefetcher->getRegion(pos, entry.value)) {
+		entry.used = true;
+		entry.key = pos;
+		return &entry.value;
+	}
+
 	if (!world.getRegion(pos, entry.value))
 		return nullptr;
 
 	if (!entry.value.read()) {
+		regionstats.invalid++;
 		// the region is not valid, region in cache was probably modified
 		entry.used = false;
 		// remember this region as broken and do not try to load it again
@@ -90,7 +131,6 @@ RegionFile* WorldCache::getRegion(const RegionPos& pos) {
 
 	entry.used = true;
 	entry.key = pos;
-	//regionstats.misses++;
 	return &entry.value;
 }
 
@@ -98,14 +138,15 @@ Chunk* WorldCache::getChunk(const ChunkPos& pos) {
 	CacheEntry<ChunkPos, Chunk>& entry = chunkcache[getChunkCacheIndex(pos)];
 	// check if chunk is already in cache
 	if (entry.used && entry.key == pos) {
-		//chunkstats.hits++;
+		chunkstats.hits++;
+		util::profileCount(util::ProfileCounter::CHUNK_CACHE_HITS);
 		return &entry.value;
 	}
 
 	// if not try to get the region of the chunk from the cache
 	RegionFile* region = getRegion(pos.getRegion());
 	if (region == nullptr) {
-		//chunkstats.unavailable++;
+		chunkstats.region_not_found++;
 		return nullptr;
 	}
 
@@ -114,13 +155,23 @@ Chunk* WorldCache::getChunk(const ChunkPos& pos) {
 	if (chunks_broken.count(pos))
 		return nullptr;
 
+	if (!region->hasChunk(pos)) {
+		chunkstats.not_found++;
+		return nullptr;
+	}
+
+	chunkstats.misses++;
+	util::profileCount(util::ProfileCounter::CHUNK_CACHE_MISSES);
+	chunk_loads++;
 	int status = region->loadChunk(pos, block_registry, entry.value);
 	// the chunk does not exist, chunk in cache was not modified
-	if (status == RegionFile::CHUNK_DOES_NOT_EXIST)
+	if (status == RegionFile::CHUNK_DOES_NOT_EXIST) {
+		chunkstats.not_found++;
 		return nullptr;
+	}
 
 	if (status != RegionFile::CHUNK_OK) {
-		//chunkstats.unavailable++;
+		chunkstats.invalid++;
 		// the chunk is not valid, chunk in cache was probably modified
 		entry.used = false;
 		// remember this chunk as broken and do not try to load it again
@@ -130,7 +181,6 @@ Chunk* WorldCache::getChunk(const ChunkPos& pos) {
 
 	entry.used = true;
 	entry.key = pos;
-	//chunkstats.misses++;
 	return &entry.value;
 }
 
@@ -152,7 +202,7 @@ Block WorldCache::getBlock(const mc::BlockPos& pos, const mc::Chunk* chunk, int
 		Block block;
 		block.pos = pos;
 		if (get & GET_ID) {
-			block.id = mychunk->getBlockID(local, true);
+			block.id = mychunk->getBlockID(local);
 			block.fields_set |= GET_ID;
 		}
 		if (get & GET_BIOME) {
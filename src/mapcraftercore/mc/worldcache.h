@@ -31,6 +31,7 @@ namespace mapcrafter {
 namespace mc {
 
 class BlockStateRegistry;
+class RegionPrefetcher;
 
 /**
  * A block with id/data/biome/lighting data.
@@ -55,7 +56,8 @@ const int GET_SKY_LIGHT = 16;
 const int GET_LIGHT = GET_BLOCK_LIGHT | GET_SKY_LIGHT;
 
 /**
- * Some cache statistics for debugging. Not used at the moment.
+ * Some cache statistics for debugging. The render profiler collects hits and misses
+ * of the world caches as well.
  *
  * Maybe add a set of corrupt chunks/regions to dump them at the end of the rendering.
  */
@@ -127,7 +129,14 @@ private:
 	mc::BlockStateRegistry& block_registry;
 	World world;
 
+	// optional prefetcher which may have read the required regions already, and its id
+	// (the regions are announced again to every new prefetcher)
+	RegionPrefetcher* region_prefetcher;
+	uint64_t region_prefetcher_id;
+
 	CacheEntry<RegionPos, RegionFile> regioncache[RSIZE];
+	// whether the region prefetcher knows that a cached region doesn't need to be read
+	bool regions_announced[RSIZE];
 	CacheEntry<ChunkPos, Chunk> chunkcache[CSIZE];
 
 	// provisional set to keep track of broken regions/chunks
@@ -138,6 +147,9 @@ private:
 	CacheStats regionstats;
 	CacheStats chunkstats;
 
+	// counts how often a chunk was loaded into (and maybe replaced) a cache entry
+	uint64_t chunk_loads;
+
 	int getRegionCacheIndex(const RegionPos& pos) const;
 	int getChunkCacheIndex(const ChunkPos& pos) const;
 
@@ -146,9 +158,22 @@ public:
 
 	const World& getWorld() const;
 
+	/**
+	 * Sets a region prefetcher which is asked for regions before reading them.
+	 */
+	void setRegionPrefetcher(RegionPrefetcher* region_prefetcher);
+
 	RegionFile* getRegion(const RegionPos& pos);
 	Chunk* getChunk(const ChunkPos& pos);
 
+	/**
+	 * Returns how often a chunk was loaded into the chunk cache. Pointers to cached
+	 * chunks are valid as long as this doesn't change.
+	 */
+	uint64_t getChunkLoads() const {
+		return chunk_loads;
+	}
+
 	Block getBlock(const mc::BlockPos& pos, const mc::Chunk* chunk, int get = GET_ID);
 
 	const CacheStats& getRegionCacheStats() const;
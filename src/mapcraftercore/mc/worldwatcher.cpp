@@ -0,0 +1,272 @@
+/*
+ * Copyright 2012-2016 Moritz Hilscher
+ *
+ * This file is part of Mapcrafter.
+ *
+ * Mapcrafter is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mapcrafter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mapcrafter.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "worldwatcher.h"
+
+#include "region.h"
+#include "../config.h"
+#include "../util.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+
+#ifdef HAVE_SYS_INOTIFY_H
+#  include <cerrno>
+#  include <cstring>
+#  include <poll.h>
+#  include <sys/inotify.h>
+#  include <unistd.h>
+#endif
+
+namespace mapcrafter {
+namespace mc {
+
+namespace {
+
+/**
+ * Parses the position of a region from a region file name, returns false if it's
+ * not a region file name.
+ */
+bool parseRegionFilename(const std::string& filename, RegionPos& region) {
+	std::string ending = ".mca";
+	if (filename.size() < ending.size()
+			|| !std::equal(ending.rbegin(), ending.rend(), filename.rbegin()))
+		return false;
+	return sscanf(filename.c_str(), "r.%d.%d.mca", &region.x, &region.z) == 2;
+}
+
+int millisecondsSince(std::chrono::steady_clock::time_point time) {
+	return std::chrono::duration_cast<std::chrono::milliseconds>(
+			std::chrono::steady_clock::now() - time).count();
+}
+
+}
+
+WorldWatcher::WorldWatcher()
+	: inotify_fd(-1) {
+#ifdef HAVE_SYS_INOTIFY_H
+	inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (inotify_fd == -1)
+		LOG(WARNING) << "Unable to initialize inotify: " << std::strerror(errno)
+				<< ". Polling the region files for changes instead.";
+#endif
+}
+
+WorldWatcher::~WorldWatcher() {
+#ifdef HAVE_SYS_INOTIFY_H
+	if (inotify_fd != -1)
+		close(inotify_fd);
+#endif
+}
+
+bool WorldWatcher::addWorld(const std::string& name, const World& world) {
+	WatchedWorld watched;
+	watched.name = name;
+	watched.region_dir = world.getRegionDir();
+	watched.world_crop = world.getWorldCrop();
+	watched.watch_descriptor = -1;
+
+#ifdef HAVE_SYS_INOTIFY_H
+	if (inotify_fd != -1) {
+		watched.watch_descriptor = inotify_add_watch(inotify_fd,
+				watched.region_dir.string().c_str(),
+				IN_CLOSE_WRITE | IN_MODIFY | IN_MOVED_TO | IN_CREATE | IN_DELETE);
+		if (watched.watch_descriptor == -1) {
+			LOG(ERROR) << "Unable to watch region directory " << watched.region_dir
+					<< ": " << std::strerror(errno);
+			return false;
+		}
+	}
+#endif
+
+	auto regions = world.getAvailableRegions();
+	for (auto it = regions.begin(); it != regions.end(); ++it) {
+		readTimestamps(watched, *it, watched.timestamps[*it]);
+		boost::system::error_code error;
+		watched.modification_times[*it] = fs::last_write_time(world.getRegionPath(*it), error);
+	}
+
+	worlds.push_back(watched);
+	return true;
+}
+
+bool WorldWatcher::waitForChanges(std::map<std::string, std::map<ChunkPos, uint32_t> >& changes,
+		std::time_t& changes_time, int debounce_ms) {
+	changes.clear();
+	while (changes.empty()) {
+		std::map<size_t, std::set<RegionPos> > regions;
+		if (!waitForRegions(-1, regions))
+			return false;
+
+		// wait until the region files weren't changed for a while
+		auto first_change = std::chrono::steady_clock::now();
+		while (true) {
+			int timeout = std::min(debounce_ms, 4 * debounce_ms - millisecondsSince(first_change));
+			if (timeout <= 0)
+				break;
+			std::map<size_t, std::set<RegionPos> > more_regions;
+			if (!waitForRegions(timeout, more_regions))
+				return false;
+			if (more_regions.empty())
+				break;
+			for (auto it = more_regions.begin(); it != more_regions.end(); ++it)
+				regions[it->first].insert(it->second.begin(), it->second.end());
+		}
+
+		changes_time = std::time(nullptr);
+		for (auto it = regions.begin(); it != regions.end(); ++it) {
+			WatchedWorld& world = worlds[it->first];
+			for (auto region_it = it->second.begin(); region_it != it->second.end(); ++region_it) {
+				std::vector<uint32_t> timestamps;
+				// ignore the region file if it can't be read, it's probably still written
+				// and we'll get another change when it's done
+				if (!readTimestamps(world, *region_it, timestamps))
+					continue;
+				std::vector<uint32_t>& old_timestamps = world.timestamps[*region_it];
+				old_timestamps.resize(1024, 0);
+				for (size_t i = 0; i < 1024; i++) {
+					if (timestamps[i] == old_timestamps[i])
+						continue;
+					ChunkPos chunk(region_it->x * 32 + i % 32, region_it->z * 32 + i / 32);
+					changes[world.name][chunk] = timestamps[i];
+				}
+				old_timestamps = timestamps;
+			}
+		}
+	}
+	return true;
+}
+
+bool WorldWatcher::readTimestamps(const WatchedWorld& world, const RegionPos& region,
+		std::vector<uint32_t>& timestamps) const {
+	timestamps.assign(1024, 0);
+	fs::path path = world.region_dir / ("r." + util::str(region.x) + "."
+			+ util::str(region.z) + ".mca");
+	if (!fs::exists(path))
+		return true;
+
+	RegionFile file(path.string());
+	file.setWorldCrop(world.world_crop);
+	if (!file.readOnlyHeaders()) {
+		// empty region files don't have any chunks
+		boost::system::error_code error;
+		return fs::file_size(path, error) == 0;
+	}
+	for (size_t i = 0; i < 1024; i++) {
+		ChunkPos chunk(region.x * 32 + i % 32, region.z * 32 + i / 32);
+		if (file.hasChunk(chunk))
+			timestamps[i] = file.getChunkTimestamp(chunk);
+	}
+	return true;
+}
+
+bool WorldWatcher::waitForRegions(int timeout_ms, std::map<size_t, std::set<RegionPos> >& regions) {
+#ifdef HAVE_SYS_INOTIFY_H
+	if (inotify_fd != -1) {
+		struct pollfd fds;
+		fds.fd = inotify_fd;
+		fds.events = POLLIN;
+		int ready = poll(&fds, 1, timeout_ms);
+		if (ready == -1 && errno != EINTR) {
+			LOG(ERROR) << "Unable to wait for changed region files: " << std::strerror(errno);
+			return false;
+		}
+		if (ready <= 0)
+			return true;
+
+		char buffer[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+		while (true) {
+			ssize_t length = read(inotify_fd, buffer, sizeof(buffer));
+			if (length <= 0)
+				break;
+			for (char* ptr = buffer; ptr < buffer + length; ) {
+				const struct inotify_event* event = (const struct inotify_event*) ptr;
+				ptr += sizeof(struct inotify_event) + event->len;
+
+				if (event->mask & IN_Q_OVERFLOW) {
+					// events were lost, so check every region file
+					for (size_t i = 0; i < worlds.size(); i++)
+						pollRegions(i, regions[i]);
+					continue;
+				}
+				RegionPos region;
+				if (event->len == 0 || !parseRegionFilename(event->name, region))
+					continue;
+				for (size_t i = 0; i < worlds.size(); i++)
+					if (worlds[i].watch_descriptor == event->wd
+							&& worlds[i].world_crop.isRegionContained(region))
+						regions[i].insert(region);
+			}
+		}
+		return true;
+	}
+#endif
+
+	auto start = std::chrono::steady_clock::now();
+	while (true) {
+		for (size_t i = 0; i < worlds.size(); i++) {
+			std::set<RegionPos> changed;
+			pollRegions(i, changed);
+			if (!changed.empty())
+				regions[i].insert(changed.begin(), changed.end());
+		}
+		int remaining = timeout_ms - millisecondsSince(start);
+		if (!regions.empty() || (timeout_ms >= 0 && remaining <= 0))
+			return true;
+		int sleep_ms = timeout_ms < 0 ? 1000 : std::min(1000, remaining);
+		std::this_thread::sleep_for(std::chrono::milliseconds(sleep_ms));
+	}
+}
+
+void WorldWatcher::pollRegions(size_t world_index, std::set<RegionPos>& regions) {
+	WatchedWorld& world = worlds[world_index];
+	if (!fs::exists(world.region_dir))
+		return;
+
+	std::set<RegionPos> existing;
+	for (fs::directory_iterator it(world.region_dir); it != fs::directory_iterator(); ++it) {
+		RegionPos region;
+		if (!parseRegionFilename(BOOST_FS_FILENAME(it->path()), region)
+				|| !world.world_crop.isRegionContained(region))
+			continue;
+		existing.insert(region);
+		boost::system::error_code error;
+		std::time_t modification_time = fs::last_write_time(it->path(), error);
+		auto known = world.modification_times.find(region);
+		if (known == world.modification_times.end() || known->second != modification_time) {
+			world.modification_times[region] = modification_time;
+			regions.insert(region);
+		}
+	}
+
+	// deleted region files
+	for (auto it = world.modification_times.begin(); it != world.modification_times.end(); ) {
+		if (existing.count(it->first))
+			++it;
+		else {
+			regions.insert(it->first);
+			world.modification_times.erase(it++);
+		}
+	}
+}
+
+}
+}
@@ -0,0 +1,107 @@
+/*
+ * Copyright 2012-2016 Moritz Hilscher
+ *
+ * This file is part of Mapcrafter.
+ *
+ * Mapcrafter is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mapcrafter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mapcrafter.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef WORLDWATCHER_H_
+#define WORLDWATCHER_H_
+
+#include "pos.h"
+#include "world.h"
+
+#include <cstdint>
+#include <ctime>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace mapcrafter {
+namespace mc {
+
+/**
+ * Watches the region files of worlds for changes and finds out which chunks changed.
+ *
+ * The watcher uses inotify if it is available and polls the modification times of the
+ * region files otherwise. It remembers the chunk timestamps of all region files, so a
+ * changed region file is compared with its previous header to find the changed chunks
+ * (chunks with a new timestamp, new chunks and deleted chunks).
+ */
+class WorldWatcher {
+public:
+	WorldWatcher();
+	~WorldWatcher();
+
+	/**
+	 * Starts watching the regions of a world and reads the headers of its region files.
+	 * Returns false if the region directory can't be watched.
+	 */
+	bool addWorld(const std::string& name, const World& world);
+
+	/**
+	 * Waits until region files are changed, then waits until no region file was changed
+	 * for the debounce time (but at most four times the debounce time after the first
+	 * change), so regions saved one after another are handled together.
+	 *
+	 * Returns the changed chunks with their new timestamps (0 for deleted chunks) of
+	 * every world with changes and the time before their region headers were read.
+	 * Returns false if watching the region files failed.
+	 */
+	bool waitForChanges(std::map<std::string, std::map<ChunkPos, uint32_t> >& changes,
+			std::time_t& changes_time, int debounce_ms);
+
+private:
+	struct WatchedWorld {
+		std::string name;
+		fs::path region_dir;
+		WorldCrop world_crop;
+
+		// chunk timestamps of every region (by local chunk index z * 32 + x)
+		std::map<RegionPos, std::vector<uint32_t> > timestamps;
+		// modification times of the region files, used when polling
+		std::map<RegionPos, std::time_t> modification_times;
+		int watch_descriptor;
+	};
+
+	/**
+	 * Reads the chunk timestamps of a region file, all timestamps are 0 if the region
+	 * file doesn't exist (anymore). Returns false if the region file can't be read.
+	 */
+	bool readTimestamps(const WatchedWorld& world, const RegionPos& region,
+			std::vector<uint32_t>& timestamps) const;
+
+	/**
+	 * Waits up to timeout_ms milliseconds (or infinitely if negative) for changed
+	 * region files and adds them to the changed regions of the worlds (by index).
+	 * Returns false if an error occurred.
+	 */
+	bool waitForRegions(int timeout_ms, std::map<size_t, std::set<RegionPos> >& regions);
+
+	/**
+	 * Checks the modification times of the region files of a world for changes.
+	 */
+	void pollRegions(size_t world_index, std::set<RegionPos>& regions);
+
+	std::vector<WatchedWorld> worlds;
+	// inotify file descriptor, -1 if polling
+	int inotify_fd;
+};
+
+}
+}
+
+#endif /* WORLDWATCHER_H_ */
@@ -25,8 +25,36 @@
 namespace mapcrafter {
 namespace renderer {
 
-// Singleton pointer
-BlockAtlas* BlockAtlas::instance_ptr = NULL;
+namespace {
+
+/**
+ * Scales a block image down to half of its size. A pixel gets the alpha-weighted
+ * color of its four source pixels, but the alpha of the top left one, so the shape
+ * of the block matches its uv image (scaled with nearest-neighbor interpolation).
+ * Solid blocks stay solid that way and there are no seams between the blocks.
+ */
+void halveBlockImage(const RGBAImage& image, RGBAImage& dest) {
+	dest.setSize(image.getWidth() / 2, image.getHeight() / 2);
+	for (int y = 0; y < dest.getHeight(); y++) {
+		for (int x = 0; x < dest.getWidth(); x++) {
+			uint8_t alpha = rgba_alpha(image.pixel(2 * x, 2 * y));
+			uint32_t r = 0, g = 0, b = 0, a = 0;
+			for (int i = 0; i < 4 && alpha != 0; i++) {
+				uint32_t pixel = image.pixel(2 * x + i % 2, 2 * y + i / 2);
+				r += rgba_red(pixel) * rgba_alpha(pixel);
+				g += rgba_green(pixel) * rgba_alpha(pixel);
+				b += rgba_blue(pixel) * rgba_alpha(pixel);
+				a += rgba_alpha(pixel);
+			}
+			if (alpha == 0)
+				dest.pixel(x, y) = 0;
+			else
+				dest.pixel(x, y) = rgba(r / a, g / a, b / a, alpha);
+		}
+	}
+}
+
+}
 
 /*
  * Load a picture and associated text file to populate the atlas with
@@ -106,7 +134,7 @@ bool BlockAtlas::OpenDictionnary(fs::path path, std::string name) {
 	return true;
 }
 
-std::shared_ptr<const RGBAImage> const BlockAtlas::GetImage(uint32_t idx) {
+std::shared_ptr<const RGBAImage> const BlockAtlas::GetImage(uint32_t idx) const {
 	if (idx < 0 || idx >= this->block_count) {
 		LOG(ERROR) << "Block atlas doesn't match image index file ";
 		return this->unknown_block;
@@ -148,5 +176,30 @@ void BlockAtlas::ShadeBlock(int idx, int uv_idx, float factor_left, float factor
 	}
 }
 
+void BlockAtlas::ScaleDown(uint32_t factor, const std::unordered_set<uint32_t>& uv_images) {
+	if (factor <= 1) {
+		return;
+	}
+	block_width /= factor;
+	block_height /= factor;
+
+	for (uint32_t idx = 0; idx < block_ptrs.size(); idx++) {
+		RGBAImage& block = *block_ptrs[idx];
+		if (block.getWidth() == 0 || block.getHeight() == 0) {
+			continue;
+		}
+		RGBAImage scaled;
+		if (uv_images.count(idx)) {
+			block.resize(scaled, block_width, block_height, InterpolationType::NEAREST);
+			block = scaled;
+		} else {
+			for (uint32_t f = factor; f > 1; f /= 2) {
+				halveBlockImage(block, scaled);
+				block = scaled;
+			}
+		}
+	}
+}
+
 }  // namespace renderer
 }  // namespace mapcrafter
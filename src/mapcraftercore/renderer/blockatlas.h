@@ -43,26 +43,27 @@ static const uint8_t FACE_LEFT_INDEX  = ((float)255.0 / 6.0) * 1;
 static const uint8_t FACE_RIGHT_INDEX = ((float)255.0 / 6.0) * 4;
 static const uint8_t FACE_UP_INDEX    = ((float)255.0 / 6.0) * 2;
 
+/*
+ * The block images of a block image file. Every set of block images has its own atlas,
+ * so the block images of different maps/rotations can be used at the same time.
+ */
 class BlockAtlas {
-  private:
-	static BlockAtlas* instance_ptr;
-	BlockAtlas(){};
-
   public:
-	static BlockAtlas& instance() {
-		if (!BlockAtlas::instance_ptr) {
-			BlockAtlas::instance_ptr = new BlockAtlas();
-		}
-		return *BlockAtlas::instance_ptr;
-	}
+	BlockAtlas() : block_count(0), block_width(0), block_height(0){};
 
 	bool OpenDictionnary(fs::path path, std::string block_file);
 
-	uint32_t const                         GetCount() { return this->block_count; };
-	std::shared_ptr<const RGBAImage> const GetImage(uint32_t idx);
+	uint32_t                               GetCount() const { return this->block_count; };
+	std::shared_ptr<const RGBAImage> const GetImage(uint32_t idx) const;
 
 	void ShadeBlock(int idx, int uv_idx, float factor_left, float factor_right, float factor_up);
 
+	/*
+	 * Scales all block images down by a factor (a power of two). The uv images are
+	 * scaled with nearest-neighbor interpolation, their pixels can't be mixed.
+	 */
+	void ScaleDown(uint32_t factor, const std::unordered_set<uint32_t>& uv_images);
+
 	uint32_t GetBlockWidth() const { return block_width; };
 	uint32_t GetBlockHeight() const { return block_width; };
 
@@ -385,9 +385,17 @@ void blockImageShadowEdges(RGBAImage& block, const RGBAImage& uv_mask,
 	assert(block.getWidth() == uv_mask.getWidth());
 	assert(block.getHeight() == uv_mask.getHeight());
 
-	size_t n = block.getWidth() * block.getHeight();
+	std::vector<uint8_t> factors;
+	blockImageShadowEdgeFactors(uv_mask, north, south, east, west, bottomleft, bottomright, factors);
+	blockImageShade(block, factors);
+}
+
+void blockImageShadowEdgeFactors(const RGBAImage& uv_mask, uint8_t north, uint8_t south,
+		uint8_t east, uint8_t west, uint8_t bottomleft, uint8_t bottomright,
+		std::vector<uint8_t>& factors) {
+	size_t n = uv_mask.getWidth() * uv_mask.getHeight();
+	factors.resize(n);
 	for (size_t i = 0; i < n; i++) {
-		RGBAPixel& pixel = block.data[i];
 		const RGBAPixel& uv_pixel = uv_mask.data[i];
 
 		// TODO
@@ -431,10 +439,18 @@ void blockImageShadowEdges(RGBAImage& block, const RGBAImage& uv_mask,
 
 		#undef setalpha
 
-		pixel = rgba_multiply_scalar(pixel, 255 - alpha);
+		factors[i] = 255 - alpha;
 	}
 }
 
+void blockImageShade(RGBAImage& block, const std::vector<uint8_t>& factors) {
+	assert(factors.size() == block.data.size());
+
+	size_t n = block.data.size();
+	for (size_t i = 0; i < n; i++)
+		block.data[i] = rgba_multiply_scalar(block.data[i], factors[i]);
+}
+
 bool blockImageIsTransparent(const RGBAImage& block, const RGBAImage& uv_mask) {
 	assert(block.getWidth() == uv_mask.getWidth());
 	assert(block.getHeight() == uv_mask.getHeight());
@@ -494,7 +510,8 @@ void RenderedBlockImages::setBlockSideDarkening(float darken_left, float darken_
 	this->darken_right = darken_right;
 }
 
-bool RenderedBlockImages::loadBlockImages(fs::path path, std::string view, int rotation, int texture_size) {
+bool RenderedBlockImages::loadBlockImages(fs::path path, std::string view, int rotation,
+		int texture_size, int downscale) {
 	LOG(INFO) << "I will load block images from " << path << " now";
 
 	if (!fs::is_directory(path)) {
@@ -502,9 +519,19 @@ bool RenderedBlockImages::loadBlockImages(fs::path path, std::string view, int r
 		return false;
 	}
 
-	std::string name = view + "_" + util::str(rotation) + "_" + util::str(texture_size);
+	this->texture_size = texture_size / downscale;
+	std::string prefix = view + "_" + util::str(rotation) + "_";
+	// use the block files of the smaller texture size if they exist,
+	// otherwise scale the images of the given texture size down
+	std::string name = prefix + util::str(this->texture_size);
+	if (downscale > 1 && fs::is_regular_file(path / (name + ".txt"))
+			&& fs::is_regular_file(path / (name + ".png"))) {
+		downscale = 1;
+	} else {
+		name = prefix + util::str(texture_size);
+	}
 
-	BlockAtlas::instance().OpenDictionnary(path,name);
+	block_atlas.OpenDictionnary(path,name);
 
 	fs::path info_file = path / (name + ".txt");
 
@@ -514,9 +541,10 @@ bool RenderedBlockImages::loadBlockImages(fs::path path, std::string view, int r
 		return false;
 	}
 
-	block_width = BlockAtlas::instance().GetBlockWidth();
-	block_height = BlockAtlas::instance().GetBlockHeight();;
-	block_images.reserve(BlockAtlas::instance().GetCount() * 2);
+	block_images.reserve(block_atlas.GetCount() * 2);
+
+	// indexes of the uv images, they must not be interpolated when scaling down
+	std::unordered_set<uint32_t> uv_indexes;
 
 	std::ifstream in(info_file.string());
 	// Skip the first line
@@ -554,6 +582,7 @@ bool RenderedBlockImages::loadBlockImages(fs::path path, std::string view, int r
 		for (std::size_t cnt=0; cnt<variantCnt; cnt++) {
 			image_index[cnt] = util::as<int>(colors[cnt]);
 			image_uv_index[cnt] = util::as<int>(uvs[cnt]);
+			uv_indexes.insert(image_uv_index[cnt]);
 			int weight = util::as<int>(weights[cnt]);
 			image_weight[cnt] = weight;
 			total_weight += weight;
@@ -562,6 +591,7 @@ bool RenderedBlockImages::loadBlockImages(fs::path path, std::string view, int r
 
 		mc::BlockState block_state = mc::BlockState::parse(block_name, variant);
 		BlockImage& block = *new BlockImage();;
+		block.atlas = &block_atlas;
 		block.image(image_index);
 		block.uv_image(image_uv_index);
 		block.weight_image(image_weight, weight_factor);
@@ -625,6 +655,10 @@ bool RenderedBlockImages::loadBlockImages(fs::path path, std::string view, int r
 	}
 	in.close();
 
+	block_atlas.ScaleDown(downscale, uv_indexes);
+	block_width = block_atlas.GetBlockWidth();
+	block_height = block_atlas.GetBlockHeight();
+
 	prepareBlockImages();
 	//runBenchmark();
 
@@ -687,6 +721,14 @@ void RenderedBlockImages::prepareBiomeBlockImage(RGBAImage& image, const BlockIm
 	}
 }
 
+BlockImageVariantCache& RenderedBlockImages::getVariantCache() {
+	return variant_cache;
+}
+
+TintedBlockImageCache& RenderedBlockImages::getTintCache() {
+	return tint_cache;
+}
+
 int RenderedBlockImages::getTextureSize() const {
 	return texture_size;
 }
@@ -714,7 +756,7 @@ void RenderedBlockImages::prepareBlockImages() {
 	const uint16_t air_image_id = air.images_idx[0];
 
 	std::unordered_set<uint16_t> shaded_blocks;
-	shaded_blocks.reserve(BlockAtlas::instance().GetCount());
+	shaded_blocks.reserve(block_atlas.GetCount());
 
 	// Go through all images to clarify few flags, and
 	// prepare compute the shading per direction
@@ -743,7 +785,7 @@ void RenderedBlockImages::prepareBlockImages() {
 			for (int16_t i = block.images_idx.size()-1; i >= 0 ; --i) {
 				uint32_t bid = block.images_idx[i];
 				uint32_t uv_bid = block.uv_images_idx[i];
-				BlockAtlas::instance().ShadeBlock(bid, uv_bid, darken_left, darken_right, 1.0);
+				block_atlas.ShadeBlock(bid, uv_bid, darken_left, darken_right, 1.0);
 			}
 		}
 
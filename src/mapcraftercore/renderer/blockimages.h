@@ -21,6 +21,7 @@
 #define BLOCKIMAGES_H_
 
 #include "blockatlas.h"
+#include "blockimagevariants.h"
 #include "image.h"
 #include "../mc/pos.h"
 
@@ -91,6 +92,12 @@ void blockImageBlendZBuffered(RGBAImage& block, const RGBAImage& uv_mask,
 		const RGBAImage& top, const RGBAImage& top_uv_mask);
 void blockImageShadowEdges(RGBAImage& block, const RGBAImage& uv_mask,
 		uint8_t north, uint8_t south, uint8_t east, uint8_t west, uint8_t bottomleft, uint8_t bottomright);
+// computes the factors blockImageShadowEdges multiplies the pixels with
+void blockImageShadowEdgeFactors(const RGBAImage& uv_mask, uint8_t north, uint8_t south,
+		uint8_t east, uint8_t west, uint8_t bottomleft, uint8_t bottomright,
+		std::vector<uint8_t>& factors);
+// multiplies every pixel with a factor (0 - 255)
+void blockImageShade(RGBAImage& block, const std::vector<uint8_t>& factors);
 bool blockImageIsTransparent(const RGBAImage& block, const RGBAImage& uv_mask);
 std::array<bool, 3> blockImageGetSideMask(const RGBAImage& uv);
 
@@ -106,7 +113,7 @@ struct BlockImage {
 	// TODO
 	// this needs some order and refactoring
 	BlockImage()
-		: lighting_specified(false) {}
+		: lighting_specified(false), atlas(nullptr) {}
 
 	std::array<bool, 3> side_mask;
 	bool is_transparent;
@@ -145,14 +152,14 @@ struct BlockImage {
 
 	const RGBAImage& image(int32_t idx) const {
 		assert(idx<(int32_t)images_idx.size());
-		return *(BlockAtlas::instance().GetImage(images_idx[idx]));
+		return *(atlas->GetImage(images_idx[idx]));
 	}
 	void image(std::vector<uint32_t>& indexes) {
 		images_idx = indexes;
 	}
 	const RGBAImage& uv_image(int32_t idx) const {
 		assert(idx<(int32_t)images_idx.size());
-		return *(BlockAtlas::instance().GetImage(uv_images_idx[idx]));
+		return *(atlas->GetImage(uv_images_idx[idx]));
 	}
 	void uv_image(std::vector<uint32_t>& indexes) {
 		uv_images_idx = indexes;
@@ -169,6 +176,8 @@ struct BlockImage {
 	std::vector<uint32_t> images_idx;
 	std::vector<uint32_t> uv_images_idx;
 	std::vector<double_t> images_weights;
+	// the atlas the image indexes refer to
+	const BlockAtlas* atlas;
 };
 
 class RenderedBlockImages : public BlockImages {
@@ -190,12 +199,30 @@ public:
 
 	void setBlockSideDarkening(float darken_left, float darken_right);
 
-	bool loadBlockImages(fs::path block_dir, std::string view, int rotation, int texture_size);
+	/**
+	 * Loads the block images of a view/rotation/texture size from the block directory.
+	 * With a downscale factor (a power of two) the block images of the texture size
+	 * texture_size / downscale are used, they are scaled down from the given texture
+	 * size if there are no block files for the smaller size.
+	 */
+	bool loadBlockImages(fs::path block_dir, std::string view, int rotation, int texture_size,
+			int downscale = 1);
 	virtual RGBAImage exportBlocks() const;
 
 	const BlockImage& getBlockImage(uint16_t id) const;
 	void prepareBiomeBlockImage(RGBAImage& image, const BlockImage& block, uint32_t color);
 
+	/**
+	 * Returns the cache of prepared block image variants (with stripped faces and
+	 * shadow edges) shared by the tile renderers.
+	 */
+	BlockImageVariantCache& getVariantCache();
+
+	/**
+	 * Returns the cache of biome tinted block images shared by the tile renderers.
+	 */
+	TintedBlockImageCache& getTintCache();
+
 	virtual int getTextureSize() const;
 	virtual int getBlockSize() const;
 	virtual int getBlockWidth() const;
@@ -211,9 +238,14 @@ private:
 
 	int texture_size;
 	int block_width, block_height;
+	// the images of the block file, referenced by the block images
+	BlockAtlas block_atlas;
 	// Mapcrafter-local block ID -> BlockImage (image, uv_image, is_transparent, ...)
 	std::vector<BlockImage*> block_images;
 	BlockImage unknown_block;
+
+	BlockImageVariantCache variant_cache;
+	TintedBlockImageCache tint_cache;
 };
 
 }
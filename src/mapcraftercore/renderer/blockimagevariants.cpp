@@ -0,0 +1,196 @@
+/*
+ * Copyright 2012-2016 Moritz Hilscher
+ *
+ * This file is part of Mapcrafter.
+ *
+ * Mapcrafter is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mapcrafter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mapcrafter.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "blockimagevariants.h"
+
+#include "../util/profiling.h"
+
+#include <algorithm>
+
+namespace mapcrafter {
+namespace renderer {
+
+BlockImageVariantKey::BlockImageVariantKey()
+	: id(0), variant(0), strip(0), shadow_edges{0, 0, 0, 0, 0, 0} {
+}
+
+bool BlockImageVariantKey::operator==(const BlockImageVariantKey& other) const {
+	return id == other.id && variant == other.variant && strip == other.strip
+			&& std::equal(shadow_edges, shadow_edges + 6, other.shadow_edges);
+}
+
+size_t BlockImageVariantKeyHash::operator()(const BlockImageVariantKey& key) const {
+	uint64_t shadow = 0;
+	for (int i = 0; i < 6; i++)
+		shadow = (shadow << 8) | key.shadow_edges[i];
+	uint64_t h = ((uint64_t) key.id << 32) | ((uint64_t) key.variant << 16) | key.strip;
+	h ^= shadow * 0x9e3779b97f4a7c15ULL;
+	h ^= h >> 31;
+	h *= 0xbf58476d1ce4e5b9ULL;
+	h ^= h >> 29;
+	return h;
+}
+
+BlockImageVariantCache::BlockImageVariantCache(size_t max_size)
+	: max_shard_size(std::max((size_t) 1, max_size / SHARDS)) {
+}
+
+BlockImageVariantCache::~BlockImageVariantCache() {
+}
+
+BlockImageVariantCache::VariantPtr BlockImageVariantCache::find(
+		const BlockImageVariantKey& key) {
+	Shard& shard = getShard(key);
+	thread_ns::unique_lock<thread_ns::mutex> lock(shard.mutex);
+	auto it = shard.variants.find(key);
+	if (it != shard.variants.end())
+		return it->second;
+	return VariantPtr();
+}
+
+BlockImageVariantCache::VariantPtr BlockImageVariantCache::insert(
+		const BlockImageVariantKey& key, VariantPtr variant) {
+	// another thread might have created the same variant in the meantime,
+	// but that doesn't matter, it's just replaced
+	Shard& shard = getShard(key);
+	thread_ns::unique_lock<thread_ns::mutex> lock(shard.mutex);
+	if (shard.variants.size() >= max_shard_size)
+		shard.variants.clear();
+	shard.variants[key] = variant;
+	return variant;
+}
+
+void BlockImageVariantCache::clear() {
+	for (int i = 0; i < SHARDS; i++) {
+		thread_ns::unique_lock<thread_ns::mutex> lock(shards[i].mutex);
+		shards[i].variants.clear();
+	}
+}
+
+BlockImageVariantCache::Shard& BlockImageVariantCache::getShard(const BlockImageVariantKey& key) {
+	return shards[(BlockImageVariantKeyHash()(key) >> 59) & (SHARDS - 1)];
+}
+
+TintedBlockImageKey::TintedBlockImageKey()
+	: color(0) {
+}
+
+bool TintedBlockImageKey::operator==(const TintedBlockImageKey& other) const {
+	return color == other.color && variant == other.variant;
+}
+
+size_t TintedBlockImageKeyHash::operator()(const TintedBlockImageKey& key) const {
+	uint64_t h = BlockImageVariantKeyHash()(key.variant) ^ (key.color * 0x9e3779b97f4a7c15ULL);
+	h ^= h >> 32;
+	h *= 0xd6e8feb86659fd93ULL;
+	h ^= h >> 32;
+	return h;
+}
+
+TintedBlockImageCache::Shard::Shard()
+	: hand(0) {
+}
+
+TintedBlockImageCache::TintedBlockImageCache(size_t max_size)
+	: max_shard_size(std::max((size_t) 1, max_size / SHARDS)), hits(0), misses(0) {
+	for (int i = 0; i < SHARDS; i++) {
+		shards[i].images.reserve(max_shard_size);
+		shards[i].index.reserve(max_shard_size);
+	}
+}
+
+TintedBlockImageCache::~TintedBlockImageCache() {
+}
+
+TintedBlockImageCache::ImagePtr TintedBlockImageCache::find(const TintedBlockImageKey& key) {
+	Shard& shard = getShard(key);
+	thread_ns::unique_lock<thread_ns::mutex> lock(shard.mutex);
+	auto it = shard.index.find(key);
+	if (it == shard.index.end()) {
+		lock.unlock();
+		misses++;
+		util::profileCount(util::ProfileCounter::TINT_CACHE_MISSES);
+		return ImagePtr();
+	}
+
+	Entry& entry = shard.images[it->second];
+	entry.referenced = true;
+	ImagePtr image = entry.image;
+	lock.unlock();
+	hits++;
+	util::profileCount(util::ProfileCounter::TINT_CACHE_HITS);
+	return image;
+}
+
+TintedBlockImageCache::ImagePtr TintedBlockImageCache::insert(const TintedBlockImageKey& key,
+		ImagePtr image) {
+	Shard& shard = getShard(key);
+	thread_ns::unique_lock<thread_ns::mutex> lock(shard.mutex);
+	auto it = shard.index.find(key);
+	if (it != shard.index.end()) {
+		// another thread was faster
+		Entry& entry = shard.images[it->second];
+		entry.image = image;
+		entry.referenced = true;
+		return image;
+	}
+
+	Entry entry = {key, image, false};
+	if (shard.images.size() < max_shard_size) {
+		shard.index[key] = shard.images.size();
+		shard.images.push_back(entry);
+		return image;
+	}
+
+	// the shard is full: advance the clock hand to the next image that wasn't found
+	// since the last round and replace it, referenced ones get a second chance
+	while (shard.images[shard.hand].referenced) {
+		shard.images[shard.hand].referenced = false;
+		shard.hand = (shard.hand + 1) % shard.images.size();
+	}
+	shard.index.erase(shard.images[shard.hand].key);
+	shard.images[shard.hand] = entry;
+	shard.index[key] = shard.hand;
+	shard.hand = (shard.hand + 1) % shard.images.size();
+	return image;
+}
+
+void TintedBlockImageCache::clear() {
+	for (int i = 0; i < SHARDS; i++) {
+		thread_ns::unique_lock<thread_ns::mutex> lock(shards[i].mutex);
+		shards[i].images.clear();
+		shards[i].index.clear();
+		shards[i].hand = 0;
+	}
+}
+
+uint64_t TintedBlockImageCache::getHits() const {
+	return hits;
+}
+
+uint64_t TintedBlockImageCache::getMisses() const {
+	return misses;
+}
+
+TintedBlockImageCache::Shard& TintedBlockImageCache::getShard(const TintedBlockImageKey& key) {
+	return shards[(TintedBlockImageKeyHash()(key) >> 59) & (SHARDS - 1)];
+}
+
+}
+}
@@ -0,0 +1,205 @@
+/*
+ * Copyright 2012-2016 Moritz Hilscher
+ *
+ * This file is part of Mapcrafter.
+ *
+ * Mapcrafter is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mapcrafter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mapcrafter.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BLOCKIMAGEVARIANTS_H_
+#define BLOCKIMAGEVARIANTS_H_
+
+#include "image.h"
+#include "../compat/thread.h"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace mapcrafter {
+namespace renderer {
+
+// faces of a block image that can be stripped away
+const int STRIP_UP = 1;
+const int STRIP_LEFT = 2;
+const int STRIP_RIGHT = 4;
+
+/**
+ * Describes a prepared variant of a block image: The block (ID and image variant) with
+ * the faces stripped away (because the neighbor blocks are the same) and the shadow
+ * edges applied.
+ */
+struct BlockImageVariantKey {
+	BlockImageVariantKey();
+
+	bool operator==(const BlockImageVariantKey& other) const;
+
+	uint16_t id;
+	uint16_t variant;
+	// stripped faces (STRIP_* bits)
+	uint8_t strip;
+	// strength of the shadow edges
+	// (north, south, east, west, bottom left, bottom right)
+	uint8_t shadow_edges[6];
+};
+
+struct BlockImageVariantKeyHash {
+	size_t operator()(const BlockImageVariantKey& key) const;
+};
+
+/**
+ * A prepared block image variant.
+ */
+struct BlockImageVariant {
+	// the block image with stripped faces and (unless shade is set) shadow edges
+	RGBAImage image;
+	// for biome blocks the shadow edges have to be applied after tinting the block,
+	// this are the factors (255 - shadow alpha) of every pixel then, empty otherwise
+	std::vector<uint8_t> shade;
+};
+
+/**
+ * A bounded cache of prepared block image variants, which is shared by the tile
+ * renderers of all render threads.
+ *
+ * The cache is split into shards with an own lock, a full shard is just cleared.
+ * The variants are returned as shared pointers, so they stay valid for the tile
+ * renderer using them even if they are removed from the cache in the meantime.
+ */
+class BlockImageVariantCache {
+public:
+	typedef std::shared_ptr<const BlockImageVariant> VariantPtr;
+
+	BlockImageVariantCache(size_t max_size = 8192);
+	~BlockImageVariantCache();
+
+	/**
+	 * Returns a cached variant, or an empty pointer if it's not cached.
+	 */
+	VariantPtr find(const BlockImageVariantKey& key);
+
+	/**
+	 * Puts a variant into the cache and returns it.
+	 */
+	VariantPtr insert(const BlockImageVariantKey& key, VariantPtr variant);
+
+	/**
+	 * Removes all variants.
+	 */
+	void clear();
+
+private:
+	static const int SHARDS = 16;
+
+	struct Shard {
+		thread_ns::mutex mutex;
+		std::unordered_map<BlockImageVariantKey, VariantPtr, BlockImageVariantKeyHash> variants;
+	};
+
+	Shard& getShard(const BlockImageVariantKey& key);
+
+	size_t max_shard_size;
+	Shard shards[SHARDS];
+};
+
+/**
+ * Describes a biome tinted block image: The prepared block image variant tinted with
+ * a biome color.
+ */
+struct TintedBlockImageKey {
+	TintedBlockImageKey();
+
+	bool operator==(const TintedBlockImageKey& other) const;
+
+	BlockImageVariantKey variant;
+	uint32_t color;
+};
+
+struct TintedBlockImageKeyHash {
+	size_t operator()(const TintedBlockImageKey& key) const;
+};
+
+/**
+ * A bounded cache of biome tinted block images (with stripped faces and shadow edges
+ * like the block image variants), shared by the tile renderers of all render threads.
+ *
+ * The biome colors of neighboring blocks are mostly the same, so most biome blocks
+ * (grass, leaves, water, ...) don't need to be tinted again. The cache is split into
+ * shards with an own lock. A full shard evicts images with the clock (second chance)
+ * algorithm: A hit just marks the image as referenced and doesn't reorder anything,
+ * so the lock is held only for the lookup.
+ */
+class TintedBlockImageCache {
+public:
+	typedef std::shared_ptr<const RGBAImage> ImagePtr;
+
+	TintedBlockImageCache(size_t max_size = 8192);
+	~TintedBlockImageCache();
+
+	/**
+	 * Returns a cached tinted image, or an empty pointer if it's not cached.
+	 */
+	ImagePtr find(const TintedBlockImageKey& key);
+
+	/**
+	 * Puts a tinted image into the cache and returns it.
+	 */
+	ImagePtr insert(const TintedBlockImageKey& key, ImagePtr image);
+
+	/**
+	 * Removes all images.
+	 */
+	void clear();
+
+	/**
+	 * Returns how often find found an image / didn't find an image.
+	 */
+	uint64_t getHits() const;
+	uint64_t getMisses() const;
+
+private:
+	static const int SHARDS = 16;
+
+	struct Entry {
+		TintedBlockImageKey key;
+		ImagePtr image;
+		// whether the image was found since the clock hand passed it the last time
+		bool referenced;
+	};
+
+	struct Shard {
+		Shard();
+
+		thread_ns::mutex mutex;
+		// the images in a ring, the clock hand points to the next eviction candidate
+		std::vector<Entry> images;
+		size_t hand;
+		std::unordered_map<TintedBlockImageKey, size_t, TintedBlockImageKeyHash> index;
+	};
+
+	Shard& getShard(const TintedBlockImageKey& key);
+
+	size_t max_shard_size;
+	Shard shards[SHARDS];
+
+	std::atomic<uint64_t> hits, misses;
+};
+
+}
+}
+
+#endif /* BLOCKIMAGEVARIANTS_H_ */
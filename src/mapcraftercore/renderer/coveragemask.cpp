@@ -0,0 +1,89 @@
+/*
+ * Copyright 2012-2016 Moritz Hilscher
+ *
+ * This file is part of Mapcrafter.
+ *
+ * Mapcrafter is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mapcrafter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mapcrafter.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "coveragemask.h"
+
+#include <algorithm>
+
+namespace mapcrafter {
+namespace renderer {
+
+CoverageMask::CoverageMask(int width, int height) {
+	reset(width, height);
+}
+
+CoverageMask::~CoverageMask() {
+}
+
+void CoverageMask::reset(int width, int height) {
+	this->width = width;
+	this->height = height;
+	covered.assign(width * height, 0);
+	empty = true;
+}
+
+void CoverageMask::clear() {
+	if (!empty)
+		std::fill(covered.begin(), covered.end(), 0);
+	empty = true;
+}
+
+bool CoverageMask::isCovered(const RGBAImage& image, int x, int y) const {
+	if (empty)
+		return false;
+	int sx_start = std::max(0, -x), sx_end = std::min(image.width, width - x);
+	int sy_start = std::max(0, -y), sy_end = std::min(image.height, height - y);
+	for (int sy = sy_start; sy < sy_end; sy++) {
+		const RGBAPixel* source = &image.data[sy * image.width];
+		const uint8_t* mask = &covered[(sy + y) * width];
+		for (int sx = sx_start; sx < sx_end; sx++)
+			// pixels that are completely transparent are not drawn anyway (see blend)
+			if (source[sx] > 0xffffff && !mask[sx + x])
+				return false;
+	}
+	return true;
+}
+
+bool CoverageMask::cover(const RGBAImage& image, int x, int y) {
+	bool visible = false;
+	int sx_start = std::max(0, -x), sx_end = std::min(image.width, width - x);
+	int sy_start = std::max(0, -y), sy_end = std::min(image.height, height - y);
+	for (int sy = sy_start; sy < sy_end; sy++) {
+		const RGBAPixel* source = &image.data[sy * image.width];
+		uint8_t* mask = &covered[(sy + y) * width];
+		for (int sx = sx_start; sx < sx_end; sx++) {
+			RGBAPixel pixel = source[sx];
+			if (pixel <= 0xffffff || mask[sx + x])
+				continue;
+			visible = true;
+			if (pixel >= 0xff000000) {
+				mask[sx + x] = 1;
+				empty = false;
+			}
+		}
+	}
+	return visible;
+}
+
+bool CoverageMask::isEmpty() const {
+	return empty;
+}
+
+}
+}
@@ -0,0 +1,79 @@
+/*
+ * Copyright 2012-2016 Moritz Hilscher
+ *
+ * This file is part of Mapcrafter.
+ *
+ * Mapcrafter is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mapcrafter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mapcrafter.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef COVERAGEMASK_H_
+#define COVERAGEMASK_H_
+
+#include "image.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace mapcrafter {
+namespace renderer {
+
+/**
+ * Remembers which pixels of an image are already covered by opaque pixels.
+ *
+ * Images are composited front-to-back with it: Everything behind a covered pixel is
+ * overwritten by the opaque pixel in front of it when the images are blitted
+ * back-to-front later, so images whose visible pixels are all covered can be skipped.
+ */
+class CoverageMask {
+public:
+	CoverageMask(int width = 0, int height = 0);
+	~CoverageMask();
+
+	/**
+	 * Resizes the mask and marks all pixels as not covered.
+	 */
+	void reset(int width, int height);
+
+	/**
+	 * Marks all pixels as not covered.
+	 */
+	void clear();
+
+	/**
+	 * Returns whether all (not completely transparent) pixels of an image drawn at
+	 * x, y are covered.
+	 */
+	bool isCovered(const RGBAImage& image, int x = 0, int y = 0) const;
+
+	/**
+	 * Marks the opaque pixels of an image drawn at x, y as covered. Returns whether
+	 * the image is visible, i.e. whether any of its pixels wasn't covered before.
+	 */
+	bool cover(const RGBAImage& image, int x = 0, int y = 0);
+
+	/**
+	 * Returns whether no pixel is covered.
+	 */
+	bool isEmpty() const;
+
+private:
+	int width, height;
+	std::vector<uint8_t> covered;
+	bool empty;
+};
+
+}
+}
+
+#endif /* COVERAGEMASK_H_ */
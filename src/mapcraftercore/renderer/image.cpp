@@ -24,11 +24,17 @@
 #include "image.h"
 
 #include "image/dithering.h"
+#include "image/palette.h"
 #include "image/quantization.h"
 #include "image/scaling.h"
+#include "../config.h"
 #include "../util.h"
 
 #include <jpeglib.h>
+#ifdef HAVE_WEBP
+#include <webp/decode.h>
+#include <webp/encode.h>
+#endif
 #include <algorithm>
 #include <iostream>
 #include <fstream>
@@ -251,6 +257,13 @@ void RGBAImage::clear() {
 	std::fill(data.begin(), data.end(), 0);
 }
 
+bool RGBAImage::isTransparent() const {
+	for (size_t i = 0; i < data.size(); i++)
+		if (rgba_alpha(data[i]) != 0)
+			return false;
+	return true;
+}
+
 RGBAImage RGBAImage::clip(int x, int y, int width, int height) const {
 	RGBAImage image(width, height);
 	for (int xx = 0; xx < width && xx + x < this->width; xx++) {
@@ -433,10 +446,12 @@ bool RGBAImage::readPNG(const std::string& filename) {
 	if (!file) {
 		return false;
 	}
+	return readPNG(file);
+}
 
+bool RGBAImage::readPNG(std::istream& file) {
 	uint8_t png_signature[8];
-	file.read((char*) &png_signature, 8);
-	if (png_sig_cmp(png_signature, 0, 8) != 0)
+	if (!file.read((char*) &png_signature, 8) || png_sig_cmp(png_signature, 0, 8) != 0)
 		return false;
 
 	png_structp png = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
@@ -504,47 +519,33 @@ bool RGBAImage::readPNG(const std::string& filename) {
 	return true;
 }
 
-bool RGBAImage::writePNG(const std::string& filename) const {
+bool RGBAImage::writePNG(const std::string& filename,
+		const PNGEncodingOptions& options) const {
 	std::ofstream file(filename.c_str(), std::ios::binary);
 	if (!file) {
 		return false;
 	}
+	return writePNG(file, options);
+}
 
-	png_structp png = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
-	if (png == NULL)
-		return false;
-
-	png_infop info = png_create_info_struct(png);
-	if (info == NULL) {
-		png_destroy_write_struct(&png, NULL);
-		return false;
-	}
-
-	if (setjmp(png_jmpbuf(png))) {
-		png_destroy_write_struct(&png, &info);
-		return false;
-	}
-
-	png_set_write_fn(png, (png_voidp) &file, pngWriteData, NULL);
-	png_set_IHDR(png, info, width, height, 8, PNG_COLOR_TYPE_RGB_ALPHA,
-	        PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+namespace {
 
-	png_bytep* rows = (png_bytep*) png_malloc(png, height * sizeof(png_bytep));
-	const uint32_t* p = &data[0];
-	for (int32_t i = 0; i < height; i++, p += width)
-		rows[i] = (png_bytep) p;
+/**
+ * The PNG encoder of the thread, it keeps its zlib stream and buffers for all images.
+ */
+thread_local PNGEncoder png_encoder;
 
-	png_set_rows(png, info, rows);
+}
 
-	if (mapcrafter::util::isBigEndian())
-		png_write_png(png, info, PNG_TRANSFORM_BGR | PNG_TRANSFORM_SWAP_ALPHA, NULL);
-	else
-		png_write_png(png, info, PNG_TRANSFORM_IDENTITY, NULL);
+bool RGBAImage::writePNG(std::ostream& file, const PNGEncodingOptions& options) const {
+	PNGEncoder& encoder = png_encoder;
+	if (!encoder.encode(*this, options))
+		return false;
 
-	file.close();
-	png_free(png, rows);
-	png_destroy_write_struct(&png, &info);
-	return true;
+	const std::vector<uint8_t>& png = encoder.getData();
+	file.write((const char*) &png[0], png.size());
+	file.flush();
+	return !file.bad();
 }
 
 namespace {
@@ -570,14 +571,36 @@ void setRowPixel(png_byte* line, int bit_depth, int x, uint8_t index) {
 	}
 }
 
+/**
+ * Buffers of the indexed PNG encoding. They are kept per thread and reused for every
+ * image, so encoding a tile doesn't need to allocate memory for the quantization
+ * octree, the nearest color cache or the PNG rows again.
+ */
+struct IndexedPNGBuffers {
+	OctreeQuantizer quantizer;
+	CachedPalette palette;
+	std::vector<RGBAPixel> colors;
+	// palette indices of the pixels, used directly as rows for 8 bit palettes
+	std::vector<uint8_t> data;
+	std::vector<png_byte> packed_rows;
+	std::vector<png_bytep> rows;
+};
+
+thread_local IndexedPNGBuffers indexed_png_buffers;
+
 }
 
-bool RGBAImage::writeIndexedPNG(const std::string& filename, int palette_bits, bool dithered) const {
+bool RGBAImage::writeIndexedPNG(const std::string& filename, int palette_bits, bool dithered,
+		const PNGEncodingOptions& options) const {
 	std::ofstream file(filename.c_str(), std::ios::binary);
 	if (!file) {
 		return false;
 	}
+	return writeIndexedPNG(file, palette_bits, dithered, options);
+}
 
+bool RGBAImage::writeIndexedPNG(std::ostream& file, int palette_bits, bool dithered,
+		const PNGEncodingOptions& options) const {
 	png_structp png = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
 	if (png == NULL)
 		return false;
@@ -593,31 +616,22 @@ bool RGBAImage::writeIndexedPNG(const std::string& filename, int palette_bits, b
 		return false;
 	}
 
+	IndexedPNGBuffers& buffers = indexed_png_buffers;
 	int palette_size = 1 << palette_bits;
 	png_set_write_fn(png, (png_voidp) &file, pngWriteData, NULL);
+	// level 3 is the highest level that uses the fast deflate algorithm of zlib
+	png_set_compression_level(png, options.fast_deflate
+			? std::min(options.compression_level, 3) : options.compression_level);
 	png_set_IHDR(png, info, width, height, palette_bits, PNG_COLOR_TYPE_PALETTE,
 			PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
 
-	//std::cout << "Doing quantization." << std::endl;
-	Octree* octree;
-	std::vector<RGBAPixel> colors;
-	octreeColorQuantize(*this, palette_size, colors, &octree);
+	std::vector<RGBAPixel>& colors = buffers.colors;
+	colors.clear();
+	buffers.quantizer.quantize(*this, palette_size, colors);
 	palette_size = colors.size();
-	//std::cout << "Finished quantization. " << palette_size << " colors." << std::endl;
-
-	png_color* palette = (png_color*) png_malloc(png, palette_size * sizeof(png_color));
-	if (palette == NULL) {
-		png_destroy_write_struct(&png, &info);
-		return false;
-	}
-
-	png_byte* palette_alpha = (png_byte*) png_malloc(png, palette_size * sizeof(png_byte));
-	if (palette == NULL) {
-		png_free(png, palette);
-		png_destroy_write_struct(&png, &info);
-		return false;
-	}
 
+	png_color palette[256];
+	png_byte palette_alpha[256];
 	for (int i = 0; i < palette_size; i++) {
 		palette[i].red = rgba_red(colors[i]);
 		palette[i].green = rgba_green(colors[i]);
@@ -628,45 +642,43 @@ bool RGBAImage::writeIndexedPNG(const std::string& filename, int palette_bits, b
 	png_set_PLTE(png, info, palette, palette_size);
 	png_set_tRNS(png, info, palette_alpha, palette_size, NULL);
 
-	OctreePalette p(colors);
-	//OctreePalette2 p(colors);
+	OctreePalette octree_palette(colors);
+	buffers.palette.setPalette(&octree_palette);
 
-	std::vector<int> data_dithered;
+	std::vector<uint8_t>& image_data = buffers.data;
 	if (dithered) {
-		RGBAImage copy = *this;
-		imageDither(copy, p, data_dithered);
+		imageDither(*this, buffers.palette, image_data);
+	} else {
+		image_data.resize(width * height);
+		for (size_t i = 0; i < data.size(); i++)
+			image_data[i] = buffers.palette.getNearestColor(data[i]);
 	}
 
-	png_bytep* rows = (png_bytep*) png_malloc(png, height * sizeof(png_bytep));
-	for (int y = 0; y < height; y++) {
-		rows[y] = (png_byte*) png_malloc(png, width * sizeof(png_byte));
-		for (int x = 0; x < width; x++)
-			rows[y][x] = 0;
-		for (int x = 0; x < width; x++) {
-			if (dithered) {
-				setRowPixel(rows[y], palette_bits, x, data_dithered[y * width + x]);
-			} else {
-				setRowPixel(rows[y], palette_bits, x, p.getNearestColor(pixel(x, y)));
-			}
+	buffers.rows.resize(height);
+	if (palette_bits == 8) {
+		for (int y = 0; y < height; y++)
+			buffers.rows[y] = &image_data[y * width];
+	} else {
+		size_t row_bytes = (width * palette_bits + 7) / 8;
+		buffers.packed_rows.assign(row_bytes * height, 0);
+		for (int y = 0; y < height; y++) {
+			png_byte* row = &buffers.packed_rows[y * row_bytes];
+			for (int x = 0; x < width; x++)
+				setRowPixel(row, palette_bits, x, image_data[y * width + x]);
+			buffers.rows[y] = row;
 		}
 	}
 
-	png_set_rows(png, info, rows);
+	png_set_rows(png, info, &buffers.rows[0]);
 
 	//if (mapcrafter::util::isBigEndian())
 	//	png_write_png(png, info, PNG_TRANSFORM_BGR | PNG_TRANSFORM_SWAP_ALPHA, NULL);
 	//else
 		png_write_png(png, info, PNG_TRANSFORM_IDENTITY, NULL);
 
-	file.close();
-	for (int y = 0; y < height; y++)
-		png_free(png, rows[y]);
-	png_free(png, rows);
-	png_free(png, palette);
-	png_free(png, palette_alpha);
-	delete octree;
+	file.flush();
 	png_destroy_write_struct(&png, &info);
-	return true;
+	return !file.bad();
 }
 
 /*
@@ -718,7 +730,109 @@ my_error_exit (j_common_ptr cinfo)
   longjmp(myerr->setjmp_buffer, 1);
 }
 
+namespace {
+
+/**
+ * Source and destination managers to read/write the JPEG data from/to C++ streams.
+ */
+struct StreamSourceManager {
+	struct jpeg_source_mgr pub;
+	std::istream* in;
+	JOCTET buffer[4096];
+};
+
+METHODDEF(void) streamInitSource(j_decompress_ptr) {
+}
+
+METHODDEF(boolean) streamFillInputBuffer(j_decompress_ptr cinfo) {
+	StreamSourceManager* src = (StreamSourceManager*) cinfo->src;
+	src->in->read((char*) src->buffer, sizeof(src->buffer));
+	size_t bytes = src->in->gcount();
+	if (bytes == 0) {
+		// insert a fake end of image marker if the data is truncated, like libjpeg does
+		src->buffer[0] = (JOCTET) 0xff;
+		src->buffer[1] = (JOCTET) JPEG_EOI;
+		bytes = 2;
+	}
+	src->pub.next_input_byte = src->buffer;
+	src->pub.bytes_in_buffer = bytes;
+	return TRUE;
+}
+
+METHODDEF(void) streamSkipInputData(j_decompress_ptr cinfo, long num_bytes) {
+	StreamSourceManager* src = (StreamSourceManager*) cinfo->src;
+	while (num_bytes > (long) src->pub.bytes_in_buffer) {
+		num_bytes -= src->pub.bytes_in_buffer;
+		streamFillInputBuffer(cinfo);
+	}
+	if (num_bytes > 0) {
+		src->pub.next_input_byte += num_bytes;
+		src->pub.bytes_in_buffer -= num_bytes;
+	}
+}
+
+METHODDEF(void) streamTermSource(j_decompress_ptr) {
+}
+
+void jpegStreamSource(j_decompress_ptr cinfo, StreamSourceManager& src, std::istream& in) {
+	src.pub.init_source = streamInitSource;
+	src.pub.fill_input_buffer = streamFillInputBuffer;
+	src.pub.skip_input_data = streamSkipInputData;
+	src.pub.resync_to_restart = jpeg_resync_to_restart;
+	src.pub.term_source = streamTermSource;
+	src.pub.next_input_byte = NULL;
+	src.pub.bytes_in_buffer = 0;
+	src.in = &in;
+	cinfo->src = &src.pub;
+}
+
+struct StreamDestinationManager {
+	struct jpeg_destination_mgr pub;
+	std::ostream* out;
+	JOCTET buffer[4096];
+};
+
+METHODDEF(void) streamInitDestination(j_compress_ptr cinfo) {
+	StreamDestinationManager* dest = (StreamDestinationManager*) cinfo->dest;
+	dest->pub.next_output_byte = dest->buffer;
+	dest->pub.free_in_buffer = sizeof(dest->buffer);
+}
+
+METHODDEF(boolean) streamEmptyOutputBuffer(j_compress_ptr cinfo) {
+	StreamDestinationManager* dest = (StreamDestinationManager*) cinfo->dest;
+	dest->out->write((const char*) dest->buffer, sizeof(dest->buffer));
+	dest->pub.next_output_byte = dest->buffer;
+	dest->pub.free_in_buffer = sizeof(dest->buffer);
+	return TRUE;
+}
+
+METHODDEF(void) streamTermDestination(j_compress_ptr cinfo) {
+	StreamDestinationManager* dest = (StreamDestinationManager*) cinfo->dest;
+	dest->out->write((const char*) dest->buffer,
+			sizeof(dest->buffer) - dest->pub.free_in_buffer);
+	dest->out->flush();
+}
+
+void jpegStreamDestination(j_compress_ptr cinfo, StreamDestinationManager& dest,
+		std::ostream& out) {
+	dest.pub.init_destination = streamInitDestination;
+	dest.pub.empty_output_buffer = streamEmptyOutputBuffer;
+	dest.pub.term_destination = streamTermDestination;
+	dest.out = &out;
+	cinfo->dest = &dest.pub;
+}
+
+}
+
 bool RGBAImage::readJPEG(const std::string& filename) {
+	std::ifstream file(filename.c_str(), std::ios::binary);
+	if (!file) {
+		return false;
+	}
+	return readJPEG(file);
+}
+
+bool RGBAImage::readJPEG(std::istream& infile) {
 	/* This struct contains the JPEG decompression parameters and pointers to
 	 * working space (which is allocated as needed by the JPEG library).
 	 */
@@ -729,22 +843,10 @@ bool RGBAImage::readJPEG(const std::string& filename) {
 	 */
 	struct my_error_mgr jerr;
 	/* More stuff */
-	FILE * infile;		/* source file */
+	StreamSourceManager src;	/* source stream */
 	JSAMPARRAY buffer;		/* Output row buffer */
 	int row_stride;		/* physical row width in output buffer */
 
-	/* In this example we want to open the input file before doing anything else,
-	 * so that the setjmp() error recovery below can assume the file is open.
-	 * VERY IMPORTANT: use "b" option to fopen() if you are on a machine that
-	 * requires it in order to read binary files.
-	 */
-
-	if ((infile = fopen(filename.c_str(), "rb")) == NULL) {
-		//fprintf(stderr, "can't open %s\n", filename.c_str());
-		//return 0;
-		return false;
-	}
-
 	/* Step 1: allocate and initialize JPEG decompression object */
 
 	/* We set up the normal JPEG error routines, then override error_exit. */
@@ -753,10 +855,9 @@ bool RGBAImage::readJPEG(const std::string& filename) {
 	/* Establish the setjmp return context for my_error_exit to use. */
 	if (setjmp(jerr.setjmp_buffer)) {
 		/* If we get here, the JPEG code has signaled an error.
-		 * We need to clean up the JPEG object, close the input file, and return.
+		 * We need to clean up the JPEG object and return.
 		 */
 		jpeg_destroy_decompress(&cinfo);
-		fclose(infile);
 		return 0;
 	}
 	/* Now we can initialize the JPEG decompression object. */
@@ -764,7 +865,7 @@ bool RGBAImage::readJPEG(const std::string& filename) {
 
 	/* Step 2: specify data source (eg, a file) */
 
-	jpeg_stdio_src(&cinfo, infile);
+	jpegStreamSource(&cinfo, src, infile);
 
 	/* Step 3: read file parameters with jpeg_read_header() */
 
@@ -837,13 +938,6 @@ bool RGBAImage::readJPEG(const std::string& filename) {
 	/* This is an important step since it will release a good deal of memory. */
 	jpeg_destroy_decompress(&cinfo);
 
-	/* After finish_decompress, we can close the input file.
-	 * Here we postpone it until after no more JPEG errors are possible,
-	 * so as to simplify the setjmp error logic above.	(Actually, I don't
-	 * think that jpeg_destroy can do an error exit, but why assume anything...)
-	 */
-	fclose(infile);
-
 	/* At this point you may want to check to see whether any corrupt-data
 	 * warnings occurred (test whether jerr.pub.num_warnings is nonzero).
 	 */
@@ -855,6 +949,15 @@ bool RGBAImage::readJPEG(const std::string& filename) {
 
 bool RGBAImage::writeJPEG(const std::string& filename, int quality,
 		RGBAPixel background) const {
+	std::ofstream file(filename.c_str(), std::ios::binary);
+	if (!file) {
+		return false;
+	}
+	return writeJPEG(file, quality, background);
+}
+
+bool RGBAImage::writeJPEG(std::ostream& outfile, int quality,
+		RGBAPixel background) const {
 
 	/* This struct contains the JPEG compression parameters and pointers to
 	 * working space (which is allocated as needed by the JPEG library).
@@ -873,7 +976,7 @@ bool RGBAImage::writeJPEG(const std::string& filename, int quality,
 	 */
 	struct jpeg_error_mgr jerr;
 	/* More stuff */
-	FILE * outfile;		/* target file */
+	StreamDestinationManager dest;	/* target stream */
 
 	/* Step 1: allocate and initialize JPEG compression object */
 
@@ -889,17 +992,10 @@ bool RGBAImage::writeJPEG(const std::string& filename, int quality,
 	/* Step 2: specify data destination (eg, a file) */
 	/* Note: steps 2 and 3 can be done in either order. */
 
-	/* Here we use the library-supplied code to send compressed data to a
-	 * stdio stream.	You can also write your own code to do something else.
-	 * VERY IMPORTANT: use "b" option to fopen() if you are on a machine that
-	 * requires it in order to write binary files.
+	/* Here we use our own destination manager to send compressed data to a
+	 * C++ stream.
 	 */
-	if ((outfile = fopen(filename.c_str(), "wb")) == NULL) {
-		//fprintf(stderr, "can't open %s\n", filename.c_str());
-		//exit(1);
-		return false;
-	}
-	jpeg_stdio_dest(&cinfo, outfile);
+	jpegStreamDestination(&cinfo, dest, outfile);
 
 	/* Step 3: set parameters for compression */
 
@@ -963,8 +1059,6 @@ bool RGBAImage::writeJPEG(const std::string& filename, int quality,
 	/* Step 6: Finish compression */
 
 	jpeg_finish_compress(&cinfo);
-	/* After finish_compress, we can close the output file. */
-	fclose(outfile);
 
 	/* Step 7: release JPEG compression object */
 
@@ -972,7 +1066,106 @@ bool RGBAImage::writeJPEG(const std::string& filename, int quality,
 	jpeg_destroy_compress(&cinfo);
 
 	/* And we're done! */
+	return !outfile.bad();
+}
+
+#ifdef HAVE_WEBP
+namespace {
+
+uint32_t swapBytes32(uint32_t x) {
+	return (x >> 24) | ((x >> 8) & 0xff00) | ((x << 8) & 0xff0000) | (x << 24);
+}
+
+}
+#endif
+
+bool RGBAImage::readWebP(const std::string& filename) {
+	std::ifstream file(filename.c_str(), std::ios::binary);
+	if (!file) {
+		return false;
+	}
+	return readWebP(file);
+}
+
+bool RGBAImage::readWebP(std::istream& in) {
+#ifdef HAVE_WEBP
+	std::string buffer((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+	const uint8_t* webp_data = (const uint8_t*) buffer.data();
+
+	int webp_width, webp_height;
+	if (!WebPGetInfo(webp_data, buffer.size(), &webp_width, &webp_height))
+		return false;
+	setSize(webp_width, webp_height);
+	if (!WebPDecodeRGBAInto(webp_data, buffer.size(), (uint8_t*) &data[0],
+			data.size() * sizeof(uint32_t), width * 4))
+		return false;
+
+	// the pixels are decoded as RGBA bytes, that is reversed on big endian systems
+	if (mapcrafter::util::isBigEndian())
+		for (size_t i = 0; i < data.size(); i++)
+			data[i] = swapBytes32(data[i]);
 	return true;
+#else
+	(void) in;
+	return false;
+#endif
+}
+
+bool RGBAImage::writeWebP(const std::string& filename, int quality, bool lossless) const {
+	std::ofstream file(filename.c_str(), std::ios::binary);
+	if (!file) {
+		return false;
+	}
+	return writeWebP(file, quality, lossless);
+}
+
+bool RGBAImage::writeWebP(std::ostream& out, int quality, bool lossless) const {
+#ifdef HAVE_WEBP
+	WebPConfig config;
+	if (!WebPConfigInit(&config))
+		return false;
+	config.lossless = lossless;
+	config.quality = quality;
+
+	WebPPicture picture;
+	if (!WebPPictureInit(&picture))
+		return false;
+	picture.width = width;
+	picture.height = height;
+	// the lossless encoder works on ARGB, so save the conversion to YUV
+	picture.use_argb = lossless;
+
+	const uint32_t* pixels = &data[0];
+	std::vector<uint32_t> swapped;
+	if (mapcrafter::util::isBigEndian()) {
+		swapped.resize(data.size());
+		for (size_t i = 0; i < data.size(); i++)
+			swapped[i] = swapBytes32(data[i]);
+		pixels = &swapped[0];
+	}
+	if (!WebPPictureImportRGBA(&picture, (const uint8_t*) pixels, width * 4)) {
+		WebPPictureFree(&picture);
+		return false;
+	}
+
+	WebPMemoryWriter writer;
+	WebPMemoryWriterInit(&writer);
+	picture.writer = WebPMemoryWrite;
+	picture.custom_ptr = &writer;
+
+	bool ok = WebPEncode(&config, &picture);
+	WebPPictureFree(&picture);
+	if (ok)
+		out.write((const char*) writer.mem, writer.size);
+	WebPMemoryWriterClear(&writer);
+	out.flush();
+	return ok && !out.bad();
+#else
+	(void) out;
+	(void) quality;
+	(void) lossless;
+	return false;
+#endif
 }
 
 }
@@ -24,8 +24,11 @@
 #include <cmath>
 #include <math.h> // to be sure M_PI is defined
 
+#include "image/pngencoder.h"
+
 #include <png.h>
 #include <cstdint>
+#include <iosfwd>
 #include <string>
 #include <tuple>
 #include <vector>
@@ -179,6 +182,11 @@ public:
 	void fill(RGBAPixel color, int x1, int y1, int w, int h);
 	void clear();
 
+	/**
+	 * Returns whether all pixels of the image are completely transparent.
+	 */
+	bool isTransparent() const;
+
 	RGBAImage clip(int x, int y, int width, int height) const;
 	RGBAImage colorize(double r, double g, double b, double a = 1) const;
 	RGBAImage colorize(uint8_t r, uint8_t g, uint8_t b, uint8_t a = 255) const;
@@ -215,12 +223,40 @@ public:
 	void blur(RGBAImage& dest, int radius) const;
 
 	bool readPNG(const std::string& filename);
-	bool writePNG(const std::string& filename) const;
-	bool writeIndexedPNG(const std::string& filename, int palette_bits = 8, bool dithered = true) const;
+	bool readPNG(std::istream& in);
+	/**
+	 * Writes a PNG image. The image is encoded into a memory buffer of the thread and
+	 * written at once.
+	 */
+	bool writePNG(const std::string& filename,
+			const PNGEncodingOptions& options = PNGEncodingOptions()) const;
+	bool writePNG(std::ostream& out,
+			const PNGEncodingOptions& options = PNGEncodingOptions()) const;
+	/**
+	 * Writes an indexed PNG image. Only the compression level and fast deflate of the
+	 * encoding options are used, the rows of indexed images aren't filtered (like
+	 * libpng does it by default for them).
+	 */
+	bool writeIndexedPNG(const std::string& filename, int palette_bits = 8, bool dithered = true,
+			const PNGEncodingOptions& options = PNGEncodingOptions()) const;
+	bool writeIndexedPNG(std::ostream& out, int palette_bits = 8, bool dithered = true,
+			const PNGEncodingOptions& options = PNGEncodingOptions()) const;
 
 	bool readJPEG(const std::string& filename);
+	bool readJPEG(std::istream& in);
 	bool writeJPEG(const std::string& filename, int quality,
 			RGBAPixel background = rgba(255, 255, 255, 255)) const;
+	bool writeJPEG(std::ostream& out, int quality,
+			RGBAPixel background = rgba(255, 255, 255, 255)) const;
+
+	/**
+	 * Reads/writes WebP images. The quality is the encoder effort when writing
+	 * lossless images. These methods always fail if Mapcrafter was built without libwebp.
+	 */
+	bool readWebP(const std::string& filename);
+	bool readWebP(std::istream& in);
+	bool writeWebP(const std::string& filename, int quality, bool lossless) const;
+	bool writeWebP(std::ostream& out, int quality, bool lossless) const;
 };
 
 template <typename Pixel>
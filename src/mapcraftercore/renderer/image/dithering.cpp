@@ -22,48 +22,70 @@
 #include "palette.h"
 #include "../image.h"
 
+#include <algorithm>
+#include <cassert>
+
 namespace mapcrafter {
 namespace renderer {
 
+namespace {
+
+inline int clampColor(int value) {
+	return value < 0 ? 0 : (value > 255 ? 255 : value);
+}
+
+}
+
 /**
  * Floyd-Steinberg dithering: http://en.wikipedia.org/wiki/Floyd-Steinberg_dithering
  */
-void imageDither(RGBAImage& image, Palette& palette, std::vector<int>& data) {
+void imageDither(const RGBAImage& image, Palette& palette, std::vector<uint8_t>& data) {
 	int width = image.getWidth();
 	int height = image.getHeight();
 	data.resize(width * height);
+	const std::vector<RGBAPixel>& colors = palette.getColors();
+	assert(colors.size() <= 256);
+
+	// the errors (r, g, b, a) diffused to the current and the next row,
+	// with one padding pixel on both sides, so no bounds checks are needed
+	int stride = (width + 2) * 4;
+	std::vector<int> errors(2 * stride, 0);
+	int* current = &errors[4];
+	int* next = &errors[stride + 4];
+
+	for (int y = 0; y < height; y++) {
+		const RGBAPixel* row = &image.data[y * width];
+		uint8_t* row_data = &data[y * width];
+		std::fill(next - 4, next + stride - 4, 0);
+
+		for (int x = 0; x < width; x++) {
+			int* error = current + x * 4;
+			int red = clampColor(rgba_red(row[x]) + error[0]);
+			int green = clampColor(rgba_green(row[x]) + error[1]);
+			int blue = clampColor(rgba_blue(row[x]) + error[2]);
+			int alpha = clampColor(rgba_alpha(row[x]) + error[3]);
 
-	for (int y = 0; y < image.getHeight(); y++) {
-		for (int x = 0; x < image.getWidth(); x++) {
-			RGBAPixel old_color = image.pixel(x, y);
 			// find nearest palette color and use it
-			int color_id = palette.getNearestColor(old_color);
-			RGBAPixel new_color = palette.getColors()[color_id];
-			image.pixel(x, y) = new_color;
-			data[y * width + x] = color_id;
+			int color_id = palette.getNearestColor(rgba(red, green, blue, alpha));
+			RGBAPixel new_color = colors[color_id];
+			row_data[x] = color_id;
 
 			// do the floyd-steinberg error diffusion magic
-			int error_r = rgba_red(old_color) - rgba_red(new_color);
-			int error_g = rgba_green(old_color) - rgba_green(new_color);
-			int error_b = rgba_blue(old_color) - rgba_blue(new_color);
-			int error_a = rgba_alpha(old_color) - rgba_alpha(new_color);
-
-			image.setPixel(x+1, y, rgba_add_clamp(image.getPixel(x+1, y),
-						error_r * 7/16,
-						error_g * 7/16,
-						error_b * 7/16,
-						error_a * 7/16));
-			image.setPixel(x-1, y+1, rgba_add_clamp(image.getPixel(x-1, y+1),
-						error_r * 3/16,
-						error_g * 3/16,
-						error_b * 3/16,
-						error_a * 3/16));
-			image.setPixel(x, y+1, rgba_add_clamp(image.getPixel(x, y+1),
-						error_r * 5/16,
-						error_g * 5/16,
-						error_b * 5/16,
-						error_a * 5/16));
+			int diff[4] = {
+				red - rgba_red(new_color),
+				green - rgba_green(new_color),
+				blue - rgba_blue(new_color),
+				alpha - rgba_alpha(new_color)
+			};
+			int* below = next + x * 4;
+			for (int i = 0; i < 4; i++) {
+				error[4 + i] += diff[i] * 7/16;
+				below[i - 4] += diff[i] * 3/16;
+				below[i] += diff[i] * 5/16;
+			}
 		}
+
+		std::swap(current, next);
 	}
 }
 
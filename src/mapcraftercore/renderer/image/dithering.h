@@ -20,6 +20,7 @@
 #ifndef IMAGE_DITHERING_H_
 #define IMAGE_DITHERING_H_
 
+#include <cstdint>
 #include <vector>
 
 namespace mapcrafter {
@@ -29,14 +30,14 @@ class RGBAImage;
 class Palette;
 
 /**
- * Applies a Floyd-Steinberg dithering to an image with a given palette.
+ * Applies a Floyd-Steinberg dithering to an image with a given palette (with at most 256
+ * colors).
  *
- * The dithering is performened in-place, so the dithered colors are saved to the image
- * object. Also the dithered image data (indices of palette colors as pixels) is saved to
- * the supplied vector. You can supply a reference to an empty int vector, it will be
- * resized and all the image pixels are saved as data[y * width + x].
- */ 
-void imageDither(RGBAImage& image, Palette& palette, std::vector<int>& data);
+ * The dithered image data (indices of palette colors as pixels) is saved to the supplied
+ * vector, it will be resized and all the image pixels are saved as data[y * width + x].
+ * The image itself is not modified, the diffused errors are kept in two row buffers.
+ */
+void imageDither(const RGBAImage& image, Palette& palette, std::vector<uint8_t>& data);
 
 }
 }
@@ -19,6 +19,8 @@
 
 #include "palette.h"
 
+#include <cassert>
+
 namespace mapcrafter {
 namespace renderer {
 
@@ -52,5 +54,38 @@ int SimplePalette::getNearestColor(const RGBAPixel& color) {
 	return best_color;
 }
 
+CachedPalette::CachedPalette()
+	: palette(nullptr), generation(0) {
+}
+
+CachedPalette::~CachedPalette() {
+}
+
+void CachedPalette::setPalette(Palette* palette) {
+	this->palette = palette;
+	if (cache.empty() || generation == 0xffff) {
+		cache.assign(1 << CACHE_BITS, {0, 0, 0});
+		generation = 0;
+	}
+	generation++;
+}
+
+const std::vector<RGBAPixel>& CachedPalette::getColors() const {
+	assert(palette != nullptr);
+	return palette->getColors();
+}
+
+int CachedPalette::getNearestColor(const RGBAPixel& color) {
+	assert(palette != nullptr);
+	// multiplicative hashing, the upper bits are the well mixed ones
+	Entry& entry = cache[(color * 2654435761u) >> (32 - CACHE_BITS)];
+	if (entry.generation != generation || entry.color != color) {
+		entry.color = color;
+		entry.color_id = palette->getNearestColor(color);
+		entry.generation = generation;
+	}
+	return entry.color_id;
+}
+
 }
 }
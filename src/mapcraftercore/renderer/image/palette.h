@@ -53,6 +53,43 @@ protected:
 	std::vector<RGBAPixel> colors;
 };
 
+/**
+ * Direct-mapped cache of nearest colors in front of another palette. Tiles consist of
+ * relatively few distinct colors, so most lookups are answered by the cache instead of
+ * by the (much slower) search of the actual palette.
+ *
+ * The cache can be reused for many palettes, setting another palette invalidates the
+ * cache without clearing it.
+ */
+class CachedPalette : public Palette {
+public:
+	CachedPalette();
+	virtual ~CachedPalette();
+
+	/**
+	 * Sets the palette whose nearest colors are cached. The palette is not owned.
+	 */
+	void setPalette(Palette* palette);
+
+	virtual const std::vector<RGBAPixel>& getColors() const;
+	virtual int getNearestColor(const RGBAPixel& color);
+
+	// 2^15 entries of 8 bytes
+	static const int CACHE_BITS = 15;
+
+protected:
+	struct Entry {
+		RGBAPixel color;
+		uint16_t color_id;
+		// entry is valid if it's the generation of the current palette
+		uint16_t generation;
+	};
+
+	Palette* palette;
+	uint16_t generation;
+	std::vector<Entry> cache;
+};
+
 }
 }
 
@@ -0,0 +1,358 @@
+/*
+ * Copyright 2012-2016 Moritz Hilscher
+ *
+ * This file is part of Mapcrafter.
+ *
+ * Mapcrafter is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mapcrafter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mapcrafter.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "pngencoder.h"
+
+#include "../image.h"
+#include "../../util.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+
+namespace mapcrafter {
+namespace renderer {
+
+namespace {
+
+const uint8_t PNG_SIGNATURE[] = {137, 80, 78, 71, 13, 10, 26, 10};
+
+// size of the IDAT chunks, that's the default compression buffer size of libpng
+const size_t IDAT_SIZE = 8192;
+
+// bytes per pixel
+const size_t BPP = 4;
+
+const size_t NO_CHUNK = std::numeric_limits<size_t>::max();
+
+void putUInt32(std::vector<uint8_t>& data, size_t offset, uint32_t value) {
+	data[offset] = value >> 24;
+	data[offset + 1] = (value >> 16) & 0xff;
+	data[offset + 2] = (value >> 8) & 0xff;
+	data[offset + 3] = value & 0xff;
+}
+
+/**
+ * The heuristic of libpng to estimate how well a filtered row compresses: The sum of
+ * the absolute values of the filtered bytes (as signed bytes).
+ */
+inline size_t filterCost(uint8_t v) {
+	return v < 128 ? v : 256 - v;
+}
+
+struct SubPredictor {
+	int operator()(int a, int, int) const { return a; }
+};
+
+struct UpPredictor {
+	int operator()(int, int b, int) const { return b; }
+};
+
+struct AveragePredictor {
+	int operator()(int a, int b, int) const { return (a + b) >> 1; }
+};
+
+struct PaethPredictor {
+	int operator()(int a, int b, int c) const {
+		int pa = std::abs(b - c);
+		int pb = std::abs(a - c);
+		int pc = std::abs(a + b - 2 * c);
+		if (pa <= pb && pa <= pc)
+			return a;
+		return pb <= pc ? b : c;
+	}
+};
+
+/**
+ * Filters a row and returns the cost of the filtered row. Stops filtering as soon as
+ * the cost exceeds the limit, the row won't be used then anyway.
+ */
+template <typename Predictor>
+size_t applyFilter(const uint8_t* row, const uint8_t* prev_row, size_t row_bytes,
+		uint8_t* out, size_t limit, Predictor predictor) {
+	size_t cost = 0;
+	for (size_t i = 0; i < BPP && i < row_bytes; i++) {
+		out[i] = row[i] - predictor(0, prev_row[i], 0);
+		cost += filterCost(out[i]);
+	}
+	for (size_t i = BPP; i < row_bytes && cost <= limit; i++) {
+		out[i] = row[i] - predictor(row[i - BPP], prev_row[i], prev_row[i - BPP]);
+		cost += filterCost(out[i]);
+	}
+	return cost;
+}
+
+/**
+ * libpng reduces the zlib window size of small images, the window size in the zlib
+ * header is adjusted to the image size as well.
+ */
+int getWindowBits(size_t image_size) {
+	int window_bits = 15;
+	if (image_size <= 16384) {
+		size_t half_window_size = 1 << (window_bits - 1);
+		while (image_size + 262 <= half_window_size) {
+			half_window_size >>= 1;
+			window_bits--;
+		}
+	}
+	// zlib doesn't support a window size of 8 bits
+	return window_bits == 8 ? 9 : window_bits;
+}
+
+void optimizeCMF(uint8_t* data, size_t image_size) {
+	if (image_size > 16384)
+		return;
+	unsigned int cmf = data[0];
+	if ((cmf & 0x0f) != 8 || (cmf & 0xf0) > 0x70)
+		return;
+	unsigned int cinfo = cmf >> 4;
+	unsigned int half_window_size = 1U << (cinfo + 7);
+	if (image_size > half_window_size)
+		return;
+	do {
+		half_window_size >>= 1;
+		cinfo--;
+	} while (cinfo > 0 && image_size <= half_window_size);
+	cmf = (cmf & 0x0f) | (cinfo << 4);
+	data[0] = cmf;
+	unsigned int flags = data[1] & 0xe0;
+	flags += 0x1f - ((cmf << 8) + flags) % 0x1f;
+	data[1] = flags;
+}
+
+}
+
+std::ostream& operator<<(std::ostream& out, PNGFilter filter) {
+	switch (filter) {
+	case PNGFilter::NONE: return out << "none";
+	case PNGFilter::SUB: return out << "sub";
+	case PNGFilter::UP: return out << "up";
+	case PNGFilter::AVERAGE: return out << "average";
+	case PNGFilter::PAETH: return out << "paeth";
+	case PNGFilter::ALL: return out << "all";
+	default: return out << "unknown";
+	}
+}
+
+PNGEncodingOptions::PNGEncodingOptions(int compression_level, PNGFilter filter,
+		bool fast_deflate)
+	: compression_level(compression_level), filter(filter), fast_deflate(fast_deflate) {
+}
+
+PNGEncoder::PNGEncoder()
+	: stream_initialized(false), stream_level(0), stream_window_bits(0),
+	  stream_strategy(0), chunk_start(NO_CHUNK), first_idat(0), image_size(0) {
+	std::memset(&stream, 0, sizeof(stream));
+}
+
+PNGEncoder::~PNGEncoder() {
+	if (stream_initialized)
+		deflateEnd(&stream);
+}
+
+bool PNGEncoder::encode(const RGBAImage& image, const PNGEncodingOptions& options) {
+	int width = image.getWidth();
+	int height = image.getHeight();
+	size_t row_bytes = width * BPP;
+
+	data.assign(PNG_SIGNATURE, PNG_SIGNATURE + sizeof(PNG_SIGNATURE));
+
+	beginChunk("IHDR");
+	data.resize(data.size() + 13);
+	putUInt32(data, chunk_start + 8, width);
+	putUInt32(data, chunk_start + 12, height);
+	data[chunk_start + 16] = 8; // bit depth
+	data[chunk_start + 17] = 6; // color type RGBA
+	data[chunk_start + 18] = 0; // compression method
+	data[chunk_start + 19] = 0; // filter method
+	data[chunk_start + 20] = 0; // no interlacing
+	endChunk();
+
+	// use the same zlib parameters as libpng
+	image_size = 0xffffffff;
+	if (row_bytes < 32768 && height < 32768)
+		image_size = (row_bytes + 1) * height;
+	int level = options.compression_level;
+	int strategy = options.filter != PNGFilter::NONE ? Z_FILTERED : Z_DEFAULT_STRATEGY;
+	// level 3 is the highest level that uses the fast deflate algorithm of zlib
+	if (options.fast_deflate)
+		level = std::min(level, 3);
+	if (!initStream(level, getWindowBits(image_size), strategy))
+		return false;
+
+	// the pixels are RGBA bytes in memory, except on big endian systems
+	const uint8_t* pixels = image.data.empty() ? nullptr : (const uint8_t*) &image.data[0];
+	if (util::isBigEndian() && pixels != nullptr) {
+		swapped_rows.resize(image.data.size() * BPP);
+		for (size_t i = 0; i < image.data.size(); i++) {
+			RGBAPixel pixel = image.data[i];
+			swapped_rows[i * BPP] = rgba_red(pixel);
+			swapped_rows[i * BPP + 1] = rgba_green(pixel);
+			swapped_rows[i * BPP + 2] = rgba_blue(pixel);
+			swapped_rows[i * BPP + 3] = rgba_alpha(pixel);
+		}
+		pixels = &swapped_rows[0];
+	}
+
+	zero_row.assign(row_bytes, 0);
+	for (size_t i = 0; i < 5; i++)
+		filtered[i].resize(row_bytes + 1);
+
+	first_idat = data.size();
+	chunk_start = NO_CHUNK;
+	for (int y = 0; y < height; y++) {
+		const uint8_t* row = pixels + y * row_bytes;
+		const uint8_t* prev_row = y == 0 ? &zero_row[0] : row - row_bytes;
+		if (!compress(filterRow(row, prev_row, row_bytes, options.filter), row_bytes + 1,
+				Z_NO_FLUSH))
+			return false;
+	}
+	if (!compress(nullptr, 0, Z_FINISH))
+		return false;
+
+	beginChunk("IEND");
+	endChunk();
+	return true;
+}
+
+const std::vector<uint8_t>& PNGEncoder::getData() const {
+	return data;
+}
+
+bool PNGEncoder::initStream(int level, int window_bits, int strategy) {
+	// the stream is only reset if possible, changing the parameters of a used stream
+	// would make the output depend on the images encoded before
+	if (stream_initialized && stream_level == level && stream_window_bits == window_bits
+			&& stream_strategy == strategy)
+		return deflateReset(&stream) == Z_OK;
+
+	if (stream_initialized)
+		deflateEnd(&stream);
+	std::memset(&stream, 0, sizeof(stream));
+	stream_initialized = deflateInit2(&stream, level, Z_DEFLATED, window_bits, 8,
+			strategy) == Z_OK;
+	stream_level = level;
+	stream_window_bits = window_bits;
+	stream_strategy = strategy;
+	return stream_initialized;
+}
+
+bool PNGEncoder::compress(const uint8_t* input, size_t size, int flush) {
+	stream.next_in = (Bytef*) input;
+	stream.avail_in = size;
+	while (true) {
+		if (chunk_start == NO_CHUNK) {
+			beginChunk("IDAT");
+			data.resize(data.size() + IDAT_SIZE);
+			stream.next_out = &data[chunk_start + 8];
+			stream.avail_out = IDAT_SIZE;
+		}
+
+		int ret = deflate(&stream, flush);
+		if (ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR)
+			return false;
+		bool finished = ret == Z_STREAM_END;
+		if (stream.avail_out == 0 || finished) {
+			data.resize(data.size() - stream.avail_out);
+			if (chunk_start == first_idat)
+				optimizeCMF(&data[chunk_start + 8], image_size);
+			endChunk();
+			if (finished)
+				return true;
+		} else if (stream.avail_in == 0 && flush == Z_NO_FLUSH) {
+			return true;
+		}
+	}
+}
+
+void PNGEncoder::beginChunk(const char* type) {
+	chunk_start = data.size();
+	data.resize(data.size() + 8);
+	std::memcpy(&data[chunk_start + 4], type, 4);
+}
+
+void PNGEncoder::endChunk() {
+	size_t length = data.size() - chunk_start - 8;
+	putUInt32(data, chunk_start, length);
+	uint32_t crc = crc32(0, &data[chunk_start + 4], length + 4);
+	data.resize(data.size() + 4);
+	putUInt32(data, data.size() - 4, crc);
+	chunk_start = NO_CHUNK;
+}
+
+const uint8_t* PNGEncoder::filterRow(const uint8_t* row, const uint8_t* prev_row,
+		size_t row_bytes, PNGFilter filter) {
+	const size_t no_limit = std::numeric_limits<size_t>::max();
+	uint8_t* out[5];
+	for (size_t i = 0; i < 5; i++) {
+		out[i] = &filtered[i][0];
+		out[i][0] = i;
+	}
+
+	if (filter == PNGFilter::NONE) {
+		std::memcpy(out[0] + 1, row, row_bytes);
+		return out[0];
+	} else if (filter == PNGFilter::SUB) {
+		applyFilter(row, prev_row, row_bytes, out[1] + 1, no_limit, SubPredictor());
+		return out[1];
+	} else if (filter == PNGFilter::UP) {
+		applyFilter(row, prev_row, row_bytes, out[2] + 1, no_limit, UpPredictor());
+		return out[2];
+	} else if (filter == PNGFilter::AVERAGE) {
+		applyFilter(row, prev_row, row_bytes, out[3] + 1, no_limit, AveragePredictor());
+		return out[3];
+	} else if (filter == PNGFilter::PAETH) {
+		applyFilter(row, prev_row, row_bytes, out[4] + 1, no_limit, PaethPredictor());
+		return out[4];
+	}
+
+	// choose the filter with the lowest cost, the earlier filter wins on equal costs
+	size_t min_cost = 0;
+	for (size_t i = 0; i < row_bytes; i++)
+		min_cost += filterCost(row[i]);
+	int best = 0;
+	size_t cost = applyFilter(row, prev_row, row_bytes, out[1] + 1, min_cost, SubPredictor());
+	if (cost < min_cost) {
+		min_cost = cost;
+		best = 1;
+	}
+	cost = applyFilter(row, prev_row, row_bytes, out[2] + 1, min_cost, UpPredictor());
+	if (cost < min_cost) {
+		min_cost = cost;
+		best = 2;
+	}
+	cost = applyFilter(row, prev_row, row_bytes, out[3] + 1, min_cost, AveragePredictor());
+	if (cost < min_cost) {
+		min_cost = cost;
+		best = 3;
+	}
+	cost = applyFilter(row, prev_row, row_bytes, out[4] + 1, min_cost, PaethPredictor());
+	if (cost < min_cost) {
+		min_cost = cost;
+		best = 4;
+	}
+
+	if (best == 0)
+		std::memcpy(out[0] + 1, row, row_bytes);
+	return out[best];
+}
+
+}
+}
@@ -0,0 +1,125 @@
+/*
+ * Copyright 2012-2016 Moritz Hilscher
+ *
+ * This file is part of Mapcrafter.
+ *
+ * Mapcrafter is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mapcrafter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mapcrafter.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef IMAGE_PNGENCODER_H_
+#define IMAGE_PNGENCODER_H_
+
+#include <cstdint>
+#include <iostream>
+#include <vector>
+#include <zlib.h>
+
+namespace mapcrafter {
+namespace renderer {
+
+class RGBAImage;
+
+/**
+ * The filters which are applied to the rows of a PNG image before compressing them.
+ * With ALL the best filter is chosen for every row, like libpng does by default.
+ */
+enum class PNGFilter {
+	NONE,
+	SUB,
+	UP,
+	AVERAGE,
+	PAETH,
+	ALL
+};
+
+std::ostream& operator<<(std::ostream& out, PNGFilter filter);
+
+/**
+ * Settings of the PNG encoding. The default settings produce the same images as libpng.
+ */
+struct PNGEncodingOptions {
+	PNGEncodingOptions(int compression_level = 6, PNGFilter filter = PNGFilter::ALL,
+			bool fast_deflate = false);
+
+	// zlib compression level from 0 to 9
+	int compression_level;
+	PNGFilter filter;
+	// uses at most compression level 3 (the fast deflate algorithm of zlib), that is
+	// much faster but creates slightly larger images
+	bool fast_deflate;
+};
+
+/**
+ * Encodes RGBA images to PNG images in memory. The zlib stream and the buffers are
+ * reused for every image, so an encoder should be kept (per thread) to encode a lot of
+ * images like the tiles.
+ */
+class PNGEncoder {
+public:
+	PNGEncoder();
+	~PNGEncoder();
+
+	/**
+	 * Encodes an image. Returns false if the compression failed.
+	 */
+	bool encode(const RGBAImage& image, const PNGEncodingOptions& options = PNGEncodingOptions());
+
+	/**
+	 * Returns the PNG data of the last encoded image.
+	 */
+	const std::vector<uint8_t>& getData() const;
+
+private:
+	/**
+	 * Makes sure that the zlib stream is initialized with the specified parameters.
+	 */
+	bool initStream(int level, int window_bits, int strategy);
+
+	/**
+	 * Compresses data into IDAT chunks. The stream is finished if flush is Z_FINISH.
+	 */
+	bool compress(const uint8_t* input, size_t size, int flush);
+
+	void beginChunk(const char* type);
+	void endChunk();
+
+	/**
+	 * Applies the filters to a row of the image (prev_row is the previous one, or zeros
+	 * for the first row) and returns the filtered row including the filter type byte.
+	 */
+	const uint8_t* filterRow(const uint8_t* row, const uint8_t* prev_row, size_t row_bytes,
+			PNGFilter filter);
+
+	z_stream stream;
+	bool stream_initialized;
+	int stream_level, stream_window_bits, stream_strategy;
+
+	// the encoded image
+	std::vector<uint8_t> data;
+	// start of the current chunk
+	size_t chunk_start;
+	// start of the first IDAT chunk
+	size_t first_idat;
+	// size of the filtered image data (before compression)
+	size_t image_size;
+
+	std::vector<uint8_t> swapped_rows, zero_row;
+	// filtered rows, one for every filter type
+	std::vector<uint8_t> filtered[5];
+};
+
+}
+}
+
+#endif /* IMAGE_PNGENCODER_H_ */
@@ -19,8 +19,8 @@
 
 #include "quantization.h"
 
+#include <algorithm>
 #include <set>
-#include <queue>
 
 namespace mapcrafter {
 namespace renderer {
@@ -310,77 +310,131 @@ int OctreePalette2::getNearestColor(const RGBAPixel& color) {
 	return sub_palettes[index]->getNearestColor(color);
 }
 
-namespace {
+OctreeQuantizer::OctreeQuantizer() {
+}
 
-struct NodeComparator {
-	bool operator()(const Octree* node1, const Octree* node2) const {
-		// reduce nodes on higher levels first
-		if (node1->getLevel() != node2->getLevel())
-			return node1->getLevel() < node2->getLevel();
-		// reduce nodes with fewer colors first
-		if (node1->getCount() != node2->getCount())
-			return node1->getCount() > node2->getCount();
-		return node1 < node2;
-	};
-};
+OctreeQuantizer::~OctreeQuantizer() {
+}
 
+int OctreeQuantizer::createNode(int parent, int level) {
+	Node node;
+	node.parent = parent;
+	node.level = level;
+	std::fill(node.children, node.children + 16, 0);
+	node.children_count = 0;
+	node.reference = node.red = node.green = node.blue = node.alpha = 0;
+	nodes.push_back(node);
+	return nodes.size() - 1;
+}
+
+int OctreeQuantizer::findOrCreateLeaf(RGBAPixel color) {
+	uint8_t red = rgba_red(color);
+	uint8_t green = rgba_green(color);
+	uint8_t blue = rgba_blue(color);
+	uint8_t alpha = rgba_alpha(color);
+
+	int node = 0;
+	for (int i = 7; i >= 8 - OCTREE_COLOR_BITS; i--) {
+		int index = (nth_bit(red, i) << 3) | (nth_bit(green, i) << 2) | nth_bit(blue, i) << 1 | nth_bit(alpha, i);
+		int child = nodes[node].children[index];
+		if (child == 0) {
+			// careful: creating a node might move the nodes in memory
+			child = createNode(node, nodes[node].level + 1);
+			nodes[node].children[index] = child;
+			nodes[node].children_count++;
+		}
+		node = child;
+	}
+	return node;
+}
+
+bool OctreeQuantizer::isQueuedBefore(int node1, int node2) const {
+	// same order as the octree color quantization always had:
+	// reduce nodes on higher levels first
+	const Node& n1 = nodes[node1];
+	const Node& n2 = nodes[node2];
+	if (n1.level != n2.level)
+		return n1.level < n2.level;
+	// reduce nodes with fewer colors first
+	if (n1.reference != n2.reference)
+		return n1.reference > n2.reference;
+	return node1 < node2;
 }
 
 /**
  * Simple octree color quantization: Similar to http://rosettacode.org/wiki/Color_quantization#C
  */
-void octreeColorQuantize(const RGBAImage& image, size_t max_colors,
-		std::vector<RGBAPixel>& colors, Octree** octree) {
+void OctreeQuantizer::quantize(const RGBAImage& image, size_t max_colors,
+		std::vector<RGBAPixel>& colors) {
 	assert(max_colors > 0);
 
-	// have an octree with the colors as leaves
-	Octree* internal_octree = new Octree();
-	// and a priority queue of leaves to be processed
-	// the order of leaves is very important, see NodeComparator
-	std::priority_queue<Octree*, std::vector<Octree*>, NodeComparator> queue;
-
-	// insert the colors into the octree
-	for (int x = 0; x < image.getWidth(); x++) {
-		for (int y = 0; y < image.getHeight(); y++) {
-			RGBAPixel color = image.pixel(x, y);
-			Octree* node = Octree::findOrCreateNode(internal_octree, color);
-			node->setColor(color);
-			// add the leaf only once to the queue
-			if (node->getCount() == 1)
-				queue.push(node);
+	nodes.clear();
+	queue.clear();
+	createNode(-1, 0);
+	auto comparator = [this](int node1, int node2) {
+		return isQueuedBefore(node1, node2);
+	};
+
+	// insert the colors into the octree,
+	// neighboring pixels often have the same color, remember the last leaf
+	RGBAPixel last_color = 0;
+	int last_leaf = -1;
+	for (auto it = image.data.begin(); it != image.data.end(); ++it) {
+		RGBAPixel color = *it;
+		if (color != last_color || last_leaf == -1) {
+			last_color = color;
+			last_leaf = findOrCreateLeaf(color);
 		}
+
+		Node& leaf = nodes[last_leaf];
+		leaf.reference++;
+		leaf.red += rgba_red(color);
+		leaf.green += rgba_green(color);
+		leaf.blue += rgba_blue(color);
+		leaf.alpha += rgba_alpha(color);
+		// add the leaf only once to the queue
+		if (leaf.reference == 1)
+			queue.push_back(last_leaf);
 	}
+	std::make_heap(queue.begin(), queue.end(), comparator);
 
 	// now: reduce the leaves until we have less colors than maximum
 	while (queue.size() > max_colors) {
-		Octree* node = queue.top();
-		assert(node->isLeaf());
-		queue.pop();
-		
-		// add the color value of the leaf to the parent
-		node->reduceToParent();
-		Octree* parent = node->getParent();
-		// delete the leaf (leaf is automatically removed from parent in reduceToParent())
-		delete node;
+		std::pop_heap(queue.begin(), queue.end(), comparator);
+		Node& node = nodes[queue.back()];
+		queue.pop_back();
+		assert(node.children_count == 0);
+
+		// add the color value of the leaf to the parent and remove it from the parent
+		Node& parent = nodes[node.parent];
+		parent.reference += node.reference;
+		parent.red += node.red;
+		parent.green += node.green;
+		parent.blue += node.blue;
+		parent.alpha += node.alpha;
+		parent.children_count--;
 
 		// add parent to queue if it is a leaf now
-		if (parent->isLeaf())
-			queue.push(parent);
+		if (parent.children_count == 0) {
+			queue.push_back(node.parent);
+			std::push_heap(queue.begin(), queue.end(), comparator);
+		}
 	}
 
 	// gather the quantized colors
 	while (queue.size()) {
-		Octree* node = queue.top();
-		assert(node->isLeaf());
-		node->setColorID(colors.size());
-		colors.push_back(node->getColor());
-		queue.pop();
+		std::pop_heap(queue.begin(), queue.end(), comparator);
+		const Node& node = nodes[queue.back()];
+		queue.pop_back();
+		colors.push_back(rgba(node.red / node.reference, node.green / node.reference,
+				node.blue / node.reference, node.alpha / node.reference));
 	}
+}
 
-	if (octree != nullptr)
-		*octree = internal_octree;
-	else
-		delete internal_octree;
+void octreeColorQuantize(const RGBAImage& image, size_t max_colors,
+		std::vector<RGBAPixel>& colors) {
+	OctreeQuantizer quantizer;
+	quantizer.quantize(image, max_colors, colors);
 }
 
 }
@@ -257,13 +257,52 @@ protected:
 	std::vector<SubPalette*> sub_palettes;
 };
 
+/**
+ * Octree color quantization with the nodes of the octree stored in an arena (instead of
+ * allocating every node with new). The arena is kept between images, so a quantizer
+ * reused for many images (for example one per render thread) doesn't need to allocate
+ * memory once it has seen a few images.
+ */
+class OctreeQuantizer {
+public:
+	OctreeQuantizer();
+	~OctreeQuantizer();
+
+	/**
+	 * Quantizes the colors of a given image to max_colors >= colors. Stores the palette
+	 * colors in the supplied vector.
+	 */
+	void quantize(const RGBAImage& image, size_t max_colors, std::vector<RGBAPixel>& colors);
+
+private:
+	struct Node {
+		int parent;
+		int level;
+		// indices of the children in the arena, 0 if a child doesn't exist
+		// (root node is at index 0 and can't be a child)
+		int children[16];
+		int children_count;
+
+		// how many colors this node represents and the sum of them
+		uint64_t reference;
+		uint64_t red, green, blue, alpha;
+	};
+
+	int createNode(int parent, int level);
+	int findOrCreateLeaf(RGBAPixel color);
+	bool isQueuedBefore(int node1, int node2) const;
+
+	std::vector<Node> nodes;
+	// binary heap of leaves to be reduced
+	std::vector<int> queue;
+};
+
 /**
  * Quantizes the colors of a given image to max_colors >= colors. Stores the palette
- * colors in the supplied vector and also the used octree to quantize the colors in the
- * octree pointer pointer if you need it.
+ * colors in the supplied vector.
  */
 void octreeColorQuantize(const RGBAImage& image, size_t max_colors,
-		std::vector<RGBAPixel>& colors, Octree** octree = nullptr);
+		std::vector<RGBAPixel>& colors);
 
 }
 }
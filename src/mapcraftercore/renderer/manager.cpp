@@ -20,11 +20,16 @@
 #include "manager.h"
 
 #include "blockimages.h"
+#include "renderjournal.h"
 #include "tilerenderworker.h"
+#include "tilestore.h"
 #include "renderview.h"
+#include "tilearchive.h"
 #include "../renderer/biomes.h"
 #include "../config/loggingconfig.h"
 #include "../mc/blockstate.h"
+#include "../mc/regionprefetcher.h"
+#include "../mc/worldwatcher.h"
 #include "../thread/impl/singlethread.h"
 #include "../thread/impl/multithreading.h"
 #include "../thread/dispatcher.h"
@@ -32,9 +37,13 @@
 #include "../version.h"
 
 #include <cstring>
+#include <algorithm>
 #include <array>
+#include <chrono>
 #include <fstream>
+#include <limits>
 #include <memory>
+#include <sstream>
 #include <thread>
 #include <tuple>
 
@@ -125,6 +134,89 @@ void parseRenderBehaviorMaps(const std::vector<std::string>& maps,
 	}
 }
 
+/**
+ * The progress output (progress bar or log output) of a map/rotation(s), it reports how
+ * long the rotation(s) took when finished.
+ */
+class RotationProgress {
+public:
+	RotationProgress(const std::string& label, const std::string& rotation_names, bool batch)
+		: label(label), rotation_names(rotation_names), progress_bar(nullptr),
+		  time_start(std::time(nullptr)) {
+		if (batch || !util::isOutTTY()) {
+			util::Logging::getInstance().setSinkLogProgress("__output__", true);
+		} else {
+			progress_bar = new util::ProgressBar;
+			progress.addHandler(progress_bar);
+		}
+		log_output = new util::LogOutputProgressHandler;
+		progress.addHandler(log_output);
+	}
+
+	~RotationProgress() {
+		if (progress_bar != nullptr)
+			delete progress_bar;
+		delete log_output;
+	}
+
+	util::IProgressHandler* getHandler() {
+		return &progress;
+	}
+
+	void finish() {
+		std::time_t took = std::time(nullptr) - time_start;
+		if (progress_bar != nullptr)
+			progress_bar->finish();
+
+		LOG(INFO) << label << "Rendering " << rotation_names
+			<< " took " << took << " seconds.";
+	}
+
+private:
+	std::string label, rotation_names;
+
+	util::MultiplexingProgressHandler progress;
+	util::ProgressBar* progress_bar;
+	util::LogOutputProgressHandler* log_output;
+
+	std::time_t time_start;
+};
+
+/**
+ * Returns the render tiles of a tile set with the points of interest of a world, whose
+ * tiles are rendered first.
+ */
+std::vector<TilePath> findPriorityTiles(const config::WorldSection& world_config,
+		const mc::World& world, TileSet& tile_set) {
+	config::RenderPriority render_priority = world_config.getRenderPriority();
+	std::vector<mc::BlockPos> points = render_priority.positions;
+	mc::BlockPos spawn;
+	if (render_priority.spawn && world.getDimension() == mc::Dimension::OVERWORLD
+			&& world.getSpawnPoint(spawn))
+		points.push_back(spawn);
+	if (render_priority.players) {
+		std::vector<mc::BlockPos> players = world.getPlayerPositions();
+		points.insert(points.end(), players.begin(), players.end());
+	}
+	if (render_priority.default_view)
+		points.push_back(world_config.getDefaultView());
+
+	std::vector<TilePath> tiles;
+	std::vector<TilePos> chunk_tiles;
+	int radius = (1 << tile_set.getDepth()) / 2;
+	for (auto it = points.begin(); it != points.end(); ++it) {
+		chunk_tiles.clear();
+		tile_set.mapChunkToTiles(mc::ChunkPos(*it), chunk_tiles);
+		for (auto tile_it = chunk_tiles.begin(); tile_it != chunk_tiles.end(); ++tile_it) {
+			TilePos tile = *tile_it - tile_set.getTileOffset();
+			if (tile.getX() >= -radius && tile.getX() < radius
+					&& tile.getY() >= -radius && tile.getY() < radius)
+				tiles.push_back(TilePath::byTilePos(tile, tile_set.getDepth()));
+		}
+	}
+	return tiles;
+}
+
 }
 
 RenderBehaviors RenderBehaviors::fromRenderOpts(
@@ -142,14 +234,88 @@ RenderBehaviors RenderBehaviors::fromRenderOpts(
 	return behaviors;
 }
 
+RenderShard::RenderShard()
+	: index(0), count(0), levels(2), compose_only(false) {
+}
+
+bool RenderShard::isEnabled() const {
+	return count > 0 || !tiles.empty() || compose_only;
+}
+
+bool RenderShard::isShard() const {
+	return isEnabled() && !compose_only;
+}
+
+int RenderShard::getZoomLevel(const TileSet& tile_set) const {
+	return std::max(tile_set.getDepth() - levels, 0);
+}
+
+std::vector<TilePath> RenderShard::getTiles(const TileSet& tile_set) const {
+	int zoom_level = getZoomLevel(tile_set);
+	std::vector<TilePath> subtrees;
+	if (zoom_level == tile_set.getDepth()) {
+		if (tile_set.isTileRequired(TilePath()))
+			subtrees.push_back(TilePath());
+	} else {
+		std::vector<TilePath> required = tile_set.getRequiredCompositeTiles();
+		for (auto it = required.begin(); it != required.end(); ++it)
+			if (it->getDepth() == zoom_level)
+				subtrees.push_back(*it);
+	}
+	if (compose_only)
+		return subtrees;
+
+	std::vector<TilePath> shard;
+	if (count > 0) {
+		// split the subtrees (sorted by their paths, so neighboring subtrees stay
+		// together) into parts with about the same count of required render tiles
+		int64_t total = 0, before = 0;
+		for (auto it = subtrees.begin(); it != subtrees.end(); ++it)
+			total += tile_set.getContainingRenderTiles(*it);
+		for (auto it = subtrees.begin(); it != subtrees.end(); ++it) {
+			if (before * count / total == index)
+				shard.push_back(*it);
+			before += tile_set.getContainingRenderTiles(*it);
+		}
+		return shard;
+	}
+
+	for (auto it = tiles.begin(); it != tiles.end(); ++it)
+		if (it->getDepth() > zoom_level)
+			LOG(WARNING) << "Ignoring tile '" << it->toString() << "' of the shard, "
+				<< "the subtrees of the shards are at zoom level " << zoom_level << ".";
+	std::set<TilePath> shard_tiles(tiles.begin(), tiles.end());
+	for (auto it = subtrees.begin(); it != subtrees.end(); ++it) {
+		TilePath path = *it;
+		while (path.getDepth() > 0 && !shard_tiles.count(path))
+			path = path.parent();
+		if (shard_tiles.count(path))
+			shard.push_back(*it);
+	}
+	return shard;
+}
+
 RenderManager::RenderManager(const config::MapcrafterConfig& config)
-	: config(config), web_config(config), time_started_scanning(0) {
+	: config(config), web_config(config), render_profiling(RenderProfiling::DISABLED),
+	  interleave_rotations(false), time_started_scanning(0), use_required_tiles(false) {
 }
 
 void RenderManager::setRenderBehaviors(const RenderBehaviors& render_behaviors) {
 	this->render_behaviors = render_behaviors;
 }
 
+void RenderManager::setRenderProfiling(RenderProfiling render_profiling) {
+	this->render_profiling = render_profiling;
+}
+
+void RenderManager::setInterleaveRotations(bool interleave_rotations) {
+	this->interleave_rotations = interleave_rotations;
+}
+
+void RenderManager::setRenderShard(const RenderShard& render_shard) {
+	this->render_shard = render_shard;
+}
+
 bool RenderManager::initialize() {
 	// an output directory would be nice -- create one if it does not exist
 	if (!fs::is_directory(config.getOutputDir()) && !fs::create_directories(config.getOutputDir())) {
@@ -161,7 +327,7 @@ bool RenderManager::initialize() {
 	return web_config.readConfigJS();
 }
 
-bool RenderManager::scanWorlds() {
+bool RenderManager::scanWorlds(int threads) {
 	auto config_worlds = config.getWorlds();
 	auto config_maps = config.getMaps();
 
@@ -204,28 +370,12 @@ bool RenderManager::scanWorlds() {
 		config::WorldSection world_config = config.getWorld(tile_set_it->world_name);
 		RenderView* render_view = createRenderView(tile_set_it->render_view, tile_set_it->rotation, 1.0f );
 
-		// load the world
-		std::shared_ptr<mc::World> world(new mc::World(world_config.getInputDir().string(),
-				world_config.getDimension(), config.getCachePath(world_config.getShortName()).string()));
-		world->setWorldCrop(world_config.getWorldCrop());
-		if (!world->load()) {
-			LOG(FATAL) << "Unable to load world " << tile_set_it->world_name << "!";
-			return false;
-		}
-		int world_version = world->getMinecraftVersion();
-		if (world_version == -1) {
-			LOG(WARNING) << "Unable to determine Minecraft version of world '"
-				<< tile_set_it->world_name << "'. Maybe level.dat doesn't exist in world directory?";
-			LOG(WARNING) << "Note that rendering of pre-1.13 worlds is not supported, "
-				<< "in case Mapcrafter fails to read the world.";
-			LOG(WARNING) << "See Mapcrafter legacy for rendering of older worlds. TODO";
-		} else if (world_version < 2860) {
-			// 2860 is 1.18.1, should be first version of remodeled 3d chunk based
-			LOG(ERROR) << "Rendering of world '" << tile_set_it->world_name << "'  is not supported.";
-			LOG(ERROR) << "This version of Mapcrafter supports only worlds of Minecraft 1.18.1 and newer";
-			LOG(ERROR) << "See Mapcrafter legacy for rendering of older worlds. TODO";
+		// load the world, all tile sets of a world use the same world object
+		std::shared_ptr<mc::World>& world = worlds[tile_set_it->world_name];
+		if (!world)
+			world = loadWorld(tile_set_it->world_name);
+		if (!world)
 			return false;
-		}
 
 		// create a tile set for this world
 		std::shared_ptr<TileSet> tile_set(render_view->createTileSet(tile_set_it->tile_width));
@@ -235,10 +385,10 @@ bool RenderManager::scanWorlds() {
 		//  - the ones with completely specified x- AND z-bounds
 		if (world_config.needsWorldCentering()) {
 			TilePos tile_offset;
-			tile_set->scan(*world, true, tile_offset);
+			tile_set->scan(*world, true, tile_offset, threads);
 			web_config.setTileSetTileOffset(*tile_set_it, tile_offset);
 		} else {
-			tile_set->scan(*world);
+			tile_set->scan(*world, threads);
 		}
 
 		// key of this tile_sets_max_zoom map is a TileSetGroupID, not TileSetID as we access it
@@ -247,8 +397,7 @@ bool RenderManager::scanWorlds() {
 		int& max_zoom = tile_sets_max_zoom[*tile_set_it];
 		max_zoom = std::max(max_zoom, tile_set->getDepth());
 
-		// set world- and tileset object in the map
-		worlds[tile_set_it->world_name][tile_set_it->rotation] = world;
+		// set tileset object in the map
 		tile_sets[*tile_set_it] = tile_set;
 
 		// clean up render view
@@ -264,16 +413,68 @@ bool RenderManager::scanWorlds() {
 		web_config.setTileSetsMaxZoom(*tile_set_it, max_zoom);
 	}
 
-	writeTemplates();
+	// the shards would write the same files at the same time
+	if (!render_shard.isShard())
+		writeTemplates();
 	return true;
 }
 
+std::shared_ptr<mc::World> RenderManager::loadWorld(const std::string& world_name) const {
+	config::WorldSection world_config = config.getWorld(world_name);
+	std::shared_ptr<mc::World> world(new mc::World(world_config.getInputDir().string(),
+			world_config.getDimension(), config.getCachePath(world_config.getShortName()).string()));
+	world->setWorldCrop(world_config.getWorldCrop());
+	if (!world->load()) {
+		LOG(FATAL) << "Unable to load world " << world_name << "!";
+		return nullptr;
+	}
+	int world_version = world->getMinecraftVersion();
+	if (world_version == -1) {
+		LOG(WARNING) << "Unable to determine Minecraft version of world '"
+			<< world_name << "'. Maybe level.dat doesn't exist in world directory?";
+		LOG(WARNING) << "Note that rendering of pre-1.13 worlds is not supported, "
+			<< "in case Mapcrafter fails to read the world.";
+		LOG(WARNING) << "See Mapcrafter legacy for rendering of older worlds. TODO";
+	} else if (world_version < 2860) {
+		// 2860 is 1.18.1, should be first version of remodeled 3d chunk based
+		LOG(ERROR) << "Rendering of world '" << world_name << "'  is not supported.";
+		LOG(ERROR) << "This version of Mapcrafter supports only worlds of Minecraft 1.18.1 and newer";
+		LOG(ERROR) << "See Mapcrafter legacy for rendering of older worlds. TODO";
+		return nullptr;
+	}
+	return world;
+}
+
 void RenderManager::renderMap(const std::string& map, RenderRotation::Direction rotation, int threads,
 		util::IProgressHandler* progress) {
+	std::set<RenderRotation::Direction> rotations;
+	rotations.insert(rotation);
+	std::vector<std::shared_ptr<MapRender> > renders = startRenderMap(map, rotations,
+			threads, progress);
+	finishRenderMap(renders);
+}
+
+std::shared_ptr<RenderManager::MapRender> RenderManager::prepareRenderMap(const std::string& map,
+		RenderRotation::Direction rotation, int threads) {
 	// make sure this map/rotation actually exists and should be rendered
 	if (!config.hasMap(map) || !config.getMap(map).getRotations().count((RenderRotation::Direction)rotation)
 			|| render_behaviors.getRenderBehavior(map, rotation) == RenderBehavior::SKIP)
-		return;
+		return nullptr;
+
+	config::MapSection map_config = config.getMap(map);
+	config::WorldSection world_config = config.getWorld(map_config.getWorld());
+
+	// a shard renders just its subtrees, the map is initialized by the compose step,
+	// so the shards can't move the tiles of a map whose max zoom level has increased
+	if (render_shard.isShard()) {
+		int max_zoom = web_config.getTileSetsMaxZoom(map_config.getTileSetGroup());
+		int old_max_zoom = web_config.getMapMaxZoom(map);
+		if (old_max_zoom != 0 && old_max_zoom < max_zoom) {
+			LOG(ERROR) << "The max zoom level of map " << map << " was increased from "
+				<< old_max_zoom << " to " << max_zoom << ", render it once without shards.";
+			return nullptr;
+		}
+	}
 
 	// do some initialization stuff for every map once
 	if (!map_initialized.count(map)) {
@@ -281,12 +482,23 @@ void RenderManager::renderMap(const std::string& map, RenderRotation::Direction
 		map_initialized.insert(map);
 	}
 
-	config::MapSection map_config = config.getMap(map);
-	config::WorldSection world_config = config.getWorld(map_config.getWorld());
+	// the shards would write to the tile archive at the same time
+	if (map_config.useTileArchive() && render_shard.isEnabled()) {
+		LOG(ERROR) << "Map " << map << " has a tile archive and can't be rendered in shards.";
+		return nullptr;
+	}
 
-	// TODO keep block state registry global per map. or are there any reasons to make more global?
-	mc::BlockStateRegistry block_registry;
-	std::shared_ptr<RenderView> render_view(createRenderView(map_config.getRenderView(), rotation, map_config.getWaterOpacity()));
+	// the block state registry is kept per map, the world caches of the render threads
+	// contain block ids and can be reused only with the same registry
+	std::shared_ptr<mc::BlockStateRegistry>& block_registry = block_registries[map];
+	if (!block_registry)
+		block_registry = std::make_shared<mc::BlockStateRegistry>();
+	std::shared_ptr<MapRender> render = std::make_shared<MapRender>();
+	render->map = map;
+	render->rotation = rotation;
+	render->threads = threads;
+	render->render_view.reset(createRenderView(map_config.getRenderView(), rotation, map_config.getWaterOpacity()));
+	RenderView* render_view = render->render_view.get();
 
 	// output a small notice if we render this map incrementally
 	int last_rendered = web_config.getMapLastRendered(map, rotation);
@@ -300,11 +512,48 @@ void RenderManager::renderMap(const std::string& map, RenderRotation::Direction
 	fs::path output_dir = config.getOutputPath(map + "/" + config::ROTATION_NAMES_SHORT[rotation]);
 	// get the tile set
 	TileSet* tile_set = tile_sets[map_config.getTileSet((RenderRotation::Direction)rotation)].get();
-	if (render_behaviors.getRenderBehavior(map, rotation) == RenderBehavior::AUTO) {
+
+	// the deepest zoom levels aren't rendered with level of detail rendering, the shards
+	// must render subtrees at the level of detail zoom level or above
+	int lod_levels = std::min(map_config.getLODLevels(), tile_set->getDepth());
+	if (lod_levels > 0 && render_shard.isEnabled()
+			&& render_shard.getZoomLevel(*tile_set) > tile_set->getDepth() - lod_levels) {
+		LOG(ERROR) << "Map " << map << " doesn't render the " << lod_levels
+				<< " deepest zoom levels, the shards must render at least "
+				<< lod_levels << " zoom levels.";
+		return nullptr;
+	}
+
+	// continue an interrupted rendering, the journal has the tiles it rendered already
+	// (every shard of a count of shards has its own journal, the other shards and
+	// composing the shards don't have one)
+	std::shared_ptr<RenderJournal> journal;
+	if (!render_shard.isEnabled())
+		journal = std::make_shared<RenderJournal>(output_dir / "render.journal");
+	else if (render_shard.count > 0 && !render_shard.compose_only)
+		journal = std::make_shared<RenderJournal>(output_dir / ("render.shard-"
+				+ util::str(render_shard.index + 1) + "-of-"
+				+ util::str(render_shard.count) + ".journal"));
+	std::time_t journal_started = time_started_scanning;
+	std::vector<TilePath> rendered_tiles;
+	bool resume = journal && !use_required_tiles
+			&& journal->read(*tile_set, journal_started, rendered_tiles);
+
+	if (use_required_tiles) {
+		// the required tiles are already known (from the changed chunks when watching)
+	} else if (render_behaviors.getRenderBehavior(map, rotation) == RenderBehavior::AUTO) {
 		// if incremental render, scan which tiles might have changed
 		LOG(INFO) << "Scanning required tiles...";
 		// use the incremental check method specified in the config
-		if (map_config.useImageModificationTimes())
+		// (the image modification times don't tell which composite tiles an interrupted
+		// rendering didn't compose anymore, so resuming uses the chunk timestamps, and
+		// so do the shards as they must agree on the required tiles and the maps with a
+		// tile archive or level of detail rendering as there are no (render tile) image files,
+		// and the maps with deduplicated tiles as transparent tiles have no image files and
+		// the other ones are links with the modification time of the first stored image)
+		if (map_config.useImageModificationTimes() && !map_config.useTileArchive()
+				&& !map_config.deduplicateTiles() && lod_levels == 0
+				&& !resume && !render_shard.isEnabled())
 			tile_set->scanRequiredByFiletimes(output_dir, map_config.getImageFormatSuffix());
 		else
 			tile_set->scanRequiredByTimestamp(web_config.getMapLastRendered(map, rotation));
@@ -313,36 +562,115 @@ void RenderManager::renderMap(const std::string& map, RenderRotation::Direction
 		tile_set->resetRequired();
 	}
 
+	if (render_shard.isEnabled()) {
+		int zoom_level = render_shard.getZoomLevel(*tile_set);
+		std::vector<TilePath> shard_tiles = render_shard.getTiles(*tile_set);
+		if (render_shard.compose_only) {
+			// the shards rendered the subtrees, just the tiles above are composed
+			if (zoom_level < tile_set->getDepth())
+				tile_set->skipRenderedTiles(shard_tiles, std::numeric_limits<int>::max());
+			else
+				tile_set->restrictRequiredTiles(std::vector<TilePath>(), zoom_level);
+			LOG(INFO) << "Composing the tiles above zoom level " << zoom_level << " from "
+				<< shard_tiles.size() << " rendered subtrees.";
+		} else {
+			tile_set->restrictRequiredTiles(shard_tiles, zoom_level);
+			LOG(INFO) << "Rendering " << shard_tiles.size() << " subtrees at zoom level "
+				<< zoom_level << " with " << tile_set->getRequiredRenderTilesCount()
+				<< " render tiles as shard.";
+		}
+	}
+
+	if (resume) {
+		int skipped = tile_set->skipRenderedTiles(rendered_tiles, journal_started);
+		LOG(INFO) << "Resuming interrupted rendering, " << skipped
+				<< " tiles were rendered already.";
+	}
+
 	// maybe we don't have to render anything at all
-	if (tile_set->getRequiredRenderTilesCount() == 0) {
+	if (tile_set->getRequiredRenderTilesCount() == 0
+			&& tile_set->getRequiredCompositeTilesCount() == 0) {
 		LOG(INFO) << "No tiles need to get rendered.";
-		return;
+		if (resume) {
+			// the interrupted rendering was actually finished
+			if (!render_shard.isEnabled()) {
+				web_config.setMapLastRendered(map, rotation, time_started_scanning);
+				web_config.writeConfigJS();
+			}
+			journal->remove();
+		}
+		return nullptr;
 	}
 
 	// create other stuff for the render dispatcher
-	std::shared_ptr<BlockImages> block_images(render_view->createBlockImages(block_registry));
-	render_view->configureBlockImages(block_images.get(), world_config, map_config);
+	render->block_images.reset(render_view->createBlockImages(*block_registry));
+	BlockImages* block_images = render->block_images.get();
+	render_view->configureBlockImages(block_images, world_config, map_config);
 
-	RenderedBlockImages* new_block_images = dynamic_cast<RenderedBlockImages*>(block_images.get());
+	RenderedBlockImages* new_block_images = dynamic_cast<RenderedBlockImages*>(block_images);
 	if (new_block_images != nullptr) {
 		if (!new_block_images->loadBlockImages(map_config.getBlockDir().string(), util::str(map_config.getRenderView()), rotation, map_config.getTextureSize())) {
 			LOG(ERROR) << "Skipping remaining rotations.";
-			return;
+			return nullptr;
+		}
+	}
+
+	// the tiles of the level of detail zoom level are rendered with the block images
+	// scaled down by the factor of the skipped zoom levels
+	std::shared_ptr<BlockImages> lod_block_images;
+	if (lod_levels > 0 && new_block_images != nullptr) {
+		lod_block_images.reset(render_view->createBlockImages(*block_registry));
+		render_view->configureBlockImages(lod_block_images.get(), world_config, map_config);
+		RenderedBlockImages* lod_images = dynamic_cast<RenderedBlockImages*>(lod_block_images.get());
+		int factor = 1 << lod_levels;
+		if (!lod_images->loadBlockImages(map_config.getBlockDir().string(),
+					util::str(map_config.getRenderView()), rotation,
+					map_config.getTextureSize(), factor)) {
+			LOG(ERROR) << "Skipping remaining rotations.";
+			return nullptr;
+		}
+		if (lod_images->getBlockWidth() * factor != new_block_images->getBlockWidth()
+				|| lod_images->getBlockHeight() * factor != new_block_images->getBlockHeight()) {
+			LOG(ERROR) << "Unable to render map " << map << " with level of detail: "
+				<< "The block images of texture size " << lod_images->getTextureSize()
+				<< " aren't exactly " << factor << " times smaller than the block images.";
+			return nullptr;
 		}
 	}
 
 	renderer::Biome::initializeBiomes();
 
-	RenderContext context;
+	RenderContext& context = render->context;
 	context.output_dir = output_dir;
 	context.background_color = config.getBackgroundColor();
 	context.world_config = config.getWorld(map_config.getWorld());
 	context.map_config = map_config;
-	context.render_view = render_view.get();
-	context.block_images = block_images.get();
+	context.render_view = render_view;
+	context.block_images = block_images;
+	context.lod_block_images = lod_block_images;
 	context.tile_set = tile_set;
-	context.block_registry = &block_registry;
-	context.world = worlds[map_config.getWorld()][rotation];
+	context.block_registry = block_registry.get();
+	context.world = worlds[map_config.getWorld()];
+	context.region_prefetcher = std::make_shared<mc::RegionPrefetcher>(*context.world);
+	if (render_profiling != RenderProfiling::DISABLED)
+		context.profile_collector = std::make_shared<util::ProfileCollector>();
+	if (map_config.useTileArchive()) {
+		context.tile_archive = std::make_shared<TileArchive>(output_dir / TileArchive::FILENAME);
+		if (!context.tile_archive->open())
+			return nullptr;
+	}
+	if (journal && journal->open(*tile_set, journal_started, resume)) {
+		journal->setTileArchive(context.tile_archive);
+		context.journal = journal;
+	}
+	if (map_config.deduplicateTiles() && !map_config.useTileArchive()) {
+		context.tile_store = std::make_shared<TileStore>(output_dir,
+				config.getOutputPath(".tilestore"));
+		context.tile_store->read(*tile_set);
+	}
+	context.priority_tiles = findPriorityTiles(world_config, *context.world, *tile_set);
+	if (!context.priority_tiles.empty())
+		LOG(INFO) << "Rendering the tiles near the points of interest first.";
 	context.initializeTileRenderer();
 
 	// update map parameters in web config
@@ -350,20 +678,113 @@ void RenderManager::renderMap(const std::string& map, RenderRotation::Direction
 	int tile_h = context.tile_renderer->getTileHeight();
 	web_config.setMapMaxZoom(map, context.tile_set->getDepth());
 	web_config.setMapTileSize(map, std::make_tuple<>(tile_w, tile_h));
-	web_config.writeConfigJS();
+	if (!render_shard.isShard())
+		web_config.writeConfigJS();
 
-	std::shared_ptr<thread::Dispatcher> dispatcher;
-	if (threads == 1 || tile_set->getRequiredRenderTilesCount() == 1)
-		dispatcher = std::make_shared<thread::SingleThreadDispatcher>();
-	else
-		dispatcher = std::make_shared<thread::MultiThreadingDispatcher>(threads);
+	return render;
+}
 
-	// do the dance
-	dispatcher->dispatch(context, progress);
+std::vector<std::shared_ptr<RenderManager::MapRender> > RenderManager::startRenderMap(
+		const std::string& map, const std::set<RenderRotation::Direction>& rotations,
+		int threads, util::IProgressHandler* progress) {
+	std::vector<std::shared_ptr<MapRender> > renders, renders_threaded;
+	std::vector<RenderContext> contexts_threaded;
+	for (auto rotation_it = rotations.begin(); rotation_it != rotations.end(); ++rotation_it) {
+		std::shared_ptr<MapRender> render = prepareRenderMap(map, *rotation_it, threads);
+		if (!render)
+			continue;
+		renders.push_back(render);
 
-	// update the map settings with last render time
-	web_config.setMapLastRendered(map, rotation, time_started_scanning);
-	web_config.writeConfigJS();
+		// do the dance
+		render->dispatch_start = std::chrono::steady_clock::now();
+		if (threads == 1 || render->context.tile_set->getRequiredRenderTilesCount() == 1) {
+			thread::SingleThreadDispatcher dispatcher;
+			dispatcher.dispatch(render->context, progress);
+		} else {
+			renders_threaded.push_back(render);
+		}
+	}
+	if (renders_threaded.empty())
+		return renders;
+
+	// the render threads are started once and render all maps/rotations
+	if (!render_threads || render_threads->getThreadCount() != threads)
+		render_threads = std::make_shared<thread::MultiThreadingDispatcher>(threads);
+	if (renders_threaded.size() == 1) {
+		MapRender& render = *renders_threaded.front();
+		render.job = render_threads->submit(render.context, progress);
+		return renders;
+	}
+
+	// rotations rendered together read their regions with the same prefetcher
+	for (auto it = renders_threaded.begin(); it != renders_threaded.end(); ++it) {
+		(*it)->context.region_prefetcher = renders_threaded.front()->context.region_prefetcher;
+		contexts_threaded.push_back((*it)->context);
+	}
+	auto jobs = render_threads->submit(contexts_threaded, progress);
+	for (size_t i = 0; i < jobs.size(); i++)
+		renders_threaded[i]->job = jobs[i];
+	return renders;
+}
+
+void RenderManager::finishRenderMap(std::vector<std::shared_ptr<MapRender> >& renders) {
+	// rotations rendered together might share data (region prefetcher), so wait for all
+	for (auto it = renders.begin(); it != renders.end(); ++it)
+		if ((*it)->job)
+			render_threads->wait((*it)->job);
+	for (auto it = renders.begin(); it != renders.end(); ++it)
+		finishRenderMap(**it);
+}
+
+void RenderManager::finishRenderMap(MapRender& render) {
+	if (render.job)
+		render_threads->wait(render.job);
+	std::chrono::duration<double> dispatch_time = std::chrono::steady_clock::now() - render.dispatch_start;
+
+	const std::string& map = render.map;
+	RenderRotation::Direction rotation = render.rotation;
+	RenderContext& context = render.context;
+	context.region_prefetcher->stop();
+	LOG(DEBUG) << "Region prefetcher: " << context.region_prefetcher->getRegionsPrefetched()
+		<< " regions prefetched, " << context.region_prefetcher->getRegionsMissed() << " missed.";
+	RenderedBlockImages* new_block_images = dynamic_cast<RenderedBlockImages*>(context.block_images);
+	if (new_block_images != nullptr) {
+		const TintedBlockImageCache& tint_cache = new_block_images->getTintCache();
+		uint64_t lookups = tint_cache.getHits() + tint_cache.getMisses();
+		LOG(DEBUG) << "Tinted block image cache: " << tint_cache.getHits() << " hits, "
+			<< tint_cache.getMisses() << " misses (" << (lookups == 0 ? 0
+				: 100 * tint_cache.getHits() / lookups) << "% hit rate).";
+	}
+
+	if (context.profile_collector) {
+		util::RenderProfile profile = context.profile_collector->getProfile();
+		profile.wall_time = dispatch_time.count();
+		profile.threads = render.threads;
+		if (render_profiling == RenderProfiling::TEXT) {
+			profile.log("Render profile of map " + map + " (rotation "
+					+ config::ROTATION_NAMES[rotation] + ")");
+		} else {
+			picojson::object profile_json;
+			profile_json["map"] = picojson::value(map);
+			profile_json["rotation"] = picojson::value(config::ROTATION_NAMES[rotation]);
+			profile_json["profile"] = profile.toJSON();
+			render_profiles.push_back(picojson::value(profile_json));
+		}
+	}
+
+	// update the map settings with last render time,
+	// a map rendered in shards is rendered when the shards are composed
+	if (!render_shard.isEnabled() || render_shard.compose_only) {
+		web_config.setMapLastRendered(map, rotation, time_started_scanning);
+		web_config.writeConfigJS();
+	}
+	if (context.tile_archive)
+		context.tile_archive->close();
+	if (context.tile_store)
+		context.tile_store->write();
+	// the rendering is complete, nothing to resume anymore
+	if (context.journal)
+		context.journal->remove();
 }
 
 bool RenderManager::run(int threads, bool batch) {
@@ -371,12 +792,93 @@ bool RenderManager::run(int threads, bool batch) {
 		return false;
 
 	LOG(INFO) << "Scanning worlds...";
-	if (!scanWorlds())
+	if (!scanWorlds(threads))
 		return false;
 
+	int time_start_all = std::time(nullptr);
+	renderRequiredMaps(threads, batch);
+	render_threads.reset();
+
+	std::time_t took_all = std::time(nullptr) - time_start_all;
+	LOG(INFO) << "Rendering all worlds took " << took_all << " seconds.";
+
+	writeRenderProfiles();
+	LOG(INFO) << "Finished.....aaand it's gone!";
+	return true;
+}
+
+bool RenderManager::watch(int threads, bool batch, int debounce_ms) {
+	if (!run(threads, batch))
+		return false;
+
+	// from now on every map is rendered incrementally
+	for (auto map_it = required_maps.begin(); map_it != required_maps.end(); ++map_it)
+		for (auto it = map_it->second.begin(); it != map_it->second.end(); ++it)
+			render_behaviors.setRenderBehavior(map_it->first, *it, RenderBehavior::AUTO);
+
+	mc::WorldWatcher watcher;
+	for (auto it = worlds.begin(); it != worlds.end(); ++it)
+		if (!watcher.addWorld(it->first, *it->second))
+			return false;
+
+	while (true) {
+		LOG(INFO) << "Waiting for changes of the worlds...";
+		std::map<std::string, std::map<mc::ChunkPos, uint32_t> > changes;
+		std::time_t changes_time;
+		if (!watcher.waitForChanges(changes, changes_time, debounce_ms))
+			return false;
+
+		int time_start = std::time(nullptr);
+		time_started_scanning = changes_time;
+		for (auto it = changes.begin(); it != changes.end(); ++it) {
+			LOG(INFO) << it->second.size() << " chunks of world " << it->first << " changed.";
+			// the new world object makes the render threads drop their world caches
+			std::shared_ptr<mc::World> world = loadWorld(it->first);
+			if (!world)
+				return false;
+			worlds[it->first] = world;
+		}
+
+		// the tiles of the changed chunks are required, nothing else
+		bool all_tiles_fit = true;
+		std::map<mc::ChunkPos, uint32_t> no_changes;
+		for (auto it = tile_sets.begin(); it != tile_sets.end(); ++it) {
+			auto world_changes = changes.find(it->first.world_name);
+			all_tiles_fit = it->second->scanRequiredByChunks(world_changes != changes.end()
+					? world_changes->second : no_changes) && all_tiles_fit;
+		}
+
+		if (all_tiles_fit) {
+			use_required_tiles = true;
+			renderRequiredMaps(threads, batch);
+			use_required_tiles = false;
+		} else {
+			// the worlds grew beyond their tile sets, so they need a higher zoom level
+			LOG(INFO) << "Worlds grew beyond the current zoom level, scanning worlds...";
+			required_maps.clear();
+			worlds.clear();
+			tile_sets.clear();
+			map_initialized.clear();
+			if (!scanWorlds(threads))
+				return false;
+			renderRequiredMaps(threads, batch);
+		}
+
+		std::time_t took = std::time(nullptr) - time_start;
+		LOG(INFO) << "Rendering changes took " << took << " seconds.";
+		writeRenderProfiles();
+	}
+	return true;
+}
+
+void RenderManager::renderRequiredMaps(int threads, bool batch) {
 	int progress_maps = 0;
 	int progress_maps_all = required_maps.size();
-	int time_start_all = std::time(nullptr);
+
+	// the previously started rotation(s), with multiple threads they might still render
+	// their last tiles while the next rotation is started already
+	std::vector<std::shared_ptr<MapRender> > previous;
+	std::shared_ptr<RotationProgress> previous_progress;
 
 	// go through all required maps
 	for (auto map_it = required_maps.begin(); map_it != required_maps.end(); ++map_it) {
@@ -391,48 +893,92 @@ bool RenderManager::run(int threads, bool batch) {
 		int progress_rotations = 0;
 		int progress_rotations_all = required_rotations.size();
 
-		// now go through the all required rotations of this map and render them
+		// the rotations are rendered one after another, or all together if interleaved
+		std::vector<std::set<RenderRotation::Direction> > rotation_steps;
 		for (auto rotation_it = required_rotations.begin();
 				rotation_it != required_rotations.end(); ++rotation_it) {
-			progress_rotations++;
-
-			LOG(INFO) << "[" << progress_maps << "." << progress_rotations << "/"
-				<< progress_maps << "." << progress_rotations_all << "] "
-				<< "Rendering rotation " << config::ROTATION_NAMES[*rotation_it] << "...";
-
-			std::shared_ptr<util::MultiplexingProgressHandler> progress(new util::MultiplexingProgressHandler);
-			util::ProgressBar* progress_bar = nullptr;
-			if (batch || !util::isOutTTY()) {
-				util::Logging::getInstance().setSinkLogProgress("__output__", true);
-			} else {
-				progress_bar = new util::ProgressBar;
-				progress->addHandler(progress_bar);
-			}
-
-			util::LogOutputProgressHandler* log_output = new util::LogOutputProgressHandler;
-			progress->addHandler(log_output);
-
-			std::time_t time_start = std::time(nullptr);
-			renderMap(map_config.getShortName(), *rotation_it, threads, progress.get());
-			std::time_t took = std::time(nullptr) - time_start;
+			if (rotation_steps.empty() || !interleave_rotations || threads == 1)
+				rotation_steps.push_back(std::set<RenderRotation::Direction>());
+			rotation_steps.back().insert(*rotation_it);
+		}
 
-			if (progress_bar != nullptr) {
-				progress_bar->finish();
-				delete progress_bar;
+		// now go through the all required rotations of this map and render them
+		for (auto step_it = rotation_steps.begin(); step_it != rotation_steps.end(); ++step_it) {
+			const std::set<RenderRotation::Direction>& rotations = *step_it;
+
+			// start the next rotation as soon as the render threads run out of work
+			// of the previous one, but don't touch a tile set that is still rendering
+			bool overlap = !previous.empty();
+			for (auto it = previous.begin(); it != previous.end(); ++it) {
+				overlap = overlap && (*it)->job;
+				for (auto rotation_it = rotations.begin(); rotation_it != rotations.end(); ++rotation_it)
+					if ((*it)->context.tile_set == tile_sets[map_config.getTileSet(*rotation_it)].get())
+						overlap = false;
+			}
+			if (overlap) {
+				for (auto it = previous.begin(); it != previous.end(); ++it)
+					render_threads->waitForTail((*it)->job);
+			} else if (previous_progress) {
+				finishRenderMap(previous);
+				previous_progress->finish();
+				previous.clear();
+				previous_progress.reset();
 			}
-			delete log_output;
 
-			LOG(INFO) << "[" << progress_maps << "." << progress_rotations << "/"
-				<< progress_maps << "." << progress_rotations_all << "] "
-				<< "Rendering rotation " << config::ROTATION_NAMES[*rotation_it]
-				<< " took " << took << " seconds.";
+			std::stringstream label, rotation_names;
+			label << "[" << progress_maps << "." << progress_rotations + 1;
+			if (rotations.size() > 1)
+				label << "-" << progress_rotations + rotations.size();
+			label << "/" << progress_maps << "." << progress_rotations_all << "] ";
+			rotation_names << (rotations.size() > 1 ? "rotations " : "rotation ");
+			for (auto rotation_it = rotations.begin(); rotation_it != rotations.end(); ++rotation_it)
+				rotation_names << (rotation_it == rotations.begin() ? "" : ", ")
+					<< config::ROTATION_NAMES[*rotation_it];
+			progress_rotations += rotations.size();
+			LOG(INFO) << label.str() << "Rendering " << rotation_names.str() << "...";
+
+			std::shared_ptr<RotationProgress> progress = std::make_shared<RotationProgress>(
+					label.str(), rotation_names.str(), batch);
+			std::vector<std::shared_ptr<MapRender> > renders = startRenderMap(
+					map_config.getShortName(), rotations, threads, progress->getHandler());
+
+			if (previous_progress) {
+				finishRenderMap(previous);
+				previous_progress->finish();
+			}
+			previous = renders;
+			previous_progress = progress;
 		}
 	}
 
-	std::time_t took_all = std::time(nullptr) - time_start_all;
-	LOG(INFO) << "Rendering all worlds took " << took_all << " seconds.";
-	LOG(INFO) << "Finished.....aaand it's gone!";
-	return true;
+	if (previous_progress) {
+		finishRenderMap(previous);
+		previous_progress->finish();
+		previous.clear();
+	}
+
+	// remove the deduplicated images which aren't used anymore, but not while other
+	// shards might still be storing their images
+	bool deduplicated = false;
+	for (auto map_it = required_maps.begin(); map_it != required_maps.end(); ++map_it)
+		deduplicated = deduplicated || config.getMap(map_it->first).deduplicateTiles();
+	if (deduplicated && (!render_shard.isEnabled() || render_shard.compose_only)) {
+		int removed = TileStore::removeUnused(config.getOutputPath(".tilestore"));
+		if (removed > 0)
+			LOG(INFO) << "Removed " << removed << " unused deduplicated tile images.";
+	}
+}
+
+void RenderManager::writeRenderProfiles() const {
+	if (render_profiling != RenderProfiling::JSON)
+		return;
+	fs::path profile_file = config.getOutputPath("profile.json");
+	std::ofstream out(profile_file.string());
+	out << picojson::value(render_profiles).serialize(true);
+	if (!out)
+		LOG(ERROR) << "Unable to write render profile to " << profile_file << ".";
+	else
+		LOG(INFO) << "Wrote render profile to " << profile_file << ".";
 }
 
 const std::vector<std::pair<std::string, std::set<RenderRotation::Direction> > >& RenderManager::getRequiredMaps() const {
@@ -536,14 +1082,15 @@ void RenderManager::initializeMap(const std::string& map) {
 			fs::path output_dir = config.getOutputPath(map + "/"
 					+ config::ROTATION_NAMES_SHORT[*rotation_it]);
 			for (int i = old_max_zoom; i < max_zoom; i++)
-				increaseMaxZoom(output_dir, map_config.getImageFormatSuffix());
+				increaseMaxZoom(output_dir, map_config);
 		}
 	}
 
 	// update the template with the max zoom level
 	// (calculated with tile set in scanWorlds-method)
 	web_config.setMapMaxZoom(map, max_zoom);
-	web_config.writeConfigJS();
+	if (!render_shard.isShard())
+		web_config.writeConfigJS();
 }
 
 /**
@@ -551,18 +1098,71 @@ void RenderManager::initializeMap(const std::string& map) {
  * on the tile tree.
  */
 void RenderManager::increaseMaxZoom(const fs::path& dir,
-		std::string image_format, int jpeg_quality) const {
+		const config::MapSection& map_config) const {
+	std::string image_format = map_config.getImageFormatSuffix();
+	auto decode = [&](RGBAImage& image, std::istream& in) {
+		if (map_config.getImageFormat() == config::ImageFormat::PNG)
+			return image.readPNG(in);
+		else if (map_config.getImageFormat() == config::ImageFormat::WEBP)
+			return image.readWebP(in);
+		return image.readJPEG(in);
+	};
+	auto encode = [&](const RGBAImage& image, std::ostream& out) {
+		if (map_config.getImageFormat() == config::ImageFormat::PNG)
+			return image.writePNG(out, map_config.getPNGEncodingOptions());
+		else if (map_config.getImageFormat() == config::ImageFormat::WEBP)
+			return image.writeWebP(out, map_config.getWebPQuality(),
+					map_config.isWebPLossless());
+		return image.writeJPEG(out, map_config.getJPEGQuality());
+	};
+
+	// the tiles are image files or in a tile archive (the paths of the tiles are used
+	// here, with an empty path for the base.png)
+	std::shared_ptr<TileArchive> archive;
+	if (fs::exists(dir / TileArchive::FILENAME)) {
+		archive = std::make_shared<TileArchive>(dir / TileArchive::FILENAME);
+		if (!archive->open())
+			return;
+	}
+	auto readTile = [&](const std::string& path, RGBAImage& image) {
+		if (archive) {
+			std::string data;
+			if (!archive->readTile(TilePath::byString(path), data))
+				return false;
+			std::istringstream in(data);
+			return decode(image, in);
+		}
+		fs::path file = dir / ((path.empty() ? "base" : path) + "." + image_format);
+		std::ifstream in(file.string().c_str(), std::ios::binary);
+		return in && decode(image, in);
+	};
+	auto writeTile = [&](const std::string& path, const RGBAImage& image) {
+		if (archive) {
+			std::ostringstream out;
+			if (encode(image, out))
+				archive->writeTile(TilePath::byString(path), out.str());
+			return;
+		}
+		fs::path file = dir / ((path.empty() ? "base" : path) + "." + image_format);
+		// the old image might be a hard link to a deduplicated image
+		fs::remove(file);
+		std::ofstream out(file.string().c_str(), std::ios::binary);
+		if (out)
+			encode(image, out);
+	};
+
 	// find out tile size by reading old base.png image
 	RGBAImage old_base;
-	if (image_format == "png") {
-		old_base.readPNG((dir / "base.png").string());
-	} else {
-		old_base.readJPEG((dir / "base.jpg").string());
-	}
+	readTile("", old_base);
 	int w = old_base.getWidth();
 	int h = old_base.getHeight();
 
-	if (fs::exists(dir / "1")) {
+	if (archive) {
+		// the archive moves the tiles itself
+		archive->increaseDepth();
+	}
+
+	if (!archive && fs::exists(dir / "1")) {
 		// at first rename the directories 1 2 3 4 (zoom level 0) and make new directories
 		util::moveFile(dir / "1", dir / "1_");
 		fs::create_directories(dir / "1");
@@ -574,7 +1174,7 @@ void RenderManager::increaseMaxZoom(const fs::path& dir,
 	}
 
 	// do the same for the other directories
-	if (fs::exists(dir / "2")) {
+	if (!archive && fs::exists(dir / "2")) {
 		util::moveFile(dir / "2", dir / "2_");
 		fs::create_directories(dir / "2");
 		util::moveFile(dir / "2_", dir / "2/3");
@@ -582,7 +1182,7 @@ void RenderManager::increaseMaxZoom(const fs::path& dir,
 				dir / (std::string("2/3.") + image_format));
 	}
 
-	if (fs::exists(dir / "3")) {
+	if (!archive && fs::exists(dir / "3")) {
 		util::moveFile(dir / "3", dir / "3_");
 		fs::create_directories(dir / "3");
 		util::moveFile(dir / "3_", dir / "3/2");
@@ -590,7 +1190,7 @@ void RenderManager::increaseMaxZoom(const fs::path& dir,
 				dir / (std::string("3/2.") + image_format));
 	}
 
-	if (fs::exists(dir / "4")) {
+	if (!archive && fs::exists(dir / "4")) {
 		util::moveFile(dir / "4", dir / "4_");
 		fs::create_directories(dir / "4");
 		util::moveFile(dir / "4_", dir / "4/1");
@@ -600,17 +1200,10 @@ void RenderManager::increaseMaxZoom(const fs::path& dir,
 
 	// now read the images, which belong to the new directories
 	RGBAImage img1, img2, img3, img4;
-	if (image_format == "png") {
-		img1.readPNG((dir / "1/4.png").string());
-		img2.readPNG((dir / "2/3.png").string());
-		img3.readPNG((dir / "3/2.png").string());
-		img4.readPNG((dir / "4/1.png").string());
-	} else {
-		img1.readJPEG((dir / "1/4.jpg").string());
-		img2.readJPEG((dir / "2/3.jpg").string());
-		img3.readJPEG((dir / "3/2.jpg").string());
-		img4.readJPEG((dir / "4/1.jpg").string());
-	}
+	readTile("1/4", img1);
+	readTile("2/3", img2);
+	readTile("3/2", img3);
+	readTile("4/1", img4);
 
 	// create images for the new directories
 	RGBAImage new1(w, h), new2(w, h), new3(w, h), new4(w, h);
@@ -628,17 +1221,10 @@ void RenderManager::increaseMaxZoom(const fs::path& dir,
 	new4.simpleAlphaBlit(old4, 0, 0);
 
 	// now save the new images in the output directory
-	if (image_format == "png") {
-		new1.writePNG((dir / "1.png").string());
-		new2.writePNG((dir / "2.png").string());
-		new3.writePNG((dir / "3.png").string());
-		new4.writePNG((dir / "4.png").string());
-	} else {
-		new1.writeJPEG((dir / "1.jpg").string(), jpeg_quality);
-		new2.writeJPEG((dir / "2.jpg").string(), jpeg_quality);
-		new3.writeJPEG((dir / "3.jpg").string(), jpeg_quality);
-		new4.writeJPEG((dir / "4.jpg").string(), jpeg_quality);
-	}
+	writeTile("1", new1);
+	writeTile("2", new2);
+	writeTile("3", new3);
+	writeTile("4", new4);
 
 	// don't forget the base.png
 	RGBAImage base(2*h, 2*h);
@@ -647,10 +1233,9 @@ void RenderManager::increaseMaxZoom(const fs::path& dir,
 	base.simpleAlphaBlit(new3, 0, h);
 	base.simpleAlphaBlit(new4, w, h);
 	base = base.resize(0, 0, InterpolationType::HALF);
-	if (image_format == "png")
-		base.writePNG((dir / "base.png").string());
-	else
-		base.writeJPEG((dir / "base.jpg").string(), jpeg_quality);
+	writeTile("", base);
+	if (archive)
+		archive->close();
 }
 
 }
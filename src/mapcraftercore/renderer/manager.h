@@ -21,14 +21,17 @@
 #define MANAGER_H_
 
 #include "tilerenderer.h"
+#include "tilerenderworker.h"
 #include "tileset.h"
 #include "../config/mapcrafterconfig.h"
 #include "../config/webconfig.h"
 #include "../mc/world.h"
 #include "../mc/worldcache.h"
 
+#include <chrono>
 #include <ctime>
 #include <map>
+#include <memory>
 #include <set>
 #include <vector>
 #include <boost/filesystem.hpp>
@@ -37,12 +40,29 @@ namespace fs = boost::filesystem;
 
 namespace mapcrafter {
 
+namespace mc {
+class BlockStateRegistry;
+}
+
+namespace thread {
+class MultiThreadingDispatcher;
+class RenderJob;
+}
+
 namespace util {
 class IProgressHandler;
 }
 
 namespace renderer {
 
+/**
+ * Whether the rendering of each map is profiled and how the profiles are reported:
+ * Logged as table (text), or written to profile.json in the output directory (json).
+ */
+enum class RenderProfiling {
+	DISABLED, TEXT, JSON
+};
+
 /**
  * This are the render options from the command line.
  */
@@ -54,6 +74,58 @@ struct RenderOpts {
 	std::vector<std::string> render_skip, render_auto, render_force;
 	bool skip_all, force_all;
 	int jobs;
+	RenderProfiling profiling;
+	bool interleave_rotations;
+	bool watch;
+	int watch_debounce;
+	std::string shard;
+	std::vector<std::string> shard_tiles;
+	int shard_levels;
+	bool compose_only;
+};
+
+/**
+ * Which part of the maps is rendered if the rendering is split into shards, for example
+ * to render the shards on different machines.
+ *
+ * A shard is a set of subtrees of the tile set: The required tiles some zoom levels
+ * above the render tiles are either split evenly (by their required render tiles) into
+ * a count of shards, or the shard is specified as list of tiles (the subtrees at or
+ * below them). The composite tiles above are composed in a separate compose-only step
+ * after all shards are rendered into the output directory.
+ */
+struct RenderShard {
+	RenderShard();
+
+	/**
+	 * Returns whether only a shard is rendered or the shards are composed.
+	 */
+	bool isEnabled() const;
+
+	/**
+	 * Returns whether the subtrees of a shard are rendered. A shard writes just the tiles
+	 * of its subtrees, the web files of the output directory (config.js, templates) are
+	 * written by the compose step.
+	 */
+	bool isShard() const;
+
+	/**
+	 * Returns the zoom level of the subtrees of the shards in a tile set.
+	 */
+	int getZoomLevel(const TileSet& tile_set) const;
+
+	/**
+	 * Returns the required tiles of the shard at its zoom level in a tile set, or all
+	 * of them if the shards are composed.
+	 */
+	std::vector<TilePath> getTiles(const TileSet& tile_set) const;
+
+	// index of the shard and count of shards, count is 0 if the shard is a list of tiles
+	int index, count;
+	std::vector<TilePath> tiles;
+	// how many zoom levels the subtrees are above the render tiles
+	int levels;
+	bool compose_only;
 };
 
 /**
@@ -123,6 +195,23 @@ public:
 	 */
 	void setRenderBehaviors(const RenderBehaviors& render_behaviors);
 
+	/**
+	 * Sets whether and how the rendering of the maps is profiled.
+	 */
+	void setRenderProfiling(RenderProfiling render_profiling);
+
+	/**
+	 * Sets whether all rotations of a map are rendered together with multiple threads,
+	 * so the render threads read and decode each world region just once for all of them.
+	 */
+	void setInterleaveRotations(bool interleave_rotations);
+
+	/**
+	 * Sets which shard of the maps is rendered, or whether the rendered shards are
+	 * composed.
+	 */
+	void setRenderShard(const RenderShard& render_shard);
+
 	/**
 	 * Some basic initialization things. blah.
 	 *
@@ -132,12 +221,12 @@ public:
 	bool initialize();
 
 	/**
-	 * Scans the worlds and create the tile sets.
+	 * Scans the worlds with a specified count of threads and create the tile sets.
 	 *
 	 * Returns false if a fatal error occured (for example unable to read a world)
 	 * and rendering the maps won't work.
 	 */
-	bool scanWorlds();
+	bool scanWorlds(int threads = 1);
 
 	/**
 	 * Renders a map/rotation with a specified count of threads and logs the progress to
@@ -156,12 +245,74 @@ public:
 	 */
 	bool run(int threads, bool batch);
 
+	/**
+	 * Renders all maps like the run method and then keeps watching the region files of
+	 * the worlds. Changed chunks are re-rendered as soon as no region file was changed for
+	 * the debounce time (in milliseconds). Returns only if an error occured.
+	 */
+	bool watch(int threads, bool batch, int debounce_ms);
+
 	/**
 	 * Returns which maps with which rotations need to get rendered.
 	 */
 	const std::vector<std::pair<std::string, std::set<RenderRotation::Direction> > >& getRequiredMaps() const;
 
 private:
+	/**
+	 * Loads a world, returns null if the world can't be loaded or isn't supported.
+	 */
+	std::shared_ptr<mc::World> loadWorld(const std::string& world_name) const;
+
+	/**
+	 * Renders the required maps/rotations and outputs some progress information.
+	 */
+	void renderRequiredMaps(int threads, bool batch);
+
+	/**
+	 * Writes the collected render profiles to profile.json if they are written as json.
+	 */
+	void writeRenderProfiles() const;
+
+	/**
+	 * A map/rotation whose render work was handed to the render threads.
+	 */
+	struct MapRender {
+		std::string map;
+		RenderRotation::Direction rotation;
+		int threads;
+
+		std::shared_ptr<RenderView> render_view;
+		std::shared_ptr<BlockImages> block_images;
+		RenderContext context;
+
+		// the job on the render threads, null if the map was rendered by a single thread
+		std::shared_ptr<thread::RenderJob> job;
+		std::chrono::steady_clock::time_point dispatch_start;
+	};
+
+	/**
+	 * Prepares rendering a map/rotation (scans the required tiles, loads the block images,
+	 * creates the render context). Returns null if there is nothing to render.
+	 */
+	std::shared_ptr<MapRender> prepareRenderMap(const std::string& map,
+			RenderRotation::Direction rotation, int threads);
+
+	/**
+	 * Prepares rotations of a map and starts rendering them. With multiple threads the
+	 * render work is just submitted to the render threads (all rotations together if
+	 * rotations are interleaved) and the rendering has to be completed with
+	 * finishRenderMap.
+	 */
+	std::vector<std::shared_ptr<MapRender> > startRenderMap(const std::string& map,
+			const std::set<RenderRotation::Direction>& rotations, int threads,
+			util::IProgressHandler* progress);
+
+	/**
+	 * Waits until started map/rotations are rendered and updates the web config/profiles.
+	 */
+	void finishRenderMap(std::vector<std::shared_ptr<MapRender> >& renders);
+	void finishRenderMap(MapRender& render);
+
 	/**
 	 * Copies a file from the template directory to the output directory and replaces the
 	 * variables from the map (every "{key}" in the file becomes "value").
@@ -194,24 +345,38 @@ private:
 	/**
 	 * Increases the max zoom level of a map (given as directory, the one with base.png).
 	 */
-	void increaseMaxZoom(const fs::path& dir, std::string image_format,
-			int jpeg_quality = 85) const;
+	void increaseMaxZoom(const fs::path& dir, const config::MapSection& map_config) const;
 
 	config::MapcrafterConfig config;
 	config::WebConfig web_config;
 
 	RenderBehaviors render_behaviors;
+	RenderProfiling render_profiling;
+	bool interleave_rotations;
+	RenderShard render_shard;
+	// the render profiles of the maps/rotations, if they are written as json
+	picojson::array render_profiles;
 
 	// time when we started scanning the worlds, used as last last render time of the maps
 	std::time_t time_started_scanning;
 	// set of initialized maps, initializeMap-method must be called for each map,
 	// this is automatically done by the renderMap-method
 	std::set<std::string> map_initialized;
+	// whether the required tiles of the tile sets are already set (when watching the worlds)
+	// and the maps are rendered without scanning the required tiles again
+	bool use_required_tiles;
 
-	// maps for world- and tile set objects
-	std::map<std::string, std::array<std::shared_ptr<mc::World>, 4> > worlds;
+	// maps for world- and tile set objects,
+	// a world object is shared by all tile sets of the world
+	std::map<std::string, std::shared_ptr<mc::World> > worlds;
 	// (world, render view, rotation) -> tile set
 	std::map<config::TileSetID, std::shared_ptr<TileSet> > tile_sets;
+	// block state registry of each map, it is shared by the rotations of a map
+	// so the render threads can keep their world caches between the rotations
+	std::map<std::string, std::shared_ptr<mc::BlockStateRegistry> > block_registries;
+
+	// the render threads, they are kept running for all maps/rotations
+	std::shared_ptr<thread::MultiThreadingDispatcher> render_threads;
 
 	// all required (= not skipped) maps and rotations
 	// as pair (map name, required rotations)
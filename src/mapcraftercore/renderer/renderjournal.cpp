@@ -0,0 +1,218 @@
+/*
+ * Copyright 2012-2016 Moritz Hilscher
+ *
+ * This file is part of Mapcrafter.
+ *
+ * Mapcrafter is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mapcrafter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mapcrafter.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "renderjournal.h"
+
+#include "tilearchive.h"
+#include "../config.h"
+#include "../util.h"
+
+#include <cstring>
+#include <fstream>
+
+#ifdef HAVE_UNISTD_H
+#  include <unistd.h>
+#endif
+
+namespace mapcrafter {
+namespace renderer {
+
+namespace {
+
+const char JOURNAL_MAGIC[8] = {'M', 'C', 'J', 'O', 'U', 'R', 'N', 'L'};
+
+// the pending tiles are written after this count of tiles or seconds
+const size_t SYNC_TILES = 1024;
+const int SYNC_SECONDS = 10;
+// or after this count of seconds with a tile archive, as its whole index is written then
+const int SYNC_ARCHIVE_SECONDS = 60;
+
+// the header: magic, started (int64), depth, tile offset x/y (int32), 4 reserved bytes,
+// all numbers are stored in big endian
+const size_t HEADER_SIZE = 32;
+
+struct JournalHeader {
+	char magic[8];
+	int64_t started;
+	int32_t depth;
+	int32_t tile_offset_x, tile_offset_y;
+};
+
+void writeHeader(const JournalHeader& header, char* data) {
+	std::memset(data, 0, HEADER_SIZE);
+	int64_t started = util::bigEndian64(header.started);
+	int32_t depth = util::bigEndian32(header.depth);
+	int32_t tile_offset_x = util::bigEndian32(header.tile_offset_x);
+	int32_t tile_offset_y = util::bigEndian32(header.tile_offset_y);
+	std::memcpy(data, header.magic, 8);
+	std::memcpy(data + 8, &started, 8);
+	std::memcpy(data + 16, &depth, 4);
+	std::memcpy(data + 20, &tile_offset_x, 4);
+	std::memcpy(data + 24, &tile_offset_y, 4);
+}
+
+void readHeader(const char* data, JournalHeader& header) {
+	std::memcpy(header.magic, data, 8);
+	std::memcpy(&header.started, data + 8, 8);
+	std::memcpy(&header.depth, data + 16, 4);
+	std::memcpy(&header.tile_offset_x, data + 20, 4);
+	std::memcpy(&header.tile_offset_y, data + 24, 4);
+	header.started = util::bigEndian64(header.started);
+	header.depth = util::bigEndian32(header.depth);
+	header.tile_offset_x = util::bigEndian32(header.tile_offset_x);
+	header.tile_offset_y = util::bigEndian32(header.tile_offset_y);
+}
+
+}
+
+RenderJournal::RenderJournal(const fs::path& filename)
+	: filename(filename), file(nullptr) {
+}
+
+RenderJournal::~RenderJournal() {
+	thread_ns::unique_lock<thread_ns::mutex> lock(mutex);
+	if (file != nullptr) {
+		syncLocked();
+		std::fclose(file);
+	}
+}
+
+bool RenderJournal::read(const TileSet& tile_set, std::time_t& started,
+		std::vector<TilePath>& tiles) const {
+	std::ifstream in(filename.string().c_str(), std::ios::binary);
+	if (!in)
+		return false;
+
+	char data[HEADER_SIZE];
+	JournalHeader header;
+	if (!in.read(data, HEADER_SIZE)) {
+		LOG(WARNING) << "Ignoring invalid render journal " << filename << ".";
+		return false;
+	}
+	readHeader(data, header);
+	if (std::memcmp(header.magic, JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC)) != 0) {
+		LOG(WARNING) << "Ignoring invalid render journal " << filename << ".";
+		return false;
+	}
+	// the tile paths are only valid if the tile set has still the same layout
+	if (header.depth != tile_set.getDepth()
+			|| header.tile_offset_x != tile_set.getTileOffset().getX()
+			|| header.tile_offset_y != tile_set.getTileOffset().getY())
+		return false;
+
+	started = header.started;
+	tiles.clear();
+	// a tile key only partly written when the rendering was interrupted is ignored
+	uint64_t key;
+	while (in.read(reinterpret_cast<char*>(&key), sizeof(key)))
+		tiles.push_back(TilePath::byKey(util::bigEndian64(key)));
+	return true;
+}
+
+bool RenderJournal::open(const TileSet& tile_set, std::time_t started, bool resume) {
+	thread_ns::unique_lock<thread_ns::mutex> lock(mutex);
+	if (file != nullptr)
+		std::fclose(file);
+	pending.clear();
+	last_sync = std::chrono::steady_clock::now();
+
+	boost::system::error_code error;
+	fs::create_directories(filename.parent_path(), error);
+	if (resume) {
+		// cut off a tile key only partly written when the rendering was interrupted,
+		// the new tile keys would be misaligned otherwise
+		uintmax_t size = fs::file_size(filename, error);
+		if (!error && size > HEADER_SIZE && (size - HEADER_SIZE) % sizeof(uint64_t) != 0)
+			fs::resize_file(filename, size - (size - HEADER_SIZE) % sizeof(uint64_t), error);
+		if (error) {
+			LOG(WARNING) << "Unable to open render journal " << filename << ".";
+			return false;
+		}
+	}
+	file = std::fopen(filename.string().c_str(), resume ? "ab" : "wb");
+	if (file == nullptr) {
+		LOG(WARNING) << "Unable to open render journal " << filename << ".";
+		return false;
+	}
+	if (!resume) {
+		JournalHeader header;
+		std::memcpy(header.magic, JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC));
+		header.started = started;
+		header.depth = tile_set.getDepth();
+		header.tile_offset_x = tile_set.getTileOffset().getX();
+		header.tile_offset_y = tile_set.getTileOffset().getY();
+		char data[HEADER_SIZE];
+		writeHeader(header, data);
+		std::fwrite(data, HEADER_SIZE, 1, file);
+		syncLocked();
+	}
+	return true;
+}
+
+void RenderJournal::setTileArchive(std::shared_ptr<TileArchive> tile_archive) {
+	thread_ns::unique_lock<thread_ns::mutex> lock(mutex);
+	this->tile_archive = tile_archive;
+}
+
+void RenderJournal::add(const TilePath& tile) {
+	thread_ns::unique_lock<thread_ns::mutex> lock(mutex);
+	if (file == nullptr)
+		return;
+	pending.push_back(util::bigEndian64(tile.getKey()));
+	std::chrono::steady_clock::duration since_sync = std::chrono::steady_clock::now() - last_sync;
+	if (tile_archive ? since_sync >= std::chrono::seconds(SYNC_ARCHIVE_SECONDS)
+			: (pending.size() >= SYNC_TILES || since_sync >= std::chrono::seconds(SYNC_SECONDS)))
+		syncLocked();
+}
+
+void RenderJournal::sync() {
+	thread_ns::unique_lock<thread_ns::mutex> lock(mutex);
+	syncLocked();
+}
+
+void RenderJournal::remove() {
+	thread_ns::unique_lock<thread_ns::mutex> lock(mutex);
+	if (file != nullptr) {
+		std::fclose(file);
+		file = nullptr;
+	}
+	pending.clear();
+	boost::system::error_code error;
+	fs::remove(filename, error);
+}
+
+void RenderJournal::syncLocked() {
+	last_sync = std::chrono::steady_clock::now();
+	if (file == nullptr)
+		return;
+	// the tiles must be in the index of the archive on disk before they are in the
+	// journal, they are written with the next batch if the index can't be written
+	if (!pending.empty() && tile_archive && !tile_archive->flush())
+		return;
+	if (!pending.empty())
+		std::fwrite(pending.data(), sizeof(uint64_t), pending.size(), file);
+	pending.clear();
+	std::fflush(file);
+#ifdef HAVE_UNISTD_H
+	fsync(fileno(file));
+#endif
+}
+
+}
+}
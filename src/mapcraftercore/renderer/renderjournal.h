@@ -0,0 +1,109 @@
+/*
+ * Copyright 2012-2016 Moritz Hilscher
+ *
+ * This file is part of Mapcrafter.
+ *
+ * Mapcrafter is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mapcrafter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mapcrafter.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RENDERJOURNAL_H_
+#define RENDERJOURNAL_H_
+
+#include "tileset.h"
+#include "../compat/thread.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <memory>
+#include <vector>
+#include <boost/filesystem.hpp>
+
+namespace fs = boost::filesystem;
+
+namespace mapcrafter {
+namespace renderer {
+
+class TileArchive;
+
+/**
+ * A journal of the composite tiles of a map/rotation which are already rendered, so an
+ * interrupted rendering can be resumed without rendering these tiles again.
+ *
+ * The journal file starts with a header (the time when the rendering was started, the
+ * zoom level and tile offset of the tile set) followed by the 64 bit keys of the
+ * rendered tile paths. The tiles are written and synced to disk in batches.
+ *
+ * If the tiles are stored in a tile archive, the index of the archive is written and
+ * synced before every batch of tiles (then a batch every minute), so the journal never
+ * has tiles which are missing in the index of the archive when the rendering is
+ * interrupted.
+ */
+class RenderJournal {
+public:
+	RenderJournal(const fs::path& filename);
+	~RenderJournal();
+
+	/**
+	 * Reads the journal of an interrupted rendering of a tile set. Returns false if there
+	 * is no journal or it belongs to a tile set with a different zoom level/tile offset.
+	 *
+	 * The time the interrupted rendering was started and its rendered tiles are returned.
+	 */
+	bool read(const TileSet& tile_set, std::time_t& started, std::vector<TilePath>& tiles) const;
+
+	/**
+	 * Opens the journal to add the tiles of a rendering of a tile set. A journal read
+	 * before is continued, otherwise a new journal is started with the given start time.
+	 */
+	bool open(const TileSet& tile_set, std::time_t started, bool resume);
+
+	/**
+	 * Sets the tile archive the rendered tiles are stored in (may be null).
+	 */
+	void setTileArchive(std::shared_ptr<TileArchive> tile_archive);
+
+	/**
+	 * Adds a composite tile which is rendered completely (including its children).
+	 * This method is thread-safe.
+	 */
+	void add(const TilePath& tile);
+
+	/**
+	 * Writes the pending tiles to the journal file and syncs it to disk.
+	 */
+	void sync();
+
+	/**
+	 * Removes the journal after the rendering is finished.
+	 */
+	void remove();
+
+private:
+	void syncLocked();
+
+	fs::path filename;
+	std::FILE* file;
+	std::shared_ptr<TileArchive> tile_archive;
+
+	thread_ns::mutex mutex;
+	std::vector<uint64_t> pending;
+	std::chrono::steady_clock::time_point last_sync;
+};
+
+}
+}
+
+#endif /* RENDERJOURNAL_H_ */
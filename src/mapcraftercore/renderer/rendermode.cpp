@@ -29,6 +29,7 @@
 #include "../config/configsections/map.h"
 #include "../config/configsections/world.h"
 #include "../mc/chunk.h"
+#include "../mc/chunkneighborhood.h"
 #include "../mc/pos.h"
 #include "../mc/world.h"
 #include "../util.h"
@@ -42,19 +43,19 @@ namespace renderer {
 
 BaseRenderMode::BaseRenderMode()
 	: images(nullptr), block_images(nullptr), world(nullptr),
-	current_chunk(nullptr) {
+	neighborhood(nullptr) {
 }
 
 BaseRenderMode::~BaseRenderMode() {
 }
 
 void BaseRenderMode::initialize(const RenderView* render_view,
-		BlockImages* images, mc::WorldCache* world, mc::Chunk** current_chunk) {
+		BlockImages* images, mc::WorldCache* world, const mc::ChunkNeighborhood* neighborhood) {
 	this->images = images;
 	this->block_images = dynamic_cast<RenderedBlockImages*>(images);
 	assert(this->block_images != nullptr);
 	this->world = world;
-	this->current_chunk = current_chunk;
+	this->neighborhood = neighborhood;
 }
 
 void BaseRenderMode::draw(RGBAImage& image, const BlockImage& block_image,
@@ -62,7 +63,7 @@ void BaseRenderMode::draw(RGBAImage& image, const BlockImage& block_image,
 }
 
 mc::Block BaseRenderMode::getBlock(const mc::BlockPos& pos, int get) {
-	return world->getBlock(pos, *current_chunk, get);
+	return neighborhood->getBlock(pos, get);
 }
 
 MultiplexingRenderMode::~MultiplexingRenderMode() {
@@ -75,9 +76,9 @@ void MultiplexingRenderMode::addRenderMode(RenderMode* render_mode) {
 }
 
 void MultiplexingRenderMode::initialize(const RenderView* render_view,
-		BlockImages* images, mc::WorldCache* world, mc::Chunk** current_chunk) {
+		BlockImages* images, mc::WorldCache* world, const mc::ChunkNeighborhood* neighborhood) {
 	for (auto it = render_modes.begin(); it != render_modes.end(); ++it)
-		(*it)->initialize(render_view, images, world, current_chunk);
+		(*it)->initialize(render_view, images, world, neighborhood);
 }
 
 bool MultiplexingRenderMode::isHidden(const mc::BlockPos& pos, const BlockImage& block_image) {
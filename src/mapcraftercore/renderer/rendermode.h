@@ -42,6 +42,7 @@ namespace mc {
 struct Block;
 class BlockPos;
 class Chunk;
+class ChunkNeighborhood;
 }
 
 namespace renderer {
@@ -59,14 +60,15 @@ public:
 
 	/**
 	 * Sets stuff (block images and world cache) that is required for the render mode
-	 * to operate. There is a pointer to the current chunk that is used by the tile
-	 * renderer, that way you (mostly) don't need to access the world cache.
+	 * to operate. There is a pointer to the chunk neighborhood of the current chunk
+	 * that is used by the tile renderer, that way you (mostly) don't need to access
+	 * the world cache.
 	 *
 	 * The render view is required because some render modes need render view specific
 	 * methods to modify the block images.
 	 */
 	virtual void initialize(const RenderView* render_view, BlockImages* images,
-			mc::WorldCache* world, mc::Chunk** current_chunk) = 0;
+			mc::WorldCache* world, const mc::ChunkNeighborhood* neighborhood) = 0;
 
 	/**
 	 * This method is called by the tile renderer to check if a block should be hidden.
@@ -83,8 +85,8 @@ public:
 
 /**
  * The base render mode class already implements handling of the initialize-method and
- * some other stuff (a comfortable getBlock-method that takes the current_chunk into
- * account).
+ * some other stuff (a comfortable getBlock-method that uses the chunk neighborhood of
+ * the current chunk).
  */
 class BaseRenderMode : public RenderMode {
 public:
@@ -96,7 +98,7 @@ public:
 	 * renderer with the render view.
 	 */
 	virtual void initialize(const RenderView* render_view, BlockImages* images,
-			mc::WorldCache* world, mc::Chunk** current_chunk);
+			mc::WorldCache* world, const mc::ChunkNeighborhood* neighborhood);
 
 	/**
 	 * Dummy implementation of interface method.
@@ -109,7 +111,7 @@ protected:
 	BlockImages* images;
 	RenderedBlockImages* block_images;
 	mc::WorldCache* world;
-	mc::Chunk** current_chunk;
+	const mc::ChunkNeighborhood* neighborhood;
 };
 
 /**
@@ -129,7 +131,7 @@ public:
 	 * Passes the supplied render data to the render modes.
 	 */
 	virtual void initialize(const RenderView* render_view, BlockImages* images,
-			mc::WorldCache* world, mc::Chunk** current_chunk);
+			mc::WorldCache* world, const mc::ChunkNeighborhood* neighborhood);
 
 	/**
 	 * Calls this method of each render mode and returns true if one render mode returns
@@ -22,6 +22,7 @@
 #include "../blockimages.h"
 #include "../image.h"
 #include "../../mc/chunk.h"
+#include "../../mc/chunkneighborhood.h"
 #include "../../mc/pos.h"
 #include "../../util.h"
 
@@ -79,7 +80,7 @@ uint8_t LightingData::getLightLevel(bool day) const {
 }
 
 LightingData LightingData::estimate(const mc::Block& block,
-		RenderedBlockImages* block_images, mc::WorldCache* world, mc::Chunk* current_chunk) {
+		RenderedBlockImages* block_images, const mc::ChunkNeighborhood& neighborhood) {
 	// estimate the light if this is a special block
 	if (!block_images->getBlockImage(block.id).has_faulty_lighting) {
 		return LightingData(block.block_light, block.sky_light);
@@ -91,8 +92,7 @@ LightingData LightingData::estimate(const mc::Block& block,
 	mc::BlockDir off(0, 0, 0);
 	mc::Block above;
 	while (++off.y) {
-		above = world->getBlock(block.pos + off, current_chunk,
-				mc::GET_ID | mc::GET_SKY_LIGHT);
+		above = neighborhood.getBlock(block.pos + off, mc::GET_ID | mc::GET_SKY_LIGHT);
 		const BlockImage& above_block = block_images->getBlockImage(above.id);
 		if (above_block.has_faulty_lighting) {
 			continue;
@@ -111,8 +111,8 @@ LightingData LightingData::estimate(const mc::Block& block,
 	for (int dx = -1; dx <= 1; dx++)
 		for (int dz = -1; dz <= 1; dz++)
 			for (int dy = -1; dy <= 1; dy++) {
-				mc::Block other = world->getBlock(block.pos + mc::BlockDir(dx, dz, dy),
-						current_chunk, mc::GET_ID | mc::GET_BLOCK_LIGHT);
+				mc::Block other = neighborhood.getBlock(block.pos + mc::BlockDir(dx, dz, dy),
+						mc::GET_ID | mc::GET_BLOCK_LIGHT);
 				const BlockImage& other_block = block_images->getBlockImage(other.id);
 				if ((other_block.is_empty || other_block.is_transparent)
 						&& !other_block.has_faulty_lighting) {
@@ -207,7 +207,7 @@ LightingColor LightingRenderMode::calculateLightingColor(const LightingData& lig
 
 LightingData LightingRenderMode::getBlockLight(const mc::BlockPos& pos) {
 	mc::Block block = getBlock(pos, mc::GET_ID | mc::GET_LIGHT);
-	LightingData light = LightingData::estimate(block, block_images, world, *current_chunk);
+	LightingData light = LightingData::estimate(block, block_images, *neighborhood);
 
 	// TODO also move this to LightingData class?
 	// lighting fix for The End
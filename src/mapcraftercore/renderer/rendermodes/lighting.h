@@ -76,7 +76,7 @@ public:
 	uint8_t getLightLevel(bool day) const;
 
 	static LightingData estimate(const mc::Block& block, RenderedBlockImages* block_images,
-			mc::WorldCache* world, mc::Chunk* current_chunk);
+			const mc::ChunkNeighborhood& neighborhood);
 
 protected:
 	uint8_t block_light, sky_light;
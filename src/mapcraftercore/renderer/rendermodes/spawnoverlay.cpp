@@ -35,7 +35,7 @@ RGBAPixel SpawnOverlay::getBlockColor(const mc::BlockPos& pos, uint16_t id, uint
 	// TODO more options
 	// TODO also mobs can't spawn on specific blocks?
 	mc::Block block = getBlock(pos, mc::GET_ID | mc::GET_LIGHT);
-	LightingData light = LightingData::estimate(block, block_images, world, *current_chunk);
+	LightingData light = LightingData::estimate(block, block_images, *neighborhood);
 	uint8_t light_level = light.getLightLevel(day);
 	if (light_level < 8)
 		return rgba(255, 0, 0, 85);
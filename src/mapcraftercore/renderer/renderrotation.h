@@ -121,6 +121,35 @@ class RenderRotation {
 	mc::BlockDir bottom;
 };
 
+/**
+ * @brief A rotation known at compile time, for code that is instantiated for every
+ * rotation. Does the same as RenderRotation, but without branching on the rotation.
+ */
+template <RenderRotation::Direction Rotation>
+struct StaticRenderRotation {
+	static constexpr mc::BlockDir rotate(const mc::BlockDir& dir) {
+		return Rotation == RenderRotation::TOP_RIGHT ? mc::BlockDir(+dir.z, -dir.x, dir.y)
+			: Rotation == RenderRotation::BOTTOM_RIGHT ? mc::BlockDir(-dir.x, -dir.z, dir.y)
+			: Rotation == RenderRotation::BOTTOM_LEFT ? mc::BlockDir(-dir.z, +dir.x, dir.y)
+			: dir;
+	}
+
+	static constexpr mc::BlockPos rotate(const mc::BlockPos& pos) {
+		return Rotation == RenderRotation::TOP_RIGHT ? mc::BlockPos(+pos.z, -pos.x, pos.y)
+			: Rotation == RenderRotation::BOTTOM_RIGHT ? mc::BlockPos(-pos.x, -pos.z, pos.y)
+			: Rotation == RenderRotation::BOTTOM_LEFT ? mc::BlockPos(-pos.z, +pos.x, pos.y)
+			: pos;
+	}
+
+	// All directions rotated
+	static constexpr mc::BlockDir getNorth() { return rotate(mc::BlockDir(0, -1, 0)); }
+	static constexpr mc::BlockDir getEast() { return rotate(mc::BlockDir(1, 0, 0)); }
+	static constexpr mc::BlockDir getSouth() { return rotate(mc::BlockDir(0, 1, 0)); }
+	static constexpr mc::BlockDir getWest() { return rotate(mc::BlockDir(-1, 0, 0)); }
+	static constexpr mc::BlockDir getTop() { return rotate(mc::BlockDir(0, 0, 1)); }
+	static constexpr mc::BlockDir getBottom() { return rotate(mc::BlockDir(0, 0, -1)); }
+};
+
 } /* namespace renderer */
 } /* namespace mapcrafter */
 
@@ -41,12 +41,9 @@ namespace renderer {
 
 namespace old {
 
-mc::ChunkPos TileTopBlockIterator::tile2Pos(int r, int c) const {
-	return tile2Pos(r, c, render_view->getRotation());
-}
-
-mc::ChunkPos TileTopBlockIterator::tile2Pos(int r, int c, const RenderRotation& rotation) {
-	switch (rotation.getRotation()) {
+template <RenderRotation::Direction Rotation>
+mc::ChunkPos TileTopBlockIterator<Rotation>::tile2Pos(int r, int c) {
+	switch (Rotation) {
 		default:
 		case RenderRotation::TOP_LEFT:
 			return mc::ChunkPos((+c - r) / 2, (+c + r) / 2);
@@ -59,43 +56,13 @@ mc::ChunkPos TileTopBlockIterator::tile2Pos(int r, int c, const RenderRotation&
 	}
 }
 
-int TileTopBlockIterator::pos2Row(const mc::BlockPos& pos) const {
-	switch(render_view->getRotation().getRotation()) {
-		default:
-		case RenderRotation::TOP_LEFT:
-			return - pos.x + pos.z;
-		case RenderRotation::TOP_RIGHT:
-			return + pos.x + pos.z;
-		case RenderRotation::BOTTOM_RIGHT:
-			return + pos.x - pos.z;
-		case RenderRotation::BOTTOM_LEFT:
-			return - pos.x - pos.z;
-	}
-}
-
-int TileTopBlockIterator::pos2Col(const mc::BlockPos& pos) const {
-	switch(render_view->getRotation().getRotation()) {
-		default:
-		case RenderRotation::TOP_LEFT:
-			return + pos.x + pos.z;
-		case RenderRotation::TOP_RIGHT:
-			return + pos.x - pos.z;
-		case RenderRotation::BOTTOM_RIGHT:
-			return - pos.x - pos.z;
-		case RenderRotation::BOTTOM_LEFT:
-			return - pos.x + pos.z;
-	}
-}
-
-TileTopBlockIterator::TileTopBlockIterator(const TilePos& tile, int block_size,
-		int tile_width, const RenderView* render_view)
-		: block_size(block_size), is_end(false), render_view(render_view) {
+template <RenderRotation::Direction Rotation>
+TileTopBlockIterator<Rotation>::TileTopBlockIterator(const TilePos& tile, int block_size,
+		int tile_width)
+		: block_size(block_size), is_end(false) {
 	// row/col 0,0 are the top left chunk of the tile 0,0
 	// each tile is four rows high, two columns wide
 
-	tile_dir = render_view->getRotation().rotate(mc::DIR_SOUTH);
-	tile_rewind = render_view->getRotation().rotate(mc::DIR_NORTH + mc::DIR_WEST);
-
 	// at first get the chunk, whose row and column is at the top right of the tile
 	// top right chunk of a tile is the top left chunk of the tile x+1,y
 	mc::ChunkPos topright_chunk = tile2Pos(
@@ -123,15 +90,17 @@ TileTopBlockIterator::TileTopBlockIterator(const TilePos& tile, int block_size,
 	draw_y = relrow * block_size / 4 - block_size / 2;
 }
 
-TileTopBlockIterator::~TileTopBlockIterator() {
+template <RenderRotation::Direction Rotation>
+TileTopBlockIterator<Rotation>::~TileTopBlockIterator() {
 }
 
-void TileTopBlockIterator::next() {
+template <RenderRotation::Direction Rotation>
+void TileTopBlockIterator<Rotation>::next() {
 	if (is_end)
 		return;
 
 	// go one block to bottom right (z+1)
-	current += tile_dir;
+	current += StaticRotation::getSouth();
 
 	int absrow = pos2Row(current);
 	int abscol = pos2Col(current);
@@ -139,14 +108,14 @@ void TileTopBlockIterator::next() {
 	// check if row/col is too big
 	if (abscol >= max_col || absrow >= max_row) {
 		// move the top one block to the left
-		top += tile_rewind;
+		top += StaticRotation::rotate(mc::BlockDir(-1, -1, 0));
 		// and set the current block to the top block
 		current = top;
 
 		// check if the current top block is out of the tile
 		if (pos2Col(current) < min_col) {
 			// then move it by a few blocks to bottom right
-			current += render_view->getRotation().rotate(mc::BlockDir(0, min_col - pos2Col(current) - 1, 0));
+			current += StaticRotation::rotate(mc::BlockDir(0, min_col - pos2Col(current) - 1, 0));
 		}
 
 		// Recalculate the row and col
@@ -163,7 +132,8 @@ void TileTopBlockIterator::next() {
 		is_end = true;
 }
 
-bool TileTopBlockIterator::end() const {
+template <RenderRotation::Direction Rotation>
+bool TileTopBlockIterator<Rotation>::end() const {
 	return is_end;
 }
 
@@ -183,11 +153,30 @@ int NewIsometricTileRenderer::getTileSize() const {
 	return images->getBlockSize() * 16 * tile_width;
 }
 
+void NewIsometricTileRenderer::renderTopBlocks(const TilePos& tile_pos, boost::container::vector<TileImage>& tile_images) {
+	switch (render_view->getRotation().getRotation()) {
+	default:
+	case RenderRotation::TOP_LEFT:
+		renderTopBlocks<RenderRotation::TOP_LEFT>(tile_pos, tile_images);
+		break;
+	case RenderRotation::TOP_RIGHT:
+		renderTopBlocks<RenderRotation::TOP_RIGHT>(tile_pos, tile_images);
+		break;
+	case RenderRotation::BOTTOM_RIGHT:
+		renderTopBlocks<RenderRotation::BOTTOM_RIGHT>(tile_pos, tile_images);
+		break;
+	case RenderRotation::BOTTOM_LEFT:
+		renderTopBlocks<RenderRotation::BOTTOM_LEFT>(tile_pos, tile_images);
+		break;
+	}
+}
+
+template <RenderRotation::Direction Rotation>
 void NewIsometricTileRenderer::renderTopBlocks(const TilePos& tile_pos, boost::container::vector<TileImage>& tile_images) {
 	int block_size = images->getBlockSize();
-	mc::BlockDir dir = render_view->getRotation().rotate(mc::DIR_NORTH + mc::DIR_EAST + mc::DIR_BOTTOM);
-	for (old::TileTopBlockIterator it(tile_pos, block_size, tile_width, render_view); !it.end(); it.next()) {
-		renderBlocks(it.getDrawX(), it.getDrawY(), it.getCurrentPos(), dir, tile_images);
+	const mc::BlockDir dir = StaticRenderRotation<Rotation>::rotate(mc::BlockDir(1, -1, -1));
+	for (old::TileTopBlockIterator<Rotation> it(tile_pos, block_size, tile_width); !it.end(); it.next()) {
+		renderBlocks<Rotation>(it.getDrawX(), it.getDrawY(), it.getCurrentPos(), dir, tile_images);
 	}
 }
 
@@ -39,10 +39,14 @@ namespace renderer {
 namespace old {
 
 /**
- * Iterates over the top blocks of a tile.
+ * Iterates over the top blocks of a tile. The rotation is a template parameter, so the
+ * row/column of the blocks is computed without branching on the rotation.
  */
+template <RenderRotation::Direction Rotation>
 class TileTopBlockIterator {
 private:
+	typedef StaticRenderRotation<Rotation> StaticRotation;
+
 	int block_size;
 
 	bool is_end;
@@ -51,19 +55,24 @@ private:
 	mc::BlockPos top;
 	mc::BlockPos current;
 
-	const RenderView* render_view;
 	int draw_x, draw_y;
 
-	mc::BlockDir tile_dir;
-	mc::BlockDir tile_rewind;
-
-	static mc::ChunkPos tile2Pos(int r, int c, const RenderRotation& rotation);
-	mc::ChunkPos tile2Pos(int r, int c) const;
-	int pos2Row(const mc::BlockPos& pos) const;
-	int pos2Col(const mc::BlockPos& pos) const;
+	static mc::ChunkPos tile2Pos(int r, int c);
+	static constexpr int pos2Row(const mc::BlockPos& pos) {
+		return Rotation == RenderRotation::TOP_RIGHT ? + pos.x + pos.z
+			: Rotation == RenderRotation::BOTTOM_RIGHT ? + pos.x - pos.z
+			: Rotation == RenderRotation::BOTTOM_LEFT ? - pos.x - pos.z
+			: - pos.x + pos.z;
+	}
+	static constexpr int pos2Col(const mc::BlockPos& pos) {
+		return Rotation == RenderRotation::TOP_RIGHT ? + pos.x - pos.z
+			: Rotation == RenderRotation::BOTTOM_RIGHT ? - pos.x - pos.z
+			: Rotation == RenderRotation::BOTTOM_LEFT ? - pos.x + pos.z
+			: + pos.x + pos.z;
+	}
 
 public:
-	TileTopBlockIterator(const TilePos& tile, int block_size, int tile_width, const RenderView* render_view);
+	TileTopBlockIterator(const TilePos& tile, int block_size, int tile_width);
 	~TileTopBlockIterator();
 
 	mc::BlockPos getCurrentPos() const { return current; };
@@ -91,6 +100,12 @@ public:
 
 protected:
 	virtual void renderTopBlocks(const TilePos& tile_pos, boost::container::vector<TileImage>& tile_images);
+
+	/**
+	 * Renders the top blocks of a tile, instantiated for every rotation.
+	 */
+	template <RenderRotation::Direction Rotation>
+	void renderTopBlocks(const TilePos& tile_pos, boost::container::vector<TileImage>& tile_images);
 };
 
 }
@@ -34,7 +34,7 @@ namespace {
 /**
  * Calculates the tiles a row and column covers.
  */
-void addRowColTiles(int row, int col, int tile_width, std::set<TilePos>& tiles) {
+void addRowColTiles(int row, int col, int tile_width, std::vector<TilePos>& tiles) {
 	// the tiles are 2 * TILE_WIDTH columns wide
 	// and 4 * TILE_WIDTH row tall
 	// calculate the approximate position of the tile
@@ -42,24 +42,24 @@ void addRowColTiles(int row, int col, int tile_width, std::set<TilePos>& tiles)
 	int y = std::floor((float) row / (4 * tile_width));
 
 	// add this tile
-	tiles.insert(TilePos(x, y));
+	tiles.push_back(TilePos(x, y));
 
 	// check if this row/col is on the border of two tiles
 	bool edge_col = col % (2 * tile_width) == 0;
 	bool edge_row = row % (4 * tile_width) == 0;
 	// if yes, we have to add the neighbor tiles
 	if (edge_col)
-		tiles.insert(TilePos(x-1, y));
+		tiles.push_back(TilePos(x-1, y));
 	if (edge_row)
-		tiles.insert(TilePos(x, y-1));
+		tiles.push_back(TilePos(x, y-1));
 	if (edge_col && edge_row)
-		tiles.insert(TilePos(x-1, y-1));
+		tiles.push_back(TilePos(x-1, y-1));
 }
 
 }
 
 void NewIsometricTileSet::mapChunkToTiles(const mc::ChunkPos& chunk,
-		std::set<TilePos>& tiles) {
+		std::vector<TilePos>& tiles) {
 	// at first get row and column of the top of the chunk
 	int row;
 	int col;
@@ -29,7 +29,7 @@ class NewIsometricTileSet : public TileSet {
 public:
 	NewIsometricTileSet(int tile_width, const RenderRotation& rotation);
 
-	virtual void mapChunkToTiles(const mc::ChunkPos& chunk, std::set<TilePos>& tiles);
+	virtual void mapChunkToTiles(const mc::ChunkPos& chunk, std::vector<TilePos>& tiles);
 };
 
 }
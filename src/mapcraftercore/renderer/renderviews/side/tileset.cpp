@@ -33,16 +33,16 @@ SideTileSet::~SideTileSet() {
 }
 
 void SideTileSet::mapChunkToTiles(const mc::ChunkPos& chunk,
-		std::set<TilePos>& tiles) {
+		std::vector<TilePos>& tiles) {
 	for (int i = mc::CHUNK_LOWEST; i < mc::CHUNK_HIGHEST; i++) {
 		// make sure we render towards -infinity
 		int x = std::floor((float) chunk.x / getTileWidth());
 		int y0 = std::floor((float) (chunk.z + mc::CHUNK_HIGHEST-i-1 + 1) / getTileWidth());
 		int y1 = std::floor((float) (chunk.z + mc::CHUNK_HIGHEST-i-1 + 0) / getTileWidth());
 		int y2 = std::floor((float) (chunk.z + mc::CHUNK_HIGHEST-i-1 - 1) / getTileWidth());
-		tiles.insert(TilePos(x, y0));
-		tiles.insert(TilePos(x, y1));
-		tiles.insert(TilePos(x, y2));
+		tiles.push_back(TilePos(x, y0));
+		tiles.push_back(TilePos(x, y1));
+		tiles.push_back(TilePos(x, y2));
 	}
 }
 
@@ -30,7 +30,7 @@ public:
 	SideTileSet(int tile_width, const RenderRotation& rotation);
 	virtual ~SideTileSet();
 
-	virtual void mapChunkToTiles(const mc::ChunkPos& chunk, std::set<TilePos>& tiles);
+	virtual void mapChunkToTiles(const mc::ChunkPos& chunk, std::vector<TilePos>& tiles);
 };
 
 }
@@ -23,6 +23,7 @@
 #include "../../blockimages.h"
 #include "../../image.h"
 #include "../../rendermode.h"
+#include "../../renderview.h"
 #include "../../tileset.h"
 #include "../../../mc/pos.h"
 #include "../../../mc/worldcache.h"
@@ -53,6 +54,25 @@ int TopdownTileRenderer::getTileSize() const {
 	return images->getBlockSize() * 16 * tile_width;
 }
 
+void TopdownTileRenderer::renderTopBlocks(const TilePos& tile_pos, boost::container::vector<TileImage>& tile_images) {
+	switch (render_view->getRotation().getRotation()) {
+	default:
+	case RenderRotation::TOP_LEFT:
+		renderTopBlocks<RenderRotation::TOP_LEFT>(tile_pos, tile_images);
+		break;
+	case RenderRotation::TOP_RIGHT:
+		renderTopBlocks<RenderRotation::TOP_RIGHT>(tile_pos, tile_images);
+		break;
+	case RenderRotation::BOTTOM_RIGHT:
+		renderTopBlocks<RenderRotation::BOTTOM_RIGHT>(tile_pos, tile_images);
+		break;
+	case RenderRotation::BOTTOM_LEFT:
+		renderTopBlocks<RenderRotation::BOTTOM_LEFT>(tile_pos, tile_images);
+		break;
+	}
+}
+
+template <RenderRotation::Direction Rotation>
 void TopdownTileRenderer::renderTopBlocks(const TilePos& tile_pos, boost::container::vector<TileImage>& tile_images) {
 	int block_size = images->getBlockSize();
 	for (int cx = 0; cx < tile_width; cx++) {
@@ -66,7 +86,7 @@ void TopdownTileRenderer::renderTopBlocks(const TilePos& tile_pos, boost::contai
 				for (int z = 0; z < 16; z++) {
 					int px = dx + x * block_size;
 					int py = dz + z * block_size;
-					renderBlocks(px, py, blockpos + mc::BlockDir(x, z, 0), mc::BlockDir(0, 0, -1), tile_images);
+					renderBlocks<Rotation>(px, py, blockpos + mc::BlockDir(x, z, 0), mc::BlockDir(0, 0, -1), tile_images);
 				}
 			}
 		}
@@ -39,6 +39,12 @@ public:
 
 protected:
 	virtual void renderTopBlocks(const TilePos& tile_pos, boost::container::vector<TileImage>& tile_images);
+
+	/**
+	 * Renders the top blocks of a tile, instantiated for every rotation.
+	 */
+	template <RenderRotation::Direction Rotation>
+	void renderTopBlocks(const TilePos& tile_pos, boost::container::vector<TileImage>& tile_images);
 };
 
 }
@@ -33,11 +33,11 @@ TopdownTileSet::~TopdownTileSet() {
 }
 
 void TopdownTileSet::mapChunkToTiles(const mc::ChunkPos& chunk,
-		std::set<TilePos>& tiles) {
+		std::vector<TilePos>& tiles) {
 	// make sure we render towards -infinity
 	int x = std::floor((float) chunk.x / getTileWidth());
 	int y = std::floor((float) chunk.z / getTileWidth());
-	tiles.insert(TilePos(x, y));
+	tiles.push_back(TilePos(x, y));
 }
 
 }
@@ -30,7 +30,7 @@ public:
 	TopdownTileSet(int tile_width, const RenderRotation& rotation);
 	virtual ~TopdownTileSet();
 
-	virtual void mapChunkToTiles(const mc::ChunkPos& chunk, std::set<TilePos>& tiles);
+	virtual void mapChunkToTiles(const mc::ChunkPos& chunk, std::vector<TilePos>& tiles);
 };
 
 }
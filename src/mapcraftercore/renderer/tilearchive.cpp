@@ -0,0 +1,362 @@
+/*
+ * Copyright 2012-2016 Moritz Hilscher
+ *
+ * This file is part of Mapcrafter.
+ *
+ * Mapcrafter is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mapcrafter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mapcrafter.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "tilearchive.h"
+
+#include "../config.h"
+#include "../util.h"
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+#ifdef HAVE_UNISTD_H
+#  include <fcntl.h>
+#  include <unistd.h>
+#endif
+
+namespace mapcrafter {
+namespace renderer {
+
+namespace {
+
+const char ARCHIVE_MAGIC[8] = {'M', 'C', 'T', 'I', 'L', 'E', 'S', 'A'};
+const int32_t ARCHIVE_VERSION = 1;
+
+// the index is written after this count of seconds while tiles are written
+const int FLUSH_SECONDS = 60;
+
+struct ArchiveHeader {
+	char magic[8];
+	int32_t version;
+	int32_t reserved;
+	int64_t index_offset;
+	int64_t index_count;
+};
+
+struct ArchiveIndexEntry {
+	int64_t key;
+	int64_t offset;
+	int32_t size;
+	int32_t reserved;
+};
+
+ArchiveHeader createHeader(uint64_t index_offset, uint64_t index_count) {
+	ArchiveHeader header;
+	std::memcpy(header.magic, ARCHIVE_MAGIC, sizeof(ARCHIVE_MAGIC));
+	header.version = util::bigEndian32(ARCHIVE_VERSION);
+	header.reserved = 0;
+	header.index_offset = util::bigEndian64(index_offset);
+	header.index_count = util::bigEndian64(index_count);
+	return header;
+}
+
+// syncs the written data of a file to disk, the file streams don't have a file descriptor
+// to sync, but syncing another file descriptor of the same file syncs the file as well
+bool syncFile(const fs::path& filename) {
+#ifdef HAVE_UNISTD_H
+	int fd = ::open(filename.string().c_str(), O_RDONLY);
+	if (fd < 0)
+		return false;
+	bool ok = fsync(fd) == 0;
+	::close(fd);
+	return ok;
+#else
+	return true;
+#endif
+}
+
+}
+
+const std::string TileArchive::FILENAME = "tiles.archive";
+
+TileArchive::TileArchive(const fs::path& filename)
+	: filename(filename), end(0), unused(0), changed(false) {
+}
+
+TileArchive::~TileArchive() {
+	close();
+}
+
+bool TileArchive::open() {
+	thread_ns::unique_lock<thread_ns::mutex> lock(mutex);
+	if (file.is_open())
+		file.close();
+	index.clear();
+	changed = false;
+	last_flush = std::chrono::steady_clock::now();
+
+	if (!fs::exists(filename)) {
+		boost::system::error_code error;
+		fs::create_directories(filename.parent_path(), error);
+		std::ofstream out(filename.string().c_str(), std::ios::binary);
+		ArchiveHeader header = createHeader(0, 0);
+		out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		if (!out) {
+			LOG(ERROR) << "Unable to create tile archive " << filename << ".";
+			return false;
+		}
+	}
+
+	file.open(filename.string().c_str(), std::ios::in | std::ios::out | std::ios::binary);
+	if (!file) {
+		LOG(ERROR) << "Unable to open tile archive " << filename << ".";
+		return false;
+	}
+
+	ArchiveHeader header;
+	std::vector<ArchiveIndexEntry> entries;
+	if (file.read(reinterpret_cast<char*>(&header), sizeof(header))
+			&& std::memcmp(header.magic, ARCHIVE_MAGIC, sizeof(ARCHIVE_MAGIC)) == 0
+			&& util::bigEndian32(header.version) == ARCHIVE_VERSION) {
+		entries.resize(util::bigEndian64(header.index_count));
+		file.seekg(util::bigEndian64(header.index_offset));
+		if (!entries.empty())
+			file.read(reinterpret_cast<char*>(&entries[0]),
+					entries.size() * sizeof(ArchiveIndexEntry));
+	}
+	if (!file) {
+		LOG(ERROR) << "Invalid tile archive " << filename << ".";
+		file.close();
+		return false;
+	}
+
+	file.seekg(0, std::ios::end);
+	end = file.tellg();
+	uint64_t used = sizeof(header);
+	index.reserve(entries.size());
+	for (auto it = entries.begin(); it != entries.end(); ++it) {
+		Entry& entry = index[util::bigEndian64(it->key)];
+		entry.offset = util::bigEndian64(it->offset);
+		entry.size = util::bigEndian32(it->size);
+		used += entry.size;
+	}
+	unused = end - used;
+	return true;
+}
+
+bool TileArchive::flush() {
+	thread_ns::unique_lock<thread_ns::mutex> lock(mutex);
+	return flushLocked();
+}
+
+bool TileArchive::close() {
+	thread_ns::unique_lock<thread_ns::mutex> lock(mutex);
+	if (!file.is_open())
+		return true;
+	bool ok = flushLocked();
+	if (ok && unused * 2 > end)
+		ok = compact();
+	file.close();
+	return ok;
+}
+
+bool TileArchive::hasTile(const TilePath& tile) const {
+	thread_ns::unique_lock<thread_ns::mutex> lock(mutex);
+	const Entry* entry = index.find(tile.getKey());
+	return entry != nullptr && entry->size > 0;
+}
+
+std::vector<TilePath> TileArchive::getTiles() const {
+	thread_ns::unique_lock<thread_ns::mutex> lock(mutex);
+	std::vector<uint64_t> keys;
+	index.forEach([&keys](uint64_t key, const Entry& entry) {
+		if (entry.size > 0)
+			keys.push_back(key);
+	});
+	std::sort(keys.begin(), keys.end());
+	std::vector<TilePath> tiles;
+	for (auto it = keys.begin(); it != keys.end(); ++it)
+		tiles.push_back(TilePath::byKey(*it));
+	return tiles;
+}
+
+bool TileArchive::readTile(const TilePath& tile, std::string& data) const {
+	thread_ns::unique_lock<thread_ns::mutex> lock(mutex);
+	const Entry* entry = index.find(tile.getKey());
+	if (!file.is_open() || entry == nullptr || entry->size == 0)
+		return false;
+	data.resize(entry->size);
+	file.seekg(entry->offset);
+	if (!file.read(&data[0], entry->size)) {
+		file.clear();
+		return false;
+	}
+	return true;
+}
+
+bool TileArchive::writeTile(const TilePath& tile, const std::string& data) {
+	thread_ns::unique_lock<thread_ns::mutex> lock(mutex);
+	if (!file.is_open())
+		return false;
+	// the image is appended, the old image is still used by the index of the header
+	file.seekp(end);
+	if (!file.write(data.data(), data.size())) {
+		file.clear();
+		return false;
+	}
+	Entry& entry = index[tile.getKey()];
+	unused += entry.size;
+	entry.offset = end;
+	entry.size = data.size();
+	end += data.size();
+	changed = true;
+
+	if (std::chrono::steady_clock::now() - last_flush >= std::chrono::seconds(FLUSH_SECONDS))
+		flushLocked();
+	return true;
+}
+
+void TileArchive::increaseDepth() {
+	thread_ns::unique_lock<thread_ns::mutex> lock(mutex);
+	TileHashMap<Entry> moved;
+	moved.reserve(index.size());
+	uint64_t& unused = this->unused;
+	index.forEach([&moved, &unused](uint64_t key, const Entry& entry) {
+		TilePath tile = TilePath::byKey(key);
+		if (tile.getDepth() == 0) {
+			unused += entry.size;
+			return;
+		}
+		std::vector<int> path = tile.getPath();
+		TilePath moved_tile = TilePath() + path[0] + (5 - path[0]);
+		for (size_t i = 1; i < path.size(); i++)
+			moved_tile += path[i];
+		moved[moved_tile.getKey()] = entry;
+	});
+	index = moved;
+	changed = true;
+}
+
+bool TileArchive::flushLocked() {
+	last_flush = std::chrono::steady_clock::now();
+	if (!file.is_open() || !changed)
+		return true;
+
+	std::vector<std::pair<uint64_t, Entry> > tiles;
+	index.forEach([&tiles](uint64_t key, const Entry& entry) {
+		if (entry.size > 0)
+			tiles.push_back(std::make_pair(key, entry));
+	});
+	std::sort(tiles.begin(), tiles.end(),
+			[](const std::pair<uint64_t, Entry>& a, const std::pair<uint64_t, Entry>& b) {
+		return a.first < b.first;
+	});
+	std::vector<ArchiveIndexEntry> entries(tiles.size());
+	for (size_t i = 0; i < tiles.size(); i++) {
+		entries[i].key = util::bigEndian64(tiles[i].first);
+		entries[i].offset = util::bigEndian64(tiles[i].second.offset);
+		entries[i].size = util::bigEndian32(tiles[i].second.size);
+		entries[i].reserved = 0;
+	}
+
+	// the new index is written after the images, then the header points to it
+	file.seekp(end);
+	if (!entries.empty())
+		file.write(reinterpret_cast<const char*>(&entries[0]),
+				entries.size() * sizeof(ArchiveIndexEntry));
+	// (the index must be on disk before the header points to it)
+	file.flush();
+	bool synced = syncFile(filename);
+	ArchiveHeader header = createHeader(end, entries.size());
+	file.seekp(0);
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	file.flush();
+	synced = synced && syncFile(filename);
+	if (!file || !synced) {
+		LOG(ERROR) << "Unable to write the index of tile archive " << filename << ".";
+		file.clear();
+		return false;
+	}
+
+	// images are appended after the index, it's unused as soon as the index is written again
+	uint64_t index_size = entries.size() * sizeof(ArchiveIndexEntry);
+	end += index_size;
+	unused += index_size;
+	changed = false;
+	return true;
+}
+
+bool TileArchive::compact() {
+	fs::path temp_filename = filename.string() + ".tmp";
+	std::ofstream out(temp_filename.string().c_str(), std::ios::binary);
+	ArchiveHeader header = createHeader(0, 0);
+	out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+	std::vector<std::pair<uint64_t, Entry> > tiles;
+	index.forEach([&tiles](uint64_t key, const Entry& entry) {
+		if (entry.size > 0)
+			tiles.push_back(std::make_pair(key, entry));
+	});
+	// the images are written in the order of their tile paths
+	std::sort(tiles.begin(), tiles.end(),
+			[](const std::pair<uint64_t, Entry>& a, const std::pair<uint64_t, Entry>& b) {
+		return a.first < b.first;
+	});
+
+	uint64_t offset = sizeof(header);
+	std::string data;
+	std::vector<ArchiveIndexEntry> entries(tiles.size());
+	for (size_t i = 0; i < tiles.size() && out; i++) {
+		data.resize(tiles[i].second.size);
+		file.seekg(tiles[i].second.offset);
+		if (!file.read(&data[0], data.size()))
+			break;
+		out.write(data.data(), data.size());
+		entries[i].key = util::bigEndian64(tiles[i].first);
+		entries[i].offset = util::bigEndian64(offset);
+		entries[i].size = util::bigEndian32(data.size());
+		entries[i].reserved = 0;
+		offset += data.size();
+	}
+	if (!entries.empty())
+		out.write(reinterpret_cast<const char*>(&entries[0]),
+				entries.size() * sizeof(ArchiveIndexEntry));
+	header = createHeader(offset, entries.size());
+	out.seekp(0);
+	out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	out.close();
+
+	boost::system::error_code error;
+	if (!file || !out || !syncFile(temp_filename)) {
+		LOG(WARNING) << "Unable to compact tile archive " << filename << ".";
+		file.clear();
+		fs::remove(temp_filename, error);
+		return false;
+	}
+	file.close();
+	fs::rename(temp_filename, filename, error);
+	if (error) {
+		LOG(WARNING) << "Unable to compact tile archive " << filename << ".";
+		fs::remove(temp_filename, error);
+	}
+	file.open(filename.string().c_str(), std::ios::in | std::ios::out | std::ios::binary);
+	if (!error) {
+		for (size_t i = 0; i < tiles.size(); i++) {
+			Entry& entry = *index.find(tiles[i].first);
+			entry.offset = util::bigEndian64(entries[i].offset);
+		}
+		end = offset + entries.size() * sizeof(ArchiveIndexEntry);
+		unused = entries.size() * sizeof(ArchiveIndexEntry);
+	}
+	return !error;
+}
+
+}
+}
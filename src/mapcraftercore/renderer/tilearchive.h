@@ -0,0 +1,128 @@
+/*
+ * Copyright 2012-2016 Moritz Hilscher
+ *
+ * This file is part of Mapcrafter.
+ *
+ * Mapcrafter is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mapcrafter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mapcrafter.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TILEARCHIVE_H_
+#define TILEARCHIVE_H_
+
+#include "tilehashmap.h"
+#include "tileset.h"
+#include "../compat/thread.h"
+
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <boost/filesystem.hpp>
+
+namespace fs = boost::filesystem;
+
+namespace mapcrafter {
+namespace renderer {
+
+/**
+ * A single file with all tile images of a map/rotation, used instead of a file per tile.
+ *
+ * The archive starts with a header (the position and size of the index), followed by
+ * the encoded tile images. The index with the 64 bit key, position and size of the image
+ * of every tile is at the end of the file. Images of updated tiles are appended, and
+ * the index is written again after them (every minute, before the render journal is
+ * synced and when the archive is closed), so the index in the header stays valid if the
+ * rendering is interrupted. The archive is compacted when it is closed and more than
+ * half of it is unused.
+ */
+class TileArchive {
+public:
+	// the name of the archive in the output directory of a map/rotation
+	static const std::string FILENAME;
+
+	TileArchive(const fs::path& filename);
+	~TileArchive();
+
+	/**
+	 * Opens the archive, a new archive is created if it doesn't exist yet.
+	 */
+	bool open();
+
+	/**
+	 * Writes the index of the archive and syncs the archive to disk.
+	 * This method is thread-safe.
+	 */
+	bool flush();
+
+	/**
+	 * Writes the index, compacts the archive if required and closes it.
+	 */
+	bool close();
+
+	/**
+	 * Returns whether the archive has an image of a tile.
+	 */
+	bool hasTile(const TilePath& tile) const;
+
+	/**
+	 * Returns the paths of all tiles in the archive, sorted by their keys.
+	 */
+	std::vector<TilePath> getTiles() const;
+
+	/**
+	 * Reads the encoded image of a tile.
+	 * This method is thread-safe.
+	 */
+	bool readTile(const TilePath& tile, std::string& data) const;
+
+	/**
+	 * Writes the encoded image of a tile, an existing image of the tile is replaced.
+	 * This method is thread-safe.
+	 */
+	bool writeTile(const TilePath& tile, const std::string& data);
+
+	/**
+	 * Moves the tiles one zoom level deeper in the same way as
+	 * RenderManager::increaseMaxZoom moves the tile files (the top level tile n becomes
+	 * n/5-n). The root tile is removed.
+	 */
+	void increaseDepth();
+
+private:
+	struct Entry {
+		uint64_t offset;
+		uint32_t size;
+
+		Entry() : offset(0), size(0) {}
+	};
+
+	bool flushLocked();
+	bool compact();
+
+	fs::path filename;
+	mutable std::fstream file;
+
+	mutable thread_ns::mutex mutex;
+	TileHashMap<Entry> index;
+	// end of the archive where images are appended, size of the unused parts
+	uint64_t end, unused;
+	bool changed;
+	std::chrono::steady_clock::time_point last_flush;
+};
+
+}
+}
+
+#endif /* TILEARCHIVE_H_ */
@@ -0,0 +1,198 @@
+/*
+ * Copyright 2012-2016 Moritz Hilscher
+ *
+ * This file is part of Mapcrafter.
+ *
+ * Mapcrafter is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mapcrafter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mapcrafter.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TILEHASHMAP_H_
+#define TILEHASHMAP_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace mapcrafter {
+namespace renderer {
+
+/**
+ * Hash map for the (up to millions of) tiles of a tile set. The tiles are identified by
+ * 64 bit keys (see TilePos::getKey() and TilePath::getKey()).
+ *
+ * Keys and values are stored in flat arrays with open addressing (linear probing), so
+ * there is no allocation per tile and no pointer chasing like with std::map/std::set.
+ * Tiles can't be removed, only the whole map can be cleared. The key ~0 is reserved to
+ * mark empty slots.
+ */
+template <typename Value>
+class TileHashMap {
+public:
+	static const uint64_t EMPTY_KEY = ~(uint64_t) 0;
+
+	TileHashMap() : count(0) {}
+
+	/**
+	 * Returns the count of tiles in the map.
+	 */
+	size_t size() const {
+		return count;
+	}
+
+	bool empty() const {
+		return count == 0;
+	}
+
+	/**
+	 * Removes all tiles, the allocated memory is kept.
+	 */
+	void clear() {
+		std::fill(keys.begin(), keys.end(), EMPTY_KEY);
+		std::fill(values.begin(), values.end(), Value());
+		count = 0;
+	}
+
+	/**
+	 * Makes sure that the specified count of tiles can be added without growing.
+	 */
+	void reserve(size_t size) {
+		size_t capacity = 16;
+		while (capacity / 2 < size)
+			capacity *= 2;
+		if (capacity > keys.size())
+			rehash(capacity);
+	}
+
+	bool contains(uint64_t key) const {
+		return !keys.empty() && keys[findSlot(key)] == key;
+	}
+
+	/**
+	 * Returns a pointer to the value of a tile, or nullptr if the tile doesn't exist.
+	 */
+	const Value* find(uint64_t key) const {
+		if (keys.empty())
+			return nullptr;
+		size_t slot = findSlot(key);
+		return keys[slot] == key ? &values[slot] : nullptr;
+	}
+
+	Value* find(uint64_t key) {
+		return const_cast<Value*>(static_cast<const TileHashMap*>(this)->find(key));
+	}
+
+	/**
+	 * Returns the value of a tile, a default value is inserted if the tile doesn't exist.
+	 */
+	Value& operator[](uint64_t key) {
+		return values[insertSlot(key)];
+	}
+
+	/**
+	 * Inserts a tile with a value. Returns false and doesn't change the value if the
+	 * tile already exists.
+	 */
+	bool insert(uint64_t key, const Value& value = Value()) {
+		size_t old_count = count;
+		size_t slot = insertSlot(key);
+		if (count == old_count)
+			return false;
+		values[slot] = value;
+		return true;
+	}
+
+	/**
+	 * Calls function(key, value) for every tile, in no specific order.
+	 */
+	template <typename Function>
+	void forEach(Function function) const {
+		for (size_t i = 0; i < keys.size(); i++)
+			if (keys[i] != EMPTY_KEY)
+				function(keys[i], values[i]);
+	}
+
+	template <typename Function>
+	void forEach(Function function) {
+		for (size_t i = 0; i < keys.size(); i++)
+			if (keys[i] != EMPTY_KEY)
+				function(keys[i], values[i]);
+	}
+
+private:
+	static size_t hash(uint64_t key) {
+		// finalizer of MurmurHash3, tile keys are far from random
+		key ^= key >> 33;
+		key *= 0xff51afd7ed558ccdULL;
+		key ^= key >> 33;
+		key *= 0xc4ceb9fe1a85ec53ULL;
+		key ^= key >> 33;
+		return key;
+	}
+
+	/**
+	 * Returns the slot of a key, or the empty slot where the key would be inserted.
+	 */
+	size_t findSlot(uint64_t key) const {
+		size_t mask = keys.size() - 1;
+		size_t slot = hash(key) & mask;
+		while (keys[slot] != key && keys[slot] != EMPTY_KEY)
+			slot = (slot + 1) & mask;
+		return slot;
+	}
+
+	size_t insertSlot(uint64_t key) {
+		// keep the load factor at most 1/2
+		if ((count + 1) * 2 > keys.size())
+			rehash(keys.empty() ? 16 : keys.size() * 2);
+		size_t slot = findSlot(key);
+		if (keys[slot] == EMPTY_KEY) {
+			keys[slot] = key;
+			count++;
+		}
+		return slot;
+	}
+
+	void rehash(size_t capacity) {
+		std::vector<uint64_t> old_keys(capacity, EMPTY_KEY);
+		std::vector<Value> old_values(capacity);
+		old_keys.swap(keys);
+		old_values.swap(values);
+		for (size_t i = 0; i < old_keys.size(); i++) {
+			if (old_keys[i] == EMPTY_KEY)
+				continue;
+			size_t slot = findSlot(old_keys[i]);
+			keys[slot] = old_keys[i];
+			values[slot] = old_values[i];
+		}
+	}
+
+	std::vector<uint64_t> keys;
+	std::vector<Value> values;
+	size_t count;
+};
+
+template <typename Value>
+const uint64_t TileHashMap<Value>::EMPTY_KEY;
+
+/**
+ * Set of tiles, a tile hash map without values.
+ */
+struct TileHashSetEmpty {};
+typedef TileHashMap<TileHashSetEmpty> TileHashSet;
+
+}
+}
+
+#endif /* TILEHASHMAP_H_ */
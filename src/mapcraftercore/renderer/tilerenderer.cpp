@@ -19,7 +19,8 @@
 
 #include "tilerenderer.h"
 
-#include <boost/range/algorithm/sort.hpp>
+#include <algorithm>
+#include <limits>
 
 #include "blockimages.h"
 #include "rendermode.h"
@@ -38,7 +39,7 @@ TileRenderer::TileRenderer(const RenderView* render_view, mc::BlockStateRegistry
 		block_registry(block_registry), images(images), block_images(dynamic_cast<RenderedBlockImages*>(images)),
 		tile_width(tile_width), world(world), current_chunk(nullptr),
 		render_mode(render_mode), render_view(render_view),
-		render_biomes(true), shadow_edges({0, 0, 0, 0, 0}),
+		render_biomes(true), shadow_edges({0, 0, 0, 0, 0}), occlusion_culling(true),
 		waterlog_full_image(
 			block_images->getBlockImage(
 				block_registry.getBlockID(
@@ -47,10 +48,23 @@ TileRenderer::TileRenderer(const RenderView* render_view, mc::BlockStateRegistry
 			block_images->getBlockImage(
 				block_registry.getBlockID(
 					mc::BlockState::parse("minecraft:water_mask", "level=2" )))),
+		solid_uv_image(
+			block_images->getBlockImage(
+				block_registry.getBlockID(
+					mc::BlockState("minecraft:unknown_block"))).uv_image(0)),
 		tile_image(waterlog_full_image.image(0).width, waterlog_full_image.image(0).height),
+		column_coverage(tile_image.image.width, tile_image.image.height),
 		waterLogTinted(tile_image.image.width, tile_image.image.height) {
 	assert(block_images);
-	render_mode->initialize(render_view, images, world, &current_chunk);
+	render_mode->initialize(render_view, images, world, &neighborhood);
+
+	// clip the faces of the water images for all combinations of water neighbors
+	for (int strip = 0; strip < 8; strip++) {
+		stripFaces(waterlog_full_image.image(0), waterlog_full_image.uv_image(0), strip,
+				waterlog_clipped[0][strip]);
+		stripFaces(waterlog_shore_image.image(0), waterlog_shore_image.uv_image(0), strip,
+				waterlog_clipped[1][strip]);
+	}
 	// Pre-allocate rendering buffers
 }
 
@@ -65,8 +79,86 @@ void TileRenderer::setShadowEdges(std::array<uint8_t, 5> shadow_edges) {
 	this->shadow_edges = shadow_edges;
 }
 
-TileRenderer::cmpBlockPos* TileRenderer::getTileComparator() const {
-	switch ((RenderRotation::Direction)render_view->getRotation()){
+void TileRenderer::setOcclusionCulling(bool occlusion_culling) {
+	this->occlusion_culling = occlusion_culling;
+}
+
+TileImageOrder::TileImageOrder() {
+}
+
+TileImageOrder::~TileImageOrder() {
+}
+
+const std::vector<uint32_t>& TileImageOrder::compute(
+		const boost::container::vector<TileImage>& tile_images, int rotation) {
+	size_t n = tile_images.size();
+	order.resize(n);
+	for (size_t i = 0; i < n; i++)
+		order[i] = i;
+	if (n < 2)
+		return order;
+
+	// the block images are drawn by y-layer first, then by row and column,
+	// row and column are the x/z coordinates depending on the rotation
+	// (see TileRenderer::getTileComparator)
+	int row_x = 0, row_z = 0, column_x = 0, column_z = 0;
+	switch ((RenderRotation::Direction) rotation) {
+	default:
+	case RenderRotation::TOP_LEFT: row_z = 1; column_x = -1; break;
+	case RenderRotation::TOP_RIGHT: row_x = 1; column_z = 1; break;
+	case RenderRotation::BOTTOM_RIGHT: row_z = -1; column_x = 1; break;
+	case RenderRotation::BOTTOM_LEFT: row_x = -1; column_z = -1; break;
+	}
+
+	int min[3], max[3];
+	for (int k = 0; k < 3; k++) {
+		keys[k].resize(n);
+		min[k] = std::numeric_limits<int>::max();
+		max[k] = std::numeric_limits<int>::min();
+	}
+	for (size_t i = 0; i < n; i++) {
+		const mc::BlockPos& pos = tile_images[i].pos;
+		int key[3] = {pos.y, row_x * pos.x + row_z * pos.z, column_x * pos.x + column_z * pos.z};
+		for (int k = 0; k < 3; k++) {
+			keys[k][i] = key[k];
+			min[k] = std::min(min[k], key[k]);
+			max[k] = std::max(max[k], key[k]);
+		}
+	}
+
+	// the blocks of a tile span only some hundred blocks in each direction,
+	// but fall back to a comparison sort just in case
+	for (int k = 0; k < 3; k++) {
+		if ((int64_t) max[k] - min[k] >= 1 << 16) {
+			TileRenderer::cmpBlockPos* comparator = TileRenderer::getTileComparator(rotation);
+			std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+				return comparator(tile_images[a], tile_images[b]);
+			});
+			return order;
+		}
+	}
+
+	// least significant key first, every pass keeps the order of the previous passes
+	// for block images with the same key
+	for (int k = 2; k >= 0; k--)
+		countingSort(keys[k], min[k], max[k]);
+	return order;
+}
+
+void TileImageOrder::countingSort(const std::vector<int>& keys, int min, int max) {
+	counts.assign(max - min + 2, 0);
+	for (size_t i = 0; i < order.size(); i++)
+		counts[keys[order[i]] - min + 1]++;
+	for (size_t i = 1; i < counts.size(); i++)
+		counts[i] += counts[i - 1];
+	order_buffer.resize(order.size());
+	for (size_t i = 0; i < order.size(); i++)
+		order_buffer[counts[keys[order[i]] - min]++] = order[i];
+	order.swap(order_buffer);
+}
+
+TileRenderer::cmpBlockPos* TileRenderer::getTileComparator(int rotation) {
+	switch ((RenderRotation::Direction) rotation) {
 	default:
 	case RenderRotation::TOP_LEFT:
 		return [](const TileImage& a, const TileImage& b) -> bool {
@@ -113,15 +205,37 @@ TileRenderer::cmpBlockPos* TileRenderer::getTileComparator() const {
 
 void TileRenderer::renderTile(const TilePos& tile_pos, RGBAImage& tile) {
 	tile.setSize(getTileWidth(), getTileHeight());
+	// the world cache may be shared with the tile renderers of other jobs (and the level
+	// of detail tile renderer), they might have replaced the chunks since the last tile
+	neighborhood.clear();
 
 	boost::container::vector<TileImage> tile_images;
-	renderTopBlocks(tile_pos, tile_images);
+	{
+		util::ProfileTimer timer(util::ProfilePhase::COLUMN_TRAVERSAL);
+		renderTopBlocks(tile_pos, tile_images);
+	}
 
-	// Sort them in order depending of the rotation
-	boost::range::sort(tile_images, getTileComparator());
+	util::ProfileTimer timer(util::ProfilePhase::COMPOSITING);
+	// order them depending of the rotation
+	const std::vector<uint32_t>& order = tile_image_order.compute(tile_images,
+			render_view->getRotation().getRotation());
+
+	// go through the block images front-to-back and remember which pixels are covered
+	// by opaque pixels already, the block images that are completely hidden by the
+	// block images in front of them don't need to be blitted
+	tile_images_visible.assign(tile_images.size(), true);
+	if (occlusion_culling) {
+		tile_coverage.reset(tile.width, tile.height);
+		for (size_t i = order.size(); i-- > 0; ) {
+			const TileImage& tile_image = tile_images[order[i]];
+			tile_images_visible[i] = tile_coverage.cover(tile_image.image, tile_image.x, tile_image.y);
+		}
+	}
 
-	for (auto it = tile_images.begin(); it != tile_images.end(); ++it) {
-		tile.alphaBlit(it->image, it->x, it->y);
+	for (size_t i = 0; i < order.size(); i++) {
+		const TileImage& tile_image = tile_images[order[i]];
+		if (tile_images_visible[i])
+			tile.alphaBlit(tile_image.image, tile_image.x, tile_image.y);
 	}
 }
 
@@ -134,18 +248,39 @@ int TileRenderer::getTileHeight() const {
 }
 
 void TileRenderer::renderBlocks(int x, int y, mc::BlockPos top, const mc::BlockDir& dir, boost::container::vector<TileImage>& tile_images) {
+	switch (render_view->getRotation().getRotation()) {
+	default:
+	case RenderRotation::TOP_LEFT:
+		renderBlocks<RenderRotation::TOP_LEFT>(x, y, top, dir, tile_images);
+		break;
+	case RenderRotation::TOP_RIGHT:
+		renderBlocks<RenderRotation::TOP_RIGHT>(x, y, top, dir, tile_images);
+		break;
+	case RenderRotation::BOTTOM_RIGHT:
+		renderBlocks<RenderRotation::BOTTOM_RIGHT>(x, y, top, dir, tile_images);
+		break;
+	case RenderRotation::BOTTOM_LEFT:
+		renderBlocks<RenderRotation::BOTTOM_LEFT>(x, y, top, dir, tile_images);
+		break;
+	}
+}
+
+template <RenderRotation::Direction Rotation>
+void TileRenderer::renderBlocks(int x, int y, mc::BlockPos top, const mc::BlockDir& dir, boost::container::vector<TileImage>& tile_images) {
+	// the neighbor blocks are looked up with the directions known at compile time
+	typedef StaticRenderRotation<Rotation> StaticRotation;
+	column_coverage.clear();
+	// whether the transparent blocks in front cover the whole block footprint already
+	bool column_covered = false;
 
 	for (; top.y >= mc::CHUNK_LOWEST*16 ; top += dir) {
 		// get current chunk position
 		mc::ChunkPos current_chunk_pos(top);
 
-		// check if current chunk is not null
-		// and if the chunk wasn't replaced in the cache (i.e. position changed)
-		if (current_chunk == nullptr || current_chunk->getPos() != current_chunk_pos) {
-			//if (!state.world->hasChunkSection(current_chunk, top.current.y))
-			//	continue;
-			current_chunk = world->getChunk(current_chunk_pos);
-		}
+		// look up the chunk and its neighbors if the position changed,
+		// all neighbor blocks are accessed through the chunk neighborhood then
+		if (!neighborhood.hasCenter(current_chunk_pos))
+			current_chunk = neighborhood.update(*world, current_chunk_pos);
 		if (current_chunk == nullptr) {
 			continue;
 		}
@@ -153,7 +288,7 @@ void TileRenderer::renderBlocks(int x, int y, mc::BlockPos top, const mc::BlockD
 		// get local block position
 		mc::LocalBlockPos local(top);
 
-		uint16_t id = current_chunk->getBlockID(local, false);
+		uint16_t id = current_chunk->getBlockID(local);
 		if (id == mc::Chunk::nop_id) continue;
 		// const mc::BlockState& bs = block_registry.getBlockState(id);
 		const BlockImage* block_image = &block_images->getBlockImage(id);
@@ -164,10 +299,18 @@ void TileRenderer::renderBlocks(int x, int y, mc::BlockPos top, const mc::BlockD
 			continue;
 		}
 
+		// the blocks behind are hidden, except the ones that can draw outside the
+		// block image (like in the skip check below)
+		if (column_covered && !block_image->is_waterlogged && !block_image->is_masked_biome) {
+			if (!block_image->is_transparent)
+				break;
+			continue;
+		}
+
 		// What's on each side ?
-		uint16_t id_top   = current_chunk->getBlockID(mc::LocalBlockPos(local.x,local.z,local.y+1), true);
-		uint16_t id_south = getBlock(top + render_view->getRotation().getSouth()).id;
-		uint16_t id_west  = getBlock(top + render_view->getRotation().getWest()).id;
+		uint16_t id_top   = current_chunk->getBlockID(mc::LocalBlockPos(local.x,local.z,local.y+1));
+		uint16_t id_south = neighborhood.getID(top + StaticRotation::getSouth());
+		uint16_t id_west  = neighborhood.getID(top + StaticRotation::getWest());
 
 		// Try an early rejection if full_water with waterloged neighbours
 		bool solid_top = false;
@@ -210,6 +353,19 @@ void TileRenderer::renderBlocks(int x, int y, mc::BlockPos top, const mc::BlockD
 		const RGBAImage& image = block_image->image(alt);
 		const RGBAImage& uv_image = block_image->uv_image(alt);
 
+		// skip the block if the blocks in front of it in this column already cover it,
+		// tinting with a biome mask and the water can draw outside the block image though
+		if (occlusion_culling && !block_image->is_waterlogged && !block_image->is_masked_biome
+				&& column_coverage.isCovered(image)) {
+			if (!block_image->is_transparent)
+				break;
+			continue;
+		}
+
+		// everything from here on is drawing, until the next block is looked up
+		util::ProfileTimer draw_timer(util::ProfilePhase::BLOCK_DRAW);
+		util::profileCount(util::ProfileCounter::BLOCKS_DRAWN);
+
 		// Prep the tile
 		tile_image.x = x;
 		tile_image.y = y;
@@ -221,76 +377,80 @@ void TileRenderer::renderBlocks(int x, int y, mc::BlockPos top, const mc::BlockD
 		// the water on the next step
 		if (!block_image->is_empty) {
 
-			bool strip_up = false;
-			bool strip_left = false;
-			bool strip_right = false;
+			// the faces to strip away and the shadow edges depend only on the neighbor
+			// blocks, the prepared block image variant is looked up in the cache
+			BlockImageVariantKey variant_key;
+			bool has_shadow_edges = false;
+			variant_key.id = id;
+			variant_key.variant = alt;
 			if (block_image->can_partial) {
-				strip_up    = id == id_top;
-				strip_right = id == id_south;
-				strip_left  = id == id_west;
-			}
-
-			if (strip_up || strip_left || strip_right) {
-				for (int i=0; i<tile_image.image.width*tile_image.image.height; i++) {
-					RGBAPixel puv = uv_image.data[i];
-					RGBAPixel p = image.data[i];
-					switch(rgba_blue(puv)) {
-						case FACE_UP_INDEX:
-							if (strip_up) {
-								p = 0;
-							}
-							break;
-						case FACE_LEFT_INDEX:
-							if (strip_left) {
-								p = 0;
-							}
-							break;
-						case FACE_RIGHT_INDEX:
-							if (strip_right) {
-								p = 0;
-							}
-							break;
-					}
-					tile_image.image.data[i] = p;
-				}
-			} else {
-				std::copy(image.data.begin(), image.data.end(), tile_image.image.data.begin());
-			}
-
-			if (block_image->is_biome) {
-				block_images->prepareBiomeBlockImage(tile_image.image, *block_image, getBiomeColor(top, *block_image, current_chunk));
+				variant_key.strip = (id == id_top ? STRIP_UP : 0)
+						| (id == id_west ? STRIP_LEFT : 0)
+						| (id == id_south ? STRIP_RIGHT : 0);
 			}
 
 			if (block_image->shadow_edges > 0) {
 				auto shadow_edge = [this, top](const mc::BlockDir& dir) {
-					const BlockImage& b = block_images->getBlockImage(getBlock(top + dir).id);
+					const BlockImage& b = block_images->getBlockImage(neighborhood.getID(top + dir));
 					return b.shadow_edges == 0;
 				};
 				uint8_t diff_top = (id != id_top);
-				uint8_t north = shadow_edge(render_view->getRotation().getNorth()) && diff_top;
-				uint8_t south = shadow_edge(render_view->getRotation().getSouth()) && diff_top;
-				uint8_t east = shadow_edge(render_view->getRotation().getEast()) && diff_top;
-				uint8_t west = shadow_edge(render_view->getRotation().getWest()) && diff_top;
-				uint8_t bottom = shadow_edge(render_view->getRotation().getBottom());
+				uint8_t north = shadow_edge(StaticRotation::getNorth()) && diff_top;
+				uint8_t south = shadow_edge(StaticRotation::getSouth()) && diff_top;
+				uint8_t east = shadow_edge(StaticRotation::getEast()) && diff_top;
+				uint8_t west = shadow_edge(StaticRotation::getWest()) && diff_top;
+				uint8_t bottom = shadow_edge(StaticRotation::getBottom());
 				uint8_t bottomleft = bottom && (id != id_west);
 				uint8_t bottomright = bottom && (id != id_south);
 
 				if (north + south + east + west + bottomleft + bottomright != 0) {
+					has_shadow_edges = true;
 					int f = block_image->shadow_edges;
-					north *= shadow_edges[0] * f;
-					south *= shadow_edges[1] * f;
-					east *= shadow_edges[2] * f;
-					west *= shadow_edges[3] * f;
-					bottomleft *= shadow_edges[4] * f;
-					bottomright *= shadow_edges[4] * f;
-					blockImageShadowEdges(tile_image.image, uv_image,
-						north, south, east, west, bottomleft, bottomright);
+					variant_key.shadow_edges[0] = north * shadow_edges[0] * f;
+					variant_key.shadow_edges[1] = south * shadow_edges[1] * f;
+					variant_key.shadow_edges[2] = east * shadow_edges[2] * f;
+					variant_key.shadow_edges[3] = west * shadow_edges[3] * f;
+					variant_key.shadow_edges[4] = bottomleft * shadow_edges[4] * f;
+					variant_key.shadow_edges[5] = bottomright * shadow_edges[4] * f;
 				}
 			}
 
+			bool prepare = variant_key.strip != 0 || has_shadow_edges;
+			if (block_image->is_biome) {
+				// the biome blocks are looked up with their biome color in the tint cache,
+				// because the biome color is mostly the same for neighboring blocks
+				TintedBlockImageKey tinted_key;
+				tinted_key.variant = variant_key;
+				tinted_key.color = getBiomeColor(top, *block_image);
+				TintedBlockImageCache& tint_cache = block_images->getTintCache();
+				TintedBlockImageCache::ImagePtr tinted = tint_cache.find(tinted_key);
+				if (!tinted) {
+					BlockImageVariantCache::VariantPtr variant;
+					if (prepare)
+						variant = getBlockImageVariant(*block_image, variant_key, image, uv_image);
+					std::shared_ptr<RGBAImage> created = std::make_shared<RGBAImage>(
+							variant ? variant->image : image);
+					block_images->prepareBiomeBlockImage(*created, *block_image, tinted_key.color);
+					// shadow edges are applied after tinting the block
+					if (variant && !variant->shade.empty())
+						blockImageShade(*created, variant->shade);
+					tinted = tint_cache.insert(tinted_key, created);
+				}
+				std::copy(tinted->data.begin(), tinted->data.end(), tile_image.image.data.begin());
+			} else {
+				BlockImageVariantCache::VariantPtr variant;
+				if (prepare)
+					variant = getBlockImageVariant(*block_image, variant_key, image, uv_image);
+				const RGBAImage& prepared = variant ? variant->image : image;
+				std::copy(prepared.data.begin(), prepared.data.end(), tile_image.image.data.begin());
+			}
+
 			// let the render mode do their magic with the block image
 			//render_mode->draw(node.image, node.pos, id, data);
-			render_mode->draw(tile_image.image, *block_image, tile_image.pos, id, render_view->getRotation());
+			{
+				util::ProfileTimer timer(util::ProfilePhase::RENDERMODE_DRAW);
+				render_mode->draw(tile_image.image, *block_image, tile_image.pos, id, render_view->getRotation());
+			}
 
 		} else {
 			// Clear out the tile from previous rendering
@@ -301,92 +461,121 @@ void TileRenderer::renderBlocks(int x, int y, mc::BlockPos top, const mc::BlockD
 		if (block_image->is_waterlogged) {
 			// assert( !(water_top && water_south && water_west) );
 
-			const RGBAImage* waterlog;
-			const RGBAImage* waterlog_uv;
-			if (water_top || solid_top) {
-				// This will be displayed as full water
-				waterlog = &waterlog_full_image.image(0);
-				waterlog_uv = &waterlog_full_image.uv_image(0);
-			} else {
-				// That one will be displayed a bit lower to look like a shore line
-				waterlog = &waterlog_shore_image.image(0);
-				waterlog_uv = &waterlog_shore_image.uv_image(0);
-			}
+			// This will be displayed as full water, otherwise a bit lower to look like
+			// a shore line, the faces next to other water are already clipped away
+			bool full = water_top || solid_top;
+			const RGBAImage* waterlog = &waterlog_clipped[full ? 0 : 1][(water_top ? STRIP_UP : 0)
+					| (water_west ? STRIP_LEFT : 0) | (water_south ? STRIP_RIGHT : 0)];
+			const RGBAImage* waterlog_uv = full ? &waterlog_full_image.uv_image(0)
+					: &waterlog_shore_image.uv_image(0);
 
-			uint32_t biome_color = getBiomeColor(top, waterlog_full_image, current_chunk);
+			uint32_t biome_color = getBiomeColor(top, waterlog_full_image);
 			biome_color = rgba(rgba_red(biome_color), rgba_green(biome_color), rgba_blue(biome_color), (render_view->getWaterOpacity() * 255));
 
+			// just render the water block with biome color
 			std::vector<RGBAPixel>::const_iterator pit      = waterlog->data.begin();
 			std::vector<RGBAPixel>::const_iterator pitend   = waterlog->data.end();
-			std::vector<RGBAPixel>::const_iterator puvit    = waterlog_uv->data.begin();
 			std::vector<RGBAPixel>::iterator pdestit        = waterLogTinted.data.begin();
-
-			if ((water_top || water_south || water_west) == false) {
-				// fast lane
-				// Nothing to clip, just render the whole water block with biome color
-				while (pit != pitend)
-				{
-					RGBAPixel p = *pit;
-					if (p) {
-						p = rgba_multiply_with_alpha(p, biome_color);
-					}
-					*pdestit = p;
-					pit ++;
-					puvit ++;
-					pdestit ++;
-				}
-			} else {
-				// Clip the some faces, and multiply by biome color
-				while (pit != pitend)
-				{
-					RGBAPixel p = *pit;
-					if (p) {
-						RGBAPixel puv = *puvit;
-						switch(rgba_blue(puv)){
-							case FACE_UP_INDEX:
-								if(water_top) {
-									p = 0;
-								}
-								break;
-							case FACE_LEFT_INDEX:
-								if(water_west) {
-									p = 0;
-								}
-								break;
-							case FACE_RIGHT_INDEX:
-								if(water_south) {
-									p = 0;
-								}
-								break;
-						}
-						if (p) {
-							p = rgba_multiply_with_alpha(p, biome_color);
-						}
-					}
-					*pdestit = p;
-					pit ++;
-					puvit ++;
-					pdestit ++;
+			while (pit != pitend)
+			{
+				RGBAPixel p = *pit;
+				if (p) {
+					p = rgba_multiply_with_alpha(p, biome_color);
 				}
+				*pdestit = p;
+				pit ++;
+				pdestit ++;
 			}
 
 			blockImageBlendZBuffered(tile_image.image, uv_image, waterLogTinted, *waterlog_uv);
 		}
 
-		tile_images.push_back(tile_image);
+		// the blocks in front of this block are at the same position of the tile,
+		// and they are blitted after this block, see getTileComparator
+		bool visible = true;
+		if (occlusion_culling && (block_image->is_transparent || !column_coverage.isEmpty()))
+			visible = column_coverage.cover(tile_image.image);
+		if (visible)
+			tile_images.push_back(tile_image);
 
 		// if this block is not transparent, then stop looking for more blocks
 		if (!block_image->is_transparent) {
 			break;
 		}
+		// also remember if the transparent blocks in front cover the whole block already
+		if (visible && !column_covered && !column_coverage.isEmpty()
+				&& column_coverage.isCovered(solid_uv_image))
+			column_covered = true;
+	}
+}
+
+template void TileRenderer::renderBlocks<RenderRotation::TOP_LEFT>(int x, int y,
+		mc::BlockPos top, const mc::BlockDir& dir, boost::container::vector<TileImage>& tile_images);
+template void TileRenderer::renderBlocks<RenderRotation::TOP_RIGHT>(int x, int y,
+		mc::BlockPos top, const mc::BlockDir& dir, boost::container::vector<TileImage>& tile_images);
+template void TileRenderer::renderBlocks<RenderRotation::BOTTOM_RIGHT>(int x, int y,
+		mc::BlockPos top, const mc::BlockDir& dir, boost::container::vector<TileImage>& tile_images);
+template void TileRenderer::renderBlocks<RenderRotation::BOTTOM_LEFT>(int x, int y,
+		mc::BlockPos top, const mc::BlockDir& dir, boost::container::vector<TileImage>& tile_images);
+
+void TileRenderer::stripFaces(const RGBAImage& image, const RGBAImage& uv_image, int strip,
+		RGBAImage& stripped) {
+	stripped = image;
+	if (strip == 0)
+		return;
+	for (size_t i = 0; i < stripped.data.size(); i++) {
+		switch (rgba_blue(uv_image.data[i])) {
+			case FACE_UP_INDEX:
+				if (strip & STRIP_UP)
+					stripped.data[i] = 0;
+				break;
+			case FACE_LEFT_INDEX:
+				if (strip & STRIP_LEFT)
+					stripped.data[i] = 0;
+				break;
+			case FACE_RIGHT_INDEX:
+				if (strip & STRIP_RIGHT)
+					stripped.data[i] = 0;
+				break;
+		}
 	}
 }
 
+BlockImageVariantCache::VariantPtr TileRenderer::getBlockImageVariant(
+		const BlockImage& block_image, const BlockImageVariantKey& key,
+		const RGBAImage& image, const RGBAImage& uv_image) {
+	BlockImageVariantCache& variant_cache = block_images->getVariantCache();
+	BlockImageVariantCache::VariantPtr variant = variant_cache.find(key);
+	if (!variant)
+		variant = variant_cache.insert(key, createBlockImageVariant(block_image, key, image, uv_image));
+	return variant;
+}
+
+std::shared_ptr<BlockImageVariant> TileRenderer::createBlockImageVariant(
+		const BlockImage& block_image, const BlockImageVariantKey& key,
+		const RGBAImage& image, const RGBAImage& uv_image) {
+	std::shared_ptr<BlockImageVariant> variant = std::make_shared<BlockImageVariant>();
+	stripFaces(image, uv_image, key.strip, variant->image);
+
+	const uint8_t* edges = key.shadow_edges;
+	if (std::count(edges, edges + 6, 0) != 6) {
+		std::vector<uint8_t> shade;
+		blockImageShadowEdgeFactors(uv_image, edges[0], edges[1], edges[2], edges[3],
+				edges[4], edges[5], shade);
+		// biome blocks are tinted before applying the shadow edges
+		if (block_image.is_biome)
+			variant->shade.swap(shade);
+		else
+			blockImageShade(variant->image, shade);
+	}
+	return variant;
+}
+
 mc::Block TileRenderer::getBlock(const mc::BlockPos& pos, int get) {
-	return world->getBlock(pos, current_chunk, get);
+	return neighborhood.getBlock(pos, get);
 }
 
-uint32_t TileRenderer::getBiomeColor(const mc::BlockPos& pos, const BlockImage& block, const mc::Chunk* chunk) {
+uint32_t TileRenderer::getBiomeColor(const mc::BlockPos& pos, const BlockImage& block) {
 	const int radius = 2;
 	float f = ((2*radius+1)*(2*radius+1));
 	float r = 0.0, g = 0.0, b = 0.0;
@@ -394,20 +583,13 @@ uint32_t TileRenderer::getBiomeColor(const mc::BlockPos& pos, const BlockImage&
 	for (int dx = -radius; dx <= radius; dx++) {
 		for (int dz = -radius; dz <= radius; dz++) {
 			mc::BlockPos other = pos + mc::BlockDir(dx, dz, 0);
-			mc::ChunkPos chunk_pos(other);
-
-			uint16_t biome_id;
-			mc::LocalBlockPos local(other);
-			if (chunk_pos != chunk->getPos()) {
-				mc::Chunk* other_chunk = world->getChunk(chunk_pos);
-				if (other_chunk == nullptr) {
-					f -= 1.0f;
-					continue;
-				}
-				biome_id = other_chunk->getBiomeAt(local);
-			} else {
-				biome_id = chunk->getBiomeAt(local);
+			const mc::Chunk* chunk = neighborhood.getChunk(other);
+			if (chunk == nullptr) {
+				f -= 1.0f;
+				continue;
 			}
+
+			uint16_t biome_id = chunk->getBiomeAt(mc::LocalBlockPos(other));
 			const Biome& biome = Biome::getBiome(biome_id);
 			uint32_t c = biome.getColor(other, block.biome_color, block.biome_colormap);
 			r += (float) rgba_red(c);
@@ -21,10 +21,15 @@
 #define TILERENDERER_H_
 
 #include "biomes.h"
+#include "blockimagevariants.h"
+#include "coveragemask.h"
 #include "image.h"
+#include "renderrotation.h"
+#include "../mc/chunkneighborhood.h"
 #include "../mc/worldcache.h" // mc::DIR_*
 
 #include <array>
+#include <memory>
 #include <vector>
 #include <boost/filesystem.hpp>
 #include <boost/container/vector.hpp>
@@ -59,6 +64,35 @@ struct TileImage {
 	TileImage(int width, int height): image(width, height) {}
 };
 
+/**
+ * Computes the order the block images of a tile are drawn in (back-to-front).
+ *
+ * This is the same order as sorting the block images with
+ * TileRenderer::getTileComparator, but the block images are bucketed by y-layer, row
+ * and column with stable counting sort passes instead, so they don't need to be
+ * compared and moved around.
+ */
+class TileImageOrder {
+public:
+	TileImageOrder();
+	~TileImageOrder();
+
+	/**
+	 * Computes the order of block images for a rotation (RenderRotation::Direction),
+	 * returns the indices of the block images in the order they are drawn.
+	 */
+	const std::vector<uint32_t>& compute(const boost::container::vector<TileImage>& tile_images,
+			int rotation);
+
+private:
+	// sorts the indices in order stable by the keys, which are in the range min..max
+	void countingSort(const std::vector<int>& keys, int min, int max);
+
+	std::vector<uint32_t> order, order_buffer;
+	std::vector<int> keys[3];
+	std::vector<uint32_t> counts;
+};
+
 class TileRenderer {
 public:
 	TileRenderer(const RenderView* render_view, mc::BlockStateRegistry& block_registry,
@@ -67,6 +101,11 @@ public:
 
 	void setRenderBiomes(bool render_biomes);
 	void setShadowEdges(std::array<uint8_t, 5> shadow_edges);
+	/**
+	 * Sets whether block images hidden by the block images in front of them are skipped
+	 * (enabled by default). The rendered tiles are the same either way.
+	 */
+	void setOcclusionCulling(bool occlusion_culling);
 
 	virtual void renderTile(const TilePos& tile_pos, RGBAImage& tile);
 
@@ -74,22 +113,55 @@ public:
 	virtual int getTileWidth() const;
 	virtual int getTileHeight() const;
 
-protected:
-	// void sortTiles(boost::container::vector<TileImage>& tile_images) const;
+	/**
+	 * Returns the comparator for sorting the block images of a tile back-to-front for
+	 * a rotation (RenderRotation::Direction), see also TileImageOrder.
+	 */
 	typedef bool cmpBlockPos(const TileImage &, const TileImage &);
-	cmpBlockPos* getTileComparator() const;
+	static cmpBlockPos* getTileComparator(int rotation);
+
+protected:
+	void renderBlocks(int x, int y, mc::BlockPos top, const mc::BlockDir& dir, boost::container::vector<TileImage>& tile_images);
+	/**
+	 * Renders the blocks of a column for a rotation known at compile time, so there is
+	 * no branching on the rotation for every block. Instantiated for all four rotations.
+	 */
+	template <RenderRotation::Direction Rotation>
 	void renderBlocks(int x, int y, mc::BlockPos top, const mc::BlockDir& dir, boost::container::vector<TileImage>& tile_images);
 	virtual void renderTopBlocks(const TilePos& tile_pos, boost::container::vector<TileImage>& tile_images) {}
 
 	mc::Block getBlock(const mc::BlockPos& pos, int get = mc::GET_ID);
-	uint32_t getBiomeColor(const mc::BlockPos& pos, const BlockImage& block, const mc::Chunk* chunk);
+	uint32_t getBiomeColor(const mc::BlockPos& pos, const BlockImage& block);
+
+	/**
+	 * Copies a block image and strips the faces specified by the STRIP_* bits away.
+	 */
+	static void stripFaces(const RGBAImage& image, const RGBAImage& uv_image, int strip,
+			RGBAImage& stripped);
+
+	/**
+	 * Returns a variant of a block image (stripped faces and shadow edges) from the
+	 * block image variant cache, it's created if it's not cached yet.
+	 */
+	BlockImageVariantCache::VariantPtr getBlockImageVariant(const BlockImage& block_image,
+			const BlockImageVariantKey& key, const RGBAImage& image, const RGBAImage& uv_image);
+
+	/**
+	 * Prepares a variant of a block image (stripped faces and shadow edges) for the
+	 * block image variant cache.
+	 */
+	std::shared_ptr<BlockImageVariant> createBlockImageVariant(const BlockImage& block_image,
+			const BlockImageVariantKey& key, const RGBAImage& image, const RGBAImage& uv_image);
+
 	mc::BlockStateRegistry& block_registry;
 
 	BlockImages* images;
 	RenderedBlockImages* block_images;
 	int tile_width;
 	mc::WorldCache* world;
-	mc::Chunk* current_chunk;
+	// the chunk the current block is in and its neighbor chunks
+	mc::ChunkNeighborhood neighborhood;
+	const mc::Chunk* current_chunk;
 	RenderMode* render_mode;
 	const RenderView* render_view;
 
@@ -97,10 +169,20 @@ protected:
 	// factors for shadow edges:
 	// north, south, east, west, bottom
 	std::array<uint8_t, 5> shadow_edges;
+	bool occlusion_culling;
 
 	const BlockImage& waterlog_full_image;
 	const BlockImage& waterlog_shore_image;
+	// the full/shore water images with the faces stripped away (by STRIP_* bits)
+	// that are next to other water
+	RGBAImage waterlog_clipped[2][8];
+	// the footprint of a solid block, see blockImageIsTransparent
+	const RGBAImage& solid_uv_image;
 	TileImage tile_image;
+	// the pixels of the tile / of the current block column covered by opaque pixels
+	CoverageMask tile_coverage, column_coverage;
+	TileImageOrder tile_image_order;
+	std::vector<char> tile_images_visible;
 	RGBAImage waterLogTinted;
 };
 
@@ -21,23 +21,51 @@
 
 #include "blockimages.h"
 #include "image.h"
+#include "renderjournal.h"
 #include "rendermode.h"
 #include "renderview.h"
+#include "tilearchive.h"
 #include "tilerenderer.h"
 #include "tileset.h"
+#include "tilestore.h"
+#include "../mc/regionprefetcher.h"
 #include "../mc/worldcache.h"
 #include "../mc/blockstate.h"
 #include "../util.h"
 
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
 namespace mapcrafter {
 namespace renderer {
 
 void RenderContext::initializeTileRenderer() {
-	world_cache.reset(new mc::WorldCache(*block_registry, *world));
+	initializeTileRenderer(std::make_shared<mc::WorldCache>(*block_registry, *world));
+}
+
+void RenderContext::initializeTileRenderer(std::shared_ptr<mc::WorldCache> world_cache) {
+	this->world_cache = world_cache;
+	world_cache->setRegionPrefetcher(region_prefetcher.get());
 	render_mode.reset(createRenderMode(world_config, map_config, render_view->getRotation()));
 	tile_renderer.reset(render_view->createTileRenderer(*block_registry, block_images,
 			map_config.getTileWidth(), world_cache.get(), render_mode.get()));
 	render_view->configureTileRenderer(tile_renderer.get(), world_config, map_config);
+
+	if (lod_block_images) {
+		lod_render_mode.reset(createRenderMode(world_config, map_config,
+				render_view->getRotation()));
+		lod_tile_renderer.reset(render_view->createTileRenderer(*block_registry,
+				lod_block_images.get(), map_config.getTileWidth(), world_cache.get(),
+				lod_render_mode.get()));
+		render_view->configureTileRenderer(lod_tile_renderer.get(), world_config, map_config);
+	}
+}
+
+int RenderContext::getDetailZoomLevel() const {
+	if (!lod_block_images)
+		return tile_set->getDepth();
+	return std::max(tile_set->getDepth() - map_config.getLODLevels(), 0);
 }
 
 TileRenderWorker::TileRenderWorker()
@@ -65,9 +93,47 @@ void TileRenderWorker::setProgressHandler(util::IProgressHandler* progress) {
 	this->progress = progress;
 }
 
+namespace {
+
+/**
+ * Encodes/decodes a tile image in the image format of a map.
+ */
+bool writeTileImage(const RGBAImage& image, std::ostream& out, const RenderContext& context) {
+	const config::MapSection& map_config = context.map_config;
+	config::Color bg = context.background_color;
+	if (map_config.getImageFormat() == config::ImageFormat::WEBP)
+		return image.writeWebP(out, map_config.getWebPQuality(), map_config.isWebPLossless());
+	if (map_config.getImageFormat() != config::ImageFormat::PNG)
+		return image.writeJPEG(out, map_config.getJPEGQuality(),
+				rgba(bg.red, bg.green, bg.blue, 255));
+	if (map_config.isPNGIndexed())
+		return image.writeIndexedPNG(out, 8, true, map_config.getPNGEncodingOptions());
+	return image.writePNG(out, map_config.getPNGEncodingOptions());
+}
+
+bool readTileImage(RGBAImage& image, std::istream& in, const RenderContext& context) {
+	if (context.map_config.getImageFormat() == config::ImageFormat::WEBP)
+		return image.readWebP(in);
+	if (context.map_config.getImageFormat() != config::ImageFormat::PNG)
+		return image.readJPEG(in);
+	return image.readPNG(in);
+}
+
+}
+
 void TileRenderWorker::saveTile(const TilePath& tile, const RGBAImage& image) {
-	bool png = render_context.map_config.getImageFormat() == config::ImageFormat::PNG;
-	bool png_indexed = render_context.map_config.isPNGIndexed();
+	util::ProfileTimer timer(util::ProfilePhase::ENCODE_WRITE);
+	// archived tiles are encoded in memory and appended to the tile archive
+	if (render_context.tile_archive) {
+		std::ostringstream out;
+		if (!writeTileImage(image, out, render_context)
+				|| !render_context.tile_archive->writeTile(tile, out.str()))
+			LOG(WARNING) << "Unable to write tile '" << tile.toString()
+					<< "' to the tile archive.";
+		return;
+	}
+
+	bool alpha = render_context.map_config.getImageFormat() != config::ImageFormat::JPEG;
 	std::string suffix = std::string(".") + render_context.map_config.getImageFormatSuffix();
 	std::string filename = tile.toString() + suffix;
 	if (tile.getDepth() == 0)
@@ -76,15 +142,28 @@ void TileRenderWorker::saveTile(const TilePath& tile, const RGBAImage& image) {
 	if (!fs::exists(file.branch_path()))
 		fs::create_directories(file.branch_path());
 
-	if ((png && !png_indexed) && !image.writePNG(file.string()))
-		LOG(WARNING) << "Unable to write '" << file.string() << "'.";
+	TileStore* tile_store = render_context.tile_store.get();
+	// transparent tiles aren't written at all (jpeg tiles have a background color),
+	// the web interface just doesn't show missing tiles
+	if (tile_store != nullptr && alpha && image.isTransparent()) {
+		tile_store->setTransparent(tile, file);
+		return;
+	}
 
-	if ((png && png_indexed) && !image.writeIndexedPNG(file.string()))
-		LOG(WARNING) << "Unable to write '" << file.string() << "'.";
+	// deduplicated tiles are encoded in memory and then stored
+	if (tile_store != nullptr) {
+		std::ostringstream out;
+		if (!writeTileImage(image, out, render_context)
+				|| !tile_store->storeTile(tile, out.str(), file))
+			LOG(WARNING) << "Unable to write '" << file.string() << "'.";
+		return;
+	}
 
-	config::Color bg = render_context.background_color;
-	if (!png && !image.writeJPEG(file.string(),
-			render_context.map_config.getJPEGQuality(), rgba(bg.red, bg.green, bg.blue, 255)))
+	// the tile might be a hard link to a deduplicated image, don't overwrite that
+	if (fs::exists(file) && fs::hard_link_count(file) > 1)
+		fs::remove(file);
+	std::ofstream out(file.string().c_str(), std::ios::binary);
+	if (!out || !writeTileImage(image, out, render_context))
 		LOG(WARNING) << "Unable to write '" << file.string() << "'.";
 }
 
@@ -92,11 +171,30 @@ void TileRenderWorker::renderRecursive(const TilePath& tile, RGBAImage& image) {
 	// if this is tile is not required or we should skip it, try to load it from file
 	if (!render_context.tile_set->isTileRequired(tile)
 			|| render_work.tiles_skip.count(tile)) {
-		bool png = render_context.map_config.getImageFormat() == config::ImageFormat::PNG;
-		fs::path file = render_context.output_dir
-				/ (tile.toString() + "." + render_context.map_config.getImageFormatSuffix());
-		if ((png && image.readPNG(file.string()))
-				|| (!png && image.readJPEG(file.string()))) {
+		bool read;
+		{
+			util::ProfileTimer timer(util::ProfilePhase::ENCODE_WRITE);
+			if (render_context.tile_archive) {
+				std::string data;
+				read = render_context.tile_archive->readTile(tile, data);
+				std::istringstream in(data);
+				read = read && readTileImage(image, in, render_context);
+			} else {
+				fs::path file = render_context.output_dir
+					/ (tile.toString() + "." + render_context.map_config.getImageFormatSuffix());
+				std::ifstream in(file.string().c_str(), std::ios::binary);
+				read = in && readTileImage(image, in, render_context);
+			}
+		}
+		// transparent tiles don't have an image file
+		if (!read && render_context.tile_store
+				&& render_context.tile_store->isTransparent(tile)) {
+			image.setSize(render_context.tile_renderer->getTileWidth(),
+					render_context.tile_renderer->getTileHeight());
+			image.clear();
+			read = true;
+		}
+		if (read) {
 			if (render_work.tiles_skip.count(tile) && progress != nullptr)
 				progress->setValue(progress->getValue()
 						+ render_context.tile_set->getContainingRenderTiles(tile));
@@ -107,11 +205,28 @@ void TileRenderWorker::renderRecursive(const TilePath& tile, RGBAImage& image) {
 				<< "', I will just render it again.";
 	}
 
-	if (tile.getDepth() == render_context.tile_set->getDepth()) {
+	if (render_context.lod_tile_renderer
+			&& tile.getDepth() == render_context.getDetailZoomLevel()) {
+		// the zoom levels below aren't rendered, this tile is composed of the render
+		// tiles rendered directly with the smaller block images
+		int w = render_context.tile_renderer->getTileWidth();
+		int h = render_context.tile_renderer->getTileHeight();
+		image.setSize(w, h);
+		renderLODRecursive(tile, image, 0, 0, w, h);
+
+		saveTile(tile, image);
+		int render_tiles = render_context.tile_set->getContainingRenderTiles(tile);
+		render_work_result.tiles_rendered += render_tiles;
+		if (progress != nullptr)
+			progress->setValue(progress->getValue() + render_tiles);
+		if (render_context.journal)
+			render_context.journal->add(tile);
+	} else if (tile.getDepth() == render_context.tile_set->getDepth()) {
 		// this tile is a render tile, render it
 		render_context.tile_renderer->renderTile(tile.getTilePos()
 				+ render_context.tile_set->getTileOffset(), image);
 		render_work_result.tiles_rendered++;
+		util::profileCount(util::ProfileCounter::RENDER_TILES);
 
 		/*
 		// draws a border on the tile
@@ -150,29 +265,22 @@ void TileRenderWorker::renderRecursive(const TilePath& tile, RGBAImage& image) {
 
 		RGBAImage other;
 		RGBAImage resized;
-		if (render_context.tile_set->hasTile(tile + 1)) {
-			renderRecursive(tile + 1, other);
-			other.resize(resized, 0, 0, InterpolationType::HALF);
-			image.simpleAlphaBlit(resized, 0, 0);
-			other.clear();
-		}
-		if (render_context.tile_set->hasTile(tile + 2)) {
-			renderRecursive(tile + 2, other);
-			other.resize(resized, 0, 0, InterpolationType::HALF);
-			image.simpleAlphaBlit(resized, w / 2, 0);
-			other.clear();
-		}
-		if (render_context.tile_set->hasTile(tile + 3)) {
-			renderRecursive(tile + 3, other);
-			other.resize(resized, 0, 0, InterpolationType::HALF);
-			image.simpleAlphaBlit(resized, 0, h / 2);
+		for (int i = 1; i <= 4; i++) {
+			if (!render_context.tile_set->hasTile(tile + i))
+				continue;
+			renderRecursive(tile + i, other);
+			{
+				util::ProfileTimer timer(util::ProfilePhase::DOWNSCALING);
+				other.resize(resized, 0, 0, InterpolationType::HALF);
+			}
+			{
+				util::ProfileTimer timer(util::ProfilePhase::COMPOSITING);
+				// children 2 and 4 are on the right, 3 and 4 on the bottom
+				image.simpleAlphaBlit(resized, i % 2 == 0 ? w / 2 : 0, i > 2 ? h / 2 : 0);
+			}
 			other.clear();
 		}
-		if (render_context.tile_set->hasTile(tile + 4)) {
-			renderRecursive(tile + 4, other);
-			other.resize(resized, 0, 0, InterpolationType::HALF);
-			image.simpleAlphaBlit(resized, w / 2, h / 2);
-		}
+		util::profileCount(util::ProfileCounter::COMPOSITE_TILES);
 
 		/*
 		// draws a border on the tile
@@ -187,10 +295,37 @@ void TileRenderWorker::renderRecursive(const TilePath& tile, RGBAImage& image) {
 
 		// then save the tile
 		saveTile(tile, image);
+		// the tile and its children are done now, an interrupted rendering can skip them
+		if (render_context.journal)
+			render_context.journal->add(tile);
+	}
+}
+
+void TileRenderWorker::renderLODRecursive(const TilePath& tile, RGBAImage& image,
+		int x, int y, int w, int h) {
+	if (tile.getDepth() < render_context.tile_set->getDepth()) {
+		for (int i = 1; i <= 4; i++)
+			if (render_context.tile_set->hasTile(tile + i))
+				renderLODRecursive(tile + i, image, i % 2 == 0 ? x + w / 2 : x,
+						i > 2 ? y + h / 2 : y, w / 2, h / 2);
+		return;
+	}
+
+	RGBAImage lod_image;
+	render_context.lod_tile_renderer->renderTile(tile.getTilePos()
+			+ render_context.tile_set->getTileOffset(), lod_image);
+	util::profileCount(util::ProfileCounter::RENDER_TILES);
+	{
+		util::ProfileTimer timer(util::ProfilePhase::COMPOSITING);
+		image.simpleAlphaBlit(lod_image, x, y);
 	}
 }
 
 void TileRenderWorker::operator()() {
+	// profile this render work if requested
+	util::RenderProfile profile;
+	util::ProfileThreadScope profile_scope(render_context.profile_collector ? &profile : nullptr);
+
 	int work = 0;
 	for (auto it = render_work.tiles.begin(); it != render_work.tiles.end(); ++it)
 		work += render_context.tile_set->getContainingRenderTiles(*it);
@@ -208,6 +343,9 @@ void TileRenderWorker::operator()() {
 		// clear image
 		image.clear();
 	}
+
+	if (render_context.profile_collector)
+		render_context.profile_collector->merge(profile);
 }
 
 } /* namespace render */
@@ -27,6 +27,7 @@
 
 #include <memory>
 #include <set>
+#include <vector>
 #include <boost/filesystem.hpp>
 
 namespace fs = boost::filesystem;
@@ -35,18 +36,26 @@ namespace mapcrafter {
 
 namespace mc {
 class BlockStateRegistry;
+class RegionPrefetcher;
 class WorldCache;
 }
 
+namespace util {
+class ProfileCollector;
+}
+
 namespace renderer {
 
 class BlockImages;
+class RenderJournal;
 class RenderMode;
 class RenderView;
 class RGBAImage;
+class TileArchive;
 class TilePath;
 class TileRenderer;
 class TileSet;
+class TileStore;
 
 struct RenderContext {
 	fs::path output_dir;
@@ -59,11 +68,31 @@ struct RenderContext {
 	TileSet* tile_set;
 	mc::BlockStateRegistry* block_registry;
 	std::shared_ptr<mc::World> world;
+	// reads the regions of upcoming render work in the background, may be null
+	std::shared_ptr<mc::RegionPrefetcher> region_prefetcher;
 
 	std::shared_ptr<mc::WorldCache> world_cache;
 	std::shared_ptr<RenderMode> render_mode;
 	std::shared_ptr<TileRenderer> tile_renderer;
 
+	// smaller block images to render the tiles of the level of detail zoom level
+	// directly from the world, null if the map renders all zoom levels
+	std::shared_ptr<BlockImages> lod_block_images;
+	std::shared_ptr<RenderMode> lod_render_mode;
+	std::shared_ptr<TileRenderer> lod_tile_renderer;
+
+	// collects the render profiles of the render threads, null if profiling is disabled
+	std::shared_ptr<util::ProfileCollector> profile_collector;
+	// records the rendered composite tiles to resume an interrupted rendering, may be null
+	std::shared_ptr<RenderJournal> journal;
+	// deduplicates the tile images, null if the map doesn't deduplicate its tiles
+	std::shared_ptr<TileStore> tile_store;
+	// the tile images are stored in this archive instead of files if not null
+	std::shared_ptr<TileArchive> tile_archive;
+	// render tiles with points of interest, the render threads render the work nearest
+	// to them first
+	std::vector<TilePath> priority_tiles;
+
 	/**
 	 * Creates/initializes the world cache and tile renderer with the render view and
 	 * other supplied objects (block images, tile set, world).
@@ -73,6 +102,20 @@ struct RenderContext {
 	 * (for multithreading for example).
 	 */
 	void initializeTileRenderer();
+
+	/**
+	 * Same as above, but uses an existing world cache of the world of this context. A
+	 * world cache can be reused as long as the world and the block state registry stay
+	 * the same (for example for the other rotations of a map).
+	 */
+	void initializeTileRenderer(std::shared_ptr<mc::WorldCache> world_cache);
+
+	/**
+	 * Returns the deepest zoom level whose tiles are rendered. This is the depth of the
+	 * tile set, or the level of detail zoom level if the map doesn't render the deepest
+	 * zoom levels (then its tiles are rendered directly from the world).
+	 */
+	int getDetailZoomLevel() const;
 };
 
 struct RenderWork {
@@ -101,6 +144,12 @@ public:
 	void saveTile(const TilePath& tile, const RGBAImage& image);
 	void renderRecursive(const TilePath& path, RGBAImage& image);
 
+	/**
+	 * Renders the render tiles below a tile with the level of detail tile renderer and
+	 * blits them to the tile image (at position x, y with the size w, h).
+	 */
+	void renderLODRecursive(const TilePath& path, RGBAImage& image, int x, int y, int w, int h);
+
 	void operator()();
 
 private:
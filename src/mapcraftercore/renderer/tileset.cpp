@@ -22,8 +22,11 @@
 #include "../mc/chunk.h"
 #include "../mc/pos.h"
 #include "../mc/world.h"
+#include "../compat/thread.h"
 
 #include <algorithm>
+#include <atomic>
+#include <cassert>
 #include <cmath>
 #include <cstdint>
 #include <cstdlib>
@@ -31,6 +34,8 @@
 #include <limits>
 #include <set>
 #include <sstream>
+#include <stdexcept>
+#include <thread>
 
 namespace mapcrafter {
 namespace renderer {
@@ -83,46 +88,78 @@ bool TilePos::operator<(const TilePos& other) const {
 	return x < other.x;
 }
 
+uint64_t TilePos::getKey() const {
+	// flip the sign bit of x so the keys of negative positions don't collide with the
+	// reserved empty key of the tile hash maps (-1:-1 would be ~0 otherwise)
+	return ((uint64_t) ((uint32_t) x ^ 0x80000000u) << 32) | (uint32_t) y;
+}
+
+TilePos TilePos::byKey(uint64_t key) {
+	return TilePos((int) ((uint32_t) (key >> 32) ^ 0x80000000u), (int) (uint32_t) key);
+}
+
 std::ostream& operator<<(std::ostream& stream, const TilePos& tile) {
 	stream << tile.getX() << ":" << tile.getY();
 	return stream;
 }
 
-TilePath::TilePath() {
+namespace {
+
+// bits of the key used to store the depth of a tile path
+const uint64_t DEPTH_MASK = 0x3f;
+
+// returns the bit offset of the node of a level (0 is the first level) in a path key
+int nodeShift(int level) {
+	return 62 - 2 * level;
+}
+
+}
+
+const int TilePath::MAX_DEPTH;
+
+TilePath::TilePath()
+	: key(0) {
 }
 
 TilePath::~TilePath() {
 }
 
 int TilePath::getDepth() const {
-	return path.size();
+	return key & DEPTH_MASK;
 }
 
-const std::vector<int>& TilePath::getPath() const {
+std::vector<int> TilePath::getPath() const {
+	std::vector<int> path(getDepth());
+	for (size_t i = 0; i < path.size(); i++)
+		path[i] = ((key >> nodeShift(i)) & 3) + 1;
 	return path;
 }
 
 TilePath TilePath::parent() const {
-	TilePath copy(*this);
-	copy.path.pop_back();
+	int depth = getDepth();
+	assert(depth > 0);
+	TilePath copy;
+	// remove the node of the last level and decrease the depth
+	copy.key = (key & ~(((uint64_t) 3 << nodeShift(depth - 1)) | DEPTH_MASK)) | (depth - 1);
 	return copy;
 }
 
 TilePos TilePath::getTilePos() const {
+	int depth = getDepth();
 	// calculate the radius of all tiles on the top zoom level (2^zoomlevel / 2)
-	int radius = pow(2, path.size()) / 2;
+	int radius = (1 << depth) / 2;
 	// the startpoint is top left
 	int x = -radius;
 	int y = -radius;
-	for (size_t i = 0; i < path.size(); i++) {
+	for (int i = 0; i < depth; i++) {
 		// now for every zoom level:
-		// get the current tile
-		int tile = path[i];
+		// get the current tile (bit 0 set: right side, bit 1 set: bottom side)
+		int tile = (key >> nodeShift(i)) & 3;
 		// increase x by the radius if this tile is on the right side (2 or 4)
-		if (tile == 2 || tile == 4)
+		if (tile & 1)
 			x += radius;
 		// increase y by the radius if this tile is on the bottom side (3 or 4)
-		if (tile == 3 || tile == 4)
+		if (tile & 2)
 			y += radius;
 		// divide size by two, because the next zoom level has only the half radius
 		radius /= 2;
@@ -131,7 +168,9 @@ TilePos TilePath::getTilePos() const {
 }
 
 TilePath& TilePath::operator+=(int node) {
-	path.push_back(node);
+	int depth = getDepth();
+	assert(depth < MAX_DEPTH && node >= 1 && node <= 4);
+	key = ((key & ~DEPTH_MASK) | ((uint64_t) (node - 1) << nodeShift(depth))) | (depth + 1);
 	return *this;
 }
 
@@ -140,11 +179,15 @@ TilePath TilePath::operator+(int node) const {
 }
 
 bool TilePath::operator==(const TilePath& other) const {
-	return path == other.path;
+	return key == other.key;
+}
+
+bool TilePath::operator!=(const TilePath& other) const {
+	return key != other.key;
 }
 
 bool TilePath::operator<(const TilePath& other) const {
-	return path < other.path;
+	return key < other.key;
 }
 
 std::ostream& operator<<(std::ostream& stream, const TilePath& path) {
@@ -153,20 +196,36 @@ std::ostream& operator<<(std::ostream& stream, const TilePath& path) {
 }
 
 std::string TilePath::toString() const {
-	std::stringstream ss;
-	for (size_t i = 0; i < path.size(); i++) {
-		ss << path[i];
-		if (i != path.size() - 1)
-			ss << "/";
+	int depth = getDepth();
+	std::string str;
+	str.reserve(2 * depth);
+	for (int i = 0; i < depth; i++) {
+		if (i != 0)
+			str += '/';
+		str += (char) ('1' + ((key >> nodeShift(i)) & 3));
+	}
+	return str;
+}
+
+TilePath TilePath::byString(const std::string& str) {
+	TilePath path;
+	for (size_t i = 0; i < str.size(); i += 2) {
+		if (str[i] < '1' || str[i] > '4' || path.getDepth() == MAX_DEPTH
+				|| (i + 1 < str.size() && (str[i + 1] != '/' || i + 2 == str.size())))
+			throw std::invalid_argument("Invalid tile path '" + str + "'");
+		path += str[i] - '0';
 	}
-	return ss.str();
+	return path;
 }
 
 TilePath TilePath::byTilePos(const TilePos& tile, int depth) {
 	TilePath path;
 
+	if (depth < 0 || depth > MAX_DEPTH)
+		throw std::runtime_error("Invalid tile depth " + util::str(depth));
+
 	// at first calculate the radius in tiles of this zoom level
-	int radius = pow(2, depth) / 2;
+	int radius = (1 << depth) / 2;
 	// check if the tile is in this bounds
 	if (tile.getX() > radius  || tile.getY() > radius
 			|| tile.getX() < -radius || tile.getY() < -radius)
@@ -219,60 +278,133 @@ TilePath TilePath::byTilePos(const TilePos& tile, int depth) {
 	return path;
 }
 
+uint64_t TilePath::getKey() const {
+	return key;
+}
+
+TilePath TilePath::byKey(uint64_t key) {
+	TilePath path;
+	path.key = key;
+	return path;
+}
+
 TileSet::TileSet(int tile_width, const RenderRotation& rotation)
-	: rotation(rotation), tile_width(tile_width), min_depth(0), depth(0) {
+	: rotation(rotation), tile_width(tile_width), min_depth(0), depth(0),
+	  required_render_tiles_count(0), required_composite_tiles_count(0),
+	  required_zoom_level(0) {
 }
 
 TileSet::~TileSet() {
 }
 
+namespace {
+
+/**
+ * A render tile found in a region of the world.
+ */
+struct RegionTile {
+	// key of the tile position
+	uint64_t tile;
+	// index of the region in the list of regions
+	int region;
+	// highest timestamp of the chunks of the region in this tile
+	int timestamp;
+
+	bool operator<(const RegionTile& other) const {
+		if (tile == other.tile)
+			return region < other.region;
+		return tile < other.tile;
+	}
+};
+
+/**
+ * Sorts the tiles of a region found since the index begin and merges the duplicates.
+ */
+void mergeRegionTiles(std::vector<RegionTile>& tiles, size_t begin) {
+	std::sort(tiles.begin() + begin, tiles.end());
+	size_t end = begin;
+	for (size_t i = begin; i < tiles.size(); i++) {
+		if (end != begin && tiles[end - 1].tile == tiles[i].tile)
+			tiles[end - 1].timestamp = std::max(tiles[end - 1].timestamp, tiles[i].timestamp);
+		else
+			tiles[end++] = tiles[i];
+	}
+	tiles.resize(end);
+}
+
+}
+
 void TileSet::findRenderTiles(const mc::World& world, bool auto_center,
-		TilePos& tile_offset) {
+		TilePos& tile_offset, int threads) {
 	// clear maybe already calculated tiles
 	render_tiles.clear();
-	required_render_tiles.clear();
+	tile_regions.clear();
+
+	// the regions are numbered by their order in the world to process the tiles of
+	// every region in the same order as a single thread would do
+	const auto& available_regions = world.getAvailableRegions();
+	std::vector<mc::RegionPos> regions(available_regions.begin(), available_regions.end());
+
+	// go through all chunks in the world, every thread takes the next region
+	// and collects the tiles of it
+	threads = std::max(1, std::min(threads, (int) regions.size()));
+	std::vector<std::vector<RegionTile>> thread_tiles(threads);
+	std::atomic<size_t> next_region(0);
+	auto scan_regions = [&](std::vector<RegionTile>& tiles) {
+		std::vector<TilePos> chunk_tiles;
+		for (size_t i = next_region++; i < regions.size(); i = next_region++) {
+			mc::RegionFile region;
+			if (!world.getRegion(regions[i], region) || !region.readOnlyHeaders())
+				continue;
+			size_t begin = tiles.size();
+			const std::set<mc::ChunkPos>& region_chunks = region.getContainingChunks();
+			for (auto chunk_it = region_chunks.begin(); chunk_it != region_chunks.end();
+			        ++chunk_it) {
+				int timestamp = region.getChunkTimestamp(*chunk_it);
+
+				// now get all tiles of the chunk
+				chunk_tiles.clear();
+				mapChunkToTiles(*chunk_it, chunk_tiles);
+				for (auto tile_it = chunk_tiles.begin(); tile_it != chunk_tiles.end(); ++tile_it) {
+					RegionTile tile = {tile_it->getKey(), (int) i, timestamp};
+					tiles.push_back(tile);
+				}
+			}
+			// a tile is usually covered by many chunks of a region
+			mergeRegionTiles(tiles, begin);
+		}
+	};
+
+	std::vector<thread_ns::thread> scan_threads;
+	for (int i = 1; i < threads; i++)
+		scan_threads.push_back(thread_ns::thread(scan_regions, std::ref(thread_tiles[i])));
+	scan_regions(thread_tiles[0]);
+	for (size_t i = 0; i < scan_threads.size(); i++)
+		scan_threads[i].join();
+
+	// put the tiles of all threads together, sorted by tile and region
+	std::vector<RegionTile>& tiles = thread_tiles[0];
+	for (int i = 1; i < threads; i++) {
+		tiles.insert(tiles.end(), thread_tiles[i].begin(), thread_tiles[i].end());
+		std::vector<RegionTile>().swap(thread_tiles[i]);
+	}
+	std::sort(tiles.begin(), tiles.end());
 
 	// the min/max x/y coordinates of the tiles in the world
 	int tiles_x_min = std::numeric_limits<int>::max(),
 	    tiles_x_max = std::numeric_limits<int>::min(),
 	    tiles_y_min = std::numeric_limits<int>::max(),
 	    tiles_y_max = std::numeric_limits<int>::min();
-
-	// go through all chunks in the world
-	auto regions = world.getAvailableRegions();
-	for (auto region_it = regions.begin(); region_it != regions.end(); ++region_it) {
-		mc::RegionFile region;
-		if (!world.getRegion(*region_it, region) || !region.readOnlyHeaders())
+	size_t tiles_count = 0;
+	for (size_t i = 0; i < tiles.size(); i++) {
+		if (i != 0 && tiles[i - 1].tile == tiles[i].tile)
 			continue;
-		const std::set<mc::ChunkPos>& region_chunks = region.getContainingChunks();
-		for (auto chunk_it = region_chunks.begin(); chunk_it != region_chunks.end();
-		        ++chunk_it) {
-			int timestamp = region.getChunkTimestamp(*chunk_it);
-
-			// now get all tiles of the chunk
-			std::set<TilePos> tiles;
-			mapChunkToTiles(*chunk_it, tiles);
-			for (std::set<TilePos>::const_iterator tile_it = tiles.begin();
-			        tile_it != tiles.end(); ++tile_it) {
-
-				// and update the bounds
-				tiles_x_min = std::min(tiles_x_min, tile_it->getX());
-				tiles_x_max = std::max(tiles_x_max, tile_it->getX());
-				tiles_y_min = std::min(tiles_y_min, tile_it->getY());
-				tiles_y_max = std::max(tiles_y_max, tile_it->getY());
-
-				// update tile timestamp
-				if (!render_tiles.count(*tile_it))
-					tile_timestamps[*tile_it] = timestamp;
-				else
-					tile_timestamps[*tile_it] = std::max(tile_timestamps[*tile_it], timestamp);
-
-				// insert the tile to the set of available render tiles
-				// and also make it required by default
-				render_tiles.insert(*tile_it);
-				required_render_tiles.insert(*tile_it);
-			}
-		}
+		TilePos tile = TilePos::byKey(tiles[i].tile);
+		tiles_x_min = std::min(tiles_x_min, tile.getX());
+		tiles_x_max = std::max(tiles_x_max, tile.getX());
+		tiles_y_min = std::min(tiles_y_min, tile.getY());
+		tiles_y_max = std::max(tiles_y_max, tile.getY());
+		tiles_count++;
 	}
 
 	// center tiles
@@ -280,23 +412,30 @@ void TileSet::findRenderTiles(const mc::World& world, bool auto_center,
 		// find a tile center if we should do it automatically
 		if (auto_center)
 			tile_offset = TilePos((tiles_x_min + tiles_x_max) / 2, (tiles_y_min + tiles_y_max) / 2);
-
-		// update all tile positions
-		std::set<TilePos> render_tiles_tmp, required_render_tiles_tmp;
-		std::map<TilePos, int> tile_timestamps_tmp;
-		for (auto it = render_tiles.begin(); it != render_tiles.end(); ++it)
-			render_tiles_tmp.insert(*it - tile_offset);
-		for (auto it = required_render_tiles.begin(); it != required_render_tiles.end(); ++it)
-			required_render_tiles_tmp.insert(*it - tile_offset);
-		for (auto it = tile_timestamps.begin(); it != tile_timestamps.end(); ++it)
-			tile_timestamps_tmp[it->first - tile_offset] = it->second;
-
-		render_tiles = render_tiles_tmp;
-		required_render_tiles = required_render_tiles_tmp;
-		tile_timestamps = tile_timestamps_tmp;
 		this->tile_offset = tile_offset;
 	}
 
+	// insert the tiles to the available render tiles and also make them required by
+	// default, all regions of a tile are next to each other in the region order
+	render_tiles.reserve(tiles_count);
+	tile_regions.reserve(tiles.size());
+	RenderTile* render_tile = nullptr;
+	for (size_t i = 0; i < tiles.size(); i++) {
+		if (i == 0 || tiles[i - 1].tile != tiles[i].tile) {
+			TilePos tile = TilePos::byKey(tiles[i].tile) - tile_offset;
+			render_tile = &render_tiles[tile.getKey()];
+			render_tile->timestamp = tiles[i].timestamp;
+			render_tile->required = true;
+		} else {
+			render_tile->timestamp = std::max(render_tile->timestamp, tiles[i].timestamp);
+		}
+
+		TileRegion tile_region = {regions[tiles[i].region], render_tile->last_region};
+		render_tile->last_region = tile_regions.size();
+		tile_regions.push_back(tile_region);
+	}
+	required_render_tiles_count = render_tiles.size();
+
 	// now get the necessary depth of the tile quadtree
 	for (min_depth = 0; min_depth < 32; min_depth++) {
 		// for each level calculate the radius and check if the tiles fit in this bounds
@@ -310,99 +449,199 @@ void TileSet::findRenderTiles(const mc::World& world, bool auto_center,
 	}
 }
 
-void TileSet::findRequiredCompositeTiles(const std::set<TilePos>& render_tiles,
-		std::set<TilePath>& tiles) {
-
-	// iterate through the render tiles on the max zoom level
-	// add their parent composite tiles
-	for (std::set<TilePos>::iterator it = render_tiles.begin(); it != render_tiles.end(); ++it) {
-		TilePath path = TilePath::byTilePos(*it, depth);
-		tiles.insert(path.parent());
-	}
-
-	// now iterate through the composite tiles from bottom to top
-	// and also add their parent composite tiles
-	for (int d = depth - 1; d > 0; d--) {
-		std::set<TilePath> tmp;
-		for (std::set<TilePath>::iterator it = tiles.begin(); it != tiles.end(); ++it) {
-			if (it->getDepth() == d)
-				tmp.insert(it->parent());
+void TileSet::updateCompositeTiles() {
+	composite_tiles.clear();
+	recompose_tiles.clear();
+	required_composite_tiles_count = 0;
+
+	// paths of all render tiles with the count of required render tiles they contain
+	std::vector<std::pair<uint64_t, int>> level;
+	level.reserve(render_tiles.size());
+	render_tiles.forEach([&](uint64_t key, const RenderTile& tile) {
+		TilePath path = TilePath::byTilePos(TilePos::byKey(key), depth);
+		level.push_back(std::make_pair(path.getKey(), tile.required ? 1 : 0));
+	});
+	std::sort(level.begin(), level.end());
+
+	// build the zoom levels from bottom to top, every composite tile contains the
+	// required render tiles of its children
+	composite_tiles.reserve(level.size() / 3 + 1);
+	for (int d = depth; d > 0; d--) {
+		size_t end = 0;
+		for (size_t i = 0; i < level.size(); i++) {
+			uint64_t parent = TilePath::byKey(level[i].first).parent().getKey();
+			if (end != 0 && level[end - 1].first == parent)
+				level[end - 1].second += level[i].second;
+			else
+				level[end++] = std::make_pair(parent, level[i].second);
 		}
-		for (std::set<TilePath>::iterator it = tmp.begin(); it != tmp.end(); ++it)
-			tiles.insert(*it);
-	}
-}
+		level.resize(end);
 
-void TileSet::updateContainingRenderTiles() {
-	containing_render_tiles.clear();
-	// initialize every composite tile with 0
-	for (auto it = composite_tiles.begin(); it != composite_tiles.end(); ++it)
-		containing_render_tiles[*it] = 0;
-	// go through all required render tiles
-	// set the containing render tiles for every parent composite tile +1
-	// to have the number of required render tiles in every composite tile
-	for (auto it = required_render_tiles.begin(); it != required_render_tiles.end(); ++it) {
-		TilePath tile = TilePath::byTilePos(*it, depth);
-		while (tile.getDepth() != 0) {
-			tile = tile.parent();
-			containing_render_tiles[tile]++;
+		for (size_t i = 0; i < level.size(); i++) {
+			composite_tiles.insert(level[i].first, level[i].second);
+			if (level[i].second > 0 && d - 1 >= required_zoom_level)
+				required_composite_tiles_count++;
 		}
 	}
 }
 
-void TileSet::scan(const mc::World& world) {
+void TileSet::scan(const mc::World& world, int threads) {
 	TilePos tile_offset(0, 0);
-	scan(world, false, tile_offset);
+	scan(world, false, tile_offset, threads);
 }
 
-void TileSet::scan(const mc::World& world, bool auto_center, TilePos& tile_offset) {
-	findRenderTiles(world, auto_center, tile_offset);
+void TileSet::scan(const mc::World& world, bool auto_center, TilePos& tile_offset,
+		int threads) {
+	findRenderTiles(world, auto_center, tile_offset, threads);
 	setDepth(min_depth);
 }
 
 void TileSet::resetRequired() {
-	required_render_tiles.clear();
-
-	for (auto it = tile_timestamps.begin(); it != tile_timestamps.end(); ++it)
-		required_render_tiles.insert(it->first);
+	required_zoom_level = 0;
+	render_tiles.forEach([](uint64_t, RenderTile& tile) {
+		tile.required = true;
+	});
+	required_render_tiles_count = render_tiles.size();
 
-	required_composite_tiles.clear();
-	findRequiredCompositeTiles(required_render_tiles, required_composite_tiles);
-
-	updateContainingRenderTiles();
+	updateCompositeTiles();
 }
 
 void TileSet::scanRequiredByTimestamp(int last_change) {
-	required_render_tiles.clear();
-
-	for (std::map<TilePos, int>::iterator it = tile_timestamps.begin();
-			it != tile_timestamps.end(); ++it) {
-		if (it->second >= last_change)
-			required_render_tiles.insert(it->first);
-	}
+	required_zoom_level = 0;
+	required_render_tiles_count = 0;
+	render_tiles.forEach([&](uint64_t, RenderTile& tile) {
+		tile.required = tile.timestamp >= last_change;
+		required_render_tiles_count += tile.required;
+	});
 
-	required_composite_tiles.clear();
-	findRequiredCompositeTiles(required_render_tiles, required_composite_tiles);
-
-	updateContainingRenderTiles();
+	updateCompositeTiles();
 }
 
 void TileSet::scanRequiredByFiletimes(const fs::path& output_dir,
 		std::string image_format) {
-	required_render_tiles.clear();
-
-	for (std::map<TilePos, int>::iterator it = tile_timestamps.begin();
-			it != tile_timestamps.end(); ++it) {
-		TilePath path = TilePath::byTilePos(it->first, depth);
+	required_zoom_level = 0;
+	required_render_tiles_count = 0;
+	render_tiles.forEach([&](uint64_t key, RenderTile& tile) {
+		TilePath path = TilePath::byTilePos(TilePos::byKey(key), depth);
 		fs::path file = output_dir / (path.toString() + "." + image_format);
-		if (!fs::exists(file) || fs::last_write_time(file) <= it->second)
-			required_render_tiles.insert(it->first);
-	}
+		tile.required = !fs::exists(file) || fs::last_write_time(file) <= tile.timestamp;
+		required_render_tiles_count += tile.required;
+	});
 
-	required_composite_tiles.clear();
-	findRequiredCompositeTiles(required_render_tiles, required_composite_tiles);
+	updateCompositeTiles();
+}
+
+bool TileSet::scanRequiredByChunks(const std::map<mc::ChunkPos, uint32_t>& chunks) {
+	required_zoom_level = 0;
+	render_tiles.forEach([](uint64_t, RenderTile& tile) {
+		tile.required = false;
+	});
+	required_render_tiles_count = 0;
 
-	updateContainingRenderTiles();
+	// new render tiles must be within the bounds of the current zoom level
+	int radius = pow(2, depth) / 2;
+	bool all_tiles_fit = true;
+	std::vector<TilePos> chunk_tiles;
+	for (auto chunk_it = chunks.begin(); chunk_it != chunks.end(); ++chunk_it) {
+		mc::RegionPos region = chunk_it->first.getRegion();
+		chunk_tiles.clear();
+		mapChunkToTiles(chunk_it->first, chunk_tiles);
+		for (auto tile_it = chunk_tiles.begin(); tile_it != chunk_tiles.end(); ++tile_it) {
+			TilePos tile = *tile_it - tile_offset;
+			RenderTile* render_tile = render_tiles.find(tile.getKey());
+			if (render_tile == nullptr) {
+				if (tile.getX() <= -radius || tile.getX() >= radius
+						|| tile.getY() <= -radius || tile.getY() >= radius) {
+					all_tiles_fit = false;
+					continue;
+				}
+				render_tile = &render_tiles[tile.getKey()];
+			}
+			render_tile->timestamp = std::max(render_tile->timestamp, (int) chunk_it->second);
+			if (!render_tile->required) {
+				render_tile->required = true;
+				required_render_tiles_count++;
+			}
+
+			// the chunk might be in a region the tile didn't have chunks of yet
+			bool has_region = false;
+			for (int i = render_tile->last_region; i != -1 && !has_region;
+					i = tile_regions[i].previous)
+				has_region = tile_regions[i].region == region;
+			if (!has_region) {
+				TileRegion tile_region = {region, render_tile->last_region};
+				render_tile->last_region = tile_regions.size();
+				tile_regions.push_back(tile_region);
+			}
+		}
+	}
+
+	updateCompositeTiles();
+	return all_tiles_fit;
+}
+
+int TileSet::skipRenderedTiles(const std::vector<TilePath>& tiles, int rendered_since) {
+	TileHashMap<bool> rendered;
+	for (auto it = tiles.begin(); it != tiles.end(); ++it)
+		if (it->getDepth() < depth)
+			rendered.insert(it->getKey(), true);
+	// whether a tile or one of its parents was rendered completely
+	auto isRendered = [&rendered](TilePath path) {
+		while (!rendered.contains(path.getKey())) {
+			if (path.getDepth() == 0)
+				return false;
+			path = path.parent();
+		}
+		return true;
+	};
+
+	int skipped = 0;
+	render_tiles.forEach([&](uint64_t key, RenderTile& tile) {
+		if (!tile.required || tile.timestamp > rendered_since
+				|| !isRendered(TilePath::byTilePos(TilePos::byKey(key), depth)))
+			return;
+		tile.required = false;
+		skipped++;
+	});
+	required_render_tiles_count -= skipped;
+	updateCompositeTiles();
+
+	// the parents of the rendered tiles might not have been composed yet
+	for (auto it = tiles.begin(); it != tiles.end(); ++it) {
+		if (!composite_tiles.contains(it->getKey()))
+			continue;
+		for (TilePath path = *it; path.getDepth() > 0; ) {
+			path = path.parent();
+			if (isRendered(path) || path.getDepth() < required_zoom_level)
+				break;
+			if (composite_tiles[path.getKey()] == 0 && recompose_tiles.insert(path.getKey(), true))
+				required_composite_tiles_count++;
+		}
+	}
+	return skipped;
+}
+
+int TileSet::restrictRequiredTiles(const std::vector<TilePath>& subtrees, int zoom_level) {
+	TileHashMap<bool> shard;
+	for (auto it = subtrees.begin(); it != subtrees.end(); ++it)
+		shard.insert(it->getKey(), true);
+
+	int restricted = 0;
+	render_tiles.forEach([&](uint64_t key, RenderTile& tile) {
+		if (!tile.required)
+			return;
+		TilePath path = TilePath::byTilePos(TilePos::byKey(key), depth);
+		while (path.getDepth() > zoom_level)
+			path = path.parent();
+		if (shard.contains(path.getKey()))
+			return;
+		tile.required = false;
+		restricted++;
+	});
+	required_render_tiles_count -= restricted;
+	required_zoom_level = zoom_level;
+	updateCompositeTiles();
+	return restricted;
 }
 
 int TileSet::getTileWidth() const {
@@ -424,14 +663,8 @@ void TileSet::setDepth(int depth) {
 
 	this->depth = depth;
 
-	// clear already calculated composite tiles and recalculate them
-	composite_tiles.clear();
-	required_composite_tiles.clear();
-
-	findRequiredCompositeTiles(render_tiles, composite_tiles);
-	findRequiredCompositeTiles(required_render_tiles, required_composite_tiles);
-
-	updateContainingRenderTiles();
+	// recalculate the composite tiles
+	updateCompositeTiles();
 }
 
 const TilePos& TileSet::getTileOffset() const {
@@ -440,34 +673,80 @@ const TilePos& TileSet::getTileOffset() const {
 
 bool TileSet::hasTile(const TilePath& path) const {
 	if (path.getDepth() == depth)
-		return render_tiles.count(path.getTilePos()) != 0;
-	return composite_tiles.count(path) != 0;
+		return render_tiles.contains(path.getTilePos().getKey());
+	return composite_tiles.contains(path.getKey());
 }
 
 bool TileSet::isTileRequired(const TilePath& path) const {
-	if(path.getDepth() == depth)
-		return required_render_tiles.count(path.getTilePos()) != 0;
-	return required_composite_tiles.count(path) != 0;
+	if (path.getDepth() < required_zoom_level)
+		return false;
+	if (path.getDepth() == depth) {
+		const RenderTile* tile = render_tiles.find(path.getTilePos().getKey());
+		return tile != nullptr && tile->required;
+	}
+	const int* containing = composite_tiles.find(path.getKey());
+	return (containing != nullptr && *containing > 0) || recompose_tiles.contains(path.getKey());
 }
 
 int TileSet::getRequiredRenderTilesCount() const {
-	return required_render_tiles.size();
-}
-
-const std::set<TilePos>& TileSet::getRequiredRenderTiles() const {
-	return required_render_tiles;
+	return required_render_tiles_count;
 }
 
 int TileSet::getRequiredCompositeTilesCount() const {
-	return required_composite_tiles.size();
+	return required_composite_tiles_count;
 }
 
-const std::set<TilePath>& TileSet::getRequiredCompositeTiles() const {
-	return required_composite_tiles;
+std::vector<TilePath> TileSet::getRequiredCompositeTiles() const {
+	std::vector<uint64_t> keys;
+	keys.reserve(required_composite_tiles_count);
+	composite_tiles.forEach([&](uint64_t key, int containing) {
+		if ((containing > 0 || recompose_tiles.contains(key))
+				&& TilePath::byKey(key).getDepth() >= required_zoom_level)
+			keys.push_back(key);
+	});
+	// the order of the path keys is the order of the paths
+	std::sort(keys.begin(), keys.end());
+
+	std::vector<TilePath> tiles;
+	tiles.reserve(keys.size());
+	for (auto it = keys.begin(); it != keys.end(); ++it)
+		tiles.push_back(TilePath::byKey(*it));
+	return tiles;
 }
 
 int TileSet::getContainingRenderTiles(const TilePath& tile) const {
-	return containing_render_tiles.at(tile);
+	if (tile.getDepth() == depth)
+		return isTileRequired(tile) ? 1 : 0;
+	const int* containing = composite_tiles.find(tile.getKey());
+	return containing != nullptr ? *containing : 0;
+}
+
+void TileSet::getRequiredTileRegions(const TilePath& tile,
+		std::vector<mc::RegionPos>& regions) const {
+	std::set<mc::RegionPos> regions_found(regions.begin(), regions.end());
+	getRequiredTileRegions(tile, regions, regions_found);
+}
+
+void TileSet::getRequiredTileRegions(const TilePath& tile, std::vector<mc::RegionPos>& regions,
+		std::set<mc::RegionPos>& regions_found) const {
+	if (!isTileRequired(tile))
+		return;
+	if (tile.getDepth() != depth) {
+		// go through the children in the same order as the tile render worker
+		for (int i = 1; i <= 4; i++)
+			getRequiredTileRegions(tile + i, regions, regions_found);
+		return;
+	}
+
+	const RenderTile* render_tile = render_tiles.find(tile.getTilePos().getKey());
+	if (render_tile == nullptr)
+		return;
+	// the regions of a tile are linked from the last one to the first one
+	size_t first = regions.size();
+	for (int i = render_tile->last_region; i != -1; i = tile_regions[i].previous)
+		if (regions_found.insert(tile_regions[i].region).second)
+			regions.push_back(tile_regions[i].region);
+	std::reverse(regions.begin() + first, regions.end());
 }
 
 }
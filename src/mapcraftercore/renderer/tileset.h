@@ -20,12 +20,14 @@
 #ifndef TILE_H_
 #define TILE_H_
 
+#include <cstdint>
 #include <map>
 #include <set>
 #include <vector>
 #include <boost/filesystem.hpp>
 
 #include "renderrotation.h"
+#include "tilehashmap.h"
 
 namespace fs = boost::filesystem;
 
@@ -96,6 +98,16 @@ public:
 	bool operator!=(const TilePos& other) const;
 	bool operator<(const TilePos& other) const;
 
+	/**
+	 * Returns a 64 bit key identifying the tile position, used for the tile hash maps.
+	 */
+	uint64_t getKey() const;
+
+	/**
+	 * Returns the tile position of a key. Opposite of getKey-method.
+	 */
+	static TilePos byKey(uint64_t key);
+
 private:
 	// actual coordinates
 	int x, y;
@@ -107,9 +119,17 @@ std::ostream& operator<<(std::ostream& stream, const TilePos& tile);
  * This class represents the path to a tile in the quadtree.
  * Every part in the path is a 1, 2, 3 or 4.
  * The length of the path is the zoom level of the tile.
+ *
+ * The path is packed into a single 64 bit integer: The node of level i is stored as
+ * node-1 in the two bits starting at bit 62-2*i, the depth in the lowest six bits.
+ * Copying and comparing paths is therefore cheap and the numeric order of the keys is
+ * the same as the lexicographic order of the paths.
  */
 class TilePath {
 public:
+	// maximum zoom level a path can have
+	static const int MAX_DEPTH = 29;
+
 	TilePath();
 	~TilePath();
 
@@ -119,9 +139,9 @@ public:
 	int getDepth() const;
 
 	/**
-	 * Returns the path.
+	 * Returns the nodes of the path.
 	 */
-	const std::vector<int>& getPath() const;
+	std::vector<int> getPath() const;
 
 	/**
 	 * Returns the path of the parent tile.
@@ -142,6 +162,7 @@ public:
 
 	// some more comparison operations
 	bool operator==(const TilePath& other) const;
+	bool operator!=(const TilePath& other) const;
 	bool operator<(const TilePath& other) const;
 
 	/**
@@ -155,8 +176,25 @@ public:
 	 */
 	static TilePath byTilePos(const TilePos& tile, int depth);
 
+	/**
+	 * Parses the string representation of a path (for example "1/2/3/4", an empty
+	 * string is the root tile). Opposite of toString-method.
+	 * Throws a std::invalid_argument exception if the string isn't a valid path.
+	 */
+	static TilePath byString(const std::string& str);
+
+	/**
+	 * Returns the 64 bit key of the path, used for the tile hash maps.
+	 */
+	uint64_t getKey() const;
+
+	/**
+	 * Returns the path of a key. Opposite of getKey-method.
+	 */
+	static TilePath byKey(uint64_t key);
+
 private:
-	std::vector<int> path;
+	uint64_t key;
 };
 
 std::ostream& operator<<(std::ostream& stream, const TilePath& path);
@@ -169,7 +207,11 @@ public:
 	TileSet(int tile_width, const RenderRotation& rotation);
 	virtual ~TileSet();
 
-	virtual void mapChunkToTiles(const mc::ChunkPos& chunk, std::set<TilePos>& tiles) = 0;
+	/**
+	 * Appends the render tiles a chunk covers to the tiles vector. A tile may be
+	 * appended more than once.
+	 */
+	virtual void mapChunkToTiles(const mc::ChunkPos& chunk, std::vector<TilePos>& tiles) = 0;
 
 	/**
 	 * Scans the tiles of a world.
@@ -180,9 +222,12 @@ public:
 	 * found tiles. If set to false (default), it will use tile_offset as center. The
 	 * default value for tile_offset is (0, 0) when using scan without the
 	 * auto_center and tile_offset parameters.
+	 *
+	 * The region files of the world are scanned with the specified count of threads.
 	 */
-	void scan(const mc::World& world);
-	void scan(const mc::World& world, bool auto_center, TilePos& tile_offset);
+	void scan(const mc::World& world, int threads = 1);
+	void scan(const mc::World& world, bool auto_center, TilePos& tile_offset,
+			int threads = 1);
 
 	/**
 	 * Resets which tiles are required / not required. All tiles will be required.
@@ -202,6 +247,36 @@ public:
 	void scanRequiredByFiletimes(const fs::path& output_dir,
 			std::string image_format = "png");
 
+	/**
+	 * Marks just the render tiles with the specified chunks as required, for example the
+	 * chunks changed since the last rendering (with their new timestamps). Chunks
+	 * outside of the known render tiles add new render tiles.
+	 *
+	 * Returns false if some new render tiles don't fit into the current maximum zoom
+	 * level. These tiles are left out, the world needs to be scanned again for them.
+	 */
+	bool scanRequiredByChunks(const std::map<mc::ChunkPos, uint32_t>& chunks);
+
+	/**
+	 * Skips the required render tiles of composite tiles which were already rendered
+	 * completely by an interrupted rendering, unless the render tiles have changed since
+	 * the interrupted rendering was started. The composite tiles on the path to the root
+	 * tile stay required to be composed again.
+	 *
+	 * Returns the count of skipped render tiles.
+	 */
+	int skipRenderedTiles(const std::vector<TilePath>& tiles, int rendered_since);
+
+	/**
+	 * Restricts the required tiles to the subtrees of the specified tiles, which have
+	 * the specified zoom level (a shard of the tile set). The render tiles of other
+	 * subtrees aren't required anymore and neither are the composite tiles above that
+	 * zoom level, they are composed when all shards are rendered.
+	 *
+	 * Returns the count of render tiles which aren't required anymore.
+	 */
+	int restrictRequiredTiles(const std::vector<TilePath>& subtrees, int zoom_level);
+
 	/**
 	 * Returns the width of the tiles in chunks.
 	 */
@@ -243,29 +318,31 @@ public:
 	 */
 	int getRequiredRenderTilesCount() const;
 
-	/**
-	 * Returns the required render tiles.
-	 */
-	const std::set<TilePos>& getRequiredRenderTiles() const;
-
 	/**
 	 * Returns the count of required composite tiles.
 	 */
 	int getRequiredCompositeTilesCount() const;
 
 	/**
-	 * Returns the required composite tiles.
+	 * Returns the required composite tiles, sorted by their paths.
 	 */
-	const std::set<TilePath>& getRequiredCompositeTiles() const;
+	std::vector<TilePath> getRequiredCompositeTiles() const;
 
 	/**
-	 * Returns the count of required render tiles a specific composite tiles contains.
+	 * Returns the count of required render tiles a specific tile contains.
 	 */
 	int getContainingRenderTiles(const TilePath& tile) const;
 
+	/**
+	 * Returns the regions the required render tiles of a specific tile are made of.
+	 * The regions are in the order in which the render tiles get rendered.
+	 */
+	void getRequiredTileRegions(const TilePath& tile, std::vector<mc::RegionPos>& regions) const;
+
 protected:
-	// Need to keep the rotation of the world as it impacts tile/chunk relationship
-	const RenderRotation& rotation;
+	// Need to keep the rotation of the world as it impacts tile/chunk relationship,
+	// it's a copy because the tile set outlives the render view that created it
+	const RenderRotation rotation;
 
 private:
 	// width of the tiles in chunks
@@ -281,21 +358,43 @@ private:
 	// but are actually rendered as pos+tile_offset
 	TilePos tile_offset;
 
-	// all available render tiles
+	struct RenderTile {
+		RenderTile() : timestamp(0), last_region(-1), required(false) {}
+
+		// timestamp required to re-render the tile
+		// (= highest timestamp of all chunks in the tile)
+		int timestamp;
+		// index of the last region of the tile in tile_regions, -1 if none
+		int last_region;
+		// whether the tile actually needs to get rendered
+		bool required;
+	};
+
+	// a region with chunks of a render tile, all regions of a tile are a linked list
+	// from the last region to the first one
+	struct TileRegion {
+		mc::RegionPos region;
+		int previous;
+	};
+
+	// all available render tiles, key is the tile position
 	// (= tiles with the highest zoom level, tree leaves in the quadtree)
-	std::set<TilePos> render_tiles;
-	// the render tiles which actually need to get rendered
-	std::set<TilePos> required_render_tiles;
-	// timestamps of render tiles required to re-render a tile
-	// (= highest timestamp of all chunks in a tile)
-	std::map<TilePos, int> tile_timestamps;
-
-	// same here for composite tiles
-	std::set<TilePath> composite_tiles;
-	std::set<TilePath> required_composite_tiles;
-
-	// count of required render tiles contained in a composite tile
-	std::map<TilePath, int> containing_render_tiles;
+	TileHashMap<RenderTile> render_tiles;
+	int required_render_tiles_count;
+	// regions with the chunks of the render tiles
+	std::vector<TileRegion> tile_regions;
+
+	// all available composite tiles, key is the tile path and value the count of
+	// required render tiles contained in the composite tile
+	// (a composite tile is required if it contains required render tiles)
+	TileHashMap<int> composite_tiles;
+	int required_composite_tiles_count;
+	// composite tiles which don't contain required render tiles, but are required
+	// anyway because their children were rendered by an interrupted rendering
+	TileHashMap<bool> recompose_tiles;
+	// zoom level of the topmost required tiles, the tiles above are never required
+	// (0 unless the required tiles are restricted to a shard)
+	int required_zoom_level;
 
 	/**
 	 * This method finds out which render level tiles a world has and which maximum
@@ -303,22 +402,31 @@ private:
 	 *
 	 * The auto_center parameter describes whether it should automatically center the
 	 * found tiles. If set to false (default), it will use tile_offset as center.
+	 *
+	 * The region files are split between the threads, every thread collects the
+	 * (de-duplicated) tiles of its regions. The tiles of all threads are then sorted
+	 * and merged into the render tiles.
 	 */
-	void findRenderTiles(const mc::World& world, bool auto_center, TilePos& tile_offset);
+	void findRenderTiles(const mc::World& world, bool auto_center, TilePos& tile_offset,
+			int threads);
 
 	/**
-	 * This method finds out which composite tiles are needed, depending on a
-	 * list of available/required render tiles, and puts them into a set.
-	 * So we can find out which composite tiles are available and which composite tiles
-	 * need to get rendered.
+	 * This method finds out which composite tiles are needed, depending on the
+	 * available/required render tiles, and how many required render tiles every
+	 * composite tile contains.
+	 *
+	 * The paths of the render tiles are sorted once, then every zoom level is built
+	 * from the one below by replacing the paths with their parents and merging equal
+	 * neighbors (paths stay sorted when cutting off their last node).
 	 */
-	void findRequiredCompositeTiles(const std::set<TilePos>& render_tiles,
-			std::set<TilePath>& tiles);
+	void updateCompositeTiles();
 
 	/**
-	 * Updates the containing_render_tiles map.
+	 * Recursive helper for getRequiredTileRegions, the regions already found are also
+	 * stored in the set.
 	 */
-	void updateContainingRenderTiles();
+	void getRequiredTileRegions(const TilePath& tile, std::vector<mc::RegionPos>& regions,
+			std::set<mc::RegionPos>& regions_found) const;
 };
 
 }
@@ -0,0 +1,247 @@
+/*
+ * Copyright 2012-2016 Moritz Hilscher
+ *
+ * This file is part of Mapcrafter.
+ *
+ * Mapcrafter is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mapcrafter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mapcrafter.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "tilestore.h"
+
+#include "../util.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+namespace mapcrafter {
+namespace renderer {
+
+namespace {
+
+const char TRANSPARENT_MAGIC[8] = {'M', 'C', 'T', 'R', 'A', 'N', 'S', 'P'};
+
+struct TransparentHeader {
+	char magic[8];
+	int32_t depth;
+};
+
+bool readFile(const fs::path& file, std::string& data) {
+	std::ifstream in(file.string().c_str(), std::ios::binary);
+	if (!in)
+		return false;
+	data.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+	return !in.bad();
+}
+
+bool writeFile(const fs::path& file, const std::string& data) {
+	std::ofstream out(file.string().c_str(), std::ios::binary);
+	out.write(data.data(), data.size());
+	return !out.fail();
+}
+
+// 64 bit FNV-1a hash of the encoded image
+uint64_t hashData(const std::string& data) {
+	uint64_t hash = 0xcbf29ce484222325ull;
+	for (size_t i = 0; i < data.size(); i++) {
+		hash ^= (uint8_t) data[i];
+		hash *= 0x100000001b3ull;
+	}
+	return hash;
+}
+
+/**
+ * Reads the keys of the transparent tiles. The tile paths are moved to the deeper zoom
+ * levels in the same way as RenderManager::increaseMaxZoom moves the tiles (the top
+ * level tile n becomes n/5-n) if the zoom level has increased since.
+ */
+bool readTransparentTiles(const fs::path& filename, int depth, std::set<uint64_t>& tiles) {
+	std::ifstream in(filename.string().c_str(), std::ios::binary);
+	if (!in)
+		return false;
+
+	TransparentHeader header;
+	if (!in.read(reinterpret_cast<char*>(&header), sizeof(header))
+			|| std::memcmp(header.magic, TRANSPARENT_MAGIC, sizeof(TRANSPARENT_MAGIC)) != 0) {
+		LOG(WARNING) << "Ignoring invalid transparent tiles file " << filename << ".";
+		return false;
+	}
+	int old_depth = util::bigEndian32(header.depth);
+	if (old_depth > depth)
+		return false;
+
+	uint64_t key;
+	while (in.read(reinterpret_cast<char*>(&key), sizeof(key))) {
+		TilePath tile = TilePath::byKey(util::bigEndian64(key));
+		// the top level tiles are composed again anyways when the zoom level increases
+		if (old_depth != depth && tile.getDepth() == 0)
+			continue;
+		for (int d = old_depth; d < depth; d++) {
+			std::vector<int> path = tile.getPath();
+			tile = TilePath() + path[0] + (5 - path[0]);
+			for (size_t i = 1; i < path.size(); i++)
+				tile += path[i];
+		}
+		tiles.insert(tile.getKey());
+	}
+	return true;
+}
+
+}
+
+TileStore::TileStore(const fs::path& output_dir, const fs::path& store_dir)
+	: filename(output_dir / "transparent.tiles"), store_dir(store_dir), depth(0) {
+}
+
+TileStore::~TileStore() {
+}
+
+void TileStore::read(const TileSet& tile_set) {
+	thread_ns::unique_lock<thread_ns::mutex> lock(mutex);
+	depth = tile_set.getDepth();
+	transparent.clear();
+	added.clear();
+	removed.clear();
+	readTransparentTiles(filename, depth, transparent);
+}
+
+bool TileStore::write() {
+	thread_ns::unique_lock<thread_ns::mutex> lock(mutex);
+	// start again with the file, it might have been changed by another process
+	std::set<uint64_t> tiles;
+	readTransparentTiles(filename, depth, tiles);
+	for (auto it = removed.begin(); it != removed.end(); ++it)
+		tiles.erase(*it);
+	tiles.insert(added.begin(), added.end());
+
+	boost::system::error_code error;
+	fs::create_directories(filename.parent_path(), error);
+	fs::path temp_filename = filename.string() + ".tmp";
+	std::ofstream out(temp_filename.string().c_str(), std::ios::binary);
+	if (!out) {
+		LOG(WARNING) << "Unable to write transparent tiles file " << filename << ".";
+		return false;
+	}
+	TransparentHeader header;
+	std::memcpy(header.magic, TRANSPARENT_MAGIC, sizeof(TRANSPARENT_MAGIC));
+	header.depth = util::bigEndian32(depth);
+	out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	for (auto it = tiles.begin(); it != tiles.end(); ++it) {
+		uint64_t key = util::bigEndian64(*it);
+		out.write(reinterpret_cast<const char*>(&key), sizeof(key));
+	}
+	out.close();
+	if (!out) {
+		LOG(WARNING) << "Unable to write transparent tiles file " << filename << ".";
+		fs::remove(temp_filename, error);
+		return false;
+	}
+	fs::rename(temp_filename, filename, error);
+	if (error) {
+		LOG(WARNING) << "Unable to write transparent tiles file " << filename << ".";
+		return false;
+	}
+	transparent.swap(tiles);
+	added.clear();
+	removed.clear();
+	return true;
+}
+
+bool TileStore::isTransparent(const TilePath& tile) const {
+	thread_ns::unique_lock<thread_ns::mutex> lock(mutex);
+	return transparent.count(tile.getKey()) || added.count(tile.getKey());
+}
+
+void TileStore::setTransparent(const TilePath& tile, const fs::path& file) {
+	boost::system::error_code error;
+	fs::remove(file, error);
+
+	thread_ns::unique_lock<thread_ns::mutex> lock(mutex);
+	added.insert(tile.getKey());
+	removed.erase(tile.getKey());
+}
+
+bool TileStore::storeTile(const TilePath& tile, const std::string& data,
+		const fs::path& file) {
+	uint64_t hash = hashData(data);
+	char name[17];
+	std::snprintf(name, sizeof(name), "%016llx", (unsigned long long) hash);
+	fs::path stored = store_dir / std::string(name, 2) / (name + file.extension().string());
+
+	{
+		thread_ns::unique_lock<thread_ns::mutex> lock(mutex);
+		if (transparent.count(tile.getKey()) || added.count(tile.getKey())) {
+			added.erase(tile.getKey());
+			removed.insert(tile.getKey());
+		}
+	}
+
+	// a new image is written to a temporary file which is linked into the store, the
+	// link fails if another thread or process stored an image with this hash meanwhile
+	boost::system::error_code error;
+	fs::path temp_file = file.string() + ".tmp" + file.extension().string();
+	bool written = false, new_image = false;
+	if (!fs::exists(stored, error)) {
+		if (!writeFile(temp_file, data))
+			return false;
+		written = true;
+		fs::create_directories(stored.parent_path(), error);
+		fs::create_hard_link(temp_file, stored, error);
+		new_image = !error;
+	}
+
+	std::string stored_data;
+	if (!new_image && (!readFile(stored, stored_data) || stored_data != data)) {
+		// a hash collision (or a broken stored image), don't deduplicate this tile
+		fs::remove(file, error);
+		if (written)
+			return util::moveFile(temp_file, file);
+		return writeFile(file, data);
+	}
+
+	if (written)
+		fs::remove(temp_file, error);
+	// the tile file isn't written directly, it might be a hard link to another image
+	fs::remove(file, error);
+	fs::create_hard_link(stored, file, error);
+	// copy the image if the file system doesn't support hard links
+	if (error && !util::copyFile(stored, file))
+		return false;
+	return true;
+}
+
+int TileStore::removeUnused(const fs::path& store_dir) {
+	boost::system::error_code error;
+	if (!fs::is_directory(store_dir, error))
+		return 0;
+	std::vector<fs::path> unused;
+	for (fs::recursive_directory_iterator it(store_dir, error), end; it != end; it.increment(error)) {
+		if (error)
+			break;
+		// an image is only used by tiles if there are other links than the stored one
+		if (fs::is_regular_file(it->path(), error)
+				&& fs::hard_link_count(it->path(), error) == 1 && !error)
+			unused.push_back(it->path());
+	}
+	int removed = 0;
+	for (auto it = unused.begin(); it != unused.end(); ++it)
+		if (fs::remove(*it, error))
+			removed++;
+	return removed;
+}
+
+}
+}
@@ -0,0 +1,99 @@
+/*
+ * Copyright 2012-2016 Moritz Hilscher
+ *
+ * This file is part of Mapcrafter.
+ *
+ * Mapcrafter is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mapcrafter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mapcrafter.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TILESTORE_H_
+#define TILESTORE_H_
+
+#include "tileset.h"
+#include "../compat/thread.h"
+
+#include <cstdint>
+#include <set>
+#include <string>
+#include <boost/filesystem.hpp>
+
+namespace fs = boost::filesystem;
+
+namespace mapcrafter {
+namespace renderer {
+
+/**
+ * Deduplicates the tile images of a map/rotation.
+ *
+ * Every unique tile image is stored once in a store directory (shared by all maps),
+ * named by the hash of the encoded image. The tile files are hard links to the stored
+ * images. Completely transparent tiles aren't written at all, they are recorded in the
+ * file transparent.tiles in the output directory of the map/rotation instead (a header
+ * with the zoom level of the tile set, followed by the 64 bit keys of the tile paths).
+ */
+class TileStore {
+public:
+	TileStore(const fs::path& output_dir, const fs::path& store_dir);
+	~TileStore();
+
+	/**
+	 * Reads which tiles of a tile set are transparent. The tile paths are moved to the
+	 * deeper zoom levels if the maximum zoom level of the tile set has increased since.
+	 */
+	void read(const TileSet& tile_set);
+
+	/**
+	 * Writes which tiles are transparent. Tiles marked or stored by other processes
+	 * rendering into the same output directory (like shards) in the meantime are kept.
+	 */
+	bool write();
+
+	/**
+	 * Returns whether a tile is transparent and has no image file.
+	 */
+	bool isTransparent(const TilePath& tile) const;
+
+	/**
+	 * Marks a tile as transparent and removes its image file.
+	 * This method is thread-safe.
+	 */
+	void setTransparent(const TilePath& tile, const fs::path& file);
+
+	/**
+	 * Stores the encoded image of a tile: The image is written into the store if there
+	 * isn't an identical image yet, then the tile file becomes a hard link to the stored
+	 * image.
+	 * This method is thread-safe.
+	 */
+	bool storeTile(const TilePath& tile, const std::string& data, const fs::path& file);
+
+	/**
+	 * Removes the stored images which aren't used by tiles anymore.
+	 * Returns the count of removed images.
+	 */
+	static int removeUnused(const fs::path& store_dir);
+
+private:
+	fs::path filename, store_dir;
+
+	mutable thread_ns::mutex mutex;
+	// the transparent tiles and the changes since they were read
+	std::set<uint64_t> transparent, added, removed;
+	int depth;
+};
+
+}
+}
+
+#endif /* TILESTORE_H_ */
@@ -19,158 +19,367 @@
 
 #include "multithreading.h"
 
+#include "../../mc/blockstate.h"
+#include "../../mc/regionprefetcher.h"
 #include "../../mc/worldcache.h"
 #include "../../renderer/tileset.h"
 #include "../../util.h"
 
+#include <algorithm>
+#include <cmath>
 #include <cstdlib>
 
 namespace mapcrafter {
 namespace thread {
 
-ThreadManager::ThreadManager()
-	: finished(false) {
+RenderJob::RenderJob(const renderer::RenderContext& context)
+	: context(context), work_queued(0), work_running(0), finished(false) {
 }
 
-ThreadManager::~ThreadManager() {
+RenderJob::~RenderJob() {
 }
 
-void ThreadManager::addWork(const renderer::RenderWork& work) {
-	thread_ns::unique_lock<thread_ns::mutex> lock(mutex);
-	work_queue.push(work);
+const renderer::RenderContext& RenderJob::getRenderContext() const {
+	return context;
 }
 
-void ThreadManager::addExtraWork(const renderer::RenderWork& work) {
-	thread_ns::unique_lock<thread_ns::mutex> lock(mutex);
-	work_extra_queue.push(work);
-	condition_wait_jobs.notify_one();
+ThreadWorker::ThreadWorker(MultiThreadingDispatcher& dispatcher)
+	: dispatcher(dispatcher) {
 }
 
-void ThreadManager::setFinished() {
-	thread_ns::unique_lock<thread_ns::mutex> lock(mutex);
-	this->finished = true;
-	condition_wait_jobs.notify_all();
-	condition_wait_results.notify_all();
+ThreadWorker::~ThreadWorker() {
 }
 
-bool ThreadManager::getWork(renderer::RenderWork& work) {
-	thread_ns::unique_lock<thread_ns::mutex> lock(mutex);
-	while (!finished && (work_queue.empty() && work_extra_queue.empty()))
-		condition_wait_jobs.wait(lock);
-	if (finished)
-		return false;
-	if (!work_extra_queue.empty())
-		work = work_extra_queue.pop();
-	else if (!work_queue.empty())
-		work = work_queue.pop();
-	return true;
+void ThreadWorker::operator()() {
+	std::shared_ptr<RenderJob> job;
+	renderer::RenderWork work;
+
+	while (dispatcher.getWork(job, work)) {
+		renderer::TileRenderWorker& render_worker = getRenderWorker(job);
+		render_worker.setRenderWork(work);
+		render_worker();
+
+		dispatcher.workFinished(job, render_worker.getRenderWorkResult());
+		job.reset();
+	}
 }
 
-void ThreadManager::workFinished(const renderer::RenderWork& work,
-		const renderer::RenderWorkResult& result) {
-	thread_ns::unique_lock<thread_ns::mutex> lock(mutex);
-	if (!result_queue.empty())
-		result_queue.push(result);
-	else {
-		result_queue.push(result);
-		condition_wait_results.notify_one();
+renderer::TileRenderWorker& ThreadWorker::getRenderWorker(const std::shared_ptr<RenderJob>& job) {
+	const renderer::RenderContext& context = job->getRenderContext();
+	WorldCacheKey world_cache_key(context.world_config.getShortName(), context.block_registry);
+
+	// forget the jobs that are finished and the world caches no other job needs
+	for (auto it = job_workers.begin(); it != job_workers.end(); ) {
+		if (it->second.job.expired())
+			it = job_workers.erase(it);
+		else
+			++it;
+	}
+	for (auto it = world_caches.begin(); it != world_caches.end(); ) {
+		bool used = it->first == world_cache_key;
+		for (auto job_it = job_workers.begin(); !used && job_it != job_workers.end(); ++job_it)
+			used = job_it->second.world_cache_key == it->first;
+		if (!used)
+			it = world_caches.erase(it);
+		else
+			++it;
+	}
+
+	CachedWorld& cached_world = world_caches[world_cache_key];
+	if (!cached_world.world_cache || cached_world.world != context.world) {
+		cached_world.world = context.world;
+		cached_world.world_cache.reset(new mc::WorldCache(*context.block_registry, *context.world));
+	}
+	std::shared_ptr<mc::WorldCache>& world_cache = cached_world.world_cache;
+	// the world cache might have been used by another job before, the tile renderers
+	// look up their chunks again for every tile (see TileRenderer::renderTile)
+	world_cache->setRegionPrefetcher(context.region_prefetcher.get());
+
+	JobWorker& job_worker = job_workers[job.get()];
+	if (!job_worker.render_worker) {
+		renderer::RenderContext thread_context = context;
+		thread_context.initializeTileRenderer(world_cache);
+		job_worker.job = job;
+		job_worker.world_cache_key = world_cache_key;
+		job_worker.render_worker = std::make_shared<renderer::TileRenderWorker>();
+		job_worker.render_worker->setRenderContext(thread_context);
 	}
+	return *job_worker.render_worker;
 }
 
-bool ThreadManager::getResult(renderer::RenderWorkResult& result) {
-	thread_ns::unique_lock<thread_ns::mutex> lock(mutex);
-	while (!finished && result_queue.empty())
-		condition_wait_results.wait(lock);
-	if (finished)
-		return false;
-	result = result_queue.pop();
-	return true;
+MultiThreadingDispatcher::MultiThreadingDispatcher(int threads)
+	: thread_count(threads), stopping(false) {
+	for (int i = 0; i < thread_count; i++)
+		this->threads.push_back(thread_ns::thread(ThreadWorker(*this)));
 }
 
-ThreadWorker::ThreadWorker(WorkerManager<renderer::RenderWork, renderer::RenderWorkResult>& manager,
-		const renderer::RenderContext& context)
-	: manager(manager), render_context(context) {
-	render_worker.setRenderContext(context);
+MultiThreadingDispatcher::~MultiThreadingDispatcher() {
+	{
+		thread_ns::unique_lock<thread_ns::mutex> lock(mutex);
+		stopping = true;
+		condition_wait_work.notify_all();
+	}
+	for (size_t i = 0; i < threads.size(); i++)
+		threads[i].join();
 }
 
-ThreadWorker::~ThreadWorker() {
+int MultiThreadingDispatcher::getThreadCount() const {
+	return thread_count;
 }
 
-void ThreadWorker::operator()() {
-	renderer::RenderWork work;
+void MultiThreadingDispatcher::dispatch(const renderer::RenderContext& context,
+		util::IProgressHandler* progress) {
+	wait(submit(context, progress));
+}
 
-	while (manager.getWork(work)) {
-		render_worker.setRenderWork(work);
-		render_worker();
+std::shared_ptr<RenderJob> MultiThreadingDispatcher::submit(
+		const renderer::RenderContext& context, util::IProgressHandler* progress) {
+	return submit(std::vector<renderer::RenderContext>(1, context), progress).front();
+}
+
+namespace {
 
-		manager.workFinished(work, render_worker.getRenderWorkResult());
+/**
+ * Returns the region in the middle of the regions a composite tile needs.
+ */
+mc::RegionPos getCenterRegion(const std::vector<mc::RegionPos>& regions) {
+	if (regions.empty())
+		return mc::RegionPos();
+	long x = 0, z = 0;
+	for (auto it = regions.begin(); it != regions.end(); ++it) {
+		x += it->x;
+		z += it->z;
 	}
+	return mc::RegionPos(std::floor((double) x / regions.size()),
+			std::floor((double) z / regions.size()));
 }
 
-MultiThreadingDispatcher::MultiThreadingDispatcher(int threads)
-	: thread_count(threads) {
+/**
+ * Returns the distance of a composite tile to the nearest of the priority tiles (render
+ * tiles with points of interest) in render tiles, 0 if there are no priority tiles.
+ */
+double getPriorityDistance(const renderer::TilePath& tile,
+		const std::vector<renderer::TilePath>& priority_tiles) {
+	double distance = 0;
+	for (auto it = priority_tiles.begin(); it != priority_tiles.end(); ++it) {
+		renderer::TilePath priority = *it;
+		while (priority.getDepth() > tile.getDepth())
+			priority = priority.parent();
+		renderer::TilePos a = tile.getTilePos(), b = priority.getTilePos();
+		double dx = a.getX() - b.getX(), dy = a.getY() - b.getY();
+		double tile_distance = std::sqrt(dx * dx + dy * dy)
+				* (1 << (it->getDepth() - tile.getDepth()));
+		if (it == priority_tiles.begin() || tile_distance < distance)
+			distance = tile_distance;
+	}
+	return distance;
 }
 
-MultiThreadingDispatcher::~MultiThreadingDispatcher() {
 }
 
-void MultiThreadingDispatcher::dispatch(const renderer::RenderContext& context,
+std::vector<std::shared_ptr<RenderJob> > MultiThreadingDispatcher::submit(
+		const std::vector<renderer::RenderContext>& contexts,
 		util::IProgressHandler* progress) {
-	auto tiles = context.tile_set->getRequiredCompositeTiles();
-	if (tiles.size() == 0)
-		return;
+	std::vector<std::shared_ptr<RenderJob> > submitted;
+	std::shared_ptr<RenderJob::WorkQueue> work_queue = std::make_shared<RenderJob::WorkQueue>();
+	std::shared_ptr<RenderJob::Progress> job_progress
+		= std::make_shared<RenderJob::Progress>(progress);
 
-	int jobs = 0;
-	for (auto tile_it = tiles.begin(); tile_it != tiles.end(); ++tile_it)
-		if (tile_it->getDepth() == context.tile_set->getDepth() - 2) {
-			renderer::RenderWork work;
-			work.tiles.insert(*tile_it);
-			manager.addWork(work);
-			jobs++;
+	// the work of every job is split into the composite tiles two levels above the
+	// render tiles, together with the regions they need
+	bool priority = false;
+	std::vector<double> work_priorities;
+	std::vector<mc::RegionPos> work_regions;
+	std::vector<std::vector<mc::RegionPos> > work_required_regions;
+	for (auto context_it = contexts.begin(); context_it != contexts.end(); ++context_it) {
+		const renderer::TileSet* tile_set = context_it->tile_set;
+		std::shared_ptr<RenderJob> job = std::make_shared<RenderJob>(*context_it);
+		job->work_queue = work_queue;
+		job->progress = job_progress;
+		job_progress->max += tile_set->getRequiredRenderTilesCount();
+		submitted.push_back(job);
+		priority = priority || !context_it->priority_tiles.empty();
+
+		// (the tiles of the level of detail zoom level are rendered as a whole)
+		int work_depth = std::max(std::min(tile_set->getDepth() - 2,
+				context_it->getDetailZoomLevel()), 0);
+		auto tiles = tile_set->getRequiredCompositeTiles();
+		for (auto tile_it = tiles.begin(); tile_it != tiles.end(); ++tile_it) {
+			// composite tiles above without required children (their children were
+			// rendered by an interrupted rendering) are just composed again, and
+			// composite tiles below without required parent (the tiles of a shard
+			// are restricted to subtrees below) are rendered as a whole
+			bool required_childs = false;
+			for (int i = 1; i <= 4 && tile_it->getDepth() < work_depth; i++)
+				required_childs = required_childs || tile_set->isTileRequired(*tile_it + i);
+			if (tile_it->getDepth() == work_depth
+					|| (tile_it->getDepth() < work_depth && !required_childs)
+					|| (tile_it->getDepth() > work_depth
+							&& !tile_set->isTileRequired(tile_it->parent()))) {
+				renderer::RenderWork work;
+				work.tiles.insert(*tile_it);
+				work_queue->push_back(std::make_pair(job.get(), work));
+				job->work_queued++;
+
+				std::vector<mc::RegionPos> regions;
+				tile_set->getRequiredTileRegions(*tile_it, regions);
+				work_priorities.push_back(getPriorityDistance(*tile_it,
+						context_it->priority_tiles));
+				work_regions.push_back(getCenterRegion(regions));
+				work_required_regions.push_back(regions);
+			}
 		}
+	}
 
-	//int render_tiles = context.tile_set->getRequiredRenderTilesCount();
-	//LOG(INFO) << thread_count << " threads will render " << render_tiles << " render tiles.";
+	// interleave the work of multiple jobs, ordered by region (row by row),
+	// the work nearest to the points of interest comes first
+	std::vector<size_t> order(work_queue->size());
+	for (size_t i = 0; i < order.size(); i++)
+		order[i] = i;
+	if (contexts.size() > 1 || priority) {
+		bool by_region = contexts.size() > 1;
+		std::stable_sort(order.begin(), order.end(),
+				[&work_priorities, &work_regions, by_region](size_t a, size_t b) {
+			if (work_priorities[a] != work_priorities[b])
+				return work_priorities[a] < work_priorities[b];
+			if (!by_region)
+				return false;
+			const mc::RegionPos& region_a = work_regions[a];
+			const mc::RegionPos& region_b = work_regions[b];
+			if (region_a.z != region_b.z)
+				return region_a.z < region_b.z;
+			return region_a.x < region_b.x;
+		});
+		RenderJob::WorkQueue ordered;
+		for (size_t i = 0; i < order.size(); i++)
+			ordered.push_back((*work_queue)[order[i]]);
+		work_queue->swap(ordered);
+	}
 
-	for (int i = 0; i < thread_count; i++) {
-		renderer::RenderContext thread_context = context;
-		thread_context.initializeTileRenderer();
-		threads.push_back(thread_ns::thread(ThreadWorker(manager, thread_context)));
-	}
-
-	progress->setMax(context.tile_set->getRequiredRenderTilesCount());
-	renderer::RenderWorkResult result;
-	while (manager.getResult(result)) {
-		progress->setValue(progress->getValue() + result.tiles_rendered);
-		for (auto tile_it = result.render_work.tiles.begin();
-				tile_it != result.render_work.tiles.end(); ++tile_it) {
-			rendered_tiles.insert(*tile_it);
-			if (*tile_it == renderer::TilePath()) {
-				manager.setFinished();
-				continue;
+	// let the prefetchers read the regions in the order of the work queue
+	for (size_t i = 0; i < order.size(); i++) {
+		const renderer::RenderContext& context = (*work_queue)[i].first->getRenderContext();
+		if (context.region_prefetcher)
+			context.region_prefetcher->prefetch(work_required_regions[order[i]]);
+	}
+
+	thread_ns::unique_lock<thread_ns::mutex> lock(mutex);
+	for (auto job_it = submitted.begin(); job_it != submitted.end(); ++job_it) {
+		if ((*job_it)->work_queued == 0)
+			(*job_it)->finished = true;
+		else
+			jobs.push_back(*job_it);
+	}
+	if (!jobs.empty() && jobs.front()->progress == job_progress)
+		updateProgress(*job_progress);
+	condition_wait_work.notify_all();
+	return submitted;
+}
+
+void MultiThreadingDispatcher::waitForTail(const std::shared_ptr<RenderJob>& job) {
+	thread_ns::unique_lock<thread_ns::mutex> lock(mutex);
+	while (!job->finished && job->work_queued > 0)
+		condition_wait_jobs.wait(lock);
+}
+
+void MultiThreadingDispatcher::wait(const std::shared_ptr<RenderJob>& job) {
+	thread_ns::unique_lock<thread_ns::mutex> lock(mutex);
+	while (!job->finished)
+		condition_wait_jobs.wait(lock);
+}
+
+bool MultiThreadingDispatcher::getWork(std::shared_ptr<RenderJob>& job,
+		renderer::RenderWork& work) {
+	thread_ns::unique_lock<thread_ns::mutex> lock(mutex);
+	while (!stopping) {
+		// the parent tiles of rendered work are composed first, so finished areas of
+		// the maps are complete as early as possible
+		for (auto it = jobs.begin(); it != jobs.end(); ++it) {
+			RenderJob& candidate = **it;
+			if (!candidate.work_extra_queue.empty()) {
+				work = candidate.work_extra_queue.front();
+				candidate.work_extra_queue.pop();
+				candidate.work_running++;
+				job = *it;
+				return true;
+			}
+		}
+		// older jobs first, so the threads move on to the next job only when idle
+		for (auto it = jobs.begin(); it != jobs.end(); ++it) {
+			RenderJob& candidate = **it;
+			if (!candidate.work_queue->empty()) {
+				// the work queue might be shared with other jobs submitted together
+				RenderJob* work_job = candidate.work_queue->front().first;
+				work = candidate.work_queue->front().second;
+				candidate.work_queue->pop_front();
+				if (--work_job->work_queued == 0)
+					condition_wait_jobs.notify_all();
+				work_job->work_running++;
+				for (auto job_it = it; job_it != jobs.end(); ++job_it)
+					if (job_it->get() == work_job)
+						job = *job_it;
+				return true;
 			}
+		}
+		condition_wait_work.wait(lock);
+	}
+	return false;
+}
 
-			renderer::TilePath parent = tile_it->parent();
-			bool childs_rendered = true;
-			for (int i = 1; i <= 4; i++)
-				if (context.tile_set->isTileRequired(parent + i)
-						&& !rendered_tiles.count(parent + i)) {
-					childs_rendered = false;
-				}
+void MultiThreadingDispatcher::workFinished(const std::shared_ptr<RenderJob>& job,
+		const renderer::RenderWorkResult& result) {
+	thread_ns::unique_lock<thread_ns::mutex> lock(mutex);
+	const renderer::TileSet* tile_set = job->context.tile_set;
+	job->progress->value += result.tiles_rendered;
+	job->work_running--;
 
-			if (childs_rendered) {
-				renderer::RenderWork work;
-				work.tiles.insert(parent);
-				for (int i = 1; i <= 4; i++)
-					if (context.tile_set->hasTile(parent + i))
-						work.tiles_skip.insert(parent + i);
-				manager.addExtraWork(work);
+	for (auto tile_it = result.render_work.tiles.begin();
+			tile_it != result.render_work.tiles.end(); ++tile_it) {
+		job->rendered_tiles.insert(tile_it->getKey());
+		// the parent tiles are composed when all of their required children are rendered,
+		// up to the root tile (or the topmost tiles of a shard)
+		if (*tile_it == renderer::TilePath() || !tile_set->isTileRequired(tile_it->parent()))
+			continue;
+
+		renderer::TilePath parent = tile_it->parent();
+		bool childs_rendered = true;
+		for (int i = 1; i <= 4; i++)
+			if (tile_set->isTileRequired(parent + i)
+					&& !job->rendered_tiles.contains((parent + i).getKey())) {
+				childs_rendered = false;
 			}
+
+		if (childs_rendered) {
+			renderer::RenderWork work;
+			work.tiles.insert(parent);
+			for (int i = 1; i <= 4; i++)
+				if (tile_set->hasTile(parent + i))
+					work.tiles_skip.insert(parent + i);
+			job->work_extra_queue.push(work);
+			condition_wait_work.notify_one();
 		}
 	}
+	job->finished = job->work_queued == 0 && job->work_extra_queue.empty()
+			&& job->work_running == 0;
 
-	for (int i = 0; i < thread_count; i++)
-		threads[i].join();
+	if (jobs.front()->progress == job->progress || job->finished)
+		updateProgress(*job->progress);
+	if (job->finished) {
+		jobs.remove(job);
+		if (!jobs.empty())
+			updateProgress(*jobs.front()->progress);
+		condition_wait_jobs.notify_all();
+	}
+}
+
+void MultiThreadingDispatcher::updateProgress(RenderJob::Progress& progress) {
+	if (progress.handler == nullptr)
+		return;
+	if (!progress.started) {
+		progress.handler->setMax(progress.max);
+		progress.started = true;
+	}
+	progress.handler->setValue(progress.value);
 }
 
 } /* namespace thread */
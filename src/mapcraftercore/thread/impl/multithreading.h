@@ -20,69 +20,179 @@
 #ifndef MULTITHREADING_H_
 #define MULTITHREADING_H_
 
-#include "concurrentqueue.h"
 #include "../dispatcher.h"
-#include "../workermanager.h"
 #include "../../compat/thread.h"
+#include "../../renderer/tilehashmap.h"
 #include "../../renderer/tilerenderworker.h"
 
-#include <set>
+#include <deque>
+#include <list>
+#include <map>
+#include <memory>
+#include <queue>
+#include <string>
 #include <thread>
+#include <utility>
 #include <vector>
 
 namespace mapcrafter {
+
+namespace mc {
+class BlockStateRegistry;
+class WorldCache;
+}
+
 namespace thread {
 
-class ThreadManager : public WorkerManager<renderer::RenderWork, renderer::RenderWorkResult> {
-public:
-	ThreadManager();
-	virtual ~ThreadManager();
+class MultiThreadingDispatcher;
 
-	void addWork(const renderer::RenderWork& work);
-	void addExtraWork(const renderer::RenderWork& work);
-	void setFinished();
+/**
+ * The render work of one map/rotation that was submitted to the render threads.
+ */
+class RenderJob {
+public:
+	RenderJob(const renderer::RenderContext& context);
+	~RenderJob();
 
-	virtual bool getWork(renderer::RenderWork& work);
-	virtual void workFinished(const renderer::RenderWork& work, const renderer::RenderWorkResult& result);
+	const renderer::RenderContext& getRenderContext() const;
 
-	bool getResult(renderer::RenderWorkResult& result);
 private:
-	ConcurrentQueue<renderer::RenderWork> work_queue, work_extra_queue;
-	ConcurrentQueue<renderer::RenderWorkResult> result_queue;
-
+	// the render work of the jobs that were submitted together, in the order to render it
+	typedef std::deque<std::pair<RenderJob*, renderer::RenderWork> > WorkQueue;
+
+	// the progress of the jobs that were submitted together
+	struct Progress {
+		Progress(util::IProgressHandler* handler)
+			: handler(handler), max(0), value(0), started(false) {}
+
+		util::IProgressHandler* handler;
+		int max, value;
+		bool started;
+	};
+
+	renderer::RenderContext context;
+
+	// composite tiles to render, parent tiles whose children are rendered are extra work
+	std::shared_ptr<WorkQueue> work_queue;
+	std::queue<renderer::RenderWork> work_extra_queue;
+	// how much work of this job is still in the (shared) work queue
+	int work_queued;
+	// how much work of this job the render threads are rendering right now
+	int work_running;
+	renderer::TileHashSet rendered_tiles;
+
+	std::shared_ptr<Progress> progress;
 	bool finished;
-	thread_ns::mutex mutex;
-	thread_ns::condition_variable condition_wait_jobs, condition_wait_results;
+
+	friend class MultiThreadingDispatcher;
 };
 
+/**
+ * A render thread. It keeps a tile renderer for every job it worked on and the world
+ * caches of their worlds, so a world cache stays warm between the jobs rendering the
+ * same world (for example the rotations of a map).
+ */
 class ThreadWorker {
 public:
-	ThreadWorker(WorkerManager<renderer::RenderWork, renderer::RenderWorkResult>& manager,
-			const renderer::RenderContext& context);
+	ThreadWorker(MultiThreadingDispatcher& dispatcher);
 	~ThreadWorker();
 
 	void operator()();
-private:
-	WorkerManager<renderer::RenderWork, renderer::RenderWorkResult>& manager;
 
-	renderer::RenderContext render_context;
-	renderer::TileRenderWorker render_worker;
+private:
+	/**
+	 * Returns the tile render worker of a job, creates it if this thread did not work on
+	 * the job yet and releases the tile renderers and world caches of finished jobs.
+	 */
+	renderer::TileRenderWorker& getRenderWorker(const std::shared_ptr<RenderJob>& job);
+
+	// world caches are shared by the jobs with the same world and block registry
+	typedef std::pair<std::string, const mc::BlockStateRegistry*> WorldCacheKey;
+
+	struct CachedWorld {
+		// the world object the cache was created for, a world cache is created again
+		// if the world was reloaded (for example because its region files changed)
+		std::shared_ptr<mc::World> world;
+		std::shared_ptr<mc::WorldCache> world_cache;
+	};
+
+	struct JobWorker {
+		std::weak_ptr<RenderJob> job;
+		WorldCacheKey world_cache_key;
+		std::shared_ptr<renderer::TileRenderWorker> render_worker;
+	};
+
+	MultiThreadingDispatcher& dispatcher;
+
+	std::map<const RenderJob*, JobWorker> job_workers;
+	std::map<WorldCacheKey, CachedWorld> world_caches;
 };
 
+/**
+ * Renders maps with a pool of render threads. The threads are started once and render
+ * all submitted jobs in order. A job is allowed to use the threads which have no work
+ * left of the previous jobs, so the next map/rotation can be submitted while the
+ * previous one is still rendering its last tiles.
+ */
 class MultiThreadingDispatcher : public Dispatcher {
 public:
 	MultiThreadingDispatcher(int threads);
 	virtual ~MultiThreadingDispatcher();
 
+	int getThreadCount() const;
+
+	/**
+	 * Submits the render work of a map/rotation and waits until it is rendered.
+	 */
 	virtual void dispatch(const renderer::RenderContext& context,
 			util::IProgressHandler* progress);
+
+	/**
+	 * Submits the render work of a map/rotation to the render threads and returns
+	 * immediately. The progress handler is only updated while the job is the oldest
+	 * unfinished job.
+	 */
+	std::shared_ptr<RenderJob> submit(const renderer::RenderContext& context,
+			util::IProgressHandler* progress);
+
+	/**
+	 * Submits the render work of multiple maps/rotations of the same world together.
+	 * Their work is interleaved and ordered by the world regions it needs, so the world
+	 * caches of the render threads read each region just once for all jobs. The progress
+	 * handler shows the progress of all jobs.
+	 */
+	std::vector<std::shared_ptr<RenderJob> > submit(
+			const std::vector<renderer::RenderContext>& contexts,
+			util::IProgressHandler* progress);
+
+	/**
+	 * Waits until all render work of a job was handed to the render threads. The job
+	 * might still be rendering, but there are idle threads for the next job.
+	 */
+	void waitForTail(const std::shared_ptr<RenderJob>& job);
+
+	/**
+	 * Waits until a job is rendered completely.
+	 */
+	void wait(const std::shared_ptr<RenderJob>& job);
+
 private:
-	int thread_count;
+	bool getWork(std::shared_ptr<RenderJob>& job, renderer::RenderWork& work);
+	void workFinished(const std::shared_ptr<RenderJob>& job,
+			const renderer::RenderWorkResult& result);
+	void updateProgress(RenderJob::Progress& progress);
 
-	ThreadManager manager;
+	int thread_count;
 	std::vector<thread_ns::thread> threads;
 
-	std::set<renderer::TilePath> rendered_tiles;
+	// unfinished jobs in the order they were submitted
+	std::list<std::shared_ptr<RenderJob> > jobs;
+	bool stopping;
+
+	thread_ns::mutex mutex;
+	thread_ns::condition_variable condition_wait_work, condition_wait_jobs;
+
+	friend class ThreadWorker;
 };
 
 } /* namespace thread */
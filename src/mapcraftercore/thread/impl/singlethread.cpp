@@ -19,6 +19,7 @@
 
 #include "singlethread.h"
 
+#include "../../mc/regionprefetcher.h"
 #include "../../mc/worldcache.h"
 #include "../../renderer/tilerenderworker.h"
 #include "../../renderer/tileset.h"
@@ -38,13 +39,29 @@ SingleThreadDispatcher::~SingleThreadDispatcher() {
 void SingleThreadDispatcher::dispatch(const renderer::RenderContext& context,
 		util::IProgressHandler* progress) {
 	int render_tiles = context.tile_set->getRequiredRenderTilesCount();
-	if (render_tiles == 0)
+	if (render_tiles == 0 && context.tile_set->getRequiredCompositeTilesCount() == 0)
 		return;
 
 	LOG(INFO) << "Single thread will render " << render_tiles << " render tiles.";
 
+	// render from the root tile, or from the topmost tiles of a shard if the required
+	// tiles are restricted to subtrees
 	renderer::RenderWork work;
-	work.tiles.insert(renderer::TilePath());
+	if (context.tile_set->isTileRequired(renderer::TilePath())) {
+		work.tiles.insert(renderer::TilePath());
+	} else {
+		auto tiles = context.tile_set->getRequiredCompositeTiles();
+		for (auto it = tiles.begin(); it != tiles.end(); ++it)
+			if (!context.tile_set->isTileRequired(it->parent()))
+				work.tiles.insert(*it);
+	}
+
+	if (context.region_prefetcher) {
+		std::vector<mc::RegionPos> regions;
+		for (auto it = work.tiles.begin(); it != work.tiles.end(); ++it)
+			context.tile_set->getRequiredTileRegions(*it, regions);
+		context.region_prefetcher->prefetch(regions);
+	}
 
 	renderer::TileRenderWorker worker;
 	worker.setRenderContext(context);
@@ -37,6 +37,7 @@
 #include "util/progress.h"
 #include "util/math.h"
 #include "util/other.h"
+#include "util/profiling.h"
 #include "util/terminal.h"
 
 #endif /* UTIL_H_ */
@@ -0,0 +1,171 @@
+/*
+ * Copyright 2012-2016 Moritz Hilscher
+ *
+ * This file is part of Mapcrafter.
+ *
+ * Mapcrafter is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mapcrafter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mapcrafter.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "profiling.h"
+
+#include "logging.h"
+
+#include <cstdio>
+
+namespace mapcrafter {
+namespace util {
+
+const char* getProfilePhaseName(ProfilePhase phase) {
+	switch (phase) {
+	case ProfilePhase::CHUNK_IO: return "chunk_io";
+	case ProfilePhase::DECOMPRESSION: return "decompression";
+	case ProfilePhase::NBT_PARSE: return "nbt_parse";
+	case ProfilePhase::PALETTE_RESOLVE: return "palette_resolve";
+	case ProfilePhase::COLUMN_TRAVERSAL: return "column_traversal";
+	case ProfilePhase::BLOCK_DRAW: return "block_draw";
+	case ProfilePhase::RENDERMODE_DRAW: return "rendermode_draw";
+	case ProfilePhase::COMPOSITING: return "compositing";
+	case ProfilePhase::DOWNSCALING: return "downscaling";
+	case ProfilePhase::ENCODE_WRITE: return "encode_write";
+	default: return "unknown";
+	}
+}
+
+const char* getProfileCounterName(ProfileCounter counter) {
+	switch (counter) {
+	case ProfileCounter::RENDER_TILES: return "render_tiles";
+	case ProfileCounter::COMPOSITE_TILES: return "composite_tiles";
+	case ProfileCounter::BLOCKS_DRAWN: return "blocks_drawn";
+	case ProfileCounter::REGION_CACHE_HITS: return "region_cache_hits";
+	case ProfileCounter::REGION_CACHE_MISSES: return "region_cache_misses";
+	case ProfileCounter::CHUNK_CACHE_HITS: return "chunk_cache_hits";
+	case ProfileCounter::CHUNK_CACHE_MISSES: return "chunk_cache_misses";
+	case ProfileCounter::TINT_CACHE_HITS: return "tint_cache_hits";
+	case ProfileCounter::TINT_CACHE_MISSES: return "tint_cache_misses";
+	default: return "unknown";
+	}
+}
+
+RenderProfile::RenderProfile()
+	: wall_time(0), threads(0) {
+	for (int i = 0; i < (int) ProfilePhase::COUNT; i++)
+		phase_nanos[i] = phase_calls[i] = 0;
+	for (int i = 0; i < (int) ProfileCounter::COUNT; i++)
+		counters[i] = 0;
+}
+
+void RenderProfile::merge(const RenderProfile& other) {
+	for (int i = 0; i < (int) ProfilePhase::COUNT; i++) {
+		phase_nanos[i] += other.phase_nanos[i];
+		phase_calls[i] += other.phase_calls[i];
+	}
+	for (int i = 0; i < (int) ProfileCounter::COUNT; i++)
+		counters[i] += other.counters[i];
+}
+
+double RenderProfile::getTotalTime() const {
+	uint64_t total = 0;
+	for (int i = 0; i < (int) ProfilePhase::COUNT; i++)
+		total += phase_nanos[i];
+	return total / 1e9;
+}
+
+void RenderProfile::log(const std::string& title) const {
+	double total = getTotalTime();
+	LOG(INFO) << title << " (" << threads << " threads, " << wall_time << "s wall time, "
+		<< total << "s thread time):";
+	char line[128];
+	for (int i = 0; i < (int) ProfilePhase::COUNT; i++) {
+		double seconds = phase_nanos[i] / 1e9;
+		std::snprintf(line, sizeof(line), "  %-18s %10.3fs %6.1f%% %12llu calls",
+				getProfilePhaseName((ProfilePhase) i), seconds,
+				total > 0 ? seconds / total * 100 : 0.0, (unsigned long long) phase_calls[i]);
+		LOG(INFO) << line;
+	}
+	for (int i = 0; i < (int) ProfileCounter::COUNT; i++) {
+		std::snprintf(line, sizeof(line), "  %-20s %12llu",
+				getProfileCounterName((ProfileCounter) i), (unsigned long long) counters[i]);
+		LOG(INFO) << line;
+	}
+}
+
+picojson::value RenderProfile::toJSON() const {
+	picojson::object phases_json, counters_json, profile_json;
+	for (int i = 0; i < (int) ProfilePhase::COUNT; i++) {
+		picojson::object phase_json;
+		phase_json["seconds"] = picojson::value(phase_nanos[i] / 1e9);
+		phase_json["calls"] = picojson::value((double) phase_calls[i]);
+		phases_json[getProfilePhaseName((ProfilePhase) i)] = picojson::value(phase_json);
+	}
+	for (int i = 0; i < (int) ProfileCounter::COUNT; i++)
+		counters_json[getProfileCounterName((ProfileCounter) i)] = picojson::value((double) counters[i]);
+	profile_json["wall_time"] = picojson::value(wall_time);
+	profile_json["thread_time"] = picojson::value(getTotalTime());
+	profile_json["threads"] = picojson::value((double) threads);
+	profile_json["phases"] = picojson::value(phases_json);
+	profile_json["counters"] = picojson::value(counters_json);
+	return picojson::value(profile_json);
+}
+
+ProfileCollector::ProfileCollector() {
+}
+
+void ProfileCollector::merge(const RenderProfile& profile) {
+	thread_ns::unique_lock<thread_ns::mutex> lock(mutex);
+	this->profile.merge(profile);
+}
+
+RenderProfile ProfileCollector::getProfile() const {
+	thread_ns::unique_lock<thread_ns::mutex> lock(mutex);
+	return profile;
+}
+
+thread_local RenderProfile* ProfileThreadScope::current_profile = nullptr;
+thread_local ProfileTimer* ProfileThreadScope::current_timer = nullptr;
+
+ProfileThreadScope::ProfileThreadScope(RenderProfile* profile)
+	: previous_profile(current_profile), previous_timer(current_timer) {
+	current_profile = profile;
+	current_timer = nullptr;
+}
+
+ProfileThreadScope::~ProfileThreadScope() {
+	current_profile = previous_profile;
+	current_timer = previous_timer;
+}
+
+void ProfileTimer::start(ProfilePhase phase) {
+	this->phase = phase;
+	started = clock::now();
+	// pause the outer timer
+	outer = ProfileThreadScope::current_timer;
+	if (outer != nullptr)
+		profile->phase_nanos[(int) outer->phase] += std::chrono::duration_cast<
+			std::chrono::nanoseconds>(started - outer->started).count();
+	ProfileThreadScope::current_timer = this;
+	profile->phase_calls[(int) phase]++;
+}
+
+void ProfileTimer::stop() {
+	clock::time_point now = clock::now();
+	profile->phase_nanos[(int) phase] += std::chrono::duration_cast<
+		std::chrono::nanoseconds>(now - started).count();
+	// and continue the outer timer
+	ProfileThreadScope::current_timer = outer;
+	if (outer != nullptr)
+		outer->started = now;
+}
+
+}
+}
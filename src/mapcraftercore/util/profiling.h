@@ -0,0 +1,196 @@
+/*
+ * Copyright 2012-2016 Moritz Hilscher
+ *
+ * This file is part of Mapcrafter.
+ *
+ * Mapcrafter is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mapcrafter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mapcrafter.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PROFILING_H_
+#define PROFILING_H_
+
+#include "picojson.h"
+#include "../compat/thread.h"
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+namespace mapcrafter {
+namespace util {
+
+/**
+ * The phases of the rendering process which are timed by the profiler.
+ */
+enum class ProfilePhase {
+	// reading region files
+	CHUNK_IO,
+	// decompressing and parsing the chunk NBT data
+	DECOMPRESSION,
+	NBT_PARSE,
+	// converting the block state / biome palettes of the chunk sections
+	PALETTE_RESOLVE,
+	// iterating over the blocks of the tiles and looking up their neighbors
+	COLUMN_TRAVERSAL,
+	// preparing and blending the block images
+	BLOCK_DRAW,
+	// drawing of the render modes (lighting, overlays, ...)
+	RENDERMODE_DRAW,
+	// blitting block images onto render tiles and child tiles onto composite tiles
+	COMPOSITING,
+	// resizing tiles for their parent composite tiles
+	DOWNSCALING,
+	// encoding and writing the tile images (and reading already rendered ones)
+	ENCODE_WRITE,
+	COUNT
+};
+
+/**
+ * Additional counters collected by the profiler.
+ */
+enum class ProfileCounter {
+	RENDER_TILES,
+	COMPOSITE_TILES,
+	BLOCKS_DRAWN,
+	REGION_CACHE_HITS,
+	REGION_CACHE_MISSES,
+	CHUNK_CACHE_HITS,
+	CHUNK_CACHE_MISSES,
+	TINT_CACHE_HITS,
+	TINT_CACHE_MISSES,
+	COUNT
+};
+
+const char* getProfilePhaseName(ProfilePhase phase);
+const char* getProfileCounterName(ProfileCounter counter);
+
+/**
+ * Timings and counters of the rendering process.
+ *
+ * Every render thread collects its own profile (see ProfileThreadScope), the profiles
+ * of the threads are merged into one when the rendering is finished.
+ */
+struct RenderProfile {
+	RenderProfile();
+
+	void merge(const RenderProfile& other);
+
+	/**
+	 * Returns the sum of the time spent in all phases (in seconds).
+	 */
+	double getTotalTime() const;
+
+	/**
+	 * Logs the profile as table.
+	 */
+	void log(const std::string& title) const;
+
+	/**
+	 * Returns the profile as json object.
+	 */
+	picojson::value toJSON() const;
+
+	uint64_t phase_nanos[(int) ProfilePhase::COUNT];
+	uint64_t phase_calls[(int) ProfilePhase::COUNT];
+	uint64_t counters[(int) ProfileCounter::COUNT];
+	// wall clock time of the whole rendering (in seconds), not merged
+	double wall_time;
+	int threads;
+};
+
+/**
+ * Collects the profiles of multiple render threads.
+ */
+class ProfileCollector {
+public:
+	ProfileCollector();
+
+	void merge(const RenderProfile& profile);
+	RenderProfile getProfile() const;
+
+private:
+	mutable thread_ns::mutex mutex;
+	RenderProfile profile;
+};
+
+class ProfileTimer;
+
+/**
+ * Sets the profile of the current thread as long as this object exists. If the profile
+ * is null (the default when profiling is disabled), nothing is recorded.
+ */
+class ProfileThreadScope {
+public:
+	ProfileThreadScope(RenderProfile* profile);
+	~ProfileThreadScope();
+
+	/**
+	 * Returns the profile of the current thread (may be null).
+	 */
+	static RenderProfile* getProfile() {
+		return current_profile;
+	}
+
+private:
+	RenderProfile* previous_profile;
+	ProfileTimer* previous_timer;
+
+	static thread_local RenderProfile* current_profile;
+	static thread_local ProfileTimer* current_timer;
+
+	friend class ProfileTimer;
+};
+
+/**
+ * Measures the time of a phase while the object exists. Nested timers pause the outer
+ * timers, so the time of each phase doesn't include the time of other phases.
+ */
+class ProfileTimer {
+public:
+	ProfileTimer(ProfilePhase phase)
+		: profile(ProfileThreadScope::current_profile) {
+		if (profile != nullptr)
+			start(phase);
+	}
+
+	~ProfileTimer() {
+		if (profile != nullptr)
+			stop();
+	}
+
+private:
+	typedef std::chrono::steady_clock clock;
+
+	void start(ProfilePhase phase);
+	void stop();
+
+	RenderProfile* profile;
+	ProfileTimer* outer;
+	ProfilePhase phase;
+	clock::time_point started;
+};
+
+/**
+ * Increases a counter of the profile of the current thread.
+ */
+inline void profileCount(ProfileCounter counter, uint64_t value = 1) {
+	RenderProfile* profile = ProfileThreadScope::getProfile();
+	if (profile != nullptr)
+		profile->counters[(int) counter] += value;
+}
+
+}
+}
+
+#endif /* PROFILING_H_ */
@@ -17,13 +17,71 @@
  * along with Mapcrafter.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include "../mapcraftercore/config.h"
+#include "../mapcraftercore/renderer/blockatlas.h"
+#include "../mapcraftercore/renderer/coveragemask.h"
 #include "../mapcraftercore/renderer/image.h"
+#include "../mapcraftercore/util.h"
 
+#include <algorithm>
 #include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <unordered_set>
+#include <vector>
+#include <png.h>
+#include <boost/filesystem.hpp>
 #include <boost/test/unit_test.hpp>
 
 namespace renderer = mapcrafter::renderer;
 
+namespace {
+
+void pngWriteString(png_structp png, png_bytep data, png_size_t length) {
+	((std::string*) png_get_io_ptr(png))->append((const char*) data, length);
+}
+
+/**
+ * Encodes an image with libpng and the same settings as the PNG encoding options.
+ */
+std::string writePNGWithLibpng(const renderer::RGBAImage& image,
+		const renderer::PNGEncodingOptions& options) {
+	std::string out;
+	png_structp png = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+	png_infop info = png_create_info_struct(png);
+	if (setjmp(png_jmpbuf(png))) {
+		png_destroy_write_struct(&png, &info);
+		return "";
+	}
+
+	int filters = PNG_ALL_FILTERS;
+	switch (options.filter) {
+	case renderer::PNGFilter::NONE: filters = PNG_FILTER_NONE; break;
+	case renderer::PNGFilter::SUB: filters = PNG_FILTER_SUB; break;
+	case renderer::PNGFilter::UP: filters = PNG_FILTER_UP; break;
+	case renderer::PNGFilter::AVERAGE: filters = PNG_FILTER_AVG; break;
+	case renderer::PNGFilter::PAETH: filters = PNG_FILTER_PAETH; break;
+	default: break;
+	}
+	png_set_filter(png, PNG_FILTER_TYPE_BASE, filters);
+	png_set_compression_level(png, options.fast_deflate
+			? std::min(options.compression_level, 3) : options.compression_level);
+
+	png_set_write_fn(png, (png_voidp) &out, pngWriteString, NULL);
+	png_set_IHDR(png, info, image.getWidth(), image.getHeight(), 8, PNG_COLOR_TYPE_RGB_ALPHA,
+			PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+	std::vector<png_bytep> rows(image.getHeight());
+	for (int y = 0; y < image.getHeight(); y++)
+		rows[y] = (png_bytep) &image.data[y * image.getWidth()];
+	png_set_rows(png, info, &rows[0]);
+	png_write_png(png, info, mapcrafter::util::isBigEndian()
+			? PNG_TRANSFORM_BGR | PNG_TRANSFORM_SWAP_ALPHA : PNG_TRANSFORM_IDENTITY, NULL);
+	png_destroy_write_struct(&png, &info);
+	return out;
+}
+
+}
+
 BOOST_AUTO_TEST_CASE(image_testIO) {
 	renderer::RGBAImage src(400, 200);
 	renderer::RGBAImage dest;
@@ -50,3 +108,189 @@ BOOST_AUTO_TEST_CASE(image_testIO) {
 		}
 	}
 }
+
+BOOST_AUTO_TEST_CASE(image_testPNGEncodingOptions) {
+	renderer::RGBAImage src(300, 150);
+	for(int x = 0; x < src.getWidth(); x++) {
+		for(int y = 0; y < src.getHeight(); y++) {
+			// some gradients and noise, so every filter is useful somewhere
+			src.setPixel(x, y, renderer::rgba(x % 256, (x + y) % 256,
+					(y < 75 ? rand() % 256 : y), x < 150 ? 255 : rand() % 256));
+		}
+	}
+
+	renderer::PNGFilter filters[] = {renderer::PNGFilter::NONE, renderer::PNGFilter::SUB,
+		renderer::PNGFilter::UP, renderer::PNGFilter::AVERAGE, renderer::PNGFilter::PAETH,
+		renderer::PNGFilter::ALL};
+	for (int level = 0; level <= 9; level += 3) {
+		for (size_t i = 0; i < 6; i++) {
+			for (int fast = 0; fast < 2; fast++) {
+				renderer::PNGEncodingOptions options(level, filters[i], fast);
+				renderer::RGBAImage dest;
+				BOOST_CHECK(src.writePNG("test.png", options));
+				BOOST_CHECK(dest.readPNG("test.png"));
+				BOOST_CHECK_EQUAL(dest.getWidth(), src.getWidth());
+				BOOST_CHECK_EQUAL(dest.getHeight(), src.getHeight());
+				BOOST_CHECK(dest.data == src.data);
+
+				// and the encoder writes the same bytes as libpng with these settings
+				std::ostringstream out;
+				BOOST_CHECK(src.writePNG(out, options));
+				BOOST_CHECK_MESSAGE(out.str() == writePNGWithLibpng(src, options),
+						"PNG differs from libpng (level " << level << ", filter "
+						<< filters[i] << ", fast deflate " << fast << ")");
+			}
+		}
+	}
+
+	// small images use a smaller zlib window, like libpng does
+	renderer::RGBAImage small(5, 3);
+	for (size_t i = 0; i < small.data.size(); i++)
+		small.data[i] = renderer::rgba(i * 10, i * 20, i * 30, 255);
+	std::ostringstream out;
+	BOOST_CHECK(small.writePNG(out));
+	BOOST_CHECK(out.str() == writePNGWithLibpng(small, renderer::PNGEncodingOptions()));
+}
+
+#ifdef HAVE_WEBP
+
+BOOST_AUTO_TEST_CASE(image_testWebP) {
+	renderer::RGBAImage src(400, 200);
+	renderer::RGBAImage dest;
+
+	for(int x = 0; x < src.getWidth(); x++) {
+		for(int y = 0; y < src.getHeight(); y++) {
+			src.setPixel(x, y, renderer::rgba(rand() % 256, rand() % 256,
+					rand() % 256, rand() % 256));
+		}
+	}
+
+	if(!src.writeWebP("test.webp", 85, true))
+		BOOST_ERROR("Unable to write image!");
+	if(!dest.readWebP("test.webp"))
+		BOOST_ERROR("Unable to read image!");
+
+	BOOST_CHECK_EQUAL(dest.getWidth(), src.getWidth());
+	BOOST_CHECK_EQUAL(dest.getHeight(), src.getHeight());
+
+	// lossless WebP keeps all visible pixels, but not the color of invisible ones
+	for(int x = 0; x < dest.getWidth(); x++) {
+		for(int y = 0; y < dest.getHeight(); y++) {
+			renderer::RGBAPixel pixel = src.getPixel(x, y);
+			if(renderer::rgba_alpha(pixel) == 0)
+				pixel = 0;
+			if(renderer::rgba_alpha(dest.getPixel(x, y)) == 0)
+				BOOST_CHECK_EQUAL(pixel, 0);
+			else if(pixel != dest.getPixel(x, y))
+				BOOST_ERROR("Images aren't equal!");
+		}
+	}
+}
+
+#endif
+
+BOOST_AUTO_TEST_CASE(image_testCoverageMask) {
+	// blitting only the images that are visible according to the coverage mask
+	// must result in the same image as blitting all images
+	std::vector<renderer::RGBAImage> images;
+	std::vector<int> xs, ys;
+	for (int i = 0; i < 200; i++) {
+		renderer::RGBAImage image(8 + rand() % 16, 8 + rand() % 16);
+		for (size_t j = 0; j < image.data.size(); j++) {
+			int alpha = rand() % 4;
+			alpha = alpha == 0 ? 0 : (alpha == 1 ? rand() % 256 : 255);
+			image.data[j] = renderer::rgba(rand() % 256, rand() % 256, rand() % 256, alpha);
+		}
+		images.push_back(image);
+		xs.push_back(rand() % 48 - 8);
+		ys.push_back(rand() % 48 - 8);
+	}
+
+	renderer::RGBAImage all(32, 32), visible(32, 32);
+	for (size_t i = 0; i < images.size(); i++)
+		all.alphaBlit(images[i], xs[i], ys[i]);
+
+	renderer::CoverageMask coverage;
+	coverage.reset(32, 32);
+	BOOST_CHECK(coverage.isEmpty());
+	std::vector<bool> images_visible(images.size());
+	for (size_t i = images.size(); i-- > 0; )
+		images_visible[i] = coverage.cover(images[i], xs[i], ys[i]);
+	BOOST_CHECK(!coverage.isEmpty());
+	BOOST_CHECK(coverage.isCovered(images[0], xs[0], ys[0]));
+	BOOST_CHECK(!images_visible[0]);
+	for (size_t i = 0; i < images.size(); i++)
+		if (images_visible[i])
+			visible.alphaBlit(images[i], xs[i], ys[i]);
+	BOOST_CHECK(all.data == visible.data);
+
+	coverage.clear();
+	BOOST_CHECK(coverage.isEmpty());
+	BOOST_CHECK(!coverage.isCovered(images[0], xs[0], ys[0]));
+}
+
+BOOST_AUTO_TEST_CASE(image_testBlockAtlasScaleDown) {
+	namespace fs = boost::filesystem;
+	using renderer::rgba;
+
+	// an atlas with two 4x4 blocks, the second one is a uv image
+	renderer::RGBAImage atlas(8, 4);
+	// top left: the colors are weighted by their alpha (the fully transparent pixel
+	// doesn't count), the alpha is the one of the top left pixel
+	atlas.setPixel(0, 0, rgba(200, 0, 0, 255));
+	atlas.setPixel(1, 0, rgba(0, 200, 0, 255));
+	atlas.setPixel(0, 1, rgba(0, 0, 200, 255));
+	atlas.setPixel(1, 1, rgba(100, 100, 100, 0));
+	// top right: semi-transparent
+	atlas.setPixel(2, 0, rgba(255, 255, 255, 51));
+	atlas.setPixel(3, 0, rgba(0, 0, 0, 204));
+	// bottom left: the top left pixel is transparent, so the pixel is too
+	atlas.setPixel(1, 2, rgba(50, 50, 50, 255));
+	atlas.setPixel(0, 3, rgba(50, 50, 50, 255));
+	atlas.setPixel(1, 3, rgba(50, 50, 50, 255));
+	// bottom right: solid
+	atlas.fill(rgba(10, 20, 30, 255), 2, 2, 2, 2);
+	for (int x = 0; x < 4; x++)
+		for (int y = 0; y < 4; y++)
+			atlas.setPixel(4 + x, y, rgba(x * 60, y * 60, 42 * (x + y), 255));
+
+	fs::path dir = fs::temp_directory_path() / "mapcrafter_test_atlas";
+	fs::remove_all(dir);
+	fs::create_directories(dir);
+	BOOST_REQUIRE(atlas.writePNG((dir / "blocks.png").string()));
+	std::ofstream((dir / "blocks.txt").string()) << "4 4 2" << std::endl;
+
+	std::unordered_set<uint32_t> uv_images = {1};
+	renderer::BlockAtlas halved;
+	BOOST_REQUIRE(halved.OpenDictionnary(dir, "blocks"));
+	halved.ScaleDown(2, uv_images);
+	BOOST_CHECK_EQUAL(halved.GetBlockWidth(), 2);
+	const renderer::RGBAImage& block = *halved.GetImage(0);
+	BOOST_REQUIRE_EQUAL(block.getWidth(), 2);
+	BOOST_REQUIRE_EQUAL(block.getHeight(), 2);
+	BOOST_CHECK_EQUAL(block.getPixel(0, 0), rgba(66, 66, 66, 255));
+	BOOST_CHECK_EQUAL(block.getPixel(1, 0), rgba(51, 51, 51, 51));
+	BOOST_CHECK_EQUAL(block.getPixel(0, 1), 0);
+	BOOST_CHECK_EQUAL(block.getPixel(1, 1), rgba(10, 20, 30, 255));
+
+	// the pixels of uv images aren't mixed
+	const renderer::RGBAImage& uv = *halved.GetImage(1);
+	BOOST_REQUIRE_EQUAL(uv.getWidth(), 2);
+	for (int x = 0; x < 2; x++)
+		for (int y = 0; y < 2; y++) {
+			renderer::RGBAPixel pixel = uv.getPixel(x, y);
+			bool source = false;
+			for (int i = 0; i < 4; i++)
+				source = source || pixel == atlas.getPixel(4 + 2 * x + i % 2, 2 * y + i / 2);
+			BOOST_CHECK(source);
+		}
+
+	// scaling down by four halves twice
+	renderer::BlockAtlas quartered;
+	BOOST_REQUIRE(quartered.OpenDictionnary(dir, "blocks"));
+	quartered.ScaleDown(4, uv_images);
+	BOOST_REQUIRE_EQUAL(quartered.GetImage(0)->getWidth(), 1);
+	BOOST_CHECK_EQUAL(quartered.GetImage(0)->getPixel(0, 0), rgba(39, 43, 48, 255));
+
+	fs::remove_all(dir);
+}
@@ -18,8 +18,11 @@
  */
 
 #include "../mapcraftercore/renderer/image.h"
+#include "../mapcraftercore/renderer/image/dithering.h"
+#include "../mapcraftercore/renderer/image/palette.h"
 #include "../mapcraftercore/renderer/image/quantization.h"
 
+#include <algorithm>
 #include <cstdlib>
 #include <set>
 #include <boost/test/unit_test.hpp>
@@ -146,3 +149,55 @@ BOOST_AUTO_TEST_CASE(image_quantization_octree) {
 	testOctreeWithImage(platypus);
 }
 
+
+BOOST_AUTO_TEST_CASE(image_quantization_fast_path) {
+	// an image with only a few colors must be quantized to exactly these colors
+	std::vector<RGBAPixel> image_colors = {
+		rgba(255, 0, 0, 255), rgba(0, 255, 0, 255), rgba(0, 0, 255, 128), rgba(0, 0, 0, 0)
+	};
+	RGBAImage image(64, 64);
+	for (int x = 0; x < image.getWidth(); x++)
+		for (int y = 0; y < image.getHeight(); y++)
+			image.setPixel(x, y, image_colors[(x / 8 + y / 8) % image_colors.size()]);
+
+	// the quantizer is reused to make sure the arena is reset properly
+	OctreeQuantizer quantizer;
+	for (int i = 0; i < 2; i++) {
+		std::vector<RGBAPixel> colors;
+		quantizer.quantize(image, 256, colors);
+		BOOST_CHECK_EQUAL(colors.size(), image_colors.size());
+		for (size_t j = 0; j < image_colors.size(); j++)
+			BOOST_CHECK(std::find(colors.begin(), colors.end(), image_colors[j]) != colors.end());
+
+		OctreePalette octree_palette(colors);
+		CachedPalette palette;
+		palette.setPalette(&octree_palette);
+
+		// dithering an image with palette colors only doesn't diffuse any errors
+		std::vector<uint8_t> data;
+		imageDither(image, palette, data);
+		BOOST_REQUIRE_EQUAL(data.size(), image.data.size());
+		for (size_t j = 0; j < data.size(); j++)
+			BOOST_CHECK_EQUAL(colors[data[j]], image.data[j]);
+	}
+
+	// random images are reduced to the maximum count of colors
+	RGBAImage random(100, 100);
+	for (int x = 0; x < random.getWidth(); x++)
+		for (int y = 0; y < random.getHeight(); y++)
+			random.setPixel(x, y, randomColor());
+	std::vector<RGBAPixel> colors;
+	quantizer.quantize(random, 64, colors);
+	BOOST_CHECK_LE(colors.size(), 64);
+
+	// the cache must return the same colors as the cached palette
+	OctreePalette octree_palette(colors);
+	CachedPalette palette;
+	palette.setPalette(&octree_palette);
+	for (int i = 0; i < 2; i++) {
+		for (size_t j = 0; j < random.data.size(); j++) {
+			RGBAPixel color = random.data[j];
+			BOOST_CHECK_EQUAL(palette.getNearestColor(color), octree_palette.getNearestColor(color));
+		}
+	}
+}
@@ -98,3 +98,59 @@ BOOST_AUTO_TEST_CASE(pos_test_block) {
 			}
 	*/
 }
+
+BOOST_AUTO_TEST_CASE(pos_test_block_dir) {
+	// the block positions and directions can be constant expressions
+	constexpr mc::BlockPos origin;
+	constexpr mc::BlockPos block(3, -7, 64);
+	constexpr mc::BlockDir dir(-1, 2, -3);
+	static_assert(origin.x == 0 && origin.z == 0 && origin.y == 0, "BlockPos() isn't zero");
+	static_assert(block.x == 3 && block.z == -7 && block.y == 64, "BlockPos(x, z, y) order");
+	static_assert(dir.x == -1 && dir.z == 2 && dir.y == -3, "BlockDir(x, z, y) order");
+	BOOST_CHECK(mc::BlockDir() == mc::BlockDir(0, 0, 0));
+
+	BOOST_CHECK_EQUAL(block + dir, mc::BlockPos(2, -5, 61));
+	BOOST_CHECK_EQUAL(block - dir, mc::BlockPos(4, -9, 67));
+	BOOST_CHECK_EQUAL(dir + block, block + dir);
+	BOOST_CHECK(block + dir - block == dir);
+
+	mc::BlockPos pos = block;
+	BOOST_CHECK_EQUAL(pos += dir, mc::BlockPos(2, -5, 61));
+	BOOST_CHECK_EQUAL(pos, mc::BlockPos(2, -5, 61));
+	pos -= dir;
+	BOOST_CHECK_EQUAL(pos, block);
+
+	// a step in every direction and back again
+	const mc::BlockDir* dirs[] = {&mc::DIR_NORTH, &mc::DIR_SOUTH, &mc::DIR_EAST,
+		&mc::DIR_WEST, &mc::DIR_TOP, &mc::DIR_BOTTOM};
+	const mc::BlockDir* opposite[] = {&mc::DIR_SOUTH, &mc::DIR_NORTH, &mc::DIR_WEST,
+		&mc::DIR_EAST, &mc::DIR_BOTTOM, &mc::DIR_TOP};
+	for (int i = 0; i < 6; i++) {
+		pos = block;
+		pos += *dirs[i];
+		BOOST_CHECK(pos != block);
+		BOOST_CHECK(pos - block == *dirs[i]);
+		BOOST_CHECK_EQUAL(pos + *opposite[i], block);
+	}
+	BOOST_CHECK_EQUAL(block + mc::DIR_NORTH, mc::BlockPos(3, -8, 64));
+	BOOST_CHECK_EQUAL(block + mc::DIR_EAST, mc::BlockPos(4, -7, 64));
+	BOOST_CHECK_EQUAL(block + mc::DIR_TOP, mc::BlockPos(3, -7, 65));
+}
+
+BOOST_AUTO_TEST_CASE(pos_test_block_local) {
+	// converting global block positions to chunks and local positions and back,
+	// also at the chunk borders of negative coordinates
+	int coords[] = {-33, -17, -16, -15, -1, 0, 1, 15, 16, 31, 32};
+	for (int x : coords)
+		for (int z : coords) {
+			mc::BlockPos block(x, z, -5);
+			mc::ChunkPos chunk(block);
+			mc::LocalBlockPos local(block);
+			BOOST_CHECK(local.x >= 0 && local.x < 16);
+			BOOST_CHECK(local.z >= 0 && local.z < 16);
+			BOOST_CHECK_EQUAL(local.y, -5);
+			BOOST_CHECK_EQUAL(local.toGlobalPos(chunk), block);
+		}
+	BOOST_CHECK_EQUAL(mc::ChunkPos(mc::BlockPos(-1, -16, 0)), mc::ChunkPos(-1, -1));
+	BOOST_CHECK_EQUAL(mc::ChunkPos(mc::BlockPos(-17, 16, 0)), mc::ChunkPos(-2, 1));
+}
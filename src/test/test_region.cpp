@@ -19,14 +19,26 @@
 
 #include "../mapcraftercore/mc/blockstate.h"
 #include "../mapcraftercore/mc/chunk.h"
+#include "../mapcraftercore/mc/chunkneighborhood.h"
+#include "../mapcraftercore/mc/nbt.h"
 #include "../mapcraftercore/mc/region.h"
+#include "../mapcraftercore/mc/regionprefetcher.h"
+#include "../mapcraftercore/mc/world.h"
+#include "../mapcraftercore/mc/worldcache.h"
 #include "../mapcraftercore/util.h"
+#include "../bench/syntheticworld.h"
+#include "testworld.h"
 
+#include <chrono>
 #include <iostream>
 #include <fstream>
+#include <new>
 #include <sstream>
+#include <thread>
+#include <vector>
 #include <boost/test/unit_test.hpp>
 
+namespace fs = boost::filesystem;
 namespace mc = mapcrafter::mc;
 
 BOOST_AUTO_TEST_CASE(region_testReadWrite) {
@@ -54,3 +66,219 @@ BOOST_AUTO_TEST_CASE(region_testReadWrite) {
 	}
 
 }
+
+BOOST_AUTO_TEST_CASE(region_testChunkSectionStorage) {
+	// check that the compact section storage returns the same block IDs
+	// for different palette sizes (uniform, packed, unpaletted)
+	int palette_sizes[] = {1, 2, 3, 5, 16, 17, 200, 256, 257, 4096};
+	for (size_t i = 0; i < sizeof(palette_sizes) / sizeof(int); i++) {
+		int palette_size = palette_sizes[i];
+		uint16_t ids[16 * 16 * 16];
+		for (int j = 0; j < 16 * 16 * 16; j++)
+			ids[j] = 1000 + ((j * 7919) % palette_size);
+
+		mc::ChunkSection section;
+		section.setBlockIDs(ids);
+		BOOST_CHECK_EQUAL(section.isUniform(), palette_size == 1);
+		for (int j = 0; j < 16 * 16 * 16; j++)
+			BOOST_CHECK_EQUAL(section.getBlockID(j), ids[j]);
+	}
+
+	uint8_t light[16 * 16 * 8];
+	mc::ChunkSection section;
+	std::fill(light, light + sizeof(light), 0xff);
+	section.setLight(1, light);
+	std::fill(light, light + sizeof(light), 0x00);
+	section.setLight(0, light);
+	size_t uniform_usage = section.getMemoryUsage();
+	for (int j = 0; j < 16 * 16 * 16; j++) {
+		BOOST_CHECK_EQUAL(section.getLight(0, j), 0);
+		BOOST_CHECK_EQUAL(section.getLight(1, j), 15);
+	}
+
+	for (int j = 0; j < 16 * 16 * 8; j++)
+		light[j] = (j % 16) | ((15 - j % 16) << 4);
+	section.setLight(0, light);
+	BOOST_CHECK(section.getMemoryUsage() > uniform_usage);
+	for (int j = 0; j < 16 * 16 * 16; j++) {
+		uint8_t expected = j % 2 == 0 ? (j / 2) % 16 : 15 - (j / 2) % 16;
+		BOOST_CHECK_EQUAL(section.getLight(0, j), expected);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(region_testChunkNeighborhood) {
+	// the chunk neighborhood must return the same block data as the world cache
+	mc::BlockStateRegistry block_registry;
+	std::shared_ptr<mc::World> world = mapcrafter::test::loadDataWorld();
+	mc::WorldCache cache(block_registry, *world);
+
+	mc::RegionFile region("data/region/r.-1.0.mca");
+	BOOST_REQUIRE(region.read());
+	auto chunks = region.getContainingChunks();
+	int y_values[] = {mc::CHUNK_LOWEST * 16 - 1, mc::CHUNK_LOWEST * 16, 0, 63, 64, 100, 319, 320};
+	for (auto it = chunks.begin(); it != chunks.end(); ++it) {
+		mc::ChunkNeighborhood neighborhood;
+		const mc::Chunk* chunk = neighborhood.update(cache, *it);
+		BOOST_CHECK(neighborhood.hasCenter(*it));
+		BOOST_CHECK_EQUAL(chunk, cache.getChunk(*it));
+
+		for (int x = -16; x < 32; x += 5)
+			for (int z = -16; z < 32; z += 3)
+				for (size_t i = 0; i < sizeof(y_values) / sizeof(int); i++) {
+					mc::BlockPos pos = mc::LocalBlockPos(0, 0, y_values[i]).toGlobalPos(*it)
+							+ mc::BlockDir(x, z, 0);
+					mc::Block expected = cache.getBlock(pos, nullptr,
+							mc::GET_ID | mc::GET_BIOME | mc::GET_LIGHT);
+					mc::Block block = neighborhood.getBlock(pos,
+							mc::GET_ID | mc::GET_BIOME | mc::GET_LIGHT);
+					BOOST_CHECK_EQUAL(block.id, expected.id);
+					BOOST_CHECK_EQUAL(block.biome, expected.biome);
+					BOOST_CHECK_EQUAL(block.block_light, expected.block_light);
+					BOOST_CHECK_EQUAL(block.sky_light, expected.sky_light);
+					BOOST_CHECK_EQUAL(neighborhood.getID(pos), expected.id);
+					BOOST_CHECK_EQUAL(neighborhood.getBlockLight(pos), expected.block_light);
+					BOOST_CHECK_EQUAL(neighborhood.getSkyLight(pos), expected.sky_light);
+				}
+	}
+}
+
+BOOST_AUTO_TEST_CASE(region_testChunkNeighborhoodReload) {
+	// the neighborhood must notice when a chunk replaces one of its chunks in the world
+	// cache, the world cache may be shared with other tile renderers
+	// (the chunks of data/region are too old to be loaded, a synthetic world is used)
+	fs::path world_dir = fs::temp_directory_path() / "mapcrafter_test_neighborhood";
+	fs::remove_all(world_dir);
+	mapcrafter::bench::SyntheticWorld synthetic(4);
+	BOOST_REQUIRE(synthetic.write(world_dir));
+	// a second region, its chunks have the same cache entries as the first ones
+	mc::ChunkPos center(1, 1), other(33, 1);
+	mc::RegionFile region((world_dir / "region" / "r.1.0.mca").string());
+	region.setChunkData(other, synthetic.createChunkData(other), 2);
+	BOOST_REQUIRE(region.write());
+
+	mc::BlockStateRegistry block_registry;
+	mc::World world(world_dir.string(), mc::Dimension::OVERWORLD,
+			(fs::temp_directory_path() / "mapcrafter_test_cache").string());
+	BOOST_REQUIRE(world.load());
+	mc::WorldCache cache(block_registry, world);
+
+	mc::ChunkNeighborhood neighborhood;
+	const mc::Chunk* chunk = neighborhood.update(cache, center);
+	BOOST_REQUIRE(chunk != nullptr);
+	BOOST_CHECK(chunk->getPos() == center);
+	BOOST_CHECK(neighborhood.hasCenter(center));
+	// getting the chunks from the cache again doesn't replace anything
+	BOOST_CHECK_EQUAL(cache.getChunk(center), chunk);
+	BOOST_CHECK(neighborhood.hasCenter(center));
+
+	// the other chunk is loaded into the cache entry of the center chunk,
+	// the neighborhood would return the blocks of the other chunk now
+	BOOST_REQUIRE(cache.getChunk(other) == chunk);
+	BOOST_CHECK(chunk->getPos() == other);
+	BOOST_CHECK(!neighborhood.hasCenter(center));
+
+	// looking up the chunks again loads the center chunk again
+	chunk = neighborhood.update(cache, center);
+	BOOST_REQUIRE(chunk != nullptr);
+	BOOST_CHECK(chunk->getPos() == center);
+	BOOST_CHECK(neighborhood.hasCenter(center));
+
+	neighborhood.clear();
+	BOOST_CHECK(!neighborhood.hasCenter(center));
+	fs::remove_all(world_dir);
+}
+
+BOOST_AUTO_TEST_CASE(region_testRegionPrefetcher) {
+	// a world cache announces the regions it has already to the prefetcher, so the
+	// prefetcher doesn't wait for them to be requested, also after the world cache was
+	// attached to another prefetcher
+	fs::path world_dir = fs::temp_directory_path() / "mapcrafter_test_prefetcher";
+	fs::remove_all(world_dir);
+	mapcrafter::bench::SyntheticWorld synthetic(2);
+	BOOST_REQUIRE(synthetic.write(world_dir));
+	mc::RegionPos region0(0, 0), region1(1, 0);
+	mc::ChunkPos chunk1(33, 1);
+	mc::RegionFile region((world_dir / "region" / "r.1.0.mca").string());
+	region.setChunkData(chunk1, synthetic.createChunkData(chunk1), 2);
+	BOOST_REQUIRE(region.write());
+
+	mc::BlockStateRegistry block_registry;
+	mc::World world(world_dir.string(), mc::Dimension::OVERWORLD,
+			(fs::temp_directory_path() / "mapcrafter_test_cache").string());
+	BOOST_REQUIRE(world.load());
+	mc::WorldCache cache(block_registry, world);
+
+	// the prefetchers keep just one region in memory and are created at the same
+	// address, like a prefetcher of a job allocated where the one of a finished job was
+	alignas(mc::RegionPrefetcher) char storage[sizeof(mc::RegionPrefetcher)];
+	mc::RegionPrefetcher* prefetcher = new (storage) mc::RegionPrefetcher(world, 1, 1);
+	cache.setRegionPrefetcher(prefetcher);
+	BOOST_REQUIRE(cache.getRegion(region0) != nullptr);
+	BOOST_CHECK_EQUAL(prefetcher->getRegionsMissed(), 1);
+	prefetcher->~RegionPrefetcher();
+
+	prefetcher = new (storage) mc::RegionPrefetcher(world, 1, 1);
+	cache.setRegionPrefetcher(prefetcher);
+	prefetcher->prefetch(region0);
+	prefetcher->prefetch(region1);
+	// the cached region is announced, the prefetcher evicts it and reads the next one
+	BOOST_REQUIRE(cache.getRegion(region0) != nullptr);
+	std::vector<mc::RegionPos> loaded;
+	for (int i = 0; i < 1000 && loaded != std::vector<mc::RegionPos>(1, region1); i++) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		loaded = prefetcher->getLoadedRegions();
+	}
+	BOOST_REQUIRE(loaded == std::vector<mc::RegionPos>(1, region1));
+	BOOST_REQUIRE(cache.getRegion(region1) != nullptr);
+	BOOST_CHECK(cache.getChunk(chunk1) != nullptr);
+	BOOST_CHECK_EQUAL(prefetcher->getRegionsPrefetched(), 1);
+	BOOST_CHECK_EQUAL(prefetcher->getRegionsMissed(), 0);
+
+	cache.setRegionPrefetcher(nullptr);
+	prefetcher->~RegionPrefetcher();
+	fs::remove_all(world_dir);
+}
+
+BOOST_AUTO_TEST_CASE(region_testPointsOfInterest) {
+	fs::path world_dir = fs::temp_directory_path() / "mapcrafter_test_world";
+	fs::remove_all(world_dir);
+	fs::create_directories(world_dir / "playerdata");
+
+	mc::nbt::NBTFile level;
+	mc::nbt::TagCompound data("Data");
+	data.addTag("SpawnX", mc::nbt::TagInt(-12));
+	data.addTag("SpawnY", mc::nbt::TagInt(70));
+	data.addTag("SpawnZ", mc::nbt::TagInt(345));
+	level.addTag("Data", data);
+	level.writeNBT((world_dir / "level.dat").string().c_str());
+
+	// a player in the overworld (current format) and one in the nether (old format)
+	double positions[2][3] = {{10.5, 64, -20.5}, {-100, 40, 100}};
+	for (int i = 0; i < 2; i++) {
+		mc::nbt::NBTFile player;
+		mc::nbt::TagList pos(mc::nbt::TagDouble::TAG_TYPE);
+		for (int j = 0; j < 3; j++)
+			pos.payload.push_back(mc::nbt::TagPtr(new mc::nbt::TagDouble(positions[i][j])));
+		player.addTag("Pos", pos);
+		if (i == 0)
+			player.addTag("Dimension", mc::nbt::TagString("minecraft:overworld"));
+		else
+			player.addTag("Dimension", mc::nbt::TagInt(-1));
+		player.writeNBT((world_dir / "playerdata" / (mapcrafter::util::str(i) + ".dat"))
+				.string().c_str());
+	}
+
+	mc::World world(world_dir.string(), mc::Dimension::OVERWORLD, "");
+	mc::BlockPos spawn;
+	BOOST_REQUIRE(world.getSpawnPoint(spawn));
+	BOOST_CHECK_EQUAL(spawn, mc::BlockPos(-12, 345, 70));
+	std::vector<mc::BlockPos> players = world.getPlayerPositions();
+	BOOST_REQUIRE_EQUAL(players.size(), 1);
+	BOOST_CHECK_EQUAL(players[0], mc::BlockPos(10, -21, 64));
+
+	mc::World nether(world_dir.string(), mc::Dimension::NETHER, "");
+	players = nether.getPlayerPositions();
+	BOOST_REQUIRE_EQUAL(players.size(), 1);
+	BOOST_CHECK_EQUAL(players[0], mc::BlockPos(-100, 100, 40));
+	fs::remove_all(world_dir);
+}
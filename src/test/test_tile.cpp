@@ -17,9 +17,42 @@
  * along with Mapcrafter.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include "../mapcraftercore/config/mapcrafterconfig.h"
+#include "../mapcraftercore/mc/blockstate.h"
+#include "../mapcraftercore/mc/region.h"
+#include "../mapcraftercore/mc/world.h"
+#include "../mapcraftercore/mc/worldcache.h"
+#include "../mapcraftercore/renderer/biomes.h"
+#include "../mapcraftercore/renderer/blockimages.h"
+#include "../mapcraftercore/renderer/blockimagevariants.h"
+#include "../mapcraftercore/renderer/manager.h"
+#include "../mapcraftercore/renderer/renderjournal.h"
+#include "../mapcraftercore/renderer/rendermode.h"
+#include "../mapcraftercore/renderer/renderrotation.h"
+#include "../mapcraftercore/renderer/renderview.h"
+#include "../mapcraftercore/renderer/tilearchive.h"
+#include "../mapcraftercore/renderer/renderviews/topdown/tileset.h"
+#include "../mapcraftercore/renderer/tilerenderer.h"
 #include "../mapcraftercore/renderer/tileset.h"
+#include "../mapcraftercore/renderer/tilestore.h"
+#include "../mapcraftercore/thread/impl/multithreading.h"
+#include "../mapcraftercore/util.h"
+#include "../bench/syntheticworld.h"
+#include "testworld.h"
 
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <limits>
 #include <map>
+#include <memory>
+#include <regex>
+#include <set>
+#include <sstream>
+#include <thread>
+#include <vector>
 #include <boost/test/unit_test.hpp>
 
 namespace renderer = mapcrafter::renderer;
@@ -51,3 +84,919 @@ BOOST_AUTO_TEST_CASE(test_tilepos) {
 	}
 	BOOST_CHECK_EQUAL(paths.size(), 256);
 }
+
+BOOST_AUTO_TEST_CASE(test_tilepath_key) {
+	renderer::TilePath path = PATH(4, 1, 3, 2);
+	BOOST_CHECK_EQUAL(path.getDepth(), 4);
+	BOOST_CHECK_EQUAL(path.toString(), "4/1/3/2");
+	BOOST_CHECK(path.getPath() == std::vector<int>({4, 1, 3, 2}));
+	BOOST_CHECK_EQUAL(path.parent(), (renderer::TilePath() + 4) + 1 + 3);
+	BOOST_CHECK_EQUAL(path.parent().parent().parent().parent(), renderer::TilePath());
+	BOOST_CHECK_EQUAL(renderer::TilePath::byKey(path.getKey()), path);
+	BOOST_CHECK_EQUAL(renderer::TilePath().toString(), "");
+	BOOST_CHECK_EQUAL(renderer::TilePath::byString("4/1/3/2"), path);
+	BOOST_CHECK_EQUAL(renderer::TilePath::byString(""), renderer::TilePath());
+	BOOST_CHECK_THROW(renderer::TilePath::byString("4/5"), std::invalid_argument);
+	BOOST_CHECK_THROW(renderer::TilePath::byString("4/1/"), std::invalid_argument);
+	BOOST_CHECK_THROW(renderer::TilePath::byString("41"), std::invalid_argument);
+
+	// the order of the paths must be the lexicographic order of their nodes
+	std::vector<renderer::TilePath> paths;
+	std::vector<std::vector<int>> nodes;
+	for (int a = 0; a <= 4; a++)
+		for (int b = 0; b <= 4; b++)
+			for (int c = 0; c <= 4; c++) {
+				renderer::TilePath path;
+				if (a != 0) {
+					path += a;
+					if (b != 0) {
+						path += b;
+						if (c != 0)
+							path += c;
+					}
+				}
+				paths.push_back(path);
+				nodes.push_back(path.getPath());
+			}
+	for (size_t i = 0; i < paths.size(); i++)
+		for (size_t j = 0; j < paths.size(); j++)
+			BOOST_CHECK_EQUAL(paths[i] < paths[j], nodes[i] < nodes[j]);
+
+	// deep paths
+	renderer::TilePos tile(-123456, 98765);
+	renderer::TilePath deep = renderer::TilePath::byTilePos(tile, renderer::TilePath::MAX_DEPTH);
+	BOOST_CHECK_EQUAL(deep.getDepth(), renderer::TilePath::MAX_DEPTH);
+	BOOST_CHECK_EQUAL(deep.getTilePos(), tile);
+	BOOST_CHECK_THROW(renderer::TilePath::byTilePos(tile, renderer::TilePath::MAX_DEPTH + 1),
+			std::runtime_error);
+
+	BOOST_CHECK_EQUAL(renderer::TilePos::byKey(tile.getKey()), tile);
+	BOOST_CHECK_EQUAL(renderer::TilePos::byKey(renderer::TilePos(-1, -1).getKey()),
+			renderer::TilePos(-1, -1));
+}
+
+BOOST_AUTO_TEST_CASE(test_tilehashmap) {
+	renderer::TileHashMap<int> map;
+	BOOST_CHECK(map.empty());
+	BOOST_CHECK(map.find(42) == nullptr);
+
+	for (int x = -50; x < 50; x++)
+		for (int y = -50; y < 50; y++)
+			map[renderer::TilePos(x, y).getKey()] = x * 1000 + y;
+	BOOST_CHECK_EQUAL(map.size(), 10000);
+	BOOST_CHECK(!map.insert(renderer::TilePos(3, 4).getKey(), 0));
+	BOOST_CHECK(map.insert(renderer::TilePos(50, 50).getKey(), 1));
+	BOOST_CHECK_EQUAL(map.size(), 10001);
+
+	for (int x = -50; x < 50; x++)
+		for (int y = -50; y < 50; y++) {
+			const int* value = map.find(renderer::TilePos(x, y).getKey());
+			BOOST_REQUIRE(value != nullptr);
+			BOOST_CHECK_EQUAL(*value, x * 1000 + y);
+		}
+	BOOST_CHECK(!map.contains(renderer::TilePos(-51, 0).getKey()));
+
+	size_t count = 0;
+	map.forEach([&](uint64_t, int) { count++; });
+	BOOST_CHECK_EQUAL(count, map.size());
+
+	map.clear();
+	BOOST_CHECK(map.empty());
+	BOOST_CHECK(!map.contains(renderer::TilePos(3, 4).getKey()));
+}
+
+BOOST_AUTO_TEST_CASE(test_tileimage_order) {
+	// the order of the block images must be the same as the one of sorting them
+	// with the tile comparator, for every rotation
+	boost::container::vector<renderer::TileImage> tile_images;
+	for (int i = 0; i < 2000; i++) {
+		renderer::TileImage tile_image;
+		tile_image.pos = mapcrafter::mc::BlockPos(rand() % 64 - 32, rand() % 64 - 32,
+				rand() % 400 - 64);
+		tile_images.push_back(tile_image);
+	}
+	// some block images at the same position
+	for (int i = 0; i < 100; i++)
+		tile_images.push_back(tile_images[rand() % tile_images.size()]);
+	// and one far away, so the comparison sort is used
+	boost::container::vector<renderer::TileImage> tile_images_far = tile_images;
+	tile_images_far[0].pos.x = 100000;
+
+	for (int rotation = 0; rotation < 4; rotation++) {
+		renderer::TileRenderer::cmpBlockPos* comparator =
+				renderer::TileRenderer::getTileComparator(rotation);
+		for (int far = 0; far < 2; far++) {
+			const boost::container::vector<renderer::TileImage>& images =
+					far ? tile_images_far : tile_images;
+			std::vector<uint32_t> expected(images.size());
+			for (size_t i = 0; i < expected.size(); i++)
+				expected[i] = i;
+			std::stable_sort(expected.begin(), expected.end(), [&](uint32_t a, uint32_t b) {
+				return comparator(images[a], images[b]);
+			});
+
+			renderer::TileImageOrder order;
+			BOOST_CHECK(order.compute(images, rotation) == expected);
+		}
+	}
+
+	renderer::TileImageOrder order;
+	BOOST_CHECK(order.compute(boost::container::vector<renderer::TileImage>(), 0).empty());
+}
+
+BOOST_AUTO_TEST_CASE(test_tile_renderer_occlusion_culling) {
+	// skipping the hidden block images must not change the rendered tiles, the synthetic
+	// world has water (waterlogged), grass (biome masked) and leaves, glass and flowers
+	// (transparent) in front of other blocks, and slabs which cover grass and water
+	namespace config = mapcrafter::config;
+	namespace mc = mapcrafter::mc;
+	namespace fs = boost::filesystem;
+
+	fs::path world_dir = fs::temp_directory_path() / "mapcrafter_test_culling";
+	fs::remove_all(world_dir);
+	mapcrafter::bench::SyntheticWorld synthetic(4);
+	BOOST_REQUIRE(synthetic.write(world_dir));
+
+	const char* render_views[] = {"isometric", "topdown"};
+	for (int view = 0; view < 2; view++) {
+		std::stringstream ss;
+		ss << "output_dir = " << (world_dir / "output").string() << std::endl;
+		ss << "template_dir = ../data/template" << std::endl;
+		ss << "[world:world]" << std::endl;
+		ss << "input_dir = " << world_dir.string() << std::endl;
+		ss << "[map:map]" << std::endl;
+		ss << "world = world" << std::endl;
+		ss << "render_view = " << render_views[view] << std::endl;
+		ss << "block_dir = ../data/blocks" << std::endl;
+		config::MapcrafterConfig config;
+		BOOST_REQUIRE(!config.parseString(ss.str()).isCritical());
+		config::WorldSection world_config = config.getWorld("world");
+		config::MapSection map_config = config.getMap("map");
+
+		for (int rotation = 0; rotation < 4; rotation++) {
+			mc::BlockStateRegistry block_registry;
+			mc::World world(world_dir.string(), world_config.getDimension(),
+					config.getCachePath("world").string());
+			BOOST_REQUIRE(world.load());
+			mc::WorldCache world_cache(block_registry, world);
+
+			std::unique_ptr<renderer::RenderView> render_view(renderer::createRenderView(
+					map_config.getRenderView(),
+					static_cast<renderer::RenderRotation::Direction>(rotation),
+					map_config.getWaterOpacity()));
+			std::unique_ptr<renderer::BlockImages> block_images(
+					render_view->createBlockImages(block_registry));
+			render_view->configureBlockImages(block_images.get(), world_config, map_config);
+			renderer::RenderedBlockImages* rendered_block_images =
+				dynamic_cast<renderer::RenderedBlockImages*>(block_images.get());
+			BOOST_REQUIRE(rendered_block_images != nullptr);
+			BOOST_REQUIRE(rendered_block_images->loadBlockImages(
+					map_config.getBlockDir().string(), mapcrafter::util::str(map_config.getRenderView()),
+					rotation, map_config.getTextureSize()));
+			renderer::Biome::initializeBiomes();
+
+			std::unique_ptr<renderer::RenderMode> render_mode(renderer::createRenderMode(
+					world_config, map_config, render_view->getRotation()));
+			std::unique_ptr<renderer::TileRenderer> tile_renderer(render_view->createTileRenderer(
+					block_registry, block_images.get(), map_config.getTileWidth(),
+					&world_cache, render_mode.get()));
+			render_view->configureTileRenderer(tile_renderer.get(), world_config, map_config);
+
+			std::unique_ptr<renderer::TileSet> tile_set(render_view->createTileSet(
+					map_config.getTileWidth()));
+			std::set<renderer::TilePos> tiles;
+			for (int x = 0; x < synthetic.getSize(); x++)
+				for (int z = 0; z < synthetic.getSize(); z++) {
+					std::vector<renderer::TilePos> chunk_tiles;
+					tile_set->mapChunkToTiles(mc::ChunkPos(x, z), chunk_tiles);
+					tiles.insert(chunk_tiles.begin(), chunk_tiles.end());
+				}
+
+			renderer::RGBAImage culled, plain;
+			size_t differ = 0, empty = 0;
+			for (auto it = tiles.begin(); it != tiles.end(); ++it) {
+				tile_renderer->setOcclusionCulling(true);
+				tile_renderer->renderTile(*it, culled);
+				tile_renderer->setOcclusionCulling(false);
+				tile_renderer->renderTile(*it, plain);
+				if (culled.data != plain.data)
+					differ++;
+				if (std::all_of(plain.data.begin(), plain.data.end(),
+						[](renderer::RGBAPixel p) { return p == 0; }))
+					empty++;
+			}
+			BOOST_CHECK_MESSAGE(differ == 0, differ << " of " << tiles.size()
+					<< " tiles differ (" << render_views[view] << ", rotation " << rotation << ")");
+			BOOST_CHECK(empty < tiles.size());
+		}
+	}
+
+	fs::remove_all(world_dir);
+}
+
+// returns keys which are all in the same cache shard (the caches use the top four bits
+// of the hash as shard index)
+template <typename Key, typename Hash>
+std::vector<Key> sameShardKeys(std::vector<Key> candidates, size_t count) {
+	std::vector<Key> keys;
+	for (size_t i = 0; i < candidates.size() && keys.size() < count; i++)
+		if ((Hash()(candidates[i]) >> 59) == (Hash()(candidates[0]) >> 59))
+			keys.push_back(candidates[i]);
+	return keys;
+}
+
+BOOST_AUTO_TEST_CASE(test_block_image_variant_cache) {
+	std::vector<renderer::BlockImageVariantKey> candidates(2048);
+	for (size_t i = 0; i < candidates.size(); i++)
+		candidates[i].id = i;
+	std::vector<renderer::BlockImageVariantKey> keys = sameShardKeys<
+		renderer::BlockImageVariantKey, renderer::BlockImageVariantKeyHash>(candidates, 3);
+	BOOST_REQUIRE_EQUAL(keys.size(), 3);
+
+	std::vector<renderer::BlockImageVariantCache::VariantPtr> variants;
+	for (size_t i = 0; i < keys.size(); i++) {
+		std::shared_ptr<renderer::BlockImageVariant> variant(new renderer::BlockImageVariant);
+		variant->image.setSize(2, 2);
+		variant->image.fill(i + 1, 0, 0, 2, 2);
+		variants.push_back(variant);
+	}
+
+	// two variants per shard
+	renderer::BlockImageVariantCache cache(32);
+	BOOST_CHECK(!cache.find(keys[0]));
+	BOOST_CHECK(cache.insert(keys[0], variants[0]) == variants[0]);
+	BOOST_CHECK(cache.insert(keys[1], variants[1]) == variants[1]);
+	BOOST_CHECK(cache.find(keys[0]) == variants[0]);
+	BOOST_CHECK(cache.find(keys[1]) == variants[1]);
+
+	// a full shard is cleared, but the variants in use stay valid
+	renderer::BlockImageVariantCache::VariantPtr in_use = cache.find(keys[0]);
+	variants[0].reset();
+	cache.insert(keys[2], variants[2]);
+	BOOST_CHECK(!cache.find(keys[0]));
+	BOOST_CHECK(!cache.find(keys[1]));
+	BOOST_CHECK(cache.find(keys[2]) == variants[2]);
+	BOOST_REQUIRE(in_use);
+	BOOST_CHECK_EQUAL(in_use->image.getPixel(1, 1), 1);
+
+	cache.clear();
+	BOOST_CHECK(!cache.find(keys[2]));
+}
+
+BOOST_AUTO_TEST_CASE(test_tinted_block_image_cache) {
+	std::vector<renderer::TintedBlockImageKey> candidates(2048);
+	for (size_t i = 0; i < candidates.size(); i++)
+		candidates[i].color = i;
+	std::vector<renderer::TintedBlockImageKey> keys = sameShardKeys<
+		renderer::TintedBlockImageKey, renderer::TintedBlockImageKeyHash>(candidates, 4);
+	BOOST_REQUIRE_EQUAL(keys.size(), 4);
+
+	std::vector<renderer::TintedBlockImageCache::ImagePtr> images;
+	for (size_t i = 0; i < keys.size(); i++) {
+		std::shared_ptr<renderer::RGBAImage> image(new renderer::RGBAImage(2, 2));
+		image->fill(i + 1, 0, 0, 2, 2);
+		images.push_back(image);
+	}
+
+	// two images per shard
+	renderer::TintedBlockImageCache cache(32);
+	BOOST_CHECK(!cache.find(keys[0]));
+	BOOST_CHECK(cache.insert(keys[0], images[0]) == images[0]);
+	BOOST_CHECK(cache.insert(keys[1], images[1]) == images[1]);
+	BOOST_CHECK(cache.find(keys[0]) == images[0]);
+	BOOST_CHECK_EQUAL(cache.getHits(), 1);
+	BOOST_CHECK_EQUAL(cache.getMisses(), 1);
+
+	// the first image was found, so it gets a second chance and the second one is evicted
+	renderer::TintedBlockImageCache::ImagePtr in_use = cache.find(keys[0]);
+	images[0].reset();
+	cache.insert(keys[2], images[2]);
+	BOOST_CHECK(!cache.find(keys[1]));
+	BOOST_CHECK(cache.find(keys[2]) == images[2]);
+
+	// the clock hand has taken the second chance of the first image,
+	// the third image was found after that, so now the first one is evicted
+	cache.insert(keys[3], images[3]);
+	BOOST_CHECK(!cache.find(keys[0]));
+	BOOST_CHECK(cache.find(keys[2]) == images[2]);
+	BOOST_CHECK(cache.find(keys[3]) == images[3]);
+
+	// evicted images which are still in use stay valid
+	BOOST_REQUIRE(in_use);
+	BOOST_CHECK_EQUAL(in_use->getPixel(1, 1), 1);
+
+	cache.clear();
+	BOOST_CHECK(!cache.find(keys[2]));
+}
+
+BOOST_AUTO_TEST_CASE(test_render_threads_world_caches) {
+	// the render threads keep running for all jobs and keep their world caches between
+	// the jobs of the same world object and block state registry
+	namespace mc = mapcrafter::mc;
+	mapcrafter::test::SyntheticMap map("render_threads", 2, "render_view = topdown");
+	mapcrafter::thread::MultiThreadingDispatcher dispatcher(1);
+
+	auto chunk_cache_misses = [&](int rotation, std::shared_ptr<mc::World> world,
+			std::shared_ptr<mc::BlockStateRegistry> block_registry) {
+		renderer::RenderContext context = map.createRenderContext(rotation, world,
+				block_registry);
+		context.profile_collector = std::make_shared<mapcrafter::util::ProfileCollector>();
+		dispatcher.dispatch(context, nullptr);
+		mapcrafter::util::RenderProfile profile = context.profile_collector->getProfile();
+		BOOST_CHECK(profile.counters[(int) mapcrafter::util::ProfileCounter::RENDER_TILES] > 0);
+		return profile.counters[(int) mapcrafter::util::ProfileCounter::CHUNK_CACHE_MISSES];
+	};
+
+	std::shared_ptr<mc::World> world = map.loadWorld();
+	std::shared_ptr<mc::BlockStateRegistry> block_registry
+		= std::make_shared<mc::BlockStateRegistry>();
+	BOOST_CHECK_EQUAL(chunk_cache_misses(0, world, block_registry), 4);
+	// the other rotations find the chunks in the world cache
+	BOOST_CHECK_EQUAL(chunk_cache_misses(1, world, block_registry), 0);
+	BOOST_CHECK_EQUAL(chunk_cache_misses(2, world, block_registry), 0);
+	// a reloaded world and another block state registry need a new world cache
+	std::shared_ptr<mc::World> reloaded_world = map.loadWorld();
+	BOOST_CHECK_EQUAL(chunk_cache_misses(3, reloaded_world, block_registry), 4);
+	BOOST_CHECK_EQUAL(chunk_cache_misses(0, reloaded_world,
+			std::make_shared<mc::BlockStateRegistry>()), 4);
+	BOOST_CHECK_EQUAL(dispatcher.getThreadCount(), 1);
+}
+
+BOOST_AUTO_TEST_CASE(test_tileset_scan) {
+	// the scan finds the same tiles as mapping every chunk of the world to its tiles one
+	// by one, no matter how many threads scan the regions
+	namespace mc = mapcrafter::mc;
+	std::shared_ptr<mc::World> world = mapcrafter::test::loadDataWorld();
+	renderer::RenderViewType render_views[] = {renderer::RenderViewType::ISOMETRIC,
+		renderer::RenderViewType::TOPDOWN, renderer::RenderViewType::SIDE};
+	for (int view = 0; view < 3; view++) {
+		for (int rotation = 0; rotation < 4; rotation++) {
+			std::unique_ptr<renderer::RenderView> render_view(renderer::createRenderView(
+					render_views[view],
+					static_cast<renderer::RenderRotation::Direction>(rotation), 1.0));
+			std::unique_ptr<renderer::TileSet> tile_set(render_view->createTileSet(1));
+
+			// the render tiles with the newest timestamp and the regions of their chunks
+			std::map<renderer::TilePos, int> timestamps;
+			std::set<mc::RegionPos> regions;
+			auto available_regions = world->getAvailableRegions();
+			for (auto region_it = available_regions.begin();
+					region_it != available_regions.end(); ++region_it) {
+				mc::RegionFile region;
+				BOOST_REQUIRE(world->getRegion(*region_it, region) && region.readOnlyHeaders());
+				const std::set<mc::ChunkPos>& chunks = region.getContainingChunks();
+				for (auto chunk_it = chunks.begin(); chunk_it != chunks.end(); ++chunk_it) {
+					std::vector<renderer::TilePos> tiles;
+					tile_set->mapChunkToTiles(*chunk_it, tiles);
+					int timestamp = region.getChunkTimestamp(*chunk_it);
+					for (auto tile_it = tiles.begin(); tile_it != tiles.end(); ++tile_it) {
+						auto it = timestamps.insert(std::make_pair(*tile_it, timestamp)).first;
+						it->second = std::max(it->second, timestamp);
+					}
+					regions.insert(*region_it);
+				}
+			}
+			BOOST_REQUIRE(!timestamps.empty());
+
+			tile_set->scan(*world);
+			BOOST_CHECK(tile_set->getTileOffset() == renderer::TilePos(0, 0));
+			BOOST_CHECK_EQUAL(tile_set->getRequiredRenderTilesCount(), timestamps.size());
+			int depth = tile_set->getDepth();
+			std::map<renderer::TilePath, int> composite_tiles;
+			for (auto it = timestamps.begin(); it != timestamps.end(); ++it) {
+				renderer::TilePath path = renderer::TilePath::byTilePos(it->first, depth);
+				BOOST_CHECK_MESSAGE(tile_set->hasTile(path), "tile " << it->first << " is missing");
+				while (path.getDepth() > 0) {
+					path = path.parent();
+					composite_tiles[path]++;
+				}
+			}
+
+			std::vector<renderer::TilePath> required = tile_set->getRequiredCompositeTiles();
+			BOOST_CHECK_EQUAL(required.size(), composite_tiles.size());
+			for (auto it = composite_tiles.begin(); it != composite_tiles.end(); ++it)
+				BOOST_CHECK_EQUAL(tile_set->getContainingRenderTiles(it->first), it->second);
+			std::vector<mc::RegionPos> tile_regions;
+			tile_set->getRequiredTileRegions(renderer::TilePath(), tile_regions);
+			BOOST_CHECK(std::set<mc::RegionPos>(tile_regions.begin(), tile_regions.end())
+					== regions);
+
+			// the tiles keep the newest timestamp of their chunks
+			std::vector<int> sorted_timestamps;
+			for (auto it = timestamps.begin(); it != timestamps.end(); ++it)
+				sorted_timestamps.push_back(it->second);
+			std::sort(sorted_timestamps.begin(), sorted_timestamps.end());
+			int last_change = sorted_timestamps[sorted_timestamps.size() / 2];
+			tile_set->scanRequiredByTimestamp(last_change);
+			BOOST_CHECK_EQUAL(tile_set->getRequiredRenderTilesCount(), sorted_timestamps.end()
+					- std::lower_bound(sorted_timestamps.begin(), sorted_timestamps.end(),
+							last_change));
+			tile_set->resetRequired();
+
+			// scanning with multiple threads, twice, gives the same tile set
+			for (int i = 0; i < 2; i++) {
+				std::unique_ptr<renderer::TileSet> threaded(render_view->createTileSet(1));
+				threaded->scan(*world, 4);
+				BOOST_CHECK_EQUAL(threaded->getDepth(), depth);
+				BOOST_CHECK_EQUAL(threaded->getRequiredRenderTilesCount(),
+						tile_set->getRequiredRenderTilesCount());
+				BOOST_CHECK(threaded->getRequiredCompositeTiles() == required);
+				for (auto it = required.begin(); it != required.end(); ++it)
+					BOOST_CHECK_EQUAL(threaded->getContainingRenderTiles(*it),
+							tile_set->getContainingRenderTiles(*it));
+				std::vector<mc::RegionPos> threaded_regions;
+				threaded->getRequiredTileRegions(renderer::TilePath(), threaded_regions);
+				BOOST_CHECK(threaded_regions == tile_regions);
+			}
+		}
+	}
+}
+
+BOOST_AUTO_TEST_CASE(test_tileset_required_by_chunks) {
+	std::shared_ptr<mapcrafter::mc::World> world = mapcrafter::test::loadDataWorld();
+	mapcrafter::mc::RegionFile region("data/region/r.-1.0.mca");
+	BOOST_REQUIRE(region.readOnlyHeaders());
+	BOOST_REQUIRE(!region.getContainingChunks().empty());
+	mapcrafter::mc::ChunkPos chunk = *region.getContainingChunks().begin();
+
+	for (int rotation = 0; rotation < 4; rotation++) {
+		// the tile set must not depend on the rotation object it was created with
+		std::unique_ptr<renderer::TopdownTileSet> tile_set =
+				mapcrafter::test::scanTileSet(*world, rotation);
+		BOOST_CHECK(tile_set->getRequiredRenderTilesCount() > 0);
+
+		// just the tile of the changed chunk is required
+		std::map<mapcrafter::mc::ChunkPos, uint32_t> chunks;
+		chunks[chunk] = 42;
+		BOOST_CHECK(tile_set->scanRequiredByChunks(chunks));
+		BOOST_CHECK_EQUAL(tile_set->getRequiredRenderTilesCount(), 1);
+		BOOST_CHECK(tile_set->getRequiredCompositeTilesCount() > 0);
+
+		chunks.clear();
+		BOOST_CHECK(tile_set->scanRequiredByChunks(chunks));
+		BOOST_CHECK_EQUAL(tile_set->getRequiredRenderTilesCount(), 0);
+		BOOST_CHECK_EQUAL(tile_set->getRequiredCompositeTilesCount(), 0);
+
+		// a chunk far away needs a higher zoom level
+		chunks[mapcrafter::mc::ChunkPos(100000, 100000)] = 42;
+		BOOST_CHECK(!tile_set->scanRequiredByChunks(chunks));
+	}
+}
+
+BOOST_AUTO_TEST_CASE(test_tileset_skip_rendered_tiles) {
+	std::unique_ptr<renderer::TopdownTileSet> scanned_tile_set =
+			mapcrafter::test::scanTileSet(*mapcrafter::test::loadDataWorld());
+	renderer::TopdownTileSet& tile_set = *scanned_tile_set;
+	BOOST_REQUIRE(tile_set.getDepth() > 1);
+	int render_tiles = tile_set.getRequiredRenderTilesCount();
+
+	// a composite tile above the render tiles was rendered by an interrupted rendering
+	renderer::TilePath rendered;
+	auto composite_tiles = tile_set.getRequiredCompositeTiles();
+	for (auto it = composite_tiles.begin(); it != composite_tiles.end(); ++it)
+		if (it->getDepth() == tile_set.getDepth() - 1)
+			rendered = *it;
+	BOOST_REQUIRE(rendered.getDepth() == tile_set.getDepth() - 1);
+	int rendered_tiles = tile_set.getContainingRenderTiles(rendered);
+
+	// the rendered tiles are read from a journal
+	boost::filesystem::path filename = boost::filesystem::temp_directory_path()
+			/ "mapcrafter_test_render.journal";
+	{
+		renderer::RenderJournal journal(filename);
+		BOOST_REQUIRE(journal.open(tile_set, 1000, false));
+		journal.add(rendered);
+	}
+	std::time_t started;
+	std::vector<renderer::TilePath> tiles;
+	renderer::RenderJournal journal(filename);
+	BOOST_REQUIRE(journal.read(tile_set, started, tiles));
+	BOOST_CHECK_EQUAL(started, 1000);
+	BOOST_REQUIRE_EQUAL(tiles.size(), 1);
+	BOOST_CHECK_EQUAL(tiles[0], rendered);
+
+	// a tile key partly written when the rendering was interrupted is cut off when
+	// the rendering is resumed, the tiles added then are read correctly
+	{
+		std::ofstream out(filename.string().c_str(), std::ios::binary | std::ios::app);
+		out.write("\x01\x02\x03", 3);
+	}
+	BOOST_REQUIRE(journal.read(tile_set, started, tiles));
+	BOOST_REQUIRE_EQUAL(tiles.size(), 1);
+	{
+		renderer::RenderJournal journal(filename);
+		BOOST_REQUIRE(journal.open(tile_set, 1000, true));
+		journal.add(rendered.parent());
+	}
+	BOOST_REQUIRE(journal.read(tile_set, started, tiles));
+	BOOST_CHECK_EQUAL(started, 1000);
+	BOOST_REQUIRE_EQUAL(tiles.size(), 2);
+	BOOST_CHECK_EQUAL(tiles[0], rendered);
+	BOOST_CHECK_EQUAL(tiles[1], rendered.parent());
+	journal.remove();
+	// just the first tile was rendered by the interrupted rendering below
+	tiles.pop_back();
+	BOOST_CHECK(!boost::filesystem::exists(filename));
+
+	// tiles changed since the interrupted rendering are rendered anyway
+	BOOST_CHECK_EQUAL(tile_set.skipRenderedTiles(tiles, 0), 0);
+	BOOST_CHECK_EQUAL(tile_set.skipRenderedTiles(tiles, std::numeric_limits<int>::max()),
+			rendered_tiles);
+	BOOST_CHECK_EQUAL(tile_set.getRequiredRenderTilesCount(), render_tiles - rendered_tiles);
+	BOOST_CHECK(!tile_set.isTileRequired(rendered));
+	// but the tiles on the path to the root tile are composed again
+	for (renderer::TilePath path = rendered; path.getDepth() > 0; ) {
+		path = path.parent();
+		BOOST_CHECK(tile_set.isTileRequired(path));
+	}
+}
+
+BOOST_AUTO_TEST_CASE(test_tileset_restrict_required_tiles) {
+	std::unique_ptr<renderer::TopdownTileSet> scanned_tile_set =
+			mapcrafter::test::scanTileSet(*mapcrafter::test::loadDataWorld());
+	renderer::TopdownTileSet& tile_set = *scanned_tile_set;
+	BOOST_REQUIRE(tile_set.getDepth() > 1);
+	int render_tiles = tile_set.getRequiredRenderTilesCount();
+
+	// split the subtrees one zoom level above the render tiles into two shards
+	int zoom_level = tile_set.getDepth() - 1;
+	std::vector<renderer::TilePath> shards[2];
+	auto composite_tiles = tile_set.getRequiredCompositeTiles();
+	for (auto it = composite_tiles.begin(); it != composite_tiles.end(); ++it)
+		if (it->getDepth() == zoom_level)
+			shards[shards[0].size() > shards[1].size()].push_back(*it);
+	BOOST_REQUIRE(!shards[1].empty());
+
+	int shard_tiles = 0;
+	for (auto it = shards[0].begin(); it != shards[0].end(); ++it)
+		shard_tiles += tile_set.getContainingRenderTiles(*it);
+	BOOST_CHECK_EQUAL(tile_set.restrictRequiredTiles(shards[0], zoom_level),
+			render_tiles - shard_tiles);
+	BOOST_CHECK_EQUAL(tile_set.getRequiredRenderTilesCount(), shard_tiles);
+	BOOST_CHECK_EQUAL(tile_set.getRequiredCompositeTilesCount(), shards[0].size());
+	BOOST_CHECK(tile_set.getRequiredCompositeTiles() == shards[0]);
+	BOOST_CHECK(!tile_set.isTileRequired(shards[1][0]));
+	// the tiles above the shard are composed later
+	BOOST_CHECK(!tile_set.isTileRequired(renderer::TilePath()));
+
+	// composing the shards requires just the tiles above them
+	tile_set.resetRequired();
+	std::vector<renderer::TilePath> subtrees = shards[0];
+	subtrees.insert(subtrees.end(), shards[1].begin(), shards[1].end());
+	tile_set.skipRenderedTiles(subtrees, std::numeric_limits<int>::max());
+	BOOST_CHECK_EQUAL(tile_set.getRequiredRenderTilesCount(), 0);
+	BOOST_CHECK(tile_set.isTileRequired(renderer::TilePath()));
+	BOOST_CHECK(!tile_set.isTileRequired(shards[0][0]));
+	BOOST_CHECK(tile_set.isTileRequired(shards[0][0].parent()));
+}
+
+BOOST_AUTO_TEST_CASE(test_render_shards) {
+	// rendering the shards and composing them gives the same output as rendering the
+	// map in one process
+	namespace fs = boost::filesystem;
+	mapcrafter::test::SyntheticMap map("shards", 4);
+	auto render = [&](const std::string& output, const renderer::RenderShard& shard) {
+		renderer::RenderManager manager(map.getConfig(output));
+		manager.setRenderShard(shard);
+		BOOST_REQUIRE(manager.run(2, true));
+	};
+	// the files of an output directory, the render times in config.js and index.html
+	// are left out
+	auto read_output = [&](const std::string& output) {
+		std::map<std::string, std::string> files;
+		fs::path dir = map.getDirectory() / output;
+		for (fs::recursive_directory_iterator it(dir), end; it != end; ++it) {
+			if (!fs::is_regular_file(it->path()))
+				continue;
+			std::ifstream in(it->path().string().c_str(), std::ios::binary);
+			std::stringstream data;
+			data << in.rdbuf();
+			std::string filename = it->path().string().substr(dir.string().size());
+			files[filename] = std::regex_replace(data.str(),
+					std::regex("[0-9]{10}|[0-9.]{10}, [0-9:]{8}"), "");
+		}
+		return files;
+	};
+
+	render("output", renderer::RenderShard());
+	renderer::RenderShard shard;
+	shard.levels = 1;
+	shard.count = 2;
+	for (shard.index = 0; shard.index < 2; shard.index++) {
+		render("output_shards", shard);
+		// just the composing writes the web files
+		BOOST_CHECK(!fs::exists(map.getDirectory() / "output_shards" / "config.js"));
+		BOOST_CHECK(!fs::exists(map.getDirectory() / "output_shards" / "index.html"));
+	}
+	renderer::RenderShard compose;
+	compose.levels = 1;
+	compose.compose_only = true;
+	render("output_shards", compose);
+
+	std::map<std::string, std::string> files = read_output("output");
+	std::map<std::string, std::string> files_shards = read_output("output_shards");
+	BOOST_CHECK(files.count("/config.js"));
+	BOOST_CHECK(files.count("/map/tl/base.png"));
+	BOOST_CHECK_EQUAL(files.size(), files_shards.size());
+	for (auto it = files.begin(); it != files.end(); ++it)
+		BOOST_CHECK_MESSAGE(files_shards.count(it->first) && files_shards[it->first] == it->second,
+				it->first << " differs");
+}
+
+BOOST_AUTO_TEST_CASE(test_render_lod_detail_zoom_level) {
+	namespace mc = mapcrafter::mc;
+
+	// without level of detail the deepest zoom level is rendered
+	mapcrafter::test::SyntheticMap plain_map("lod_zoom_plain", 4);
+	renderer::RenderContext plain = plain_map.createRenderContext(0, plain_map.loadWorld(),
+			std::make_shared<mc::BlockStateRegistry>());
+	BOOST_CHECK(!plain.lod_block_images);
+	BOOST_CHECK_EQUAL(plain.getDetailZoomLevel(), plain.tile_set->getDepth());
+
+	// the level of detail zoom level is the skipped levels above the deepest one, but not
+	// above the top level (a world of one chunk with big tiles has less zoom levels than
+	// the maximum of skipped levels)
+	mapcrafter::test::SyntheticMap map("lod_zoom", 1, "lod_levels = 4\ntexture_size = 16\ntile_width = 8");
+	renderer::RenderContext context = map.createRenderContext(0, map.loadWorld(),
+			std::make_shared<mc::BlockStateRegistry>());
+	BOOST_REQUIRE(context.lod_block_images);
+	int min_depth = context.tile_set->getMinDepth();
+	for (int depth = min_depth; depth <= min_depth + 6; depth++) {
+		context.tile_set->setDepth(depth);
+		BOOST_CHECK_EQUAL(context.getDetailZoomLevel(), std::max(depth - 4, 0));
+	}
+	BOOST_REQUIRE(min_depth < 4);
+	context.tile_set->setDepth(4);
+	BOOST_CHECK_EQUAL(context.getDetailZoomLevel(), 0);
+	context.tile_set->setDepth(5);
+	BOOST_CHECK_EQUAL(context.getDetailZoomLevel(), 1);
+}
+
+BOOST_AUTO_TEST_CASE(test_render_lod_tile) {
+	// a tile of the level of detail zoom level looks like the downscaled render tiles
+	// below it, it's just rendered directly with the smaller block images
+	namespace mc = mapcrafter::mc;
+	for (int lod_levels = 1; lod_levels <= 2; lod_levels++) {
+		mapcrafter::test::SyntheticMap map("lod_tile", 4,
+				"lod_levels = " + mapcrafter::util::str(lod_levels) + "\ntexture_size = 16");
+		renderer::RenderContext context = map.createRenderContext(0, map.loadWorld(),
+				std::make_shared<mc::BlockStateRegistry>());
+		context.initializeTileRenderer();
+		renderer::TileRenderWorker worker;
+		worker.setRenderContext(context);
+
+		renderer::TileSet* tile_set = context.tile_set;
+		int detail = context.getDetailZoomLevel();
+		BOOST_REQUIRE_EQUAL(detail, tile_set->getDepth() - lod_levels);
+		int w = context.tile_renderer->getTileWidth();
+		int h = context.tile_renderer->getTileHeight();
+
+		// downscales the render tiles below a tile like the composite tiles do
+		std::function<void (const renderer::TilePath&, renderer::RGBAImage&)> downscale;
+		downscale = [&](const renderer::TilePath& tile, renderer::RGBAImage& image) {
+			if (tile.getDepth() == tile_set->getDepth()) {
+				context.tile_renderer->renderTile(tile.getTilePos()
+						+ tile_set->getTileOffset(), image);
+				return;
+			}
+			image.setSize(w, h);
+			for (int i = 1; i <= 4; i++) {
+				if (!tile_set->hasTile(tile + i))
+					continue;
+				renderer::RGBAImage child, resized;
+				downscale(tile + i, child);
+				child.resize(resized, 0, 0, renderer::InterpolationType::HALF);
+				image.simpleAlphaBlit(resized, i % 2 == 0 ? w / 2 : 0, i > 2 ? h / 2 : 0);
+			}
+		};
+
+		int tiles = 0;
+		std::vector<renderer::TilePath> composite_tiles = tile_set->getRequiredCompositeTiles();
+		for (auto it = composite_tiles.begin(); it != composite_tiles.end(); ++it) {
+			if (it->getDepth() != detail)
+				continue;
+			renderer::RGBAImage lod, expected;
+			lod.setSize(w, h);
+			worker.renderLODRecursive(*it, lod, 0, 0, w, h);
+			downscale(*it, expected);
+			BOOST_REQUIRE_EQUAL(lod.getWidth(), expected.getWidth());
+			BOOST_REQUIRE_EQUAL(lod.getHeight(), expected.getHeight());
+
+			long long diff = 0;
+			size_t alpha_differ = 0, visible = 0;
+			for (size_t i = 0; i < lod.data.size(); i++) {
+				renderer::RGBAPixel a = lod.data[i], b = expected.data[i];
+				if ((renderer::rgba_alpha(a) == 0) != (renderer::rgba_alpha(b) == 0))
+					alpha_differ++;
+				if (renderer::rgba_alpha(a) == 0 || renderer::rgba_alpha(b) == 0)
+					continue;
+				visible++;
+				diff += std::abs(renderer::rgba_red(a) - renderer::rgba_red(b))
+						+ std::abs(renderer::rgba_green(a) - renderer::rgba_green(b))
+						+ std::abs(renderer::rgba_blue(a) - renderer::rgba_blue(b));
+			}
+			// the shapes of the blocks match except for a few edge pixels, the colors
+			// differ just slightly because the block images are downscaled and not the
+			// blended render tiles
+			BOOST_CHECK_MESSAGE(alpha_differ * 20 <= visible + alpha_differ, it->toString()
+					<< ": " << alpha_differ << " pixels differ in transparency");
+			BOOST_CHECK_MESSAGE(diff <= 10 * 3 * (long long) visible, it->toString()
+					<< ": mean color difference " << diff / (3.0 * visible));
+			if (visible > 0)
+				tiles++;
+		}
+		BOOST_CHECK(tiles > 0);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(test_tile_store) {
+	namespace fs = boost::filesystem;
+	fs::path output_dir = fs::temp_directory_path() / "mapcrafter_test_tilestore";
+	fs::path store_dir = output_dir / ".tilestore";
+	fs::remove_all(output_dir);
+	fs::create_directories(output_dir);
+
+	renderer::TopdownTileSet tile_set(1, renderer::RenderRotation(0));
+	tile_set.setDepth(3);
+
+	// tiles with the same image share one stored image
+	renderer::TilePath tile1 = renderer::TilePath::byString("1/2/3");
+	renderer::TilePath tile2 = renderer::TilePath::byString("4/3/2");
+	renderer::TileStore store(output_dir, store_dir);
+	store.read(tile_set);
+	for (int i = 0; i < 2; i++)
+		BOOST_CHECK(store.storeTile(i == 0 ? tile1 : tile2, "image",
+				output_dir / (i == 0 ? "1.png" : "2.png")));
+	BOOST_CHECK(!fs::exists(output_dir / "1.png.tmp.png"));
+	BOOST_CHECK(!fs::exists(output_dir / "2.png.tmp.png"));
+	BOOST_CHECK_EQUAL(fs::hard_link_count(output_dir / "1.png"), 3);
+	BOOST_CHECK_EQUAL(renderer::TileStore::removeUnused(store_dir), 0);
+	fs::remove(output_dir / "1.png");
+	fs::remove(output_dir / "2.png");
+	BOOST_CHECK_EQUAL(renderer::TileStore::removeUnused(store_dir), 1);
+
+	// render threads storing the same image at the same time share one stored image
+	std::vector<std::thread> threads;
+	std::atomic<int> stored_tiles(0);
+	for (int i = 0; i < 8; i++)
+		threads.push_back(std::thread([&store, &output_dir, &stored_tiles, i]() {
+			for (int j = 0; j < 20; j++)
+				if (store.storeTile(renderer::TilePath::byString("1/1/1"), "image",
+						output_dir / ("shared" + mapcrafter::util::str(i * 20 + j) + ".png")))
+					stored_tiles++;
+		}));
+	for (size_t i = 0; i < threads.size(); i++)
+		threads[i].join();
+	BOOST_CHECK_EQUAL(stored_tiles, 160);
+	BOOST_CHECK_EQUAL(fs::hard_link_count(output_dir / "shared0.png"), 161);
+	for (int i = 0; i < 160; i++)
+		fs::remove(output_dir / ("shared" + mapcrafter::util::str(i) + ".png"));
+
+	// a stored image with other data (like a hash collision) isn't used
+	fs::path stored;
+	for (fs::recursive_directory_iterator it(store_dir), end; it != end; ++it)
+		if (fs::is_regular_file(it->path()))
+			stored = it->path();
+	BOOST_REQUIRE(!stored.empty());
+	std::ofstream((stored.string()).c_str()) << "other image";
+	BOOST_CHECK(store.storeTile(tile1, "image", output_dir / "1.png"));
+	BOOST_CHECK_EQUAL(fs::hard_link_count(output_dir / "1.png"), 1);
+	std::ifstream in((output_dir / "1.png").string().c_str());
+	std::string data;
+	std::getline(in, data);
+	BOOST_CHECK_EQUAL(data, "image");
+	fs::remove(output_dir / "1.png");
+	BOOST_CHECK_EQUAL(renderer::TileStore::removeUnused(store_dir), 1);
+
+	// transparent tiles are remembered, also when the zoom level increases
+	std::ofstream((output_dir / "3.png").string().c_str()).close();
+	store.setTransparent(tile1, output_dir / "3.png");
+	BOOST_CHECK(!fs::exists(output_dir / "3.png"));
+	BOOST_CHECK(store.isTransparent(tile1));
+	BOOST_CHECK(!store.isTransparent(tile2));
+	BOOST_REQUIRE(store.write());
+
+	renderer::TileStore store2(output_dir, store_dir);
+	store2.read(tile_set);
+	BOOST_CHECK(store2.isTransparent(tile1));
+	tile_set.setDepth(4);
+	store2.read(tile_set);
+	BOOST_CHECK(!store2.isTransparent(tile1));
+	BOOST_CHECK(store2.isTransparent(renderer::TilePath::byString("1/4/2/3")));
+
+	fs::remove_all(output_dir);
+}
+
+BOOST_AUTO_TEST_CASE(test_tile_archive) {
+	namespace fs = boost::filesystem;
+	fs::path filename = fs::temp_directory_path() / "mapcrafter_test_tiles.archive";
+	fs::remove(filename);
+
+	renderer::TilePath root;
+	renderer::TilePath tile = renderer::TilePath::byString("1/2/3");
+	{
+		renderer::TileArchive archive(filename);
+		BOOST_REQUIRE(archive.open());
+		BOOST_CHECK(archive.writeTile(root, "base"));
+		BOOST_CHECK(archive.writeTile(tile, "old image"));
+		BOOST_CHECK(archive.writeTile(tile, "image"));
+	}
+
+	// the tiles are read back from the index, updated tiles have their latest image
+	std::string data;
+	renderer::TileArchive archive(filename);
+	BOOST_REQUIRE(archive.open());
+	BOOST_CHECK(archive.readTile(tile, data));
+	BOOST_CHECK_EQUAL(data, "image");
+	BOOST_CHECK(archive.readTile(root, data));
+	BOOST_CHECK_EQUAL(data, "base");
+	BOOST_CHECK(!archive.hasTile(tile + 1));
+	BOOST_CHECK_EQUAL(archive.getTiles().size(), 2);
+
+	// the tiles move one zoom level deeper like the tile files
+	archive.increaseDepth();
+	BOOST_CHECK(!archive.hasTile(root));
+	BOOST_CHECK(!archive.hasTile(tile));
+	BOOST_CHECK(archive.readTile(renderer::TilePath::byString("1/4/2/3"), data));
+	BOOST_CHECK_EQUAL(data, "image");
+	// the unused images are removed when the archive is closed
+	BOOST_CHECK(archive.close());
+	BOOST_CHECK(fs::file_size(filename) < 100);
+
+	BOOST_REQUIRE(archive.open());
+	BOOST_CHECK(archive.readTile(renderer::TilePath::byString("1/4/2/3"), data));
+	BOOST_CHECK_EQUAL(data, "image");
+	archive.close();
+	fs::remove(filename);
+}
+
+BOOST_AUTO_TEST_CASE(test_render_journal_tile_archive) {
+	// the tiles in the journal of an interrupted rendering must be in the index of the
+	// tile archive, the archive writes its index before the journal is synced
+	namespace fs = boost::filesystem;
+	fs::path dir = fs::temp_directory_path() / "mapcrafter_test_journal_archive";
+	fs::path archive_filename = dir / renderer::TileArchive::FILENAME;
+	fs::path journal_filename = dir / "render.journal";
+	fs::remove_all(dir);
+	fs::create_directories(dir);
+
+	renderer::TopdownTileSet tile_set(1, renderer::RenderRotation(0));
+	tile_set.setDepth(3);
+	renderer::TilePath tiles[] = {renderer::TilePath::byString("1/2"),
+			renderer::TilePath::byString("4/3"), renderer::TilePath::byString("2/2")};
+	{
+		std::shared_ptr<renderer::TileArchive> archive
+			= std::make_shared<renderer::TileArchive>(archive_filename);
+		BOOST_REQUIRE(archive->open());
+		renderer::RenderJournal journal(journal_filename);
+		BOOST_REQUIRE(journal.open(tile_set, 1000, false));
+		journal.setTileArchive(archive);
+		for (int i = 0; i < 2; i++) {
+			BOOST_CHECK(archive->writeTile(tiles[i], "image " + mapcrafter::util::str(i)));
+			journal.add(tiles[i]);
+		}
+		journal.sync();
+		BOOST_CHECK(archive->writeTile(tiles[2], "image 2"));
+
+		// the rendering is killed now, just the files on disk are left
+		fs::copy_file(archive_filename, dir / "killed.archive");
+		fs::copy_file(journal_filename, dir / "killed.journal");
+	}
+	fs::rename(dir / "killed.archive", archive_filename);
+	fs::rename(dir / "killed.journal", journal_filename);
+
+	// the resumed rendering finds the tiles of the journal in the archive
+	std::time_t started;
+	std::vector<renderer::TilePath> rendered;
+	renderer::RenderJournal journal(journal_filename);
+	BOOST_REQUIRE(journal.read(tile_set, started, rendered));
+	BOOST_REQUIRE_EQUAL(rendered.size(), 2);
+	std::shared_ptr<renderer::TileArchive> archive
+		= std::make_shared<renderer::TileArchive>(archive_filename);
+	BOOST_REQUIRE(archive->open());
+	std::string data;
+	for (int i = 0; i < 2; i++) {
+		BOOST_CHECK_EQUAL(rendered[i], tiles[i]);
+		BOOST_CHECK(archive->readTile(tiles[i], data));
+		BOOST_CHECK_EQUAL(data, "image " + mapcrafter::util::str(i));
+	}
+	BOOST_CHECK(!archive->hasTile(tiles[2]));
+
+	// and renders the missing tile again
+	BOOST_REQUIRE(journal.open(tile_set, started, true));
+	journal.setTileArchive(archive);
+	BOOST_CHECK(archive->writeTile(tiles[2], "image 2"));
+	journal.add(tiles[2]);
+	journal.sync();
+	renderer::TileArchive resumed_archive(archive_filename);
+	BOOST_REQUIRE(resumed_archive.open());
+	BOOST_REQUIRE(journal.read(tile_set, started, rendered));
+	BOOST_CHECK_EQUAL(rendered.size(), 3);
+	for (auto it = rendered.begin(); it != rendered.end(); ++it)
+		BOOST_CHECK(resumed_archive.hasTile(*it));
+
+	journal.remove();
+	archive->close();
+	resumed_archive.close();
+	fs::remove_all(dir);
+}
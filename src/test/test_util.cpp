@@ -47,3 +47,34 @@ BOOST_AUTO_TEST_CASE(util_testMath) {
 	BOOST_CHECK_EQUAL(util::binary<11011101>::value, 221);
 }
 
+
+BOOST_AUTO_TEST_CASE(util_testProfiling) {
+	// nothing is recorded without a profile
+	util::RenderProfile profile;
+	{
+		util::ProfileTimer timer(util::ProfilePhase::BLOCK_DRAW);
+		util::profileCount(util::ProfileCounter::BLOCKS_DRAWN);
+	}
+	BOOST_CHECK_EQUAL(profile.phase_calls[(int) util::ProfilePhase::BLOCK_DRAW], 0);
+
+	{
+		util::ProfileThreadScope scope(&profile);
+		util::ProfileTimer outer(util::ProfilePhase::COLUMN_TRAVERSAL);
+		for (int i = 0; i < 3; i++) {
+			util::ProfileTimer inner(util::ProfilePhase::BLOCK_DRAW);
+			util::profileCount(util::ProfileCounter::BLOCKS_DRAWN);
+		}
+	}
+	BOOST_CHECK(util::ProfileThreadScope::getProfile() == nullptr);
+	BOOST_CHECK_EQUAL(profile.phase_calls[(int) util::ProfilePhase::COLUMN_TRAVERSAL], 1);
+	BOOST_CHECK_EQUAL(profile.phase_calls[(int) util::ProfilePhase::BLOCK_DRAW], 3);
+	BOOST_CHECK_EQUAL(profile.counters[(int) util::ProfileCounter::BLOCKS_DRAWN], 3);
+
+	util::ProfileCollector collector;
+	collector.merge(profile);
+	collector.merge(profile);
+	util::RenderProfile merged = collector.getProfile();
+	BOOST_CHECK_EQUAL(merged.phase_calls[(int) util::ProfilePhase::BLOCK_DRAW], 6);
+	BOOST_CHECK_EQUAL(merged.counters[(int) util::ProfileCounter::BLOCKS_DRAWN], 6);
+	BOOST_CHECK_CLOSE(merged.getTotalTime(), 2 * profile.getTotalTime(), 0.0001);
+}
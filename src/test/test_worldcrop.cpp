@@ -17,10 +17,14 @@
  * along with Mapcrafter.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include "../mapcraftercore/mc/blockstate.h"
+#include "../mapcraftercore/mc/chunk.h"
 #include "../mapcraftercore/mc/worldcrop.h"
 #include "../mapcraftercore/util.h"
+#include "../bench/syntheticworld.h"
 
 #include <set>
+#include <vector>
 #include <boost/test/unit_test.hpp>
 
 namespace mc = mapcrafter::mc;
@@ -177,3 +181,69 @@ BOOST_AUTO_TEST_CASE(world_crop_block_mask) {
 	BOOST_CHECK_THROW(mask.loadFromStringDefinition("3:15b"), std::invalid_argument);
 	BOOST_CHECK_THROW(mask.loadFromStringDefinition("3:15b18"), std::invalid_argument);
 }
+
+BOOST_AUTO_TEST_CASE(world_crop_chunk) {
+	// the cropped and hidden blocks of a chunk look like empty space (air, no block light,
+	// full sky light), the other blocks are the same as in the chunk without crop, also
+	// at the boundaries of the sections and chunks
+	mc::BlockStateRegistry block_registry;
+	mapcrafter::bench::SyntheticWorld synthetic(2);
+	uint16_t stone = block_registry.getBlockID(mc::BlockState("minecraft:stone"));
+
+	mc::WorldCrop crops[3];
+	// y bounds at section boundaries, x bounds within chunk 0, z bounds at chunk boundaries
+	crops[0].setMinY(64);
+	crops[0].setMaxY(95);
+	crops[0].setMinX(8);
+	crops[0].setMaxZ(15);
+	// y bounds within sections and a block mask
+	crops[1].setMinY(-10);
+	crops[1].setMaxY(70);
+	crops[1].loadBlockMask("!" + util::str(stone));
+	// just a block mask
+	crops[2].loadBlockMask("!" + util::str(stone));
+
+	mc::ChunkPos chunks[] = {mc::ChunkPos(0, 0), mc::ChunkPos(1, 0), mc::ChunkPos(0, 1)};
+	for (int c = 0; c < 3; c++) {
+		std::vector<uint8_t> data = synthetic.createChunkData(chunks[c]);
+		mc::Chunk plain;
+		BOOST_REQUIRE(plain.readNBT(block_registry, reinterpret_cast<const char*>(&data[0]),
+				data.size()));
+
+		for (int i = 0; i < 3; i++) {
+			const mc::WorldCrop& crop = crops[i];
+			mc::Chunk cropped;
+			cropped.setWorldCrop(crop);
+			BOOST_REQUIRE(cropped.readNBT(block_registry,
+					reinterpret_cast<const char*>(&data[0]), data.size()));
+
+			int hidden_blocks = 0, shown_blocks = 0;
+			for (int y = mc::CHUNK_LOWEST * 16; y < mc::CHUNK_HIGHEST * 16; y++)
+				for (int z = 0; z < 16; z++)
+					for (int x = 0; x < 16; x++) {
+						mc::LocalBlockPos pos(x, z, y);
+						mc::BlockPos global = pos.toGlobalPos(chunks[c]);
+						uint16_t id = plain.getBlockID(pos);
+						bool hidden = !crop.isBlockContainedXZ(global)
+							|| !crop.isBlockContainedY(global)
+							|| (crop.hasBlockMask() && crop.getBlockMask()->isHidden(id, 0));
+						if (hidden) {
+							hidden_blocks++;
+							if (cropped.getBlockID(pos) != mc::Chunk::nop_id
+									|| cropped.getBlockLight(pos) != 0
+									|| cropped.getSkyLight(pos) != 15)
+								BOOST_ERROR("hidden block " << global << " of crop " << i);
+						} else {
+							shown_blocks++;
+							if (cropped.getBlockID(pos) != id
+									|| cropped.getBlockLight(pos) != plain.getBlockLight(pos)
+									|| cropped.getSkyLight(pos) != plain.getSkyLight(pos))
+								BOOST_ERROR("shown block " << global << " of crop " << i);
+						}
+					}
+			BOOST_CHECK(hidden_blocks > 0);
+			// the chunk outside the z bounds is cropped completely
+			BOOST_CHECK_EQUAL(shown_blocks == 0, i == 0 && chunks[c].z == 1);
+		}
+	}
+}
@@ -0,0 +1,143 @@
+/*
+ * Copyright 2012-2016 Moritz Hilscher
+ *
+ * This file is part of Mapcrafter.
+ *
+ * Mapcrafter is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mapcrafter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mapcrafter.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "testworld.h"
+
+#include "../mapcraftercore/mc/blockstate.h"
+#include "../mapcraftercore/renderer/biomes.h"
+#include "../mapcraftercore/renderer/blockimages.h"
+#include "../mapcraftercore/renderer/renderview.h"
+#include "../mapcraftercore/renderer/tileset.h"
+#include "../mapcraftercore/util.h"
+#include "../bench/syntheticworld.h"
+
+#include <algorithm>
+#include <sstream>
+#include <boost/test/unit_test.hpp>
+
+namespace mapcrafter {
+namespace test {
+
+std::shared_ptr<mc::World> loadDataWorld() {
+	std::shared_ptr<mc::World> world(new mc::World("data", mc::Dimension::OVERWORLD,
+			(fs::temp_directory_path() / "mapcrafter_test_cache").string()));
+	BOOST_REQUIRE(world->load());
+	return world;
+}
+
+std::unique_ptr<renderer::TopdownTileSet> scanTileSet(const mc::World& world,
+		int rotation) {
+	std::unique_ptr<renderer::TopdownTileSet> tile_set(new renderer::TopdownTileSet(1,
+			renderer::RenderRotation(rotation)));
+	tile_set->scan(world);
+	return tile_set;
+}
+
+SyntheticMap::SyntheticMap(const std::string& name, int size, const std::string& map_options)
+	: dir(fs::temp_directory_path() / ("mapcrafter_test_" + name)),
+	  map_options(map_options) {
+	fs::remove_all(dir);
+	bench::SyntheticWorld synthetic(size);
+	BOOST_REQUIRE(synthetic.write(dir / "world"));
+}
+
+SyntheticMap::~SyntheticMap() {
+	fs::remove_all(dir);
+}
+
+const fs::path& SyntheticMap::getDirectory() const {
+	return dir;
+}
+
+config::MapcrafterConfig SyntheticMap::getConfig(const std::string& output_name) const {
+	std::stringstream ss;
+	ss << "output_dir = " << (dir / output_name).string() << std::endl;
+	ss << "template_dir = ../data/template" << std::endl;
+	ss << "[world:world]" << std::endl;
+	ss << "input_dir = " << (dir / "world").string() << std::endl;
+	ss << "[map:map]" << std::endl;
+	ss << "world = world" << std::endl;
+	ss << "block_dir = ../data/blocks" << std::endl;
+	ss << map_options << std::endl;
+	config::MapcrafterConfig config;
+	BOOST_REQUIRE(!config.parseString(ss.str()).isCritical());
+	return config;
+}
+
+std::shared_ptr<mc::World> SyntheticMap::loadWorld() const {
+	config::MapcrafterConfig config = getConfig();
+	std::shared_ptr<mc::World> world(new mc::World((dir / "world").string(),
+			config.getWorld("world").getDimension(), config.getCachePath("world").string()));
+	BOOST_REQUIRE(world->load());
+	return world;
+}
+
+renderer::RenderContext SyntheticMap::createRenderContext(int rotation,
+		std::shared_ptr<mc::World> world,
+		std::shared_ptr<mc::BlockStateRegistry> block_registry) {
+	config::MapcrafterConfig config = getConfig();
+	config::WorldSection world_config = config.getWorld("world");
+	config::MapSection map_config = config.getMap("map");
+	renderer::RenderRotation::Direction direction =
+			static_cast<renderer::RenderRotation::Direction>(rotation);
+
+	std::shared_ptr<renderer::RenderView> render_view(renderer::createRenderView(
+			map_config.getRenderView(), direction, map_config.getWaterOpacity()));
+	std::shared_ptr<renderer::TileSet> tile_set(render_view->createTileSet(
+			map_config.getTileWidth()));
+	tile_set->scan(*world);
+
+	std::string view = util::str(map_config.getRenderView());
+	std::shared_ptr<renderer::BlockImages> block_images(
+			render_view->createBlockImages(*block_registry));
+	render_view->configureBlockImages(block_images.get(), world_config, map_config);
+	BOOST_REQUIRE(dynamic_cast<renderer::RenderedBlockImages&>(*block_images).loadBlockImages(
+			map_config.getBlockDir().string(), view, rotation, map_config.getTextureSize()));
+	std::shared_ptr<renderer::BlockImages> lod_block_images;
+	int lod_levels = std::min(map_config.getLODLevels(), tile_set->getDepth());
+	if (lod_levels > 0) {
+		lod_block_images.reset(render_view->createBlockImages(*block_registry));
+		render_view->configureBlockImages(lod_block_images.get(), world_config, map_config);
+		BOOST_REQUIRE(dynamic_cast<renderer::RenderedBlockImages&>(*lod_block_images)
+				.loadBlockImages(map_config.getBlockDir().string(), view, rotation,
+						map_config.getTextureSize(), 1 << lod_levels));
+	}
+	renderer::Biome::initializeBiomes();
+
+	render_objects.push_back(render_view);
+	render_objects.push_back(tile_set);
+	render_objects.push_back(block_images);
+	render_objects.push_back(block_registry);
+
+	renderer::RenderContext context;
+	context.output_dir = config.getOutputPath("map/" + config::ROTATION_NAMES_SHORT[rotation]);
+	context.background_color = config.getBackgroundColor();
+	context.world_config = world_config;
+	context.map_config = map_config;
+	context.render_view = render_view.get();
+	context.block_images = block_images.get();
+	context.lod_block_images = lod_block_images;
+	context.tile_set = tile_set.get();
+	context.block_registry = block_registry.get();
+	context.world = world;
+	return context;
+}
+
+}
+}
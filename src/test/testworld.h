@@ -0,0 +1,97 @@
+/*
+ * Copyright 2012-2016 Moritz Hilscher
+ *
+ * This file is part of Mapcrafter.
+ *
+ * Mapcrafter is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mapcrafter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mapcrafter.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TESTWORLD_H_
+#define TESTWORLD_H_
+
+#include "../mapcraftercore/config/mapcrafterconfig.h"
+#include "../mapcraftercore/mc/world.h"
+#include "../mapcraftercore/renderer/renderviews/topdown/tileset.h"
+#include "../mapcraftercore/renderer/tilerenderworker.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <boost/filesystem.hpp>
+
+namespace fs = boost::filesystem;
+
+namespace mapcrafter {
+namespace test {
+
+/**
+ * Loads the world of the test data directory. Its chunks are too old to be read, but
+ * its region files are enough to scan the tile sets of the world.
+ */
+std::shared_ptr<mc::World> loadDataWorld();
+
+/**
+ * Creates a top view tile set with a tile width of one chunk and scans the required
+ * tiles of a world.
+ */
+std::unique_ptr<renderer::TopdownTileSet> scanTileSet(const mc::World& world,
+		int rotation = 0);
+
+/**
+ * A map of a synthetic world (see bench/syntheticworld.h) which is written to a
+ * temporary directory. The world is called "world" and the map "map", the map renders
+ * into the output directory next to the world.
+ */
+class SyntheticMap {
+public:
+	/**
+	 * Writes a synthetic world of a size (in chunks) to a temporary directory with the
+	 * name of the test. The map options (lines "key = value") are added to the map.
+	 */
+	SyntheticMap(const std::string& name, int size, const std::string& map_options = "");
+	~SyntheticMap();
+
+	const fs::path& getDirectory() const;
+
+	/**
+	 * Returns the configuration of the map, rendering into an output directory of
+	 * another name if specified.
+	 */
+	config::MapcrafterConfig getConfig(const std::string& output_name = "output") const;
+
+	/**
+	 * Loads the world of the map (a new world object every time).
+	 */
+	std::shared_ptr<mc::World> loadWorld() const;
+
+	/**
+	 * Creates the render context of a rotation of the map like the render manager, all
+	 * tiles are required. This object keeps the render view, block images and tile set
+	 * the render context refers to.
+	 */
+	renderer::RenderContext createRenderContext(int rotation,
+			std::shared_ptr<mc::World> world,
+			std::shared_ptr<mc::BlockStateRegistry> block_registry);
+
+private:
+	fs::path dir;
+	std::string map_options;
+
+	std::vector<std::shared_ptr<void> > render_objects;
+};
+
+}
+}
+
+#endif /* TESTWORLD_H_ */